@@ -35,10 +35,7 @@ AssetCache::AssetCache(Foundation::Framework* framework) :
     memory_cache_size_ = framework_->GetDefaultConfig().DeclareSetting("AssetSystem", "memory_cache_size", DEFAULT_MEMORY_CACHE_SIZE);
 
     // Get path of local secondary cache
-    std::string local_cache_path = framework_->GetDefaultConfig().DeclareSetting("AssetSystem", "local_cache_path", std::string("./data/assetcache"));
-    
-    CheckDiskCache(cache_path_);
-    CheckDiskCache(local_cache_path);
+    local_cache_path_ = framework_->GetDefaultConfig().DeclareSetting("AssetSystem", "local_cache_path", std::string("./data/assetcache"));
 
     md5_engine_ = new QCryptographicHash(QCryptographicHash::Md5);
 }
@@ -48,6 +45,18 @@ AssetCache::~AssetCache()
     SAFE_DELETE(md5_engine_);
 }
 
+void AssetCache::ScanDiskCaches()
+{
+    CheckDiskCache(cache_path_);
+    CheckDiskCache(local_cache_path_);
+}
+
+void AssetCache::AddScannedDiskCaches()
+{
+    disk_cache_contents_.insert(scanned_disk_cache_contents_.begin(), scanned_disk_cache_contents_.end());
+    scanned_disk_cache_contents_.clear();
+}
+
 void AssetCache::CheckDiskCache(const std::string& path)
 {
     try
@@ -58,7 +67,7 @@ void AssetCache::CheckDiskCache(const std::string& path)
         {
             if (boost::filesystem::is_regular_file(i->status()))
             {
-                disk_cache_contents_.insert(i->path().native_directory_string());
+                scanned_disk_cache_contents_.insert(i->path().native_directory_string());
             }
             ++i;
         }
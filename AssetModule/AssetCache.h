@@ -43,6 +43,15 @@ namespace Asset
         //! Update. Adds age to assets, removes oldest if cache size too big
         void Update(f64 frametime);
 
+        //! Scans the disk cache paths for cached assets
+        /*! Only fills in the scan results, so may be called from a worker thread while the cache is in use.
+            The assets are not found from the disk cache before AddScannedDiskCaches() is called.
+         */
+        void ScanDiskCaches();
+
+        //! Adds the assets found by ScanDiskCaches() to the assets known to be in disk cache
+        void AddScannedDiskCaches();
+
     private:
         //! Check contents of a disk cache path
         /*! \param path Disk cache path
@@ -58,6 +67,9 @@ namespace Asset
 
         //! Current disk asset cache path
         std::string cache_path_;
+
+        //! Local secondary disk cache path
+        std::string local_cache_path_;
         
         //! Maximum memory cache size
         uint memory_cache_size_;
@@ -69,6 +81,9 @@ namespace Asset
         //! Values are hash values from asset id's
         std::set<std::string> disk_cache_contents_;
 
+        //! Assets found in disk cache by ScanDiskCaches(), not yet added to disk_cache_contents_
+        std::set<std::string> scanned_disk_cache_contents_;
+
         //! Framework
         Foundation::Framework* framework_;
 
@@ -192,6 +192,16 @@ namespace Asset
         // Update cache
         cache_->Update(frametime); 
     }
+
+    void AssetManager::ScanDiskCaches()
+    {
+        cache_->ScanDiskCaches();
+    }
+
+    void AssetManager::AddScannedDiskCaches()
+    {
+        cache_->AddScannedDiskCaches();
+    }
     
     Foundation::AssetPtr AssetManager::GetFromCache(const std::string& asset_id)
     {
@@ -256,4 +266,14 @@ namespace Asset
         } 
         return ret;
     }
+
+    void AssetManager::SetAssetPriority(const std::string& asset_id, Real priority)
+    {
+        AssetProviderVector::iterator i = providers_.begin();
+        while (i != providers_.end())
+        {
+            (*i)->SetAssetPriority(asset_id, priority);
+            ++i;
+        }
+    }
 }
@@ -84,6 +84,12 @@ namespace Asset
         //! Gets information about current asset transfers
         virtual Foundation::AssetTransferInfoVector GetAssetTransferInfo();
         
+        //! Sets download priority of an asset
+        /*! \param asset_id Asset ID
+            \param priority Estimated on-screen size of the asset in pixels, 0 if not visible at all
+         */
+        virtual void SetAssetPriority(const std::string& asset_id, Real priority);
+
         //! Registers an asset provider
         /*! \param asset_provider Provider to register
             \return true if successfully registered
@@ -107,6 +113,12 @@ namespace Asset
          */
         void Update(f64 frametime);            
         
+        //! Scans the disk caches for cached assets. May be called from a worker thread.
+        void ScanDiskCaches();
+
+        //! Makes the assets found by ScanDiskCaches() available from the disk cache
+        void AddScannedDiskCaches();
+
     private:      
         //! Gets new request tag
         request_tag_t GetNextTag();
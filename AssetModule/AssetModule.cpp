@@ -32,7 +32,7 @@ namespace Asset
     }
 
     // virtual
-    void AssetModule::Initialize()
+    void AssetModule::PreInitialize()
     {
         manager_ = AssetManagerPtr(new AssetManager(framework_));
         framework_->GetServiceManager()->RegisterService(Foundation::Service::ST_Asset, manager_);
@@ -52,8 +52,17 @@ namespace Asset
         framework_category_id_ = framework_->GetEventManager()->QueryEventCategory("Framework");
     }
 
+    // virtual
+    void AssetModule::Initialize()
+    {
+        // May run on a worker thread (see AssetModule.xml), so only scan the disk caches here
+        manager_->ScanDiskCaches();
+    }
+
     void AssetModule::PostInitialize()
     {
+        manager_->AddScannedDiskCaches();
+
         RegisterConsoleCommand(Console::CreateCommand(
             "RequestAsset", "Request asset from server. Usage: RequestAsset(uuid,assettype)", 
             Console::Bind(this, &AssetModule::ConsoleRequestAsset)));
@@ -41,6 +41,7 @@ namespace Asset
         virtual ~AssetModule();
 
         virtual void Load();
+        virtual void PreInitialize();
         virtual void Initialize();
         virtual void PostInitialize();
         virtual void Uninitialize();
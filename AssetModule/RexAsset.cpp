@@ -9,5 +9,13 @@ namespace Asset
         age_(0.0)
     {
     }
+
+    RexAssetView::RexAssetView(boost::shared_ptr<RexAsset> asset, uint size) :
+        asset_(asset),
+        data_(asset->GetData()),
+        size_(std::min(size, asset->GetSize())),
+        metadata_(asset->GetMetadata())
+    {
+    }
     
 }
@@ -65,6 +65,49 @@ namespace Asset
 		mutable f64 age_;
     };
 
+    //! Read-only view to the beginning of the data of a RexAsset. Implements the AssetInterface.
+    /*! Used to give the continuous part of a transfer in progress to progressive decoders without copying it.
+        Keeps the viewed asset alive, but the owner of the asset must not reallocate its data while views exist.
+        \ingroup AssetModuleClient
+     */
+    class RexAssetView : public Foundation::AssetInterface
+    {
+    public:
+        //! constructor
+        /*! \param asset Asset to view
+            \param size Number of bytes from the beginning of the asset data to show
+         */
+        RexAssetView(boost::shared_ptr<RexAsset> asset, uint size);
+
+        //! destructor
+        virtual ~RexAssetView() {};
+
+        //! returns asset ID
+        virtual const std::string& GetId() const { return asset_->GetId(); }
+
+        //! returns asset type
+        virtual const std::string& GetType() const { return asset_->GetType(); }
+
+        //! returns size of the viewed data
+        virtual uint GetSize() const { return size_; }
+
+        //! returns viewed data
+        virtual const u8* GetData() const { return data_; }
+
+        //! returns asset metadata
+        virtual Foundation::AssetMetadataInterface* GetMetadata() const { return metadata_; }
+
+    private:
+        //! viewed asset
+        boost::shared_ptr<RexAsset> asset_;
+        //! viewed data, taken at construction so that the view can be read from other threads
+        const u8* data_;
+        //! size of viewed data
+        uint size_;
+        //! metadata of viewed asset
+        Foundation::AssetMetadataInterface* metadata_;
+    };
+
 }
 
 #endif
@@ -16,17 +16,73 @@
 #include "ServiceManager.h"
 #include "ConfigurationManager.h"
 
+#include <algorithm>
+#include <cmath>
+
 using namespace OpenSimProtocol;
 using namespace RexTypes;
 
 namespace Asset
 {
     const Real UDPAssetProvider::DEFAULT_ASSET_TIMEOUT = 120.0;
+    const uint UDPAssetProvider::DEFAULT_MAX_TEXTURE_TRANSFERS = 32;
+    const Real UDPAssetProvider::DEFAULT_TEXTURE_PARK_THRESHOLD = 16.0;
+
+    //! How often texture priorities are checked for changes, in seconds
+    static const f64 TEXTURE_PRIORITY_INTERVAL = 0.5;
+
+    //! On-screen size assumed for textures that have not been given a priority, in pixels
+    static const Real DEFAULT_TEXTURE_PRIORITY = 256.0 * 256.0;
+
+    //! Priority changes smaller than this fraction are not sent to the server
+    static const Real TEXTURE_PRIORITY_CHANGE = 0.25;
+
+    //! Assumed full-resolution width of a texture, used to choose the discard level
+    static const Real NOMINAL_TEXTURE_SIZE = 512.0;
+
+    //! Largest discard level requested; the server can't go further than the number of resolution levels in the image
+    static const s8 MAX_DISCARD_LEVEL = 4;
+
+    //! Transfers that haven't received anything in this many seconds don't take up a transfer slot
+    static const f64 TEXTURE_STALL_TIME = 5.0;
+
+    //! Size of the image data in the ImageData message
+    static const uint TEXTURE_FIRST_PACKET_SIZE = 600;
+
+    //! Size of the image data in the ImagePacket messages, except the last one
+    static const uint TEXTURE_PACKET_SIZE = 1000;
+
+    //! Maximum number of image blocks in one RequestImage message
+    static const uint MAX_IMAGE_REQUEST_BLOCKS = 32;
+
+    //! Returns the discard level at which the texture still has at least as many pixels as it covers on screen
+    static s8 DiscardLevelForPriority(Real priority)
+    {
+        Real screen_size = sqrt(std::max(priority, (Real)1.0));
+        Real texture_size = NOMINAL_TEXTURE_SIZE;
+        s8 discard_level = 0;
+        while ((discard_level < MAX_DISCARD_LEVEL) && (texture_size * 0.5 >= screen_size))
+        {
+            texture_size *= 0.5;
+            ++discard_level;
+        }
+        return discard_level;
+    }
+
+    typedef std::pair<Real, size_t> PrioritizedRequest;
+
+    static bool CompareRequestPriority(const PrioritizedRequest& lhs, const PrioritizedRequest& rhs)
+    {
+        return lhs.first > rhs.first;
+    }
 
     UDPAssetProvider::UDPAssetProvider(Foundation::Framework* framework) :
-        framework_(framework)
+        framework_(framework),
+        texture_priority_time_(0.0)
     {
         asset_timeout_ = framework_->GetDefaultConfig().DeclareSetting("AssetSystem", "udp_timeout", DEFAULT_ASSET_TIMEOUT);
+        max_texture_transfers_ = framework_->GetDefaultConfig().DeclareSetting("AssetSystem", "udp_max_texture_transfers", DEFAULT_MAX_TEXTURE_TRANSFERS);
+        texture_park_threshold_ = framework_->GetDefaultConfig().DeclareSetting("AssetSystem", "udp_texture_park_threshold", DEFAULT_TEXTURE_PARK_THRESHOLD);
 
         Foundation::EventManagerPtr event_manager = framework_->GetEventManager();
 
@@ -83,21 +139,22 @@ namespace Asset
         UDPAssetTransfer* transfer = GetTransfer(asset_id);
 
         if ((transfer) && (transfer->GetReceivedContinuous() >= received))
-        {
-            // Make new temporary asset for the incomplete data
-            RexAsset* new_asset = new RexAsset(transfer->GetAssetId(), GetTypeNameFromAssetType(transfer->GetAssetType()));
-            Foundation::AssetPtr asset_ptr(new_asset);
-            
-            RexAsset::AssetDataVector& data = new_asset->GetDataInternal();
-            data.resize(transfer->GetReceivedContinuous());
-            transfer->AssembleData(&data[0]);
-
-            return asset_ptr;
-        }
+            return transfer->GetContinuousAsset();
 
         return Foundation::AssetPtr();
     }
 
+    void UDPAssetProvider::SetAssetPriority(const std::string& asset_id, Real priority)
+    {
+        if (!RexUUID::IsValid(asset_id))
+            return;
+
+        if (priority < 0.0)
+            texture_priorities_.erase(RexUUID(asset_id));
+        else
+            texture_priorities_[RexUUID(asset_id)] = priority;
+    }
+
     void UDPAssetProvider::SetCurrentProtocolModule(boost::weak_ptr<ProtocolUtilities::ProtocolModuleInterface> protocolModule)
     {
         protocolModule_ = protocolModule;
@@ -138,6 +195,9 @@ namespace Asset
         // Connection exists, send any pending requests
         SendPendingRequests(net);
 
+        // Tell the server about textures that have become more or less important
+        UpdateTexturePriorities(net, frametime);
+
         // Handle timeouts for texture & asset transfers
         // Disable asset timeouts for now, a long transfer may stall all others on the server
         // HandleTextureTimeouts(net, frametime);
@@ -216,7 +276,7 @@ namespace Asset
         }
 
         for(int j = 0; j < erase_tex.size(); ++j)
-            texture_transfers_.erase(erase_tex[j]);
+            RemoveTextureTransfer(erase_tex[j]);
     }
 
     void UDPAssetProvider::HandleAssetTimeouts(boost::shared_ptr<ProtocolUtilities::ProtocolModuleInterface> net, f64 frametime)
@@ -259,19 +319,171 @@ namespace Asset
 
     void UDPAssetProvider::SendPendingRequests(boost::shared_ptr<ProtocolUtilities::ProtocolModuleInterface> net)
     {
-        AssetRequestVector::iterator i = pending_requests_.begin();
-        while(i != pending_requests_.end())
+        if (pending_requests_.empty())
+            return;
+
+        // Other assets, and textures that are already being transferred, can be handled right away. New texture
+        // transfers are started in priority order as long as there are free transfer slots
+        AssetRequestVector requests;
+        requests.swap(pending_requests_);
+
+        std::vector<PrioritizedRequest> textures;
+        for(size_t i = 0; i < requests.size(); ++i)
         {
-            RexUUID asset_uuid(i->asset_id_);
-            if (i->asset_type_ == RexAT_Texture)
-                RequestTexture(net, asset_uuid, i->tags_);
+            const AssetRequest& request = requests[i];
+            RexUUID asset_uuid(request.asset_id_);
+            if (request.asset_type_ != RexAT_Texture)
+                RequestOtherAsset(net, asset_uuid, request.asset_type_, request.tags_);
+            else if (GetTransfer(request.asset_id_))
+                RequestTexture(net, asset_uuid, request.tags_);
             else
-                RequestOtherAsset(net, asset_uuid, i->asset_type_, i->tags_);
+                textures.push_back(PrioritizedRequest(GetTexturePriority(asset_uuid), i));
+        }
+
+        if (textures.empty())
+            return;
 
-            i = pending_requests_.erase(i);
+        std::stable_sort(textures.begin(), textures.end(), CompareRequestPriority);
+
+        uint active = GetActiveTextureTransfers();
+        for(size_t i = 0; i < textures.size(); ++i)
+        {
+            const AssetRequest& request = requests[textures[i].second];
+            bool new_transfer = (GetTransfer(request.asset_id_) == 0);
+            if ((new_transfer) && (max_texture_transfers_) && (active >= max_texture_transfers_))
+            {
+                pending_requests_.push_back(request);
+                continue;
+            }
+
+            RexUUID asset_uuid(request.asset_id_);
+            RequestTexture(net, asset_uuid, request.tags_);
+            if ((new_transfer) && (!texture_transfers_[asset_uuid].IsParked()))
+                ++active;
         }
     }
 
+    void UDPAssetProvider::UpdateTexturePriorities(boost::shared_ptr<ProtocolUtilities::ProtocolModuleInterface> net, f64 frametime)
+    {
+        UDPAssetTransferMap::iterator i = texture_transfers_.begin();
+        while (i != texture_transfers_.end())
+        {
+            i->second.AddTime(frametime);
+            ++i;
+        }
+
+        texture_priority_time_ += frametime;
+        if (texture_priority_time_ < TEXTURE_PRIORITY_INTERVAL)
+            return;
+        texture_priority_time_ = 0.0;
+
+        std::vector<RexUUID> changed;
+        for(i = texture_transfers_.begin(); i != texture_transfers_.end(); ++i)
+        {
+            UDPAssetTransfer& transfer = i->second;
+            Real priority = GetTexturePriority(i->first);
+
+            if (priority < texture_park_threshold_)
+            {
+                if (!transfer.IsParked())
+                {
+                    AssetModule::LogDebug("Parking texture " + transfer.GetAssetId());
+                    transfer.SetParked(true);
+                    changed.push_back(i->first);
+                }
+                continue;
+            }
+
+            s8 discard_level = DiscardLevelForPriority(priority);
+            if ((transfer.IsParked()) || (discard_level != transfer.GetDiscardLevel()) ||
+                (fabs(priority - transfer.GetPriority()) > transfer.GetPriority() * TEXTURE_PRIORITY_CHANGE))
+            {
+                if (transfer.IsParked())
+                    AssetModule::LogDebug("Resuming texture " + transfer.GetAssetId());
+                transfer.SetParked(false);
+                transfer.SetPriority(priority);
+                transfer.SetDiscardLevel(discard_level);
+                // Don't let the time spent parked count as a stall
+                transfer.ResetTime();
+                changed.push_back(i->first);
+            }
+        }
+
+        SendTextureRequests(net, changed);
+    }
+
+    void UDPAssetProvider::SendTextureRequests(boost::shared_ptr<ProtocolUtilities::ProtocolModuleInterface> net,
+        const std::vector<RexUUID>& asset_ids)
+    {
+        const ProtocolUtilities::ClientParameters& client = net->GetClientParameters();
+
+        size_t start = 0;
+        while (start < asset_ids.size())
+        {
+            size_t count = std::min<size_t>(asset_ids.size() - start, MAX_IMAGE_REQUEST_BLOCKS);
+
+            ProtocolUtilities::NetOutMessage *m = net->StartMessageBuilding(RexNetMsgRequestImage);
+            assert(m);
+
+            m->AddUUID(client.agentID);
+            m->AddUUID(client.sessionID);
+
+            m->SetVariableBlockCount(count);
+            for(size_t j = start; j < start + count; ++j)
+            {
+                const UDPAssetTransfer& transfer = texture_transfers_[asset_ids[j]];
+                m->AddUUID(asset_ids[j]); // Image UUID
+                if (transfer.IsParked())
+                {
+                    m->AddS8(-1); // Discard level, -1 = cancel
+                    m->AddF32(0.0); // Download priority, 0 = cancel
+                    m->AddU32(0); // Starting packet
+                }
+                else
+                {
+                    m->AddS8(transfer.GetDiscardLevel()); // Discard level
+                    m->AddF32(transfer.GetPriority()); // Download priority
+                    m->AddU32(transfer.GetReceivedContinuousPackets()); // Starting packet
+                }
+                m->AddU8(RexIT_Normal); // Image type
+            }
+
+            m->MarkReliable();
+            net->FinishMessageBuilding(m);
+
+            start += count;
+        }
+    }
+
+    Real UDPAssetProvider::GetTexturePriority(const RexUUID& asset_id) const
+    {
+        TexturePriorityMap::const_iterator i = texture_priorities_.find(asset_id);
+        if (i == texture_priorities_.end())
+            return DEFAULT_TEXTURE_PRIORITY;
+
+        return i->second;
+    }
+
+    void UDPAssetProvider::RemoveTextureTransfer(const RexUUID& asset_id)
+    {
+        texture_transfers_.erase(asset_id);
+        texture_priorities_.erase(asset_id);
+    }
+
+    uint UDPAssetProvider::GetActiveTextureTransfers() const
+    {
+        uint active = 0;
+        UDPAssetTransferMap::const_iterator i = texture_transfers_.begin();
+        while (i != texture_transfers_.end())
+        {
+            if ((!i->second.IsParked()) && (i->second.GetTime() < TEXTURE_STALL_TIME))
+                ++active;
+            ++i;
+        }
+
+        return active;
+    }
+
     void UDPAssetProvider::RequestTexture(boost::shared_ptr<ProtocolUtilities::ProtocolModuleInterface> net, 
         const RexUUID& asset_id, const RequestTagVector& tags)
     {
@@ -284,30 +496,28 @@ namespace Asset
             return;
         }
 
-        const ProtocolUtilities::ClientParameters& client = net->GetClientParameters();
+        Real priority = GetTexturePriority(asset_id);
 
         UDPAssetTransfer new_transfer;
         new_transfer.SetAssetId(asset_id.ToString());
         new_transfer.SetAssetType(RexAT_Texture);
+        new_transfer.SetPacketLayout(TEXTURE_FIRST_PACKET_SIZE, TEXTURE_PACKET_SIZE);
         new_transfer.InsertTags(tags);
+        new_transfer.SetPriority(priority);
+        new_transfer.SetDiscardLevel(DiscardLevelForPriority(priority));
         texture_transfers_[asset_id] = new_transfer;
 
-        AssetModule::LogDebug("Requesting texture " + asset_id.ToString());
-
-        ProtocolUtilities::NetOutMessage *m = net->StartMessageBuilding(RexNetMsgRequestImage);
-        assert(m);
+        // A texture that is not visible is not requested until it becomes visible
+        if (priority < texture_park_threshold_)
+        {
+            AssetModule::LogDebug("Texture " + asset_id.ToString() + " not visible, parking it");
+            texture_transfers_[asset_id].SetParked(true);
+            return;
+        }
 
-        m->AddUUID(client.agentID);
-        m->AddUUID(client.sessionID);
+        AssetModule::LogDebug("Requesting texture " + asset_id.ToString());
 
-        m->SetVariableBlockCount(1);
-        m->AddUUID(asset_id); // Image UUID
-        m->AddS8(0); // Discard level
-        m->AddF32(100.0); // Download priority
-        m->AddU32(0); // Starting packet
-        m->AddU8(RexIT_Normal); // Image type
-        m->MarkReliable();
-        net->FinishMessageBuilding(m);
+        SendTextureRequests(net, std::vector<RexUUID>(1, asset_id));
     }
 
     void UDPAssetProvider::RequestOtherAsset(boost::shared_ptr<ProtocolUtilities::ProtocolModuleInterface> net,
@@ -396,6 +606,7 @@ namespace Asset
         pending_requests_.clear();
         asset_transfers_.clear();
         texture_transfers_.clear();
+        texture_priorities_.clear();
     }
 
     void UDPAssetProvider::HandleTextureHeader(ProtocolUtilities::NetInMessage* msg)
@@ -426,7 +637,7 @@ namespace Asset
         if (transfer.Ready())
         {
             StoreAsset(transfer);
-            texture_transfers_.erase(i);
+            RemoveTextureTransfer(asset_id);
         }
     }
 
@@ -454,7 +665,7 @@ namespace Asset
         if (transfer.Ready())
         {
             StoreAsset(transfer);
-            texture_transfers_.erase(i);
+            RemoveTextureTransfer(asset_id);
         }
     }
 
@@ -474,7 +685,7 @@ namespace Asset
         SendAssetCanceled(transfer);
 
         AssetModule::LogDebug("Transfer of texture " + asset_id.ToString() + " canceled");
-        texture_transfers_.erase(i);
+        RemoveTextureTransfer(asset_id);
     }
 
     void UDPAssetProvider::HandleAssetHeader(ProtocolUtilities::NetInMessage* msg)
@@ -614,13 +825,8 @@ namespace Asset
             service_manager->GetService<Foundation::AssetServiceInterface>(Foundation::Service::ST_Asset).lock();
         if (asset_service)
         {
-            const std::string& asset_id = transfer.GetAssetId();
-
-            Foundation::AssetPtr new_asset = Foundation::AssetPtr(new RexAsset(asset_id, GetTypeNameFromAssetType(transfer.GetAssetType())));
-            RexAsset::AssetDataVector& data = checked_static_cast<RexAsset*>(new_asset.get())->GetDataInternal();
-            data.resize(transfer.GetReceived());
-            transfer.AssembleData(&data[0]);
-
+            // The receive buffer already holds the complete data
+            Foundation::AssetPtr new_asset = transfer.GetAsset();
             asset_service->StoreAsset(new_asset);
 
             // Send asset ready event for each request tag
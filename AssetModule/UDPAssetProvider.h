@@ -64,6 +64,15 @@ namespace Asset
         //! Returns information about current asset transfers
         virtual Foundation::AssetTransferInfoVector GetTransferInfo();
         
+        //! Sets download priority of a texture
+        /*! Textures are requested in priority order, and the priority also decides the discard level asked from
+            the server. Textures that have never been given a priority are treated as moderately large on screen.
+            \param asset_id Texture UUID
+            \param priority Estimated on-screen size of the texture in pixels, 0 if not visible at all, or negative to
+                   forget the priority. The priority is also forgotten when the transfer of the texture ends.
+         */
+        virtual void SetAssetPriority(const std::string& asset_id, Real priority);
+
         virtual void SetCurrentProtocolModule(boost::weak_ptr<ProtocolUtilities::ProtocolModuleInterface> protocolModule);
 
         //! Performs time-based update 
@@ -96,6 +105,32 @@ namespace Asset
          */
         void SendPendingRequests(boost::shared_ptr<ProtocolUtilities::ProtocolModuleInterface> net);
 
+        //! Resends priorities and discard levels of texture transfers whose on-screen size has changed
+        /*! Transfers that fall below the park threshold are canceled on the server but keep their data,
+            and are resumed from the first missing packet when they become visible again.
+            \param net Connected network interface
+            \param frametime Time since last frame
+         */
+        void UpdateTexturePriorities(boost::shared_ptr<ProtocolUtilities::ProtocolModuleInterface> net, f64 frametime);
+
+        //! Sends RequestImage blocks for texture transfers, using the priority state stored in each transfer
+        /*! \param net Connected network interface
+            \param asset_ids Texture UUIDs
+         */
+        void SendTextureRequests(boost::shared_ptr<ProtocolUtilities::ProtocolModuleInterface> net,
+            const std::vector<RexUUID>& asset_ids);
+
+        //! Returns estimated on-screen size of a texture in pixels
+        Real GetTexturePriority(const RexUUID& asset_id) const;
+
+        //! Removes a completed or canceled texture transfer, and forgets the priority of the texture
+        void RemoveTextureTransfer(const RexUUID& asset_id);
+
+        //! Returns number of texture transfers that are receiving data
+        /*! Parked transfers and transfers that haven't received anything for a while are not counted
+         */
+        uint GetActiveTextureTransfers() const;
+
         //! Handles texture timeouts
         /*! \param net Connected network interface
             \param frametime Time since last frame
@@ -195,6 +230,25 @@ namespace Asset
         //! Default asset transfer timeout 
         static const Real DEFAULT_ASSET_TIMEOUT;
 
+        //! Maximum number of active texture transfers, 0 = unlimited
+        uint max_texture_transfers_;
+
+        //! On-screen size in pixels below which texture transfers are parked
+        Real texture_park_threshold_;
+
+        //! Time since texture priorities were last checked
+        f64 texture_priority_time_;
+
+        //! Estimated on-screen sizes of textures, as set by SetAssetPriority
+        typedef std::map<RexUUID, Real> TexturePriorityMap;
+        TexturePriorityMap texture_priorities_;
+
+        //! Default maximum number of active texture transfers
+        static const uint DEFAULT_MAX_TEXTURE_TRANSFERS;
+
+        //! Default park threshold, in pixels
+        static const Real DEFAULT_TEXTURE_PARK_THRESHOLD;
+
         //! Framework
         Foundation::Framework* framework_;
 
@@ -1,13 +1,23 @@
 #include "StableHeaders.h"
 #include "UDPAssetTransfer.h"
 #include "AssetModule.h"
+#include "RexAsset.h"
+#include "RexTypes.h"
 
 namespace Asset
 {
     UDPAssetTransfer::UDPAssetTransfer() :
         size_(0),
         received_(0),
-        time_(0.0)
+        received_continuous_(0),
+        received_continuous_packets_(0),
+        data_end_(0),
+        first_packet_size_(0),
+        packet_size_(0),
+        time_(0.0),
+        priority_(0.0f),
+        discard_level_(0),
+        parked_(false)
     {
     }
     
@@ -20,29 +30,25 @@ namespace Asset
         if (!size_) 
             return false; // No header received, size not known yet
         
-        return received_ >= size_;
+        return received_continuous_ >= size_;
     }
     
-    uint UDPAssetTransfer::GetReceivedContinuous() const
+    void UDPAssetTransfer::SetPacketLayout(uint first_packet_size, uint packet_size)
     {
-        uint size = 0;
-        
-        DataPacketMap::const_iterator i = data_packets_.begin();
-        
-        uint expected_index = 0;
-      
-        while (i != data_packets_.end())
-        {
-            if (i->first != expected_index)
-                break;
-            
-            size += i->second.size();
-            
-            ++expected_index;
-            ++i;
-        }
+        first_packet_size_ = first_packet_size;
+        packet_size_ = packet_size;
+    }
+    
+    void UDPAssetTransfer::SetSize(uint size)
+    {
+        size_ = size;
+        if (!size_)
+            return;
         
-        return size;
+        // From here on the buffer doesn't move, so views to it stay valid
+        GetBuffer().resize(size_);
+        data_end_ = std::min(data_end_, size_);
+        received_continuous_ = std::min(received_continuous_, size_);
     }
     
     void UDPAssetTransfer::ReceiveData(uint packet_index, const u8* data, uint size)
@@ -55,34 +61,113 @@ namespace Asset
             return;
         }
         
-        if (!data_packets_[packet_index].size())
+        if (((packet_index < received_packets_.size()) && (received_packets_[packet_index])) ||
+            (delayed_packets_.find(packet_index) != delayed_packets_.end()))
         {
-            data_packets_[packet_index].resize(size);
-            memcpy(&data_packets_[packet_index][0], data, size);
+            AssetModule::LogDebug("Already received asset data packet index " + ToString<uint>(packet_index));
+            return;
+        }
+        
+        if (packet_size_)
+        {
+            if (WritePacket(packet_index, GetPacketOffset(packet_index), data, size))
+                received_ += size;
+            UpdateContinuous();
+            return;
+        }
+        
+        // Packet sizes not known: data can only be placed right after the continuous data
+        if (packet_index != received_continuous_packets_)
+        {
+            delayed_packets_[packet_index].assign(data, data + size);
             received_ += size;
+            return;
         }
-        else
+        
+        if (WritePacket(packet_index, received_continuous_, data, size))
+            received_ += size;
+        UpdateContinuous();
+        
+        DataPacketMap::iterator i = delayed_packets_.find(received_continuous_packets_);
+        while (i != delayed_packets_.end())
         {
-            AssetModule::LogDebug("Already received asset data packet index " + ToString<uint>(packet_index));
+            if (!WritePacket(i->first, received_continuous_, &i->second[0], i->second.size()))
+                received_ -= i->second.size();
+            delayed_packets_.erase(i);
+            UpdateContinuous();
+            i = delayed_packets_.find(received_continuous_packets_);
         }
     }
     
-    void UDPAssetTransfer::AssembleData(u8* buffer) const
+    boost::shared_ptr<RexAsset> UDPAssetTransfer::GetAsset()
     {
-        DataPacketMap::const_iterator i = data_packets_.begin();
+        GetBuffer();
+        return asset_;
+    }
+    
+    Foundation::AssetPtr UDPAssetTransfer::GetContinuousAsset()
+    {
+        if (!received_continuous_)
+            return Foundation::AssetPtr();
+        
+        if (size_)
+            return Foundation::AssetPtr(new RexAssetView(asset_, received_continuous_));
+        
+        // The buffer may still be reallocated while the size is not known, so make a copy
+        RexAsset* new_asset = new RexAsset(asset_id_, RexTypes::GetTypeNameFromAssetType(asset_type_));
+        Foundation::AssetPtr asset_ptr(new_asset);
+        const std::vector<u8>& buffer = GetBuffer();
+        new_asset->GetDataInternal().assign(buffer.begin(), buffer.begin() + received_continuous_);
+        return asset_ptr;
+    }
+    
+    uint UDPAssetTransfer::GetPacketOffset(uint packet_index) const
+    {
+        if (!packet_index)
+            return 0;
         
-        uint expected_index = 0;
-      
-        while (i != data_packets_.end())
+        return first_packet_size_ + (packet_index - 1) * packet_size_;
+    }
+    
+    bool UDPAssetTransfer::WritePacket(uint packet_index, uint offset, const u8* data, uint size)
+    {
+        if ((size_) && (offset + size > size_))
         {
-            if (i->first != expected_index)
-                break;
-            
-            memcpy(buffer, &i->second[0], i->second.size());
-            buffer += i->second.size();
-            
-            ++expected_index;
-            ++i;
+            AssetModule::LogWarning("Asset data packet index " + ToString<uint>(packet_index) + " of " + asset_id_ +
+                " does not fit in the asset size");
+            return false;
         }
+        
+        std::vector<u8>& buffer = GetBuffer();
+        if (buffer.size() < offset + size)
+            buffer.resize(offset + size);
+        memcpy(&buffer[offset], data, size);
+        
+        if (packet_index >= received_packets_.size())
+            received_packets_.resize(packet_index + 1, false);
+        received_packets_[packet_index] = true;
+        
+        data_end_ = std::max(data_end_, offset + size);
+        return true;
+    }
+    
+    void UDPAssetTransfer::UpdateContinuous()
+    {
+        while ((received_continuous_packets_ < received_packets_.size()) && (received_packets_[received_continuous_packets_]))
+            ++received_continuous_packets_;
+        
+        // Without known packet sizes, data is only ever written at the end of the continuous part
+        if (packet_size_)
+            received_continuous_ = std::min(GetPacketOffset(received_continuous_packets_), data_end_);
+        else
+            received_continuous_ = data_end_;
+    }
+    
+    std::vector<u8>& UDPAssetTransfer::GetBuffer()
+    {
+        if (!asset_)
+            asset_ = boost::shared_ptr<RexAsset>(new RexAsset(asset_id_, RexTypes::GetTypeNameFromAssetType(asset_type_)));
+        
+        return asset_->GetDataInternal();
     }
-}
\ No newline at end of file
+}
@@ -4,9 +4,17 @@
 #define incl_Asset_UDPAssetTransfer_h
 
 #include "CoreTypes.h"
+#include "AssetInterface.h"
+
 namespace Asset
 {
+    class RexAsset;
+
     //! Stores data related to an UDP asset transfer that is in progress. Not necessary to clients of the AssetModule.
+    /*! Packets are written directly to their place in a single buffer, which is preallocated when the asset size
+        becomes known. The buffer is the data of the RexAsset that is stored to the cache when the transfer is ready,
+        and the continuous data received so far can be viewed without copying.
+     */
     class UDPAssetTransfer
     {
     public:
@@ -23,12 +31,23 @@ namespace Asset
          */
         void ReceiveData(uint packet_index, const u8* data, uint size);
         
-        //! Assembles continuous asset data to a buffer
-        /*! Call GetReceivedContinuous() (or GetReceived() if you know the transfer is complete)
-            first to know how big the buffer must be
-            \param buffer Pointer to buffer that will receive data
+        //! Sets sizes of the data packets, used to place each packet in the buffer
+        /*! If the packet size is not known (0), packets are placed one after another in order, and packets received
+            ahead of time are held back until the gap before them has been filled.
+            \param first_packet_size Size of packet 0
+            \param packet_size Size of the other packets, except possibly the last one
+         */
+        void SetPacketLayout(uint first_packet_size, uint packet_size);
+        
+        //! Returns the asset whose data is the receive buffer
+        /*! Only valid as a complete asset when Ready() returns true
          */
-        void AssembleData(u8* buffer) const;
+        boost::shared_ptr<RexAsset> GetAsset();
+        
+        //! Returns an asset containing the continuous data received so far
+        /*! If the asset size is known the data is not copied, otherwise a new asset is made
+         */
+        Foundation::AssetPtr GetContinuousAsset();
         
         //! Sets asset ID
         /*! \param asset_id Asset id
@@ -44,7 +63,7 @@ namespace Asset
         /*! Called when asset transfer header received
             \param size Asset size in bytes
          */
-        void SetSize(uint size) { size_ = size; }
+        void SetSize(uint size);
         
         //! Adds elapsed time
         /*! \param delta_time Amount of time to add
@@ -79,10 +98,33 @@ namespace Asset
         uint GetReceived() const { return received_; }
         
         //! Returns total size of continuous data from the asset beginning received so far
-        uint GetReceivedContinuous() const;
+        uint GetReceivedContinuous() const { return received_continuous_; }
+        
+        //! Returns number of packets received without gaps from the asset beginning
+        uint GetReceivedContinuousPackets() const { return received_continuous_packets_; }
         
         //! Returns elapsed time since last packet
         f64 GetTime() const { return time_; }
+        
+        //! Sets download priority last sent to the server
+        void SetPriority(Real priority) { priority_ = priority; }
+        
+        //! Returns download priority last sent to the server
+        Real GetPriority() const { return priority_; }
+        
+        //! Sets discard level last sent to the server
+        void SetDiscardLevel(s8 discard_level) { discard_level_ = discard_level; }
+        
+        //! Returns discard level last sent to the server
+        s8 GetDiscardLevel() const { return discard_level_; }
+        
+        //! Sets whether the transfer is parked
+        /*! A parked transfer has been canceled on the server, but keeps its data so that it can be resumed.
+         */
+        void SetParked(bool parked) { parked_ = parked; }
+        
+        //! Returns whether the transfer is parked
+        bool IsParked() const { return parked_; }
                         
         //! Returns whether transfer is finished (all bytes received)
         bool Ready() const;
@@ -90,6 +132,18 @@ namespace Asset
     private:
         typedef std::map<uint, std::vector<u8> > DataPacketMap;
         
+        //! Returns buffer offset of a packet, when packet sizes are known
+        uint GetPacketOffset(uint packet_index) const;
+        
+        //! Copies packet data to the buffer and marks the packet received. Returns false if the packet does not fit
+        bool WritePacket(uint packet_index, uint offset, const u8* data, uint size);
+        
+        //! Moves the continuous data watermark past packets that have been received
+        void UpdateContinuous();
+        
+        //! Returns the receive buffer, creating the asset if necessary
+        std::vector<u8>& GetBuffer();
+        
         //! Asset ID
         std::string asset_id_;
         
@@ -102,14 +156,44 @@ namespace Asset
         //! Received bytes
         uint received_;
         
-        //! Map of data packets
-        DataPacketMap data_packets_;
+        //! Continuous bytes received from the beginning
+        uint received_continuous_;
+        
+        //! Continuous packets received from the beginning
+        uint received_continuous_packets_;
+        
+        //! End of the furthest packet written to the buffer
+        uint data_end_;
+        
+        //! Size of packet 0, 0 if not known
+        uint first_packet_size_;
+        
+        //! Size of the other packets, 0 if not known
+        uint packet_size_;
+        
+        //! Asset that owns the receive buffer
+        boost::shared_ptr<RexAsset> asset_;
+        
+        //! Received flag of each packet
+        std::vector<bool> received_packets_;
+        
+        //! Packets received ahead of time, when packet sizes are not known
+        DataPacketMap delayed_packets_;
         
         //! Elapsed time since last packet
         f64 time_;
         
         //! List of request tags associated with this transfer
         RequestTagVector tags_;
+        
+        //! Download priority last sent to the server
+        Real priority_;
+        
+        //! Discard level last sent to the server
+        s8 discard_level_;
+        
+        //! Parked flag
+        bool parked_;
     };
 }
 
@@ -23,6 +23,7 @@
 #include "Color.h"
 #include "CoreStringUtils.h"
 #include "CoreThread.h"
+#include "DataSerializer.h"
 
 
 //! Core contains functionality and definitions that are common to all subprojects in the viewer.
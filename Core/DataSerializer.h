@@ -0,0 +1,176 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_Core_DataSerializer_h
+#define incl_Core_DataSerializer_h
+
+#include "CoreTypes.h"
+#include "CoreException.h"
+
+#include <string>
+#include <vector>
+#include <cstring>
+
+//! Writes typed values into a byte buffer for binary serialization.
+/*! Values are written little-endian regardless of the platform. Strings and byte blocks are prefixed with their
+    length as u16. Use DataDeserializer to read the data back.
+*/
+class DataSerializer
+{
+public:
+    //! Constructor
+    /*! \param buffer Buffer to append to. Must outlive the serializer.
+     */
+    explicit DataSerializer(std::vector<u8>& buffer) : buffer_(buffer) {}
+
+    void AddU8(u8 value) { buffer_.push_back(value); }
+
+    void AddU16(u16 value)
+    {
+        buffer_.push_back((u8)(value & 0xff));
+        buffer_.push_back((u8)(value >> 8));
+    }
+
+    void AddU32(u32 value)
+    {
+        for(int i = 0; i < 4; ++i)
+            buffer_.push_back((u8)((value >> (i * 8)) & 0xff));
+    }
+
+    void AddS32(s32 value) { AddU32((u32)value); }
+
+    void AddF32(f32 value)
+    {
+        u32 bits;
+        memcpy(&bits, &value, sizeof(bits));
+        AddU32(bits);
+    }
+
+    void AddBool(bool value) { AddU8(value ? 1 : 0); }
+
+    //! Adds raw bytes without a length prefix.
+    void AddBytes(const u8* data, size_t size) { buffer_.insert(buffer_.end(), data, data + size); }
+
+    //! Adds a string with u16 length prefix. Longer strings are truncated.
+    void AddString(const std::string& value)
+    {
+        size_t size = value.size() < 0xffff ? value.size() : 0xffff;
+        AddU16((u16)size);
+        AddBytes((const u8*)value.data(), size);
+    }
+
+    //! Returns number of bytes in the buffer.
+    size_t GetBytesFilled() const { return buffer_.size(); }
+
+    //! Overwrites an u16 written earlier, used to fill in length prefixes once the length is known.
+    void SetU16(size_t pos, u16 value)
+    {
+        buffer_[pos] = (u8)(value & 0xff);
+        buffer_[pos + 1] = (u8)(value >> 8);
+    }
+
+    //! Overwrites an u32 written earlier.
+    void SetU32(size_t pos, u32 value)
+    {
+        for(int i = 0; i < 4; ++i)
+            buffer_[pos + i] = (u8)((value >> (i * 8)) & 0xff);
+    }
+
+private:
+    std::vector<u8>& buffer_;
+};
+
+//! Reads typed values written by DataSerializer.
+/*! Reading past the end of the data throws an Exception.
+*/
+class DataDeserializer
+{
+public:
+    //! Constructor
+    /*! \param data Data to read. Must outlive the deserializer.
+        \param size Size of data in bytes.
+     */
+    DataDeserializer(const u8* data, size_t size) : data_(data), size_(size), pos_(0) {}
+
+    u8 ReadU8()
+    {
+        Require(1);
+        return data_[pos_++];
+    }
+
+    u16 ReadU16()
+    {
+        Require(2);
+        u16 value = (u16)(data_[pos_] | (data_[pos_ + 1] << 8));
+        pos_ += 2;
+        return value;
+    }
+
+    u32 ReadU32()
+    {
+        Require(4);
+        u32 value = 0;
+        for(int i = 0; i < 4; ++i)
+            value |= ((u32)data_[pos_ + i]) << (i * 8);
+        pos_ += 4;
+        return value;
+    }
+
+    s32 ReadS32() { return (s32)ReadU32(); }
+
+    f32 ReadF32()
+    {
+        u32 bits = ReadU32();
+        f32 value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    bool ReadBool() { return ReadU8() != 0; }
+
+    //! Reads raw bytes written with AddBytes.
+    void ReadBytes(u8* dest, size_t size)
+    {
+        Require(size);
+        memcpy(dest, data_ + pos_, size);
+        pos_ += size;
+    }
+
+    //! Reads a string written with AddString.
+    std::string ReadString()
+    {
+        u16 size = ReadU16();
+        Require(size);
+        std::string value((const char*)data_ + pos_, size);
+        pos_ += size;
+        return value;
+    }
+
+    //! Skips bytes.
+    void Skip(size_t size)
+    {
+        Require(size);
+        pos_ += size;
+    }
+
+    //! Returns pointer to the current read position.
+    const u8* GetCurrentData() const { return data_ + pos_; }
+
+    //! Returns number of bytes read so far.
+    size_t GetBytesRead() const { return pos_; }
+
+    //! Returns number of bytes left.
+    size_t GetBytesLeft() const { return size_ - pos_; }
+
+private:
+    void Require(size_t size) const
+    {
+        if (size > size_ - pos_)
+            throw Exception("DataDeserializer: read past end of data");
+    }
+
+    const u8* data_;
+    size_t size_;
+    size_t pos_;
+};
+
+#endif
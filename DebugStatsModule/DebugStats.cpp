@@ -24,12 +24,22 @@
 #include "RealXtend/RexProtocolMsgIDs.h"
 #include "NetworkMessages/NetInMessage.h"
 #include "NetworkMessages/NetMessageManager.h"
+#include "NetworkTrace.h"
+#include "ZeroCode.h"
+#include "RexUUID.h"
+#include "AttributeInterface.h"
+#include "DataSerializer.h"
 #include "UiModule.h"
 #include "Inworld/View/UiProxyWidget.h"
 #include "Inworld/InworldSceneController.h"
 
 #include "EC_OpenSimPresence.h"
 
+#include "Poco/Timestamp.h"
+
+#include <QDomDocument>
+
+#include <cstring>
 #include <utility>
 
 #include "MemoryLeakCheck.h"
@@ -77,6 +87,22 @@ void DebugStatsModule::PostInitialize()
         "Shows the participant window.",
         Console::Bind(this, &DebugStatsModule::ShowParticipantWindow)));
 
+    RegisterConsoleCommand(Console::CreateCommand("BenchmarkSpatialIndex", 
+        "Measures scene spatial index updates and queries. Usage: BenchmarkSpatialIndex(entities=50000, queries=1000)",
+        Console::Bind(this, &DebugStatsModule::BenchmarkSpatialIndex)));
+
+    RegisterConsoleCommand(Console::CreateCommand("CheckNetworkBufferReuse", 
+        "Checks that the network message path reuses its pooled buffers and outbound messages. Usage: CheckNetworkBufferReuse(cycles=1000)",
+        Console::Bind(this, &DebugStatsModule::CheckNetworkBufferReuse)));
+
+    RegisterConsoleCommand(Console::CreateCommand("BenchmarkZeroCode", 
+        "Checks single-pass zero-coding against the scalar code and measures both. Usage: BenchmarkZeroCode(random=10000, tracefile)",
+        Console::Bind(this, &DebugStatsModule::BenchmarkZeroCode)));
+
+    RegisterConsoleCommand(Console::CreateCommand("BenchmarkComponentSerialization", 
+        "Checks component binary and XML round trips and measures both. Usage: BenchmarkComponentSerialization(components=10000)",
+        Console::Bind(this, &DebugStatsModule::BenchmarkComponentSerialization)));
+
     frameworkEventCategory_ = framework_->GetEventManager()->QueryEventCategory("Framework");
 }
 
@@ -135,6 +161,586 @@ Console::CommandResult DebugStatsModule::ShowParticipantWindow(const StringVecto
     return Console::ResultSuccess();
 }
 
+/// Returns a pseudo-random number between min and max, advancing the seed.
+static Real RandomReal(uint &seed, Real min, Real max)
+{
+    seed = seed * 1103515245 + 12345;
+    return min + (max - min) * ((seed >> 8) & 0xffff) / 65535.0f;
+}
+
+Console::CommandResult DebugStatsModule::BenchmarkSpatialIndex(const StringVector &params)
+{
+    const uint num_entities = params.size() > 0 ? ParseString<uint>(params[0], 0) : 50000;
+    const uint num_queries = params.size() > 1 ? ParseString<uint>(params[1], 0) : 1000;
+    if (num_entities == 0 || num_queries == 0)
+        return Console::ResultFailure("Usage: BenchmarkSpatialIndex(entities=50000, queries=1000)");
+
+    const Real world_size = 1024.0f; // 4x4 regions
+    const Real query_radius = 20.0f;
+    const Real view_depth = 100.0f;
+    const uint nearest_count = 10;
+
+    uint seed = 1;
+    std::vector<Vector3df> positions(num_entities);
+    for (uint i = 0; i < num_entities; ++i)
+        positions[i] = Vector3df(RandomReal(seed, 0.0f, world_size), RandomReal(seed, 0.0f, world_size), RandomReal(seed, 0.0f, 100.0f));
+    std::vector<Vector3df> points(num_queries);
+    for (uint i = 0; i < num_queries; ++i)
+        points[i] = Vector3df(RandomReal(seed, 0.0f, world_size), RandomReal(seed, 0.0f, world_size), RandomReal(seed, 0.0f, 100.0f));
+
+    Scene::SpatialIndex index;
+    Poco::Timestamp timer;
+    for (uint i = 0; i < num_entities; ++i)
+        index.SetPosition(i, positions[i]);
+    const double insert_ms = timer.elapsed() / 1000.0;
+
+    timer.update();
+    for (uint i = 0; i < num_entities; ++i)
+    {
+        positions[i] += Vector3df(RandomReal(seed, -1.0f, 1.0f), RandomReal(seed, -1.0f, 1.0f), 0.0f);
+        index.SetPosition(i, positions[i]);
+    }
+    const double move_ms = timer.elapsed() / 1000.0;
+
+    Scene::EntityIdVector ids;
+    size_t num_found = 0;
+    timer.update();
+    for (uint i = 0; i < num_queries; ++i)
+    {
+        ids.clear();
+        index.QueryRadius(points[i], query_radius, ids);
+        num_found += ids.size();
+    }
+    const double radius_ms = timer.elapsed() / 1000.0;
+
+    size_t num_brute_found = 0;
+    timer.update();
+    for (uint i = 0; i < num_queries; ++i)
+        for (uint j = 0; j < num_entities; ++j)
+            if (points[i].getDistanceFromSQ(positions[j]) <= query_radius * query_radius)
+                ++num_brute_found;
+    const double brute_ms = timer.elapsed() / 1000.0;
+
+    timer.update();
+    for (uint i = 0; i < num_queries; ++i)
+    {
+        ids.clear();
+        index.QueryNearest(points[i], nearest_count, ids);
+    }
+    const double nearest_ms = timer.elapsed() / 1000.0;
+
+    const Vector3df extent(query_radius, query_radius, query_radius);
+    timer.update();
+    for (uint i = 0; i < num_queries; ++i)
+    {
+        ids.clear();
+        index.QueryBox(points[i] - extent, points[i] + extent, ids);
+    }
+    const double box_ms = timer.elapsed() / 1000.0;
+
+    // A 90 degree view looking along the x axis
+    const Real diagonal = 1.0f / sqrt(2.0f);
+    const Vector3df normals[6] = { Vector3df(1.0f, 0.0f, 0.0f), Vector3df(-1.0f, 0.0f, 0.0f),
+        Vector3df(diagonal, diagonal, 0.0f), Vector3df(diagonal, -diagonal, 0.0f),
+        Vector3df(diagonal, 0.0f, diagonal), Vector3df(diagonal, 0.0f, -diagonal) };
+    timer.update();
+    for (uint i = 0; i < num_queries; ++i)
+    {
+        Scene::SpatialPlaneVector planes;
+        for (uint j = 0; j < 6; ++j)
+            planes.push_back(Scene::SpatialPlane(normals[j], -normals[j].dotProduct(points[i])));
+        planes[1].distance_ += view_depth;
+
+        ids.clear();
+        index.QueryFrustum(planes, ids);
+    }
+    const double frustum_ms = timer.elapsed() / 1000.0;
+
+    if (num_found != num_brute_found)
+        return Console::ResultFailure("Spatial index radius queries found " + ToString(num_found) + " entities, brute force " +
+            ToString(num_brute_found));
+
+    std::string result = ToString(num_entities) + " entities in " + ToString(index.GetNumCells()) + " cells, " +
+        ToString(num_queries) + " queries. Insert " + ToString(insert_ms) + " ms, move " + ToString(move_ms) + " ms. " +
+        "Radius " + ToString(radius_ms) + " ms, brute force " + ToString(brute_ms) + " ms. Nearest " +
+        ToString(nearest_ms) + " ms, box " + ToString(box_ms) + " ms, frustum " + ToString(frustum_ms) + " ms.";
+    LogInfo(result);
+    return Console::ResultSuccess(result);
+}
+
+/// Counts the messages received from a NetMessageManager.
+class NetworkMessageCounter : public ProtocolUtilities::INetMessageListener
+{
+public:
+    NetworkMessageCounter() : count(0) {}
+
+    virtual void OnNetworkMessageReceived(ProtocolUtilities::NetMsgID msgID, ProtocolUtilities::NetInMessage *msg) { ++count; }
+
+    /// Number of messages received.
+    size_t count;
+};
+
+/// Sends a ChatFromViewer message with the given text. The message is zero-coded.
+static void SendTestChatMessage(ProtocolUtilities::NetMessageManager &manager, std::vector<uint8_t> &text, bool reliable)
+{
+    ProtocolUtilities::NetOutMessage *m = manager.StartNewMessage(RexNetMsgChatFromViewer);
+    assert(m);
+    if (!m)
+        return;
+
+    m->AddUUID(RexUUID());
+    m->AddUUID(RexUUID());
+    m->AddBuffer(text.size(), &text[0]);
+    m->AddU8(0);
+    m->AddS32(0);
+    if (reliable)
+        m->MarkReliable();
+
+    manager.FinishMessage(m);
+}
+
+Console::CommandResult DebugStatsModule::CheckNetworkBufferReuse(const StringVector &params)
+{
+    const uint num_cycles = params.size() > 0 ? ParseString<uint>(params[0], 0) : 1000;
+    if (num_cycles == 0)
+        return Console::ResultFailure("Usage: CheckNetworkBufferReuse(cycles=1000)");
+
+    // A message manager of its own, so that the live connection is not disturbed
+    boost::shared_ptr<ProtocolUtilities::NetMessageManager> manager(new ProtocolUtilities::NetMessageManager("./data/message_template.msg"));
+    NetworkMessageCounter counter;
+    manager->RegisterNetworkListener(&counter);
+    manager->ConnectLoopback();
+
+    // A short text with zero runs, and a long zero run which decodes past a pooled buffer
+    std::vector<uint8_t> short_text(200, 0);
+    for (uint i = 0; i < short_text.size(); ++i)
+        if (i % 8 != 0)
+            short_text[i] = 'a' + i % 26;
+    std::vector<uint8_t> long_text(10000, 0);
+    long_text[0] = 'a';
+
+    // Each cycle sends a reliable and an unreliable message and receives them. The acks of the reliable message
+    // are received during the next cycle, which frees it from the resend queue.
+    const uint warmup_cycles = 16;
+    size_t slabs = 0;
+    size_t buffers = 0;
+    size_t out_messages = 0;
+    for (uint i = 0; i < warmup_cycles + num_cycles; ++i)
+    {
+        if (i == warmup_cycles)
+        {
+            slabs = manager->GetBufferPool().SlabAllocations();
+            buffers = manager->GetBufferPool().BuffersAllocated();
+            out_messages = manager->GetOutMessagesAllocated();
+        }
+
+        SendTestChatMessage(*manager, short_text, true);
+        SendTestChatMessage(*manager, long_text, false);
+        manager->ProcessMessages();
+    }
+    manager->ProcessMessages();
+    manager->UnregisterNetworkListener(&counter);
+
+    const size_t expected_count = 2 * (warmup_cycles + num_cycles);
+    std::string result = ToString(num_cycles) + " cycles: buffer slabs " + ToString(slabs) + " -> " +
+        ToString(manager->GetBufferPool().SlabAllocations()) + ", buffers " + ToString(buffers) + " -> " +
+        ToString(manager->GetBufferPool().BuffersAllocated()) + ", out messages " + ToString(out_messages) + " -> " +
+        ToString(manager->GetOutMessagesAllocated()) + ", received " + ToString(counter.count) + "/" +
+        ToString(expected_count) + " messages.";
+
+    if (manager->GetBufferPool().SlabAllocations() != slabs || manager->GetOutMessagesAllocated() != out_messages ||
+        manager->GetBufferPool().BuffersInUse() != 0 || counter.count != expected_count)
+    {
+        LogError(result);
+        return Console::ResultFailure(result);
+    }
+
+    LogInfo(result);
+    return Console::ResultSuccess(result);
+}
+
+/// Returns a pseudo-random number between 0 and 0xffffff, advancing the seed.
+static uint RandomUint(uint &seed)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) & 0xffffff;
+}
+
+/// Fills a buffer with pseudo-random bytes and zero runs. Some of the runs are longer than 255 bytes.
+/// \param zero_percent Percentage of runs that are zero runs
+static void RandomZeroRunData(uint &seed, std::vector<uint8_t> &data, size_t size, uint zero_percent)
+{
+    data.resize(size);
+    size_t i = 0;
+    while (i < size)
+    {
+        const bool zero = RandomUint(seed) % 100 < zero_percent;
+        const size_t run = 1 + RandomUint(seed) % (RandomUint(seed) % 8 == 0 ? 600 : 16);
+        for (size_t j = 0; j < run && i < size; ++j)
+            data[i++] = zero ? 0 : (uint8_t)(1 + RandomUint(seed) % 255);
+    }
+}
+
+/// Zero-decodes a possibly malformed stream with both the scalar and the single-pass code.
+/// \return True if both reject the stream, or both decode it to the same data and the single-pass decode detects
+///         a too small destination
+static bool ZeroDecodeMatches(const std::vector<uint8_t> &src, std::vector<uint8_t> &scalar, std::vector<uint8_t> &single)
+{
+    const uint8_t *src_data = src.empty() ? 0 : &src[0];
+    const size_t length = ProtocolUtilities::CountZeroDecodedLength(src_data, src.size());
+    scalar.assign(length + 1, 0);
+    single.assign(length + 1, 0);
+    const bool scalar_ok = length > 0 && ProtocolUtilities::ZeroDecode(&scalar[0], length, src_data, src.size());
+    const size_t single_length = ProtocolUtilities::ZeroDecodeSinglePass(&single[0], single.size(), src_data, src.size());
+    if (!scalar_ok)
+        return single_length == 0;
+
+    return single_length == length && memcmp(&scalar[0], &single[0], length) == 0 &&
+        ProtocolUtilities::ZeroDecodeSinglePass(&single[0], length - 1, src_data, src.size()) == 0;
+}
+
+/// Returns the message body of an SLUDP datagram, without the header and the appended acks.
+/// \return False if the datagram is malformed
+static bool GetDatagramBody(const uint8_t *data, size_t size, std::vector<uint8_t> &body)
+{
+    if (size < 6)
+        return false;
+
+    const size_t header = 6 + data[5];
+    const size_t acks = (data[0] & ProtocolUtilities::NetFlagAck) ? 1 + data[size - 1] * 4 : 0;
+    if (header + acks >= size)
+        return false;
+
+    body.assign(data + header, data + size - acks);
+    return true;
+}
+
+Console::CommandResult DebugStatsModule::BenchmarkZeroCode(const StringVector &params)
+{
+    const uint num_random = params.size() > 0 ? ParseString<uint>(params[0], 0) : 10000;
+    if (num_random == 0)
+        return Console::ResultFailure("Usage: BenchmarkZeroCode(random=10000, tracefile)");
+
+    // Random data with zero runs of all lengths, encoded with both encoders and decoded with both decoders. The
+    // random data is also decoded as is, which exercises the handling of malformed streams.
+    uint seed = 1;
+    uint mismatches = 0;
+    std::vector<uint8_t> data, scalar, single;
+    for (uint i = 0; i < num_random; ++i)
+    {
+        RandomZeroRunData(seed, data, RandomUint(seed) % 4096, 10 + i % 50);
+        const uint8_t *src_data = data.empty() ? 0 : &data[0];
+
+        const size_t encoded_length = ProtocolUtilities::CountZeroEncodedLength(src_data, data.size());
+        scalar.assign(encoded_length + 1, 0);
+        single.assign(encoded_length + 1, 0);
+        const bool scalar_ok = ProtocolUtilities::ZeroEncode(&scalar[0], encoded_length, src_data, data.size());
+        const size_t single_length = ProtocolUtilities::ZeroEncodeSinglePass(&single[0], encoded_length, src_data, data.size());
+        if (!scalar_ok || single_length != encoded_length || memcmp(&scalar[0], &single[0], encoded_length) != 0 ||
+            (encoded_length > 0 && ProtocolUtilities::ZeroEncodeSinglePass(&single[0], encoded_length - 1, src_data, data.size()) != 0))
+        {
+            ++mismatches;
+            continue;
+        }
+
+        std::vector<uint8_t> encoded(scalar.begin(), scalar.begin() + encoded_length);
+        if (!ZeroDecodeMatches(encoded, scalar, single) || (encoded_length > 0 && single.size() != data.size() + 1) ||
+            (encoded_length > 0 && memcmp(&single[0], &data[0], data.size()) != 0))
+            ++mismatches;
+        if (!ZeroDecodeMatches(data, scalar, single))
+            ++mismatches;
+    }
+
+    if (mismatches > 0)
+        return Console::ResultFailure("Single-pass zero-coding differs from the scalar code for " + ToString(mismatches) +
+            " of " + ToString(num_random) + " random buffers");
+
+    // The corpus is the zero-coded message bodies of a recorded trace, or random messages if there is no trace
+    std::vector<std::vector<uint8_t> > corpus;
+    if (params.size() > 1)
+    {
+        ProtocolUtilities::TraceConnection trace(0.0);
+        if (!trace.Load(params[1]))
+            return Console::ResultFailure("Could not load network trace " + params[1]);
+
+        std::vector<uint8_t> datagram(65536);
+        std::vector<uint8_t> body;
+        while (trace.PacketsAvailable())
+        {
+            const int size = trace.ReceiveBytes(&datagram[0], datagram.size());
+            if (size > 0 && (datagram[0] & ProtocolUtilities::NetFlagZeroCode) && GetDatagramBody(&datagram[0], size, body) &&
+                ProtocolUtilities::CountZeroDecodedLength(&body[0], body.size()) > 0)
+                corpus.push_back(body);
+        }
+    }
+    else
+    {
+        for (uint i = 0; i < 2000; ++i)
+        {
+            RandomZeroRunData(seed, data, 50 + RandomUint(seed) % 1200, 40);
+            std::vector<uint8_t> encoded(ProtocolUtilities::CountZeroEncodedLength(&data[0], data.size()));
+            ProtocolUtilities::ZeroEncodeSinglePass(&encoded[0], encoded.size(), &data[0], data.size());
+            corpus.push_back(encoded);
+        }
+    }
+    if (corpus.empty())
+        return Console::ResultFailure("The network trace has no zero-coded messages");
+
+    std::vector<std::vector<uint8_t> > decoded(corpus.size());
+    size_t encoded_bytes = 0;
+    size_t decoded_bytes = 0;
+    for (uint i = 0; i < corpus.size(); ++i)
+    {
+        decoded[i].resize(ProtocolUtilities::CountZeroDecodedLength(&corpus[i][0], corpus[i].size()));
+        ProtocolUtilities::ZeroDecode(&decoded[i][0], decoded[i].size(), &corpus[i][0], corpus[i].size());
+        encoded_bytes += corpus[i].size();
+        decoded_bytes += decoded[i].size();
+    }
+
+    // Both decoders write to a buffer as large as a pooled message buffer, as on the receive path
+    const uint repeats = 20;
+    std::vector<uint8_t> buffer(ProtocolUtilities::NetMessageBuffer::cSize);
+    Poco::Timestamp timer;
+    for (uint r = 0; r < repeats; ++r)
+        for (uint i = 0; i < corpus.size(); ++i)
+        {
+            const size_t length = ProtocolUtilities::CountZeroDecodedLength(&corpus[i][0], corpus[i].size());
+            if (length <= buffer.size())
+                ProtocolUtilities::ZeroDecode(&buffer[0], length, &corpus[i][0], corpus[i].size());
+        }
+    const double scalar_decode_ms = timer.elapsed() / 1000.0;
+
+    timer.update();
+    for (uint r = 0; r < repeats; ++r)
+        for (uint i = 0; i < corpus.size(); ++i)
+            ProtocolUtilities::ZeroDecodeSinglePass(&buffer[0], buffer.size(), &corpus[i][0], corpus[i].size());
+    const double single_decode_ms = timer.elapsed() / 1000.0;
+
+    timer.update();
+    for (uint r = 0; r < repeats; ++r)
+        for (uint i = 0; i < decoded.size(); ++i)
+        {
+            const size_t length = ProtocolUtilities::CountZeroEncodedLength(&decoded[i][0], decoded[i].size());
+            if (length <= buffer.size())
+                ProtocolUtilities::ZeroEncode(&buffer[0], length, &decoded[i][0], decoded[i].size());
+        }
+    const double scalar_encode_ms = timer.elapsed() / 1000.0;
+
+    timer.update();
+    for (uint r = 0; r < repeats; ++r)
+        for (uint i = 0; i < decoded.size(); ++i)
+            ProtocolUtilities::ZeroEncodeSinglePass(&buffer[0], buffer.size(), &decoded[i][0], decoded[i].size());
+    const double single_encode_ms = timer.elapsed() / 1000.0;
+
+    std::string result = ToString(num_random) + " random buffers match. Corpus of " + ToString(corpus.size()) +
+        " messages, " + ToString(encoded_bytes) + " bytes zero-coded, " + ToString(decoded_bytes) + " bytes decoded, " +
+        ToString(repeats) + " times. Decode " + ToString(scalar_decode_ms) + " ms scalar, " + ToString(single_decode_ms) +
+        " ms single-pass. Encode " + ToString(scalar_encode_ms) + " ms scalar, " + ToString(single_encode_ms) +
+        " ms single-pass.";
+    LogInfo(result);
+    return Console::ResultSuccess(result);
+}
+
+/// A component with an attribute of each type that has a binary serialization, for the serialization round trips.
+class SerializationBenchmarkComponent : public Foundation::ComponentInterface
+{
+public:
+    explicit SerializationBenchmarkComponent(Foundation::Framework *framework) :
+        Foundation::ComponentInterface(framework),
+        position_(this, "position"),
+        orientation_(this, "orientation"),
+        color_(this, "color"),
+        scale_(this, "scale"),
+        count_(this, "count"),
+        flags_(this, "flags"),
+        visible_(this, "visible"),
+        text_(this, "text")
+    {
+    }
+
+    virtual const std::string &TypeName() const
+    {
+        static const std::string name("EC_SerializationBenchmark");
+        return name;
+    }
+
+    virtual bool IsSerializable() const { return true; }
+
+    /// Sets all attributes to pseudo-random values, advancing the seed.
+    void Randomize(uint &seed)
+    {
+        position_.Set(Vector3df(RandomReal(seed, 0.0f, 256.0f), RandomReal(seed, 0.0f, 256.0f), RandomReal(seed, 0.0f, 100.0f)),
+            Foundation::LocalOnly);
+        orientation_.Set(Quaternion(RandomReal(seed, -PI, PI), RandomReal(seed, -PI, PI), RandomReal(seed, -PI, PI)),
+            Foundation::LocalOnly);
+        color_.Set(Color(RandomReal(seed, 0.0f, 1.0f), RandomReal(seed, 0.0f, 1.0f), RandomReal(seed, 0.0f, 1.0f)),
+            Foundation::LocalOnly);
+        scale_.Set(RandomReal(seed, 0.1f, 10.0f), Foundation::LocalOnly);
+        count_.Set((int)RandomReal(seed, -1000.0f, 1000.0f), Foundation::LocalOnly);
+        flags_.Set((uint)RandomReal(seed, 0.0f, 65535.0f), Foundation::LocalOnly);
+        visible_.Set(RandomReal(seed, 0.0f, 1.0f) > 0.5f, Foundation::LocalOnly);
+        text_.Set("text " + ToString((uint)RandomReal(seed, 0.0f, 65535.0f)), Foundation::LocalOnly);
+    }
+
+    /// Sets one of the attributes to a pseudo-random value, so that only it is dirty.
+    void RandomizeAttribute(uint &seed, uint index)
+    {
+        SerializationBenchmarkComponent other(framework_);
+        other.Randomize(seed);
+        const Foundation::AttributeVector &attributes = other.GetAttributes();
+        attributes_[index % attributes_.size()]->FromString(attributes[index % attributes.size()]->ToString(),
+            Foundation::LocalOnly);
+    }
+
+    /// @return True if the name and all attribute values of the components are equal.
+    bool Equals(SerializationBenchmarkComponent &other)
+    {
+        if (Name() != other.Name())
+            return false;
+        const Foundation::AttributeVector &attributes = other.GetAttributes();
+        for (uint i = 0; i < attributes_.size(); ++i)
+            if (attributes_[i]->ToString() != attributes[i]->ToString())
+                return false;
+        return true;
+    }
+
+    Foundation::Attribute<Vector3df> position_;
+    Foundation::Attribute<Quaternion> orientation_;
+    Foundation::Attribute<Color> color_;
+    Foundation::Attribute<Real> scale_;
+    Foundation::Attribute<int> count_;
+    Foundation::Attribute<uint> flags_;
+    Foundation::Attribute<bool> visible_;
+    Foundation::Attribute<std::string> text_;
+};
+
+typedef boost::shared_ptr<SerializationBenchmarkComponent> SerializationBenchmarkComponentPtr;
+
+/// Reads the components written with SerializeToBinary into the given components, in order.
+/// @return False if the data was malformed or not of the expected type.
+static bool DeserializeBenchmarkComponents(const std::vector<u8> &data, std::vector<SerializationBenchmarkComponentPtr> &components)
+{
+    try
+    {
+        DataDeserializer source(&data[0], data.size());
+        for (uint i = 0; i < components.size(); ++i)
+        {
+            if (source.ReadString() != components[i]->TypeName())
+                return false;
+            if (!components[i]->DeserializeFromBinary(source, Foundation::Network))
+                return false;
+        }
+    }
+    catch (Exception &)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+/// Reads the components written with SerializeTo into the given components, in order.
+/// @return False if the data was malformed or has fewer components.
+static bool DeserializeBenchmarkComponents(const QByteArray &data, std::vector<SerializationBenchmarkComponentPtr> &components)
+{
+    QDomDocument doc;
+    if (!doc.setContent(data))
+        return false;
+
+    QDomElement comp_element = doc.documentElement().firstChildElement("component");
+    for (uint i = 0; i < components.size(); ++i)
+    {
+        if (comp_element.isNull())
+            return false;
+        components[i]->DeserializeFrom(comp_element, Foundation::Network);
+        comp_element = comp_element.nextSiblingElement("component");
+    }
+
+    return true;
+}
+
+Console::CommandResult DebugStatsModule::BenchmarkComponentSerialization(const StringVector &params)
+{
+    const uint num_components = params.size() > 0 ? ParseString<uint>(params[0], 0) : 10000;
+    if (num_components == 0)
+        return Console::ResultFailure("Usage: BenchmarkComponentSerialization(components=10000)");
+
+    uint seed = 1;
+    std::vector<SerializationBenchmarkComponentPtr> sources, binary_targets, xml_targets;
+    for (uint i = 0; i < num_components; ++i)
+    {
+        sources.push_back(SerializationBenchmarkComponentPtr(new SerializationBenchmarkComponent(framework_)));
+        sources.back()->SetName("component" + ToString(i));
+        sources.back()->Randomize(seed);
+        binary_targets.push_back(SerializationBenchmarkComponentPtr(new SerializationBenchmarkComponent(framework_)));
+        xml_targets.push_back(SerializationBenchmarkComponentPtr(new SerializationBenchmarkComponent(framework_)));
+    }
+
+    // Full binary round trip
+    std::vector<u8> binary;
+    Poco::Timestamp timer;
+    {
+        DataSerializer dest(binary);
+        for (uint i = 0; i < num_components; ++i)
+            sources[i]->SerializeToBinary(dest);
+    }
+    const double binary_write_ms = timer.elapsed() / 1000.0;
+
+    timer.update();
+    if (!DeserializeBenchmarkComponents(binary, binary_targets))
+        return Console::ResultFailure("Binary component data could not be read back");
+    const double binary_read_ms = timer.elapsed() / 1000.0;
+
+    for (uint i = 0; i < num_components; ++i)
+        if (!binary_targets[i]->Equals(*sources[i]))
+            return Console::ResultFailure("Component " + ToString(i) + " differs after the binary round trip");
+
+    // XML round trip, as the components are sent when binary serialization is not supported
+    timer.update();
+    QDomDocument doc;
+    QDomElement entity_elem = doc.createElement("entity");
+    for (uint i = 0; i < num_components; ++i)
+        sources[i]->SerializeTo(doc, entity_elem);
+    doc.appendChild(entity_elem);
+    const QByteArray xml = doc.toByteArray();
+    const double xml_write_ms = timer.elapsed() / 1000.0;
+
+    timer.update();
+    if (!DeserializeBenchmarkComponents(xml, xml_targets))
+        return Console::ResultFailure("XML component data could not be read back");
+    const double xml_read_ms = timer.elapsed() / 1000.0;
+
+    for (uint i = 0; i < num_components; ++i)
+        if (!xml_targets[i]->Equals(*sources[i]))
+            return Console::ResultFailure("Component " + ToString(i) + " differs after the XML round trip");
+
+    // Dirty attribute round trip, the other attributes must keep their values
+    for (uint i = 0; i < num_components; ++i)
+    {
+        sources[i]->ResetChange();
+        sources[i]->RandomizeAttribute(seed, i);
+    }
+    std::vector<u8> dirty;
+    {
+        DataSerializer dest(dirty);
+        for (uint i = 0; i < num_components; ++i)
+            sources[i]->SerializeToBinary(dest, true);
+    }
+    if (!DeserializeBenchmarkComponents(dirty, binary_targets))
+        return Console::ResultFailure("Binary dirty attribute data could not be read back");
+
+    for (uint i = 0; i < num_components; ++i)
+        if (!binary_targets[i]->Equals(*sources[i]))
+            return Console::ResultFailure("Component " + ToString(i) + " differs after the dirty attribute round trip");
+
+    std::string result = ToString(num_components) + " components match after the round trips. Binary " +
+        ToString(binary.size()) + " bytes, write " + ToString(binary_write_ms) + " ms, read " + ToString(binary_read_ms) +
+        " ms. XML " + ToString(xml.size()) + " bytes, write " + ToString(xml_write_ms) + " ms, read " +
+        ToString(xml_read_ms) + " ms. Dirty attributes only " + ToString(dirty.size()) + " bytes.";
+    LogInfo(result);
+    return Console::ResultSuccess(result);
+}
+
 void DebugStatsModule::Update(f64 frametime)
 {
     RESETPROFILER;
@@ -74,6 +74,22 @@ public slots:
         /// Sends random NetOutMessage packet
         Console::CommandResult SendRandomNetworkOutPacket(const StringVector &params);
 
+        /// Measures the scene spatial index against brute force queries. Params: number of entities, number of queries.
+        Console::CommandResult BenchmarkSpatialIndex(const StringVector &params);
+
+        /// Sends and receives messages through a loopback message manager and checks that the buffer pool slab and
+        /// outbound message allocation counters stay constant. Other heap allocations, f.ex. of the sequence number
+        /// sets, are not counted. Params: number of send and receive cycles.
+        Console::CommandResult CheckNetworkBufferReuse(const StringVector &params);
+
+        /// Checks the single-pass zero-coding against the scalar implementation with random data, and measures both
+        /// over a packet corpus. Params: number of random buffers, network trace file to take the corpus from.
+        Console::CommandResult BenchmarkZeroCode(const StringVector &params);
+
+        /// Checks that components read back equal after binary, XML and dirty attribute serialization, and measures
+        /// the binary and XML sizes and times. Params: number of components.
+        Console::CommandResult BenchmarkComponentSerialization(const StringVector &params);
+
         /// A history of estimated frame times.
         std::vector<std::pair<uint64_t, double> > frameTimes;
 
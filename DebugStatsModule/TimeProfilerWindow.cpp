@@ -12,6 +12,9 @@
 #include "NetworkMessages/NetMessageManager.h"
 #include "AssetServiceInterface.h"
 #include "WorldStream.h"
+#include "SceneManager.h"
+#include "EC_OgreAnimationController.h"
+#include "OgreMaterialUtils.h"
 
 #include <utility>
 
@@ -476,7 +479,9 @@ void TimeProfilerWindow::RefreshOgreProfilingWindow()
 
     findChild<QLabel*>("labelTextureManager")->setText(ReadOgreManagerStatus(Ogre::TextureManager::getSingleton()).c_str());
     findChild<QLabel*>("labelMeshManager")->setText(ReadOgreManagerStatus(Ogre::MeshManager::getSingleton()).c_str());
-    findChild<QLabel*>("labelMaterialManager")->setText(ReadOgreManagerStatus(Ogre::MaterialManager::getSingleton()).c_str());
+    findChild<QLabel*>("labelMaterialManager")->setText(QString("%1, legacy: %2")
+        .arg(ReadOgreManagerStatus(Ogre::MaterialManager::getSingleton()).c_str())
+        .arg(OgreRenderer::GetNumLegacyMaterials()));
     findChild<QLabel*>("labelSkeletonManager")->setText(ReadOgreManagerStatus(Ogre::SkeletonManager::getSingleton()).c_str());
     findChild<QLabel*>("labelCompositorManager")->setText(ReadOgreManagerStatus(Ogre::CompositorManager::getSingleton()).c_str());
     findChild<QLabel*>("labelGPUProgramManager")->setText(ReadOgreManagerStatus(Ogre::HighLevelGpuProgramManager::getSingleton()).c_str());
@@ -497,6 +502,24 @@ void TimeProfilerWindow::RefreshOgreProfilingWindow()
         findChild<QLabel*>("labelParticleSystems")->setText(QString("%1").arg(CountSize(scene->getMovableObjectIterator(Ogre::ParticleSystemFactory::FACTORY_TYPE_NAME))));
     }
 
+    // Number of animated meshes in each animation LOD
+    using OgreRenderer::EC_OgreAnimationController;
+    uint lod_counts[EC_OgreAnimationController::LOD_COUNT] = { 0 };
+    Scene::ScenePtr world_scene = framework_->GetDefaultWorldScene();
+    if (world_scene)
+    {
+        for(Scene::SceneManager::iterator iter = world_scene->begin(); iter != world_scene->end(); ++iter)
+        {
+            EC_OgreAnimationController *animctrl = (*iter)->GetComponent<EC_OgreAnimationController>().get();
+            if (animctrl && !animctrl->GetRunningAnimations().empty())
+                ++lod_counts[animctrl->GetLod()];
+        }
+    }
+    QString lods;
+    for(int i = 0; i < EC_OgreAnimationController::LOD_COUNT; ++i)
+        lods += QString("%1 %2  ").arg(EC_OgreAnimationController::GetLodName((EC_OgreAnimationController::AnimationLod)i)).arg(lod_counts[i]);
+    findChild<QLabel*>("labelAnimationLod")->setText(lods);
+
     QTimer::singleShot(500, this, SLOT(RefreshOgreProfilingWindow()));
 }
 
@@ -729,6 +752,37 @@ void TimeProfilerWindow::RefreshNetworkProfilingData()
         sprintf(str, "%.2f p/sec", (float)resentPacketsPerSec);
         findChild<QLabel*>("labelPacketResends")->setText(str);
 
+        ProtocolUtilities::NetResendStats resendStats = netMessageManager->GetResendStats();
+        if (resendStats.rttSamples == 0)
+            sprintf(str, "- (RTO %d ms)", (int)(resendStats.retransmissionTimeout * 1000.0));
+        else
+            sprintf(str, "%d ms +- %d (RTO %d ms)", (int)(resendStats.smoothedRtt * 1000.0),
+                (int)(resendStats.rttVariation * 1000.0), (int)(resendStats.retransmissionTimeout * 1000.0));
+        findChild<QLabel*>("labelRoundTripTime")->setText(str);
+
+        sprintf(str, "%s / %s (%d+%d msgs)", FormatBytes((int)resendStats.bytesInFlight).c_str(),
+            FormatBytes((int)resendStats.congestionWindow).c_str(), (int)resendStats.messagesInFlight, (int)resendStats.messagesDeferred);
+        findChild<QLabel*>("labelDataInFlight")->setText(str);
+
+        sprintf(str, "%.1f sec", (float)netMessageManager->GetTimeSinceLastReceived());
+        findChild<QLabel*>("labelLastHeardSince")->setText(str);
+
+        const ProtocolUtilities::BandwidthManager &bandwidth = current_world_stream_->GetBandwidthManager();
+        sprintf(str, "%d / %d kbps, loss %.1f%%, %d textures and %d assets pending", (int)(bandwidth.GetBudget() / 1000.f),
+            (int)(bandwidth.GetMaxBitsPerSecond() / 1000.f), bandwidth.GetLossRate() * 100.f, (int)bandwidth.GetPendingTextures(),
+            (int)bandwidth.GetPendingAssets());
+        findChild<QLabel*>("labelBandwidthBudget")->setText(str);
+
+        std::string throttles;
+        for(int i = 0; i < ProtocolUtilities::TC_NumCategories; ++i)
+        {
+            ProtocolUtilities::ThrottleCategory category = (ProtocolUtilities::ThrottleCategory)i;
+            sprintf(str, "%s %d/%d  ", ProtocolUtilities::ThrottleCategoryName(category), (int)(bandwidth.GetMeasuredRate(category) / 1000.f),
+                (int)(bandwidth.GetThrottle(category) / 1000.f));
+            throttles += str;
+        }
+        findChild<QLabel*>("labelThrottles")->setText(throttles.c_str());
+
         netMessageManager->lostPackets.OutputBucketedAccumulated(dstAccum, numEntries, bucketSize, &dstOccur);
         double packetLossPerSec = EventHistory::SmoothedAvgPerSecond(dstAccum, bucketSize, smoothingCoeff);
         sprintf(str, "%.2f p/sec", (float)packetLossPerSec);
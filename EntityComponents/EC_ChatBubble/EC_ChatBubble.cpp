@@ -13,12 +13,9 @@
 #include "Renderer.h"
 #include "EC_OgrePlaceable.h"
 #include "Entity.h"
-#include "OgreMaterialUtils.h"
+#include "LabelAtlas.h"
 
 #include <Ogre.h>
-#include <OgreBillboardSet.h>
-#include <OgreTextureManager.h>
-#include <OgreResource.h>
 
 #include <QFile>
 #include <QPainter>
@@ -32,8 +29,8 @@ EC_ChatBubble::EC_ChatBubble(Foundation::ModuleInterface *module) :
     font_(QFont("Arial", 100)),
     bubbleColor_(QColor(48, 113, 255, 255)),
     textColor_(Qt::white),
-    billboardSet_(0),
-    billboard_(0)
+    label_(0),
+    position_(0.0f, 0.0f, 1.5f)
 {
     renderer_ = framework_->GetServiceManager()->GetService<OgreRenderer::Renderer>(Foundation::Service::ST_Renderer);
 }
@@ -41,12 +38,24 @@ EC_ChatBubble::EC_ChatBubble(Foundation::ModuleInterface *module) :
 EC_ChatBubble::~EC_ChatBubble()
 {
     RemoveAllMessages();
+
+    if (label_ && !renderer_.expired())
+    {
+        OgreRenderer::LabelAtlas *atlas = renderer_.lock()->GetLabelAtlas();
+        if (atlas)
+            atlas->DestroyLabel(label_);
+    }
 }
 
 void EC_ChatBubble::SetPosition(const Vector3df& position)
 {
-    if (billboard_)
-        billboard_->setPosition(Ogre::Vector3(position.x, position.y, position.z));
+    position_ = position;
+    if (label_ && !renderer_.expired())
+    {
+        OgreRenderer::LabelAtlas *atlas = renderer_.lock()->GetLabelAtlas();
+        if (atlas)
+            atlas->SetOffset(label_, Ogre::Vector3(position.x, position.y, position.z));
+    }
 }
 
 void EC_ChatBubble::ShowMessage(const QString &msg)
@@ -54,9 +63,8 @@ void EC_ChatBubble::ShowMessage(const QString &msg)
     if (renderer_.expired())
         return;
 
-    Ogre::SceneManager *scene = renderer_.lock()->GetSceneManager();
-    assert(scene);
-    if (!scene)
+    OgreRenderer::LabelAtlas *atlas = renderer_.lock()->GetLabelAtlas();
+    if (!atlas)
         return;
 
     Scene::Entity *entity = GetParentEntity();
@@ -73,22 +81,9 @@ void EC_ChatBubble::ShowMessage(const QString &msg)
     if (!sceneNode)
         return;
 
-    // Create billboard if it doesn't exist.
-    if (!billboardSet_ && !billboard_)
-    {
-        billboardSet_ = scene->createBillboardSet(renderer_.lock()->GetUniqueObjectName(), 1);
-        assert(billboardSet_);
-
-        materialName_ = std::string("material") + renderer_.lock()->GetUniqueObjectName(); 
-        Ogre::MaterialPtr material = OgreRenderer::CloneMaterial("UnlitTexturedSoftAlpha", materialName_);
-        billboardSet_->setMaterialName(materialName_);
-
-        billboard_ = billboardSet_->createBillboard(Ogre::Vector3(0, 0, 1.5f));
-        assert(billboard_);
-        billboardSet_->setDefaultDimensions(2, 1);
-
-        sceneNode->attachObject(billboardSet_);
-    }
+    // Create label if it doesn't exist.
+    if (!label_)
+        label_ = atlas->CreateLabel(sceneNode, Ogre::Vector3(position_.x, position_.y, position_.z));
 
     if (msg.isNull() || msg.isEmpty())
         return;
@@ -122,45 +117,29 @@ void EC_ChatBubble::RemoveAllMessages()
 
 void EC_ChatBubble::Refresh()
 {
-    if (renderer_.expired() ||!billboardSet_ || !billboard_)
+    if (renderer_.expired() || !label_)
+        return;
+
+    OgreRenderer::LabelAtlas *atlas = renderer_.lock()->GetLabelAtlas();
+    if (!atlas)
         return;
 
     // If no messages in the log, hide the chat bubble.
     if (messages_.size() == 0)
     {
-        billboardSet_->setVisible(false);
+        atlas->SetVisible(label_, false);
         return;
     }
     else
-        billboardSet_->setVisible(true);
+        atlas->SetVisible(label_, true);
 
     // Get pixmap with chat bubble and text rendered to it.
     QPixmap pixmap = GetChatBubblePixmap();
     if (pixmap.isNull())
         return;
 
-    // Create texture
-    QImage img = pixmap.toImage();
-#include "DisableMemoryLeakCheck.h"
-    Ogre::DataStreamPtr stream(new Ogre::MemoryDataStream((void*)img.bits(), img.byteCount()));
-#include "EnableMemoryLeakCheck.h"
-    std::string tex_name("ChatBubbleTexture" + renderer_.lock()->GetUniqueObjectName());
-    Ogre::TextureManager &manager = Ogre::TextureManager::getSingleton();
-    Ogre::Texture *tex = checked_static_cast<Ogre::Texture *>(manager.create(
-        tex_name, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME).get());
-    assert(tex);
-
-    tex->loadRawData(stream, img.width(), img.height(), Ogre::PF_A8R8G8B8);
-
-    // Set new texture for the material
-    assert(!materialName_.empty());
-    if (!materialName_.empty())
-    {
-        Ogre::MaterialManager &mgr = Ogre::MaterialManager::getSingleton();
-        Ogre::MaterialPtr material = mgr.getByName(materialName_);
-        assert(material.get());
-        OgreRenderer::SetTextureUnitOnMaterial(material, tex_name);
-    }
+    // The bubble is drawn with 800 pixels per world unit, the atlas scales the image down if it's too large.
+    atlas->SetImage(label_, pixmap.toImage(), pixmap.width() / 800.0f, pixmap.height() / 800.0f);
 }
 
 QPixmap EC_ChatBubble::GetChatBubblePixmap()
@@ -239,7 +218,9 @@ QPixmap EC_ChatBubble::GetChatBubblePixmap()
     // Draw text
     painter.setPen(textColor_);
     painter.drawText(rect, Qt::AlignCenter | Qt::TextWordWrap, fullChatLog);
+    painter.end();
 
-    return pixmap;
+    // Only the bubble goes to the atlas, include the outline.
+    return pixmap.copy(rect.adjusted(-1, -1, 1, 1).intersected(max_rect));
 }
 
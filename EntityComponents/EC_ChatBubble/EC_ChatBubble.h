@@ -22,13 +22,6 @@ namespace OgreRenderer
     class Renderer;
 }
 
-namespace Ogre
-{
-    class SceneNode;
-    class BillboardSet;
-    class Billboard;
-}
-
 class EC_ChatBubble : public Foundation::ComponentInterface
 {
     Q_OBJECT
@@ -77,20 +70,17 @@ private slots:
     void Refresh();
 
 private:
-    /// Returns pixmap with chat bubble and current messages renderer to it.
+    /// Returns pixmap with chat bubble and current messages renderer to it, cropped to the bubble.
     QPixmap GetChatBubblePixmap();
 
     /// Renderer pointer.
     boost::weak_ptr<OgreRenderer::Renderer> renderer_;
 
-    /// Ogre billboard set.
-    Ogre::BillboardSet *billboardSet_;
-
-    /// Ogre billboard.
-    Ogre::Billboard *billboard_;
+    /// Label in the renderer's label atlas, 0 if not created yet.
+    uint label_;
 
-    /// Name of the material used for the billboard set.
-    std::string materialName_;
+    /// Position of the label relative to the entity.
+    Vector3df position_;
 
     /// For used for the chat bubble text.
     QFont font_;
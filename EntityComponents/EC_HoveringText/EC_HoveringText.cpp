@@ -13,12 +13,9 @@
 #include "Renderer.h"
 #include "EC_OgrePlaceable.h"
 #include "Entity.h"
-#include "OgreMaterialUtils.h"
+#include "LabelAtlas.h"
 
 #include <Ogre.h>
-#include <OgreBillboardSet.h>
-#include <OgreTextureManager.h>
-#include <OgreResource.h>
 
 #include <QFile>
 #include <QPainter>
@@ -32,8 +29,8 @@ EC_HoveringText::EC_HoveringText(Foundation::ModuleInterface *module) :
     font_(QFont("Arial", 100)),
     backgroundColor_(Qt::transparent),
     textColor_(Qt::black),
-    billboardSet_(0),
-    billboard_(0),
+    label_(0),
+    position_(0.0f, 0.0f, 0.7f),
     text_(""),
     visibility_animation_timeline_(new QTimeLine(1000, this)),
     visibility_timer_(new QTimer(this)),
@@ -53,12 +50,23 @@ EC_HoveringText::EC_HoveringText(Foundation::ModuleInterface *module) :
 
 EC_HoveringText::~EC_HoveringText()
 {
+    if (label_ && !renderer_.expired())
+    {
+        OgreRenderer::LabelAtlas *atlas = renderer_.lock()->GetLabelAtlas();
+        if (atlas)
+            atlas->DestroyLabel(label_);
+    }
 }
 
 void EC_HoveringText::SetPosition(const Vector3df& position)
 {
-    if (billboard_)
-        billboard_->setPosition(Ogre::Vector3(position.x, position.y, position.z));
+    position_ = position;
+    if (label_ && !renderer_.expired())
+    {
+        OgreRenderer::LabelAtlas *atlas = renderer_.lock()->GetLabelAtlas();
+        if (atlas)
+            atlas->SetOffset(label_, Ogre::Vector3(position.x, position.y, position.z));
+    }
 }
 
 void EC_HoveringText::SetFont(const QFont &font)
@@ -89,8 +97,12 @@ void EC_HoveringText::SetBackgroundGradient(const QColor &start_color, const QCo
 
 void EC_HoveringText::Show()
 {
-    if (billboardSet_)
-        billboardSet_->setVisible(true);
+    if (label_ && !renderer_.expired())
+    {
+        OgreRenderer::LabelAtlas *atlas = renderer_.lock()->GetLabelAtlas();
+        if (atlas)
+            atlas->SetVisible(label_, true);
+    }
 }
 
 void EC_HoveringText::AnimatedShow()
@@ -119,8 +131,12 @@ void EC_HoveringText::Clicked(int msec_to_show)
 
 void EC_HoveringText::Hide()
 {
-    if (billboardSet_)
-        billboardSet_->setVisible(false);
+    if (label_ && !renderer_.expired())
+    {
+        OgreRenderer::LabelAtlas *atlas = renderer_.lock()->GetLabelAtlas();
+        if (atlas)
+            atlas->SetVisible(label_, false);
+    }
 }
 
 void EC_HoveringText::AnimatedHide()
@@ -136,18 +152,15 @@ void EC_HoveringText::AnimatedHide()
 
 void EC_HoveringText::UpdateAnimationStep(int step)
 {
-    if (materialName_.empty())
+    if (!label_ || renderer_.expired())
         return;
 
     float alpha = step;
     alpha /= 100;
 
-    Ogre::MaterialManager &mgr = Ogre::MaterialManager::getSingleton();
-    Ogre::MaterialPtr material = mgr.getByName(materialName_);
-    assert(material.get());
-
-    material->getTechnique(0)->getPass(0)->getTextureUnitState(0)->setAlphaOperation(
-        Ogre::LBX_BLEND_MANUAL, Ogre::LBS_TEXTURE, Ogre::LBS_MANUAL, 1.0, 0.0, alpha);
+    OgreRenderer::LabelAtlas *atlas = renderer_.lock()->GetLabelAtlas();
+    if (atlas)
+        atlas->SetAlpha(label_, alpha);
 }
 
 void EC_HoveringText::AnimationFinished()
@@ -158,10 +171,11 @@ void EC_HoveringText::AnimationFinished()
 
 bool EC_HoveringText::IsVisible() const
 {
-    if (billboardSet_)
-        return billboardSet_->isVisible();
-    else
+    if (!label_ || renderer_.expired())
         return false;
+
+    OgreRenderer::LabelAtlas *atlas = renderer_.lock()->GetLabelAtlas();
+    return atlas && atlas->IsVisible(label_);
 }
 
 void EC_HoveringText::ShowMessage(const QString &text)
@@ -169,9 +183,8 @@ void EC_HoveringText::ShowMessage(const QString &text)
     if (renderer_.expired())
         return;
 
-    Ogre::SceneManager *scene = renderer_.lock()->GetSceneManager();
-    assert(scene);
-    if (!scene)
+    OgreRenderer::LabelAtlas *atlas = renderer_.lock()->GetLabelAtlas();
+    if (!atlas)
         return;
 
     Scene::Entity *entity = GetParentEntity();
@@ -188,23 +201,9 @@ void EC_HoveringText::ShowMessage(const QString &text)
     if (!sceneNode)
         return;
 
-    // Create billboard if it doesn't exist.
-    if (!billboardSet_ && !billboard_)
-    {
-        billboardSet_ = scene->createBillboardSet(renderer_.lock()->GetUniqueObjectName(), 1);
-        assert(billboardSet_);
-
-        materialName_ = std::string("material") + renderer_.lock()->GetUniqueObjectName();
-        OgreRenderer::CloneMaterial("HoveringText", materialName_);
-        billboardSet_->setMaterialName(materialName_);
-        billboardSet_->setCastShadows(false);
-
-        billboard_ = billboardSet_->createBillboard(Ogre::Vector3(0, 0, 0.7f));
-        assert(billboard_);
-        billboardSet_->setDefaultDimensions(2, 1);
-
-        sceneNode->attachObject(billboardSet_);
-    }
+    // Create label if it doesn't exist.
+    if (!label_)
+        label_ = atlas->CreateLabel(sceneNode, Ogre::Vector3(position_.x, position_.y, position_.z));
 
     if (text.isNull() || text.isEmpty())
         return;
@@ -215,7 +214,11 @@ void EC_HoveringText::ShowMessage(const QString &text)
 
 void EC_HoveringText::Redraw()
 {
-    if (renderer_.expired() || !billboardSet_ || !billboard_)
+    if (renderer_.expired() || !label_)
+        return;
+
+    OgreRenderer::LabelAtlas *atlas = renderer_.lock()->GetLabelAtlas();
+    if (!atlas)
         return;
 
     // Get pixmap with text rendered to it.
@@ -223,28 +226,8 @@ void EC_HoveringText::Redraw()
     if (pixmap.isNull())
         return;
 
-    // Create texture
-    QImage img = pixmap.toImage();
-#include "DisableMemoryLeakCheck.h"
-    Ogre::DataStreamPtr stream(new Ogre::MemoryDataStream((void*)img.bits(), img.byteCount()));
-#include "EnableMemoryLeakCheck.h"
-    std::string tex_name("HoveringTextTexture" + renderer_.lock()->GetUniqueObjectName());
-    Ogre::TextureManager &manager = Ogre::TextureManager::getSingleton();
-    Ogre::Texture *tex = checked_static_cast<Ogre::Texture *>(manager.create(
-        tex_name, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME).get());
-    assert(tex);
-
-    tex->loadRawData(stream, img.width(), img.height(), Ogre::PF_A8R8G8B8);
-
-    // Set new texture for the material
-    assert(!materialName_.empty());
-    if (!materialName_.empty())
-    {
-        Ogre::MaterialManager &mgr = Ogre::MaterialManager::getSingleton();
-        Ogre::MaterialPtr material = mgr.getByName(materialName_);
-        assert(material.get());
-        OgreRenderer::SetTextureUnitOnMaterial(material, tex_name);
-    }
+    // The text is drawn with 800 pixels per world unit, the atlas scales the image down if it's too large.
+    atlas->SetImage(label_, pixmap.toImage(), pixmap.width() / 800.0f, pixmap.height() / 800.0f);
 }
 
 QPixmap EC_HoveringText::GetTextPixmap()
@@ -297,7 +280,9 @@ QPixmap EC_HoveringText::GetTextPixmap()
     // Draw text
     painter.setPen(textColor_);
     painter.drawText(rect, Qt::AlignCenter | Qt::TextWordWrap, text_);
+    painter.end();
 
-    return pixmap;
+    // Only the drawn area goes to the atlas, include the outline.
+    return pixmap.copy(rect.adjusted(-1, -1, 1, 1).intersected(max_rect));
 }
 
@@ -22,14 +22,6 @@ namespace OgreRenderer
     class Renderer;
 }
 
-namespace Ogre
-{
-    class SceneNode;
-    class BillboardSet;
-    class Billboard;
-    class MaterialPtr;
-}
-
 QT_BEGIN_NAMESPACE
 class QTimeLine;
 QT_END_NAMESPACE
@@ -107,20 +99,17 @@ private slots:
     void Redraw();
 
 private:
-    /// Returns pixmap with chat bubble and current messages renderer to it.
+    /// Returns pixmap with the current text rendered to it, cropped to the drawn area.
     QPixmap GetTextPixmap();
 
     /// Renderer pointer.
     boost::weak_ptr<OgreRenderer::Renderer> renderer_;
 
-    /// Ogre billboard set.
-    Ogre::BillboardSet *billboardSet_;
-
-    /// Ogre billboard.
-    Ogre::Billboard *billboard_;
+    /// Label in the renderer's label atlas, 0 if not created yet.
+    uint label_;
 
-    /// Name of the material used for the billboard set.
-    std::string materialName_;
+    /// Position of the label relative to the entity.
+    Vector3df position_;
 
     /// For used for the hovering text.
     QFont font_;
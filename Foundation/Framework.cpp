@@ -237,6 +237,10 @@ namespace Foundation
             ("auth_server", po::value<std::string>(), "realXtend authentication server address and port")
             ("auth_login", po::value<std::string>(), "realXtend authentication server user name")
             ("login", "automatically login to server using provided credentials")
+            ("capture", po::value<std::string>(), "record the inbound network traffic to a trace file")
+            ("replay", po::value<std::string>(), "play back a network trace instead of connecting to a server")
+            ("replay_speed", po::value<double>()->default_value(1.0), "playback speed of the network trace, 0 for as fast as possible")
+            ("exit_after_replay", "exit after the network trace has been played back and the timings logged")
             ;
 
         try
@@ -436,6 +440,19 @@ namespace Foundation
         return Console::ResultSuccess();
     }
 
+    Console::CommandResult Framework::ConsoleStartupTimeline(const StringVector &params)
+    {
+        boost::shared_ptr<Console::ConsoleServiceInterface> console = GetService<Console::ConsoleServiceInterface>(Foundation::Service::ST_Console).lock();
+        if (console)
+        {
+            StringVector lines = module_manager_->GetStartupTimeline();
+            for(size_t i = 0 ; i < lines.size() ; ++i)
+                console->Print(lines[i]);
+        }
+
+        return Console::ResultSuccess();
+    }
+
     Console::CommandResult Framework::ConsoleSendEvent(const StringVector &params)
     {
         if (params.size() != 2)
@@ -563,6 +580,10 @@ namespace Foundation
                 "Lists all loaded modules.", 
                 Console::Bind(this, &Framework::ConsoleListModules)));
 
+            console->RegisterCommand(Console::CreateCommand("StartupTimeline", 
+                "Prints the time each module spent loading and initializing, and on which thread.", 
+                Console::Bind(this, &Framework::ConsoleStartupTimeline)));
+
             console->RegisterCommand(Console::CreateCommand("SendEvent", 
                 "Sends an internal event. Only for events that contain no data. Usage: SendEvent(event category name, event id)", 
                 Console::Bind(this, &Framework::ConsoleSendEvent)));
@@ -174,6 +174,9 @@ namespace Foundation
         //! List all loaded modules
         Console::CommandResult ConsoleListModules(const StringVector &params);
 
+        //! Print the time each module spent in each startup phase
+        Console::CommandResult ConsoleStartupTimeline(const StringVector &params);
+
         //! send event
         Console::CommandResult ConsoleSendEvent(const StringVector &params);
 
@@ -10,6 +10,10 @@
 
 #include <algorithm>
 #include <sstream>
+#include <iomanip>
+#include <deque>
+
+#include <boost/bind.hpp>
 
 #include <Poco/Environment.h>
 #include <Poco/UnicodeConverter.h>
@@ -20,6 +24,9 @@ namespace fs = boost::filesystem;
 
 typedef void (*SetProfilerFunc)(Foundation::Profiler *profiler);
 
+using boost::posix_time::ptime;
+using boost::posix_time::microsec_clock;
+
 namespace Foundation
 {
     namespace Module
@@ -47,11 +54,163 @@ namespace Foundation
 
             delete module; // needed for modules not loaded through poco's SharedLibrary (static libs).
         }
+
+        bool StartupPhaseLess(const StartupPhase &lhs, const StartupPhase &rhs)
+        {
+            return lhs.start_ < rhs.start_;
+        }
+
+        //! Runs Initialize() of loaded modules in dependency order, on the main thread and on worker threads.
+        /*! A module waits for the modules it depends on that are initialized in the same run. Only dependencies
+            that come earlier in the module list are counted, so that a cyclic dependency can not deadlock.
+            Modules initialized on the main thread are initialized in module list order.
+         */
+        class InitializeScheduler
+        {
+        public:
+            InitializeScheduler(ModuleManager *manager) : manager_(manager), num_done_(0), finished_(false) {}
+
+            //! Adds a module to initialize. Dependencies are indices of earlier added modules.
+            void AddModule(ModuleInterface *module, const std::vector<size_t> &dependencies, bool worker)
+            {
+                Task task = { module, dependencies, worker, false, false };
+                tasks_.push_back(task);
+            }
+
+            //! Initializes all added modules. Rethrows the first error on the main thread after workers are done.
+            void Run(uint num_workers)
+            {
+                boost::thread_group workers;
+                for(uint i = 0; i < num_workers; ++i)
+                    workers.create_thread(boost::bind(&InitializeScheduler::WorkerLoop, this));
+
+                {
+                    ScopedLock lock(mutex_);
+                    QueueReadyTasks();
+                }
+
+                for(size_t i = 0; i < tasks_.size(); ++i)
+                {
+                    if (tasks_[i].worker_)
+                        continue;
+
+                    {
+                        ScopedLock lock(mutex_);
+                        while(error_.empty() && !IsReady(tasks_[i]))
+                            condition_.wait(lock);
+                        if (!error_.empty())
+                            break;
+                    }
+
+                    RunTask(i);
+                }
+
+                {
+                    ScopedLock lock(mutex_);
+                    while(error_.empty() && num_done_ < tasks_.size())
+                        condition_.wait(lock);
+                    finished_ = true;
+                }
+                condition_.notify_all();
+                workers.join_all();
+
+                if (!error_.empty())
+                    throw Exception(error_.c_str());
+            }
+
+        private:
+            struct Task
+            {
+                ModuleInterface *module_;
+                std::vector<size_t> dependencies_;
+                bool worker_;
+                bool queued_;
+                bool done_;
+            };
+
+            //! Returns true if all dependencies of a task are done. Call with the mutex locked.
+            bool IsReady(const Task &task) const
+            {
+                for(size_t i = 0; i < task.dependencies_.size(); ++i)
+                    if (!tasks_[task.dependencies_[i]].done_)
+                        return false;
+                return true;
+            }
+
+            //! Queues worker tasks whose dependencies are done. Call with the mutex locked.
+            void QueueReadyTasks()
+            {
+                for(size_t i = 0; i < tasks_.size(); ++i)
+                    if (tasks_[i].worker_ && !tasks_[i].queued_ && IsReady(tasks_[i]))
+                    {
+                        tasks_[i].queued_ = true;
+                        queue_.push_back(i);
+                    }
+            }
+
+            //! Initializes the module of a task and wakes up everyone waiting for it.
+            void RunTask(size_t index)
+            {
+                std::string error;
+                try
+                {
+                    manager_->InitializeModule(tasks_[index].module_);
+                }
+                catch(std::exception &e)
+                {
+                    error = "Initializing module " + tasks_[index].module_->Name() + " threw an exception: " + e.what();
+                }
+
+                {
+                    ScopedLock lock(mutex_);
+                    tasks_[index].done_ = true;
+                    ++num_done_;
+                    if (!error.empty() && error_.empty())
+                        error_ = error;
+                    QueueReadyTasks();
+                }
+                condition_.notify_all();
+            }
+
+            void WorkerLoop()
+            {
+                for(;;)
+                {
+                    size_t index;
+                    {
+                        ScopedLock lock(mutex_);
+                        while(!finished_ && (queue_.empty() || !error_.empty()))
+                            condition_.wait(lock);
+                        if (finished_)
+                            return;
+                        index = queue_.front();
+                        queue_.pop_front();
+                    }
+
+                    RunTask(index);
+                }
+            }
+
+            ModuleManager *manager_;
+            std::vector<Task> tasks_;
+            //! Worker tasks ready to run
+            std::deque<size_t> queue_;
+            size_t num_done_;
+            //! Set when all tasks are done or an error occurred, makes the workers exit
+            bool finished_;
+            //! First error that occurred
+            std::string error_;
+            Mutex mutex_;
+            Condition condition_;
+        };
     }
 
     ModuleManager::ModuleManager(Framework *framework) :
         framework_(framework),
-        DEFAULT_MODULES_PATH(framework->GetDefaultConfig().DeclareSetting<std::string>("ModuleManager", "Default_Modules_Path", "./modules"))
+        DEFAULT_MODULES_PATH(framework->GetDefaultConfig().DeclareSetting<std::string>("ModuleManager", "Default_Modules_Path", "./modules")),
+        parallel_initialization_(framework->GetDefaultConfig().DeclareSetting<bool>("ModuleManager", "parallel_initialization", false)),
+        startup_time_(microsec_clock::universal_time()),
+        main_thread_id_(boost::this_thread::get_id())
     {
     }
 
@@ -84,7 +243,9 @@ namespace Foundation
             Poco::Logger::get(module->Name()).setLevel(log_level);
 #endif
             module->SetFramework(framework_);
+            ptime start = microsec_clock::universal_time();
             module->LoadInternal();
+            RecordStartupPhase(module->Name(), "Load", start);
         }
         else
         {
@@ -194,6 +355,16 @@ namespace Foundation
         // Check and warn if any module dependencies could not be satisfied.
         CheckDependencies(moduleDescriptions);
 
+        // Remember the dependencies for initializing the modules in parallel.
+        for(size_t i = 0; i < moduleDescriptions.size(); ++i)
+            for(size_t j = 0; j < moduleDescriptions[i].moduleNames.size(); ++j)
+            {
+                const std::string &entry = moduleDescriptions[i].moduleNames[j];
+                module_dependencies_[entry] = moduleDescriptions[i].dependencies;
+                if (moduleDescriptions[i].workerInitialize)
+                    worker_initialize_entries_.insert(entry);
+            }
+
         // Finally, load up all modules. The module description list is now sorted in a topological order, so that the dependencies
         // are satisfied when traversing begin()->end().
         for(std::vector<ModuleLoadDescription>::iterator iter = moduleDescriptions.begin(); iter != moduleDescriptions.end(); ++iter)
@@ -257,6 +428,7 @@ namespace Foundation
 
         StringVector entries;
         StringVector dependencies;
+        bool workerInitialize = false;
 
         try
         {
@@ -273,6 +445,8 @@ namespace Foundation
                     dependencies.push_back(config->getString(*it));
                 else if (it->find("entry") != std::string::npos)
                     entries.push_back(config->getString(*it));
+                else if (*it == "worker_initialize")
+                    workerInitialize = config->getBool(*it);
             }
         }
         catch(const std::exception &e)
@@ -310,6 +484,7 @@ namespace Foundation
             /// \note Currently cannot specify in a single XML file several modules that would have separate dependencies. They all share the same!
             ///       Though, this is not currently in any way seen critical. (just write two xml files if you need separate dependencies)
             desc.dependencies = dependencies; 
+            desc.workerInitialize = workerInitialize;
             out.push_back(desc);
 //        }
     }
@@ -323,15 +498,62 @@ namespace Foundation
                 PreInitializeModule(mod);
         }
 
-        for(size_t i = 0; i < modules_.size(); ++i)
+        if (parallel_initialization_)
+            InitializeModulesParallel();
+        else
         {
-            ModuleInterface *mod = modules_[i].module_.get();
-            if (mod->State() != Foundation::Module::MS_Initialized)
-                InitializeModule(mod);
+            for(size_t i = 0; i < modules_.size(); ++i)
+            {
+                ModuleInterface *mod = modules_[i].module_.get();
+                if (mod->State() != Foundation::Module::MS_Initialized)
+                    InitializeModule(mod);
+            }
         }
 
         for(size_t i = 0; i < modules_.size(); ++i)
             PostInitializeModule(modules_[i].module_.get());
+
+        LogStartupTimeline();
+    }
+
+    void ModuleManager::InitializeModulesParallel()
+    {
+        Module::InitializeScheduler scheduler(this);
+
+        // Index of each module in the scheduler, by name, for resolving dependencies
+        std::map<std::string, size_t> indices;
+        uint num_worker_modules = 0;
+
+        for(size_t i = 0; i < modules_.size(); ++i)
+        {
+            ModuleInterface *mod = modules_[i].module_.get();
+            if (mod->State() == Foundation::Module::MS_Initialized)
+                continue;
+
+            std::vector<size_t> dependencies;
+            std::map<std::string, StringVector>::const_iterator deps = module_dependencies_.find(modules_[i].entry_);
+            if (deps != module_dependencies_.end())
+                for(size_t j = 0; j < deps->second.size(); ++j)
+                {
+                    std::map<std::string, size_t>::const_iterator dep = indices.find(deps->second[j]);
+                    if (dep != indices.end())
+                        dependencies.push_back(dep->second);
+                }
+
+            bool worker = worker_initialize_entries_.find(modules_[i].entry_) != worker_initialize_entries_.end();
+            if (worker)
+                ++num_worker_modules;
+
+            size_t index = indices.size();
+            indices[modules_[i].entry_] = index;
+            scheduler.AddModule(mod, dependencies, worker);
+        }
+
+        // Leave one hardware thread for the modules initialized on the main thread.
+        uint num_workers = std::min(num_worker_modules, std::max(boost::thread::hardware_concurrency(), 2u) - 1);
+        Foundation::RootLogInfo("Initializing " + ToString(num_worker_modules) + " modules on " + ToString(num_workers) + " worker threads.");
+
+        scheduler.Run(num_workers);
     }
 
     void ModuleManager::UninitializeModules()
@@ -475,7 +697,9 @@ namespace Foundation
         {
             try
             {
+                ptime start = microsec_clock::universal_time();
                 library = Module::SharedLibraryPtr(new Module::SharedLibrary(path));
+                RecordStartupPhase(fs::path(name).filename(), "LoadLibrary", start);
                 if (!library->sl_.hasSymbol("SetProfiler"))
                     throw Poco::Exception("Function SetProfiler() need to be exported from the shared library for profiling to work properly!");
 
@@ -537,7 +761,9 @@ namespace Foundation
 #endif
 
             module->SetFramework(framework_);
+            ptime start = microsec_clock::universal_time();
             module->LoadInternal();
+            RecordStartupPhase(module->Name(), "Load", start);
 
             Module::Entry entry = { modulePtr, *it, library };
 
@@ -562,7 +788,9 @@ namespace Foundation
         assert(module);
         assert(module->State() == Foundation::Module::MS_Loaded);
         Foundation::RootLogDebug("Preinitializing module " + module->Name());
+        ptime start = microsec_clock::universal_time();
         module->PreInitializeInternal();
+        RecordStartupPhase(module->Name(), "PreInitialize", start);
 
         // Do not log preinit success here to avoid extraneous logging.
     }
@@ -572,7 +800,9 @@ namespace Foundation
         assert(module);
         assert(module->State() == Foundation::Module::MS_Loaded);
         Foundation::RootLogDebug("Initializing module " + module->Name());
+        ptime start = microsec_clock::universal_time();
         module->InitializeInternal();
+        RecordStartupPhase(module->Name(), "Initialize", start);
 
         // Send a log message in the log channel of the module we just initialized.
         Poco::Logger::get(module->Name()).information(module->Name() + " initialized.");
@@ -583,7 +813,9 @@ namespace Foundation
         assert(module);
         assert(module->State() == Foundation::Module::MS_Loaded);
         Foundation::RootLogDebug("Postinitializing module " + module->Name());
+        ptime start = microsec_clock::universal_time();
         module->PostInitializeInternal();
+        RecordStartupPhase(module->Name(), "PostInitialize", start);
 
         // Do not log postinit success here to avoid extraneous logging.
     }
@@ -624,6 +856,64 @@ namespace Foundation
         return false;
     }
 
+    void ModuleManager::RecordStartupPhase(const std::string &module, const std::string &phase, const ptime &start)
+    {
+        ptime end = microsec_clock::universal_time();
+
+        Module::StartupPhase startup_phase;
+        startup_phase.module_ = module;
+        startup_phase.phase_ = phase;
+        startup_phase.start_ = (start - startup_time_).total_microseconds() / 1000.0;
+        startup_phase.duration_ = (end - start).total_microseconds() / 1000.0;
+        startup_phase.worker_ = boost::this_thread::get_id() != main_thread_id_;
+
+        MutexLock lock(startup_phases_mutex_);
+        startup_phases_.push_back(startup_phase);
+    }
+
+    std::vector<Module::StartupPhase> ModuleManager::GetStartupPhases() const
+    {
+        std::vector<Module::StartupPhase> phases;
+        {
+            MutexLock lock(startup_phases_mutex_);
+            phases = startup_phases_;
+        }
+
+        std::stable_sort(phases.begin(), phases.end(), Module::StartupPhaseLess);
+        return phases;
+    }
+
+    StringVector ModuleManager::GetStartupTimeline() const
+    {
+        std::vector<Module::StartupPhase> phases = GetStartupPhases();
+
+        StringVector lines;
+        lines.push_back("    start ms  duration ms  thread  phase           module");
+        for(size_t i = 0; i < phases.size(); ++i)
+        {
+            std::stringstream ss;
+            ss << std::fixed << std::setprecision(1)
+               << std::setw(12) << phases[i].start_ << "  "
+               << std::setw(11) << phases[i].duration_ << "  "
+               << std::left << std::setw(6) << (phases[i].worker_ ? "worker" : "main") << "  "
+               << std::setw(14) << phases[i].phase_ << "  "
+               << phases[i].module_;
+            lines.push_back(ss.str());
+        }
+
+        return lines;
+    }
+
+    void ModuleManager::LogStartupTimeline() const
+    {
+        StringVector lines = GetStartupTimeline();
+        for(size_t i = 0; i < lines.size(); ++i)
+            Foundation::RootLogDebug(lines[i]);
+
+        f64 total = (microsec_clock::universal_time() - startup_time_).total_microseconds() / 1000.0;
+        Foundation::RootLogInfo("Modules loaded and initialized in " + ToString(static_cast<int>(total)) + " ms. Use StartupTimeline console command for details.");
+    }
+
     StringVectorPtr ModuleManager::GetXmlFiles(const std::string &path)
     {
         StringVectorPtr files(new StringVector);
@@ -4,11 +4,13 @@
 #define incl_Foundation_ModuleManager_h
 
 #include <boost/filesystem.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 #include <Poco/SharedLibrary.h>
 #include <Poco/ClassLoader.h>
 
 #include "ModuleInterface.h"
 #include "ModuleReference.h"
+#include "CoreThread.h"
 
 namespace fs = boost::filesystem;
 
@@ -72,11 +74,38 @@ namespace Foundation
             //! shared library this module was loaded from. Null for static library
             SharedLibraryPtr shared_library_;
         };
+
+        //! Time spent by a module in one startup phase. Used for the startup timeline of ModuleManager.
+        /*! \ingroup Foundation_group
+            \ingroup Module_group
+        */
+        struct StartupPhase
+        {
+            //! name of the module
+            std::string module_;
+            //! name of the phase, f.ex. LoadLibrary, Load, PreInitialize, Initialize or PostInitialize
+            std::string phase_;
+            //! start of the phase in milliseconds since the module manager was created
+            f64 start_;
+            //! duration of the phase in milliseconds
+            f64 duration_;
+            //! true if the phase was run on a worker thread
+            bool worker_;
+        };
     }
 
     //! Manages run-time loadable and unloadable modules.
     /*! See \ref ModuleArchitecture for details on how to use.  
 
+        Modules are loaded and initialized one at a time in dependency order on the main thread. If the
+        ModuleManager/parallel_initialization setting is enabled, InitializeModules() runs the Initialize()
+        of modules that set worker_initialize to true in their module definition
+        file on worker threads, as soon as the modules they depend on are initialized. Other modules are still
+        initialized in order on the main thread, concurrently with the worker threads. See \ref depencency_sec
+        for what such modules may do in Initialize().
+
+        The time each module spends in each startup phase is recorded, see GetStartupTimeline().
+
         \ingroup Foundation_group
         \ingroup Module_group
     */
@@ -276,6 +305,12 @@ namespace Foundation
         //! \note Does not remove from modules_
         void UnloadModule(Module::Entry &entry);
 
+        //! Returns the startup phases recorded so far, in the order they started.
+        std::vector<Module::StartupPhase> GetStartupPhases() const;
+
+        //! Returns the startup timeline as readable lines, one for each module startup phase.
+        StringVector GetStartupTimeline() const;
+
     private:
         /// Stores the information contained in a single shared library XML file.
         struct ModuleLoadDescription
@@ -283,6 +318,7 @@ namespace Foundation
             boost::filesystem::path moduleDescFilename;
             StringVector moduleNames; ///< The names of the modules contained in this shared library.
             StringVector dependencies;
+            bool workerInitialize; ///< True if the modules may be initialized on a worker thread.
 
             bool Precedes(const ModuleLoadDescription &rhs) const;
 
@@ -310,6 +346,15 @@ namespace Foundation
         //! returns true if module is present
         bool HasModule(ModuleInterface *module) const;
 
+        //! Initializes loaded modules, running modules that allow it on worker threads in dependency order.
+        void InitializeModulesParallel();
+
+        //! Records the time a module spent in a startup phase that began at start.
+        void RecordStartupPhase(const std::string &module, const std::string &phase, const boost::posix_time::ptime &start);
+
+        //! Writes the startup timeline and the total startup time to the log.
+        void LogStartupTimeline() const;
+
         //! Returns a vector containing all xml files in the specified directory, scans recursively.
         StringVectorPtr GetXmlFiles(const std::string &path);
 
@@ -327,6 +372,27 @@ namespace Foundation
         ModuleTypeSet exclude_list_;
         
         Framework *framework_;
+
+        //! If true, modules that allow it are initialized on worker threads
+        bool parallel_initialization_;
+
+        //! Dependencies of each module entry, from the module definition files
+        std::map<std::string, StringVector> module_dependencies_;
+
+        //! Module entries that may be initialized on a worker thread
+        std::set<std::string> worker_initialize_entries_;
+
+        //! Time the module manager was created, startup phases are timed from this
+        boost::posix_time::ptime startup_time_;
+
+        //! Thread the module manager was created in
+        boost::thread::id main_thread_id_;
+
+        //! Startup phases in the order they were recorded
+        std::vector<Module::StartupPhase> startup_phases_;
+
+        //! Mutex for startup phases, which may be recorded from worker threads
+        mutable Mutex startup_phases_mutex_;
     };
 }
 
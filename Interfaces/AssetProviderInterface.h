@@ -97,6 +97,15 @@ namespace Foundation
         //! Returns information about current asset transfers
         virtual AssetTransferInfoVector GetTransferInfo() = 0;
 
+        //! Sets download priority of an asset
+        /*! Providers that can download progressively may use this to order their requests, to choose the quality
+            to download, or to pause downloads that are not needed at the moment. Others can ignore it.
+            \param asset_id Asset ID
+            \param priority Estimated on-screen size of the asset in pixels, 0 if not visible at all, or negative to
+                   forget the priority
+         */
+        virtual void SetAssetPriority(const std::string& asset_id, Real priority) {};
+
         //! Sets current protocolmodule
         virtual void SetCurrentProtocolModule(boost::weak_ptr<ProtocolUtilities::ProtocolModuleInterface> protocolModule) {};
 
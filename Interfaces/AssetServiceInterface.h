@@ -97,6 +97,14 @@ namespace Foundation
         //! Gets information about current asset transfers
         virtual AssetTransferInfoVector GetAssetTransferInfo() = 0;
                 
+        //! Sets download priority of an asset
+        /*! Passed on to all asset providers. Can be called repeatedly, for example as the camera moves.
+            \param asset_id Asset ID
+            \param priority Estimated on-screen size of the asset in pixels, 0 if not visible at all, or negative to
+                   forget the priority when the asset is no longer used, so that providers fall back to their default
+         */
+        virtual void SetAssetPriority(const std::string& asset_id, Real priority) = 0;
+
         //! Registers an asset provider
         /*! \param asset_provider Provider to register
             \return true if successfully registered
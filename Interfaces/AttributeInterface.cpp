@@ -198,4 +198,129 @@ template<> void Attribute<AssetReference>::FromString(const std::string& str, Ch
     Set(value, change);
 }
 
+template<> void Attribute<std::string>::ToBinary(DataSerializer& dest) const
+{
+    dest.AddString(Get());
+}
+
+template<> void Attribute<bool>::ToBinary(DataSerializer& dest) const
+{
+    dest.AddBool(Get());
+}
+
+template<> void Attribute<int>::ToBinary(DataSerializer& dest) const
+{
+    dest.AddS32(Get());
+}
+
+template<> void Attribute<uint>::ToBinary(DataSerializer& dest) const
+{
+    dest.AddU32(Get());
+}
+
+template<> void Attribute<Real>::ToBinary(DataSerializer& dest) const
+{
+    dest.AddF32(Get());
+}
+
+template<> void Attribute<Vector3df>::ToBinary(DataSerializer& dest) const
+{
+    Vector3df value = Get();
+    
+    dest.AddF32(value.x);
+    dest.AddF32(value.y);
+    dest.AddF32(value.z);
+}
+
+template<> void Attribute<Quaternion>::ToBinary(DataSerializer& dest) const
+{
+    Quaternion value = Get();
+    
+    dest.AddF32(value.w);
+    dest.AddF32(value.x);
+    dest.AddF32(value.y);
+    dest.AddF32(value.z);
+}
+
+template<> void Attribute<Color>::ToBinary(DataSerializer& dest) const
+{
+    Color value = Get();
+    
+    dest.AddF32(value.r);
+    dest.AddF32(value.g);
+    dest.AddF32(value.b);
+    dest.AddF32(value.a);
+}
+
+template<> void Attribute<AssetReference>::ToBinary(DataSerializer& dest) const
+{
+    AssetReference value = Get();
+    
+    dest.AddString(value.type_);
+    dest.AddString(value.id_);
+}
+
+template<> void Attribute<std::string>::FromBinary(DataDeserializer& source, ChangeType change)
+{
+    Set(source.ReadString(), change);
+}
+
+template<> void Attribute<bool>::FromBinary(DataDeserializer& source, ChangeType change)
+{
+    Set(source.ReadBool(), change);
+}
+
+template<> void Attribute<int>::FromBinary(DataDeserializer& source, ChangeType change)
+{
+    Set(source.ReadS32(), change);
+}
+
+template<> void Attribute<uint>::FromBinary(DataDeserializer& source, ChangeType change)
+{
+    Set(source.ReadU32(), change);
+}
+
+template<> void Attribute<Real>::FromBinary(DataDeserializer& source, ChangeType change)
+{
+    Set(source.ReadF32(), change);
+}
+
+template<> void Attribute<Vector3df>::FromBinary(DataDeserializer& source, ChangeType change)
+{
+    Vector3df value;
+    value.x = source.ReadF32();
+    value.y = source.ReadF32();
+    value.z = source.ReadF32();
+    Set(value, change);
+}
+
+template<> void Attribute<Quaternion>::FromBinary(DataDeserializer& source, ChangeType change)
+{
+    Quaternion value;
+    value.w = source.ReadF32();
+    value.x = source.ReadF32();
+    value.y = source.ReadF32();
+    value.z = source.ReadF32();
+    Set(value, change);
+}
+
+template<> void Attribute<Color>::FromBinary(DataDeserializer& source, ChangeType change)
+{
+    Color value;
+    value.r = source.ReadF32();
+    value.g = source.ReadF32();
+    value.b = source.ReadF32();
+    value.a = source.ReadF32();
+    Set(value, change);
+}
+
+template<> void Attribute<AssetReference>::FromBinary(DataDeserializer& source, ChangeType change)
+{
+    std::string type = source.ReadString();
+    std::string id = source.ReadString();
+    
+    Foundation::AssetReference value(id, type);
+    Set(value, change);
+}
+
 }
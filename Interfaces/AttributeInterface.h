@@ -5,6 +5,7 @@
 
 #include "CoreDefines.h"
 #include "CoreStringUtils.h"
+#include "DataSerializer.h"
 #include "ComponentInterface.h"
 
 namespace Foundation
@@ -47,6 +48,12 @@ namespace Foundation
         virtual std::string ToString() const = 0;
         //! Convert attribute from string for XML deserialization
         virtual void FromString(const std::string& str, ChangeType change) = 0;
+        //! Write attribute value for binary serialization
+        virtual void ToBinary(DataSerializer& dest) const = 0;
+        //! Read attribute value for binary deserialization
+        /*! Throws Exception if the data ends before the value does
+         */
+        virtual void FromBinary(DataDeserializer& source, ChangeType change) = 0;
         
     protected:
         //! Owning component
@@ -86,6 +93,8 @@ namespace Foundation
         
         virtual std::string ToString() const;
         virtual void FromString(const std::string& str, ChangeType change);
+        virtual void ToBinary(DataSerializer& dest) const;
+        virtual void FromBinary(DataDeserializer& source, ChangeType change);
         
     private:
         //! Attribute value
@@ -9,6 +9,7 @@
 #include "ServiceManager.h"
 #include "Entity.h"
 #include "SceneManager.h"
+#include "DataSerializer.h"
 
 #include <QDomDocument>
 
@@ -138,4 +139,111 @@ void ComponentInterface::DeserializeFrom(QDomElement& element, ChangeType change
     }
 }
 
+void ComponentInterface::SerializeToBinary(DataSerializer& dest, bool dirty_only) const
+{
+    if (!IsBinarySerializable())
+        return;
+    
+    dest.AddString(TypeName());
+    
+    // Length of the rest is filled in at the end, so that readers can skip unknown components
+    size_t size_pos = dest.GetBytesFilled();
+    dest.AddU32(0);
+    
+    dest.AddString(name_);
+    
+    // Only a subclass that overrides IsBinarySerializable can get here with too many attributes
+    uint count = attributes_.size();
+    if (count > MAX_BINARY_ATTRIBUTES)
+    {
+        RootLogError("Component " + TypeName() + " has " + ToString(count) + " attributes, only the first " +
+            ToString((uint)MAX_BINARY_ATTRIBUTES) + " are serialized to binary. Serialize it as XML instead.");
+        assert(false);
+        count = MAX_BINARY_ATTRIBUTES;
+    }
+    dest.AddU8(count);
+    
+    std::vector<u8> mask((count + 7) / 8, 0);
+    for (uint i = 0; i < count; ++i)
+    {
+        if (!dirty_only || attributes_[i]->IsDirty())
+            mask[i / 8] |= 1 << (i % 8);
+    }
+    if (!mask.empty())
+        dest.AddBytes(&mask[0], mask.size());
+    
+    for (uint i = 0; i < count; ++i)
+    {
+        if (!(mask[i / 8] & (1 << (i % 8))))
+            continue;
+        
+        size_t attr_pos = dest.GetBytesFilled();
+        dest.AddU16(0);
+        attributes_[i]->ToBinary(dest);
+        size_t attr_size = dest.GetBytesFilled() - attr_pos - 2;
+        assert(attr_size <= 0xffff);
+        dest.SetU16(attr_pos, (u16)attr_size);
+    }
+    
+    dest.SetU32(size_pos, dest.GetBytesFilled() - size_pos - 4);
+}
+
+bool ComponentInterface::DeserializeFromBinary(DataDeserializer& source, ChangeType change)
+{
+    try
+    {
+        u32 size = source.ReadU32();
+        const u8* data = source.GetCurrentData();
+        source.Skip(size);
+        
+        if (!IsBinarySerializable())
+            return false;
+        
+        DataDeserializer body(data, size);
+        SetName(body.ReadString());
+        
+        uint count = body.ReadU8();
+        std::vector<u8> mask((count + 7) / 8, 0);
+        if (!mask.empty())
+            body.ReadBytes(&mask[0], mask.size());
+        
+        for (uint i = 0; i < count; ++i)
+        {
+            if (!(mask[i / 8] & (1 << (i % 8))))
+                continue;
+            
+            u16 attr_size = body.ReadU16();
+            const u8* attr_data = body.GetCurrentData();
+            body.Skip(attr_size);
+            
+            // Data for attributes this component does not have is skipped
+            if (i < attributes_.size())
+            {
+                DataDeserializer attr_source(attr_data, attr_size);
+                attributes_[i]->FromBinary(attr_source, change);
+            }
+        }
+    }
+    catch (Exception&)
+    {
+        return false;
+    }
+    
+    return true;
+}
+
+bool ComponentInterface::SkipBinary(DataDeserializer& source)
+{
+    try
+    {
+        source.Skip(source.ReadU32());
+    }
+    catch (Exception&)
+    {
+        return false;
+    }
+    
+    return true;
+}
+
 }
@@ -14,6 +14,8 @@
 
 class QDomDocument;
 class QDomElement;
+class DataSerializer;
+class DataDeserializer;
 
 namespace Scene
 {
@@ -59,7 +61,10 @@ namespace Foundation
         const std::string& Name() { return name_; }
         void SetName(const std::string& name) { name_ = name; }
         
-        void SetParentEntity(Scene::Entity* entity);
+        //! Set the entity the component belongs to, or null when it is removed from the entity
+        /*! Components that keep state about their entity elsewhere, f.ex. in the scene, override this to follow it.
+         */
+        virtual void SetParentEntity(Scene::Entity* entity);
         Scene::Entity* GetParentEntity() const;
         
         //! Return true for components that support XML serialization
@@ -83,6 +88,33 @@ namespace Foundation
         //! Deserialize from XML
         virtual void DeserializeFrom(QDomElement& element, ChangeType change);
         
+        //! Return true for components that support binary serialization
+        /*! By default the serializable components that keep their state in at most 255 attributes, the rest are
+            serialized as XML. Components that override SerializeTo with custom XML should return false.
+         */
+        virtual bool IsBinarySerializable() const
+        {
+            return IsSerializable() && !attributes_.empty() && attributes_.size() <= MAX_BINARY_ATTRIBUTES;
+        }
+        //! Maximum number of attributes in the binary serialization, the count is written as a byte
+        static const size_t MAX_BINARY_ATTRIBUTES = 255;
+        //! Serialize to binary
+        /*! Writes the type name and the length of the rest, then the name, a bitmask of the attributes present and
+            each of them prefixed with its length. Attribute values must stay below 64 kB.
+            \param dirty_only If true, only the attributes that have changed are written
+         */
+        virtual void SerializeToBinary(DataSerializer& dest, bool dirty_only = false) const;
+        //! Deserialize from binary
+        /*! The type name written by SerializeToBinary must have been read by the caller, to find the component.
+            Attributes are matched by index, attributes not present in the data keep their values.
+            \return False if the data was malformed
+         */
+        virtual bool DeserializeFromBinary(DataDeserializer& source, ChangeType change);
+        //! Skip the binary data of a component whose type name has been read, f.ex. an unknown component type
+        /*! \return False if the data was malformed
+         */
+        static bool SkipBinary(DataDeserializer& source);
+        
     protected:
         //! Helper function for starting component serialization. Creates a component element with name, adds it to the document, and returns it
         QDomElement BeginSerialization(QDomDocument& doc, QDomElement& base_element) const;
@@ -87,7 +87,8 @@ namespace MumbleVoip
             frame_sequence_(0),
             encoding_quality_(0),
             state_(STATE_CONNECTING),
-            send_position_(false)
+            send_position_(false),
+            frame_pool_(SAMPLE_RATE, SAMPLE_WIDTH, NUMBER_OF_CHANNELS, SAMPLES_IN_FRAME*SAMPLE_WIDTH/8, FRAMES_PER_PACKET)
     {
         // BlockingQueuedConnection for cross thread signaling
         QObject::connect(this, SIGNAL(UserObjectCreated(User*)), SLOT(AddToUserList(User*)), Qt::ConnectionType::BlockingQueuedConnection);
@@ -143,7 +144,7 @@ namespace MumbleVoip
         while (encode_queue_.size() > 0)
         {
             PCMAudioFrame* frame = encode_queue_.takeFirst();
-            SAFE_DELETE(frame);
+            frame_pool_.Release(frame);
         }
         while (channels_.size() > 0)
         {
@@ -335,7 +336,8 @@ namespace MumbleVoip
         if (state_ != STATE_OPEN)
             return;
 
-        PCMAudioFrame* f = new PCMAudioFrame(frame);
+        PCMAudioFrame* f = frame_pool_.Get();
+        memcpy(f->DataPtr(), frame->DataPtr(), std::min(f->DataSize(), frame->DataSize()));
         encode_queue_.push_back(f);
         
         if (encode_queue_.size() < FRAMES_PER_PACKET)
@@ -352,7 +354,7 @@ namespace MumbleVoip
             packet_list.push_back(std::string(reinterpret_cast<char *>(encode_buffer_), len));
             assert(len < ENCODE_BUFFER_SIZE_);
 
-            delete audio_frame;
+            frame_pool_.Release(audio_frame);
         }
         const int PACKET_DATA_SIZE_MAX = 1024;
 	    static char data[PACKET_DATA_SIZE_MAX];
@@ -631,26 +633,21 @@ namespace MumbleVoip
             return;
         }
 
-        PCMAudioFrame* audio_frame = new PCMAudioFrame(SAMPLE_RATE, SAMPLE_WIDTH, NUMBER_OF_CHANNELS, SAMPLES_IN_FRAME*SAMPLE_WIDTH/8);
+        // Decode straight into the playback buffer of the user. The buffer is lock free,
+        // so the main thread may be reading older frames at the same time.
+        PCMAudioFrame* audio_frame = user->GetPlaybackBufferFrame();
+        if (!audio_frame)
+        {
+            user->AddToPlaybackBuffer(); // counts the dropped frame
+            return;
+        }
         int ret = celt_decode(celt_decoder_, data, size, (short*)audio_frame->DataPtr());
 
         switch (ret)
         {
         case CELT_OK:
-            {
-                if (user->tryLock(5)) // 5 ms
-                {
-                    user->AddToPlaybackBuffer(audio_frame);
-                    user->unlock();
-                    return;
-                }
-                else
-                {
-//                        user->NotifyAudioPacketDroped();
-                    MumbleVoipModule::LogWarning("Audio packet dropped: user locket");
-                }
-            }
-            break;
+            user->AddToPlaybackBuffer();
+            return;
         case CELT_BAD_ARG:
             MumbleVoipModule::LogError("CELT decoding error: CELT_BAD_ARG");
             break;
@@ -667,7 +664,6 @@ namespace MumbleVoip
             MumbleVoipModule::LogError("CELT decoding error: CELT_UNIMPLEMENTED");
             break;
         }
-        delete audio_frame;
     }
 
     void Connection::SetEncodingQuality(double quality)
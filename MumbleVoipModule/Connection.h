@@ -11,6 +11,7 @@
 #include <QTimer>
 #include "Core.h"
 #include "MumbleDefines.h"
+#include "PCMAudioFramePool.h"
 
 class QNetworkReply;
 class QNetworkAccessManager;
@@ -32,6 +33,7 @@ namespace MumbleVoip
     class PCMAudioFrame;
     class ServerInfo;
 
+    //! Audio frame of a user. The frame is owned by the user, see User::GetAudioFrame
     typedef QPair<User*, PCMAudioFrame*> AudioPacket;
 
     //! Connection to a single mumble server.
@@ -71,7 +73,8 @@ namespace MumbleVoip
 
         //! @return first <user,audio frame> pair from playback queue
         //!         return <0,0> if playback queue is empty
-        //! The caller must delete audio frame object after usage
+        //! The caller must give the frame back with User::ReleaseAudioFrame after usage
+        //! @note Reads the users' playback buffers, so must not be used while a VoiceMixer is running
         virtual AudioPacket GetAudioPacket();
 
         //! Encode and send given frame to Mumble server
@@ -170,6 +173,7 @@ namespace MumbleVoip
         QString reason_;
         MumbleClient::MumbleClient* client_;
         QString join_request_; // queued request to join a channel @todo IMPLEMENT BETTER
+        PCMAudioFramePool frame_pool_; // frames of encode_queue_
         QList<PCMAudioFrame*> encode_queue_;
         QList<Channel*> channels_; // @todo Use shared ptr
         QMap<int, User*> users_; // maps: session id <-> User object
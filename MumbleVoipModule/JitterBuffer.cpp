@@ -0,0 +1,175 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+
+#include "JitterBuffer.h"
+#include "PCMAudioFrame.h"
+#include "MumbleDefines.h"
+#include "CoreDefines.h"
+
+#include "MemoryLeakCheck.h"
+
+namespace MumbleVoip
+{
+    JitterBuffer::JitterBuffer() :
+        write_index_(0),
+        read_index_(0),
+        received_count_(0),
+        drop_count_(0),
+        target_depth_(INITIAL_DEPTH_),
+        playing_(false),
+        waiting_(false),
+        starved_(false),
+        played_ms_(0)
+    {
+        for (int i = 0; i < CAPACITY_; ++i)
+            slots_[i] = new PCMAudioFrame(SAMPLE_RATE, SAMPLE_WIDTH, NUMBER_OF_CHANNELS, SAMPLES_IN_FRAME*SAMPLE_WIDTH/8);
+        stable_time_.start();
+    }
+
+    JitterBuffer::~JitterBuffer()
+    {
+        for (int i = 0; i < CAPACITY_; ++i)
+            SAFE_DELETE(slots_[i]);
+    }
+
+    PCMAudioFrame* JitterBuffer::BeginWrite()
+    {
+        if (Available() >= CAPACITY_)
+            return 0;
+        return slots_[(int)write_index_ & (CAPACITY_ - 1)];
+    }
+
+    void JitterBuffer::EndWrite()
+    {
+        received_count_.ref();
+        write_index_.fetchAndAddRelease(1);
+    }
+
+    void JitterBuffer::DropFrame()
+    {
+        received_count_.ref();
+        drop_count_.ref();
+    }
+
+    int JitterBuffer::Available() const
+    {
+        // Indices only grow, so the difference stays correct when they wrap around
+        uint written = (uint)write_index_.fetchAndAddAcquire(0);
+        uint read = (uint)read_index_.fetchAndAddAcquire(0);
+        return (int)(written - read);
+    }
+
+    void JitterBuffer::Skip(int count)
+    {
+        drop_count_.fetchAndAddOrdered(count);
+        read_index_.fetchAndAddRelease(count);
+    }
+
+    void JitterBuffer::IncreaseDepth()
+    {
+        if (target_depth_ < MAX_DEPTH_)
+            target_depth_++;
+        stable_time_.start();
+    }
+
+    PCMAudioFrame* JitterBuffer::GetFrame()
+    {
+        int available = Available();
+
+        if (playing_)
+        {
+            int lead_ms = played_ms_ - playout_clock_.elapsed();
+            if (lead_ms < 0 && available == 0)
+            {
+                // Everything handed out has been played
+                playing_ = false;
+                starved_ = true;
+                starve_time_.start();
+                return 0;
+            }
+            if (lead_ms < 0)
+            {
+                // Frames arrived after the sound channel had run out of audio
+                if (lead_ms < -FRAME_LENGTH_MS_)
+                    IncreaseDepth();
+                playout_clock_.start();
+                played_ms_ = 0;
+            }
+        }
+
+        if (!playing_)
+        {
+            if (available == 0)
+                return 0;
+
+            if (starved_)
+            {
+                // Ran dry in the middle of speech, not at the end of a talk spurt
+                if (starve_time_.elapsed() < SPURT_GAP_MS_)
+                    IncreaseDepth();
+                starved_ = false;
+            }
+            if (!waiting_)
+            {
+                waiting_ = true;
+                wait_time_.start();
+            }
+
+            // Prebuffer target depth, unless the talk spurt is shorter than that
+            if (available < target_depth_ && wait_time_.elapsed() < target_depth_ * FRAME_LENGTH_MS_)
+                return 0;
+
+            waiting_ = false;
+            playing_ = true;
+            played_ms_ = 0;
+            playout_clock_.start();
+        }
+
+        if (stable_time_.elapsed() > DEPTH_DECREASE_INTERVAL_MS_)
+        {
+            if (target_depth_ > MIN_DEPTH_)
+                target_depth_--;
+            stable_time_.start();
+        }
+
+        if (played_ms_ - playout_clock_.elapsed() >= target_depth_ * FRAME_LENGTH_MS_)
+            return 0;
+        if (available == 0)
+            return 0;
+
+        // Sender is ahead of us, e.g. after a burst of delayed packets: drop the oldest audio
+        if (available > target_depth_ + MAX_EXCESS_)
+            Skip(available - target_depth_);
+
+        played_ms_ += FRAME_LENGTH_MS_;
+        return slots_[(int)read_index_ & (CAPACITY_ - 1)];
+    }
+
+    void JitterBuffer::ReleaseFrame()
+    {
+        read_index_.fetchAndAddRelease(1);
+    }
+
+    int JitterBuffer::LengthMs() const
+    {
+        return Available() * FRAME_LENGTH_MS_;
+    }
+
+    int JitterBuffer::TargetDepthMs() const
+    {
+        return target_depth_ * FRAME_LENGTH_MS_;
+    }
+
+    int JitterBuffer::ReceivedFrameCount() const
+    {
+        return received_count_.fetchAndAddAcquire(0);
+    }
+
+    int JitterBuffer::DroppedFrameCount() const
+    {
+        return drop_count_.fetchAndAddAcquire(0);
+    }
+
+} // namespace MumbleVoip
@@ -0,0 +1,101 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_MumbleVoipModule_JitterBuffer_h
+#define incl_MumbleVoipModule_JitterBuffer_h
+
+#include <QAtomicInt>
+#include <QTime>
+
+namespace MumbleVoip
+{
+    class PCMAudioFrame;
+
+    //! Playback buffer of received voice of one user
+    //!
+    //! Single producer, single consumer ring of preallocated audio frames. The
+    //! mumbleclient thread decodes straight into the frame returned by BeginWrite()
+    //! and publishes it with EndWrite(). The main thread takes frames with GetFrame()
+    //! and gives the slot back with ReleaseFrame(). Neither side takes a lock: the
+    //! write index is only advanced by the producer and the read index only by the
+    //! consumer.
+    //!
+    //! GetFrame() paces playback: when a talk spurt starts, frames are held back
+    //! until target depth worth of audio is buffered, and after that only as much
+    //! audio is handed out as keeps the sound channel target depth ahead of real
+    //! time. If the buffer runs dry in the middle of speech, the target depth is
+    //! increased by one frame. After a while without underruns it is decreased again.
+    class JitterBuffer
+    {
+    public:
+        JitterBuffer();
+        virtual ~JitterBuffer();
+
+        //! @return frame to decode into, 0 if the buffer is full. Producer thread only.
+        PCMAudioFrame* BeginWrite();
+
+        //! Publishes the frame returned by BeginWrite(). Producer thread only.
+        void EndWrite();
+
+        //! Counts a frame that could not be written
+        void DropFrame();
+
+        //! @return next frame due for playback, 0 if none. The frame must be given
+        //!         back with ReleaseFrame() before calling this again. Consumer thread only.
+        PCMAudioFrame* GetFrame();
+
+        //! Gives back the frame returned by GetFrame(). Consumer thread only.
+        void ReleaseFrame();
+
+        //! @return length of buffered audio in ms
+        int LengthMs() const;
+
+        //! @return current target depth in ms
+        int TargetDepthMs() const;
+
+        //! @return number of frames written
+        int ReceivedFrameCount() const;
+
+        //! @return number of frames dropped because the buffer was full or too long
+        int DroppedFrameCount() const;
+
+    private:
+        static const int CAPACITY_ = 32; // frames, must be power of two
+        static const int FRAME_LENGTH_MS_ = 10;
+        static const int MIN_DEPTH_ = 2; // frames
+        static const int INITIAL_DEPTH_ = 6; // frames, one packet of most senders
+        static const int MAX_DEPTH_ = 20; // frames
+        static const int MAX_EXCESS_ = 10; // frames over target depth before dropping
+        static const int SPURT_GAP_MS_ = 200; // silence longer than this starts a new talk spurt
+        static const int DEPTH_DECREASE_INTERVAL_MS_ = 10000;
+
+        //! @return number of frames written but not yet read
+        int Available() const;
+
+        //! Skips oldest frames. Consumer thread only.
+        void Skip(int count);
+
+        //! Increases target depth by one frame after an underrun
+        void IncreaseDepth();
+
+        PCMAudioFrame* slots_[CAPACITY_];
+        // Read with fetchAndAddAcquire(0) to get an acquire load
+        mutable QAtomicInt write_index_;
+        mutable QAtomicInt read_index_;
+        mutable QAtomicInt received_count_;
+        mutable QAtomicInt drop_count_;
+
+        // Consumer state
+        int target_depth_;
+        bool playing_;
+        bool waiting_;
+        bool starved_;
+        int played_ms_;
+        QTime playout_clock_;
+        QTime wait_time_;
+        QTime starve_time_;
+        QTime stable_time_;
+    };
+
+} // namespace MumbleVoip
+
+#endif // incl_MumbleVoipModule_JitterBuffer_h
@@ -0,0 +1,63 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+
+#include "PCMAudioFramePool.h"
+#include "PCMAudioFrame.h"
+#include "CoreDefines.h"
+
+#include "MemoryLeakCheck.h"
+
+namespace MumbleVoip
+{
+    PCMAudioFramePool::PCMAudioFramePool(int sample_rate, int sample_width, int channels, int data_size, int initial_count) :
+        sample_rate_(sample_rate),
+        sample_width_(sample_width),
+        channels_(channels),
+        data_size_(data_size)
+    {
+        for (int i = 0; i < initial_count; ++i)
+            free_frames_.append(new PCMAudioFrame(sample_rate_, sample_width_, channels_, data_size_));
+    }
+
+    PCMAudioFramePool::~PCMAudioFramePool()
+    {
+        QMutexLocker locker(&mutex_);
+        foreach(PCMAudioFrame* frame, free_frames_)
+            SAFE_DELETE(frame);
+        free_frames_.clear();
+    }
+
+    PCMAudioFrame* PCMAudioFramePool::Get()
+    {
+        {
+            QMutexLocker locker(&mutex_);
+            if (free_frames_.size() > 0)
+                return free_frames_.takeLast();
+        }
+        return new PCMAudioFrame(sample_rate_, sample_width_, channels_, data_size_);
+    }
+
+    void PCMAudioFramePool::Release(PCMAudioFrame* frame)
+    {
+        if (!frame)
+            return;
+
+        if (frame->DataSize() != data_size_)
+        {
+            delete frame;
+            return;
+        }
+
+        QMutexLocker locker(&mutex_);
+        free_frames_.append(frame);
+    }
+
+    int PCMAudioFramePool::FreeCount() const
+    {
+        QMutexLocker locker(&mutex_);
+        return free_frames_.size();
+    }
+
+} // namespace MumbleVoip
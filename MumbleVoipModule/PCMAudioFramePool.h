@@ -0,0 +1,48 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_MumbleVoipModule_PCMAudioFramePool_h
+#define incl_MumbleVoipModule_PCMAudioFramePool_h
+
+#include <QList>
+#include <QMutex>
+
+namespace MumbleVoip
+{
+    class PCMAudioFrame;
+
+    //! Recycles audio frames of one fixed size
+    //!
+    //! Voice is handled in 10 ms frames of equal size, so there is no need to
+    //! allocate a new frame from heap for each of them. Frames are taken with Get()
+    //! and given back with Release() instead of deleting them.
+    class PCMAudioFramePool
+    {
+    public:
+        //! @param data_size Size of the frames in bytes
+        //! @param initial_count Number of frames to allocate beforehand
+        PCMAudioFramePool(int sample_rate, int sample_width, int channels, int data_size, int initial_count);
+
+        //! Deletes the frames in the pool. Frames still in use must not be released after this.
+        virtual ~PCMAudioFramePool();
+
+        //! @return a free frame. Allocates a new one if the pool is empty.
+        virtual PCMAudioFrame* Get();
+
+        //! Returns a frame taken with Get() back to the pool
+        virtual void Release(PCMAudioFrame* frame);
+
+        //! @return number of free frames in the pool
+        virtual int FreeCount() const;
+
+    private:
+        int sample_rate_;
+        int sample_width_;
+        int channels_;
+        int data_size_;
+        QList<PCMAudioFrame*> free_frames_;
+        mutable QMutex mutex_;
+    };
+
+} // namespace MumbleVoip
+
+#endif // incl_MumbleVoipModule_PCMAudioFramePool_h
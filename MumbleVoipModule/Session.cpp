@@ -17,6 +17,8 @@
 #include "Participant.h"
 #include "MumbleLibrary.h"
 #include "MumbleVoipModule.h"
+#include "VoiceMixer.h"
+#include "ConfigurationManager.h"
 
 //#define BUILDING_DLL // for dll import/export declarations
 //#define CreateEvent  CreateEventW // for \boost\asio\detail\win_event.hpp and \boost\asio\detail\win_iocp_handle_service.hpp
@@ -41,7 +43,10 @@ namespace MumbleVoip
             audio_receiving_enabled_(true),
             speaker_voice_activity_(0),
             server_info_(server_info),
-            connection_(0)
+            connection_(0),
+            mixed_playback_channel_(0),
+            voice_mixer_(0),
+            recorded_frame_(new PCMAudioFrame(SAMPLE_RATE, SAMPLE_WIDTH, NUMBER_OF_CHANNELS, SAMPLES_IN_FRAME*SAMPLE_WIDTH/8))
         {
             channel_name_ = server_info.channel;
             OpenConnection(server_info);
@@ -59,8 +64,10 @@ namespace MumbleVoip
                 SAFE_DELETE(p);
             }
             left_participants_.clear();
+            SAFE_DELETE(voice_mixer_); // stops the mixer thread before users are deleted
             if (connection_)
                 SAFE_DELETE(connection_);
+            SAFE_DELETE(recorded_frame_);
         }
 
         void Session::OpenConnection(ServerInfo server_info)
@@ -83,12 +90,17 @@ namespace MumbleVoip
             connection_->SendAudio(audio_sending_enabled_);
             connection_->ReceiveAudio(audio_receiving_enabled_);
             MumbleLibrary::Start();
+
+            int max_positional_voices = framework_->GetDefaultConfig().DeclareSetting("MumbleVoip", "max_positional_voices", 4);
+            voice_mixer_ = new VoiceMixer(max_positional_voices);
+            voice_mixer_->start();
             //connect(MumbleLibrary::Instance(), SIGNAL(InteralError()), SLOT(HandleMumbleLibraryError()) );
 //            connect(connection_manager_, SIGNAL(AudioFrameSent(PCMAudioFrame*)), SLOT(UpdateSpeakerActivity(PCMAudioFrame*)) );
         }
 
         void Session::Close()
         {
+            SAFE_DELETE(voice_mixer_);
             connection_->Close();
             SAFE_DELETE(connection_);
             state_ = STATE_CLOSED;
@@ -317,16 +329,8 @@ namespace MumbleVoip
             if (counter != 0)
                 return;
 
-            short top = 0;
-            const short max = 100; //! \todo Use more proper treshold value
-            for(int i = 0; i < frame->SampleCount(); ++i)
-            {
-                int sample = abs(frame->SampleAt(i));
-                if (sample > top)
-                    top = sample;
-            }
-
-            double activity = top / max;
+            const double max = 3000; //! \todo Use more proper treshold value
+            double activity = VoiceMixer::Rms((const short*)frame->DataPtr(), frame->DataSize() * 8 / frame->SampleWidth()) / max;
             if (activity > 1.0)
                 activity = 1.0;
 
@@ -337,6 +341,16 @@ namespace MumbleVoip
         }
 
         bool Session::GetOwnAvatarPosition(Vector3df& position, Vector3df& direction)
+        {
+            Quaternion q;
+            if (!GetOwnAvatarTransform(position, q))
+                return false;
+
+            direction = q*Vector3df::UNIT_Z;
+            return true;
+        }
+
+        bool Session::GetOwnAvatarTransform(Vector3df& position, Quaternion& orientation)
         {
             using namespace Foundation;
             boost::shared_ptr<WorldLogicInterface> world_logic = framework_->GetServiceManager()->GetService<WorldLogicInterface>(Service::ST_WorldLogic).lock();
@@ -351,9 +365,8 @@ namespace MumbleVoip
             if (!ogre_placeable)
                 return false;
 
-            Quaternion q = ogre_placeable->GetOrientation();
             position = ogre_placeable->GetPosition(); 
-            direction = q*Vector3df::UNIT_Z;
+            orientation = ogre_placeable->GetOrientation();
 
             return true;
         }
@@ -412,7 +425,7 @@ namespace MumbleVoip
             while (sound_service->GetRecordedSoundSize() > SAMPLES_IN_FRAME*SAMPLE_WIDTH/8)
             {
                 int bytes_to_read = SAMPLES_IN_FRAME*SAMPLE_WIDTH/8;
-                PCMAudioFrame* frame = new PCMAudioFrame(SAMPLE_RATE, SAMPLE_WIDTH, NUMBER_OF_CHANNELS, bytes_to_read );
+                PCMAudioFrame* frame = recorded_frame_;
                 int bytes = sound_service->GetRecordedSoundData(frame->DataPtr(), bytes_to_read);
                 UpdateSpeakerActivity(frame);
                 assert(bytes_to_read == bytes);
@@ -429,45 +442,69 @@ namespace MumbleVoip
                 if (audio_sending_enabled_)
                     connection_->SendAudioFrame(frame, avatar_position);
 //                emit AudioFrameSent(frame);
-                delete frame;
             }
         }
 
         void Session::PlaybackReceivedAudio()
         {
-			if (!connection_)
+			if (!connection_ || !voice_mixer_)
 				return;
 
-			if (!audio_sending_enabled_)
-				return;
+            UpdateMixerSpeakers();
+
+            QList<VoiceMixer::PositionalFrame> positional_frames;
+            QList<PCMAudioFrame*> mixed_frames;
+            voice_mixer_->TakeOutput(positional_frames, mixed_frames);
 
-            for(;;)
+            // Frames are always taken from the mixer so that they do not pile up
+            QList<int> active_sessions;
+            foreach(VoiceMixer::PositionalFrame packet, positional_frames)
             {
-                AudioPacket packet = connection_->GetAudioPacket();
-                if (packet.second == 0)
-                    break; // nothing to play anymore
-
-				bool muted = false;
-				foreach(Participant* participant, participants_)
-				{
-					if (participant->UserPtr() == packet.first && participant->IsMuted())
-					{
-						muted = true;
-						break;
-					}
-				}
-				if (!muted)
-					PlaybackAudioFrame(packet.first, packet.second);
+                if (audio_sending_enabled_)
+                {
+                    PlaybackAudioFrame(packet.first, packet.second);
+                    active_sessions.append(packet.first->Session());
+                }
+                voice_mixer_->ReleaseFrame(packet.second);
             }
+            foreach(PCMAudioFrame* frame, mixed_frames)
+            {
+                if (audio_sending_enabled_)
+                    PlaybackMixedAudioFrame(frame);
+                voice_mixer_->ReleaseFrame(frame);
+            }
+
+            StopIdlePlaybackChannels(active_sessions);
         }
 
-        void Session::PlaybackAudioFrame(User* user, PCMAudioFrame* frame)
+        void Session::UpdateMixerSpeakers()
         {
-            boost::shared_ptr<Foundation::SoundServiceInterface> sound_service = SoundService();
-            if (!sound_service.get())
-                return;    
+            QList<VoiceMixer::Speaker> speakers;
+            foreach(Participant* participant, participants_)
+            {
+                User* user = participant->UserPtr();
+                if (!user)
+                    continue;
+
+                VoiceMixer::Speaker speaker;
+                speaker.user = user;
+                speaker.muted = participant->IsMuted();
+                QMutexLocker user_locker(user);
+                speaker.position_known = user->PositionKnown();
+                speaker.position = user->Position();
+                speakers.append(speaker);
+            }
 
-            Foundation::SoundServiceInterface::SoundBuffer sound_buffer;
+            Vector3df listener_position(0, 0, 0);
+            Quaternion listener_orientation;
+            GetOwnAvatarTransform(listener_position, listener_orientation);
+            voice_mixer_->SetSpeakers(speakers, listener_position, listener_orientation);
+        }
+
+        void Session::FillSoundBuffer(PCMAudioFrame* frame)
+        {
+            // The buffer keeps its capacity, so this does not allocate after the first frames
+            Foundation::SoundServiceInterface::SoundBuffer& sound_buffer = playback_sound_buffer_;
             
             sound_buffer.data_.resize(frame->DataSize());
             memcpy(&sound_buffer.data_[0], frame->DataPtr(), frame->DataSize());
@@ -482,6 +519,16 @@ namespace MumbleVoip
                 sound_buffer.stereo_ = true;
             else
                 sound_buffer.stereo_ = false;
+        }
+
+        void Session::PlaybackAudioFrame(User* user, PCMAudioFrame* frame)
+        {
+            boost::shared_ptr<Foundation::SoundServiceInterface> sound_service = SoundService();
+            if (!sound_service.get())
+                return;    
+
+            FillSoundBuffer(frame);
+            Foundation::SoundServiceInterface::SoundBuffer& sound_buffer = playback_sound_buffer_;
 
             QMutexLocker user_locker(user);
             if (audio_playback_channels_.contains(user->Session()))
@@ -494,8 +541,36 @@ namespace MumbleVoip
                     audio_playback_channels_[user->Session()] = sound_service->PlaySoundBuffer3D(sound_buffer, Foundation::SoundServiceInterface::Voice, user->Position(), 0);
                 else
                     audio_playback_channels_[user->Session()] = sound_service->PlaySoundBuffer(sound_buffer,  Foundation::SoundServiceInterface::Voice, 0);
+        }
+
+        void Session::PlaybackMixedAudioFrame(PCMAudioFrame* frame)
+        {
+            boost::shared_ptr<Foundation::SoundServiceInterface> sound_service = SoundService();
+            if (!sound_service.get())
+                return;    
+
+            FillSoundBuffer(frame);
+            mixed_playback_channel_ = sound_service->PlaySoundBuffer(playback_sound_buffer_, Foundation::SoundServiceInterface::Voice, mixed_playback_channel_);
+        }
+
+        void Session::StopIdlePlaybackChannels(const QList<int>& active_sessions)
+        {
+            boost::shared_ptr<Foundation::SoundServiceInterface> sound_service = SoundService();
+            if (!sound_service.get())
+                return;    
 
-            delete frame;
+            // Free the channels of speakers that are no longer positional once they have played out
+            QMap<int, sound_id_t>::iterator i = audio_playback_channels_.begin();
+            while (i != audio_playback_channels_.end())
+            {
+                if (!active_sessions.contains(i.key()) && sound_service->GetSoundState(i.value()) != Foundation::SoundServiceInterface::Playing)
+                {
+                    sound_service->StopSound(i.value());
+                    i = audio_playback_channels_.erase(i);
+                }
+                else
+                    ++i;
+            }
         }
 
         boost::shared_ptr<Foundation::SoundServiceInterface> Session::SoundService()
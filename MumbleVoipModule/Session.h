@@ -23,6 +23,7 @@ namespace MumbleVoip
     class User;
     class PCMAudioFrame;
     class Connection;
+    class VoiceMixer;
 
     namespace InWorldVoice
     {
@@ -62,11 +63,16 @@ namespace MumbleVoip
 
             virtual void OpenConnection(ServerInfo info);
             bool GetOwnAvatarPosition(Vector3df& position, Vector3df& direction);
+            bool GetOwnAvatarTransform(Vector3df& position, Quaternion& orientation);
             QString OwnAvatarId();
             QString GetAvatarFullName(QString uuid) const;
             void SendRecordedAudio();
             void PlaybackReceivedAudio();
+            void UpdateMixerSpeakers();
+            void FillSoundBuffer(PCMAudioFrame* frame);
             void PlaybackAudioFrame(User* user, PCMAudioFrame* frame);
+            void PlaybackMixedAudioFrame(PCMAudioFrame* frame);
+            void StopIdlePlaybackChannels(const QList<int>& active_sessions);
             boost::shared_ptr<Foundation::SoundServiceInterface> SoundService();
     
             Foundation::Framework* framework_;
@@ -85,8 +91,12 @@ namespace MumbleVoip
             const ServerInfo &server_info_;
             User* self_user_;
             QString channel_name_;
-            QMap<int, sound_id_t> audio_playback_channels_;
+            QMap<int, sound_id_t> audio_playback_channels_; // positional channels, only for the closest speakers
+            sound_id_t mixed_playback_channel_; // stereo mix of the other speakers
+            VoiceMixer* voice_mixer_;
             std::string recording_device_;
+            PCMAudioFrame* recorded_frame_; // reused for every recorded chunk
+            Foundation::SoundServiceInterface::SoundBuffer playback_sound_buffer_; // reused for every played frame
 
         private slots:
             void CreateNewParticipant(User*);
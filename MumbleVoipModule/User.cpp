@@ -24,18 +24,13 @@ namespace MumbleVoip
           position_(0,0,0),
           left_(false),
           channel_(channel),
-          received_voice_packet_count_(0),
-          voice_packet_drop_count_(0)
+          playback_buffer_frame_taken_(false)
     {
         last_audio_frame_time_.start(); // initialize time state so that restart is possible later
     }
 
     User::~User()
     {
-        foreach(PCMAudioFrame* audio, playback_queue_)
-            SAFE_DELETE(audio);
-
-        playback_queue_.clear();
     }
 
     QString User::Name() const
@@ -73,20 +68,21 @@ namespace MumbleVoip
         return speaking_;
     }
 
-    void User::AddToPlaybackBuffer(PCMAudioFrame* frame)
+    PCMAudioFrame* User::GetPlaybackBufferFrame()
     {
-        received_voice_packet_count_++;
-        if (PlaybackBufferLengthMs() > PLAYBACK_BUFFER_MAX_LENGTH_MS_)
-        {
-            foreach(PCMAudioFrame* frame, playback_queue_)
-            {
-                delete frame;
-                voice_packet_drop_count_++;
-            }
-            playback_queue_.clear();
-        }
+        PCMAudioFrame* frame = playback_buffer_.BeginWrite();
+        playback_buffer_frame_taken_ = (frame != 0);
+        return frame;
+    }
+
+    void User::AddToPlaybackBuffer()
+    {
+        if (playback_buffer_frame_taken_)
+            playback_buffer_.EndWrite();
+        else
+            playback_buffer_.DropFrame();
+        playback_buffer_frame_taken_ = false;
 
-        playback_queue_.push_back(frame);
         last_audio_frame_time_.restart();
 
         if (!speaking_)
@@ -111,22 +107,25 @@ namespace MumbleVoip
 
     int User::PlaybackBufferLengthMs() const
     {
-        return 1000 * playback_queue_.size() * SAMPLES_IN_FRAME / SAMPLE_RATE;
+        return playback_buffer_.LengthMs();
     }
     
     PCMAudioFrame* User::GetAudioFrame()
     {
-        if (playback_queue_.size() == 0)
-            return 0;
+        return playback_buffer_.GetFrame();
+    }
 
-        return playback_queue_.takeFirst();
+    void User::ReleaseAudioFrame()
+    {
+        playback_buffer_.ReleaseFrame();
     }
 
     double User::VoicePacketDropRatio() const
     {
-        if (received_voice_packet_count_ == 0)
+        int received = playback_buffer_.ReceivedFrameCount();
+        if (received == 0)
             return 0;
-        return static_cast<double>(voice_packet_drop_count_)/received_voice_packet_count_;
+        return static_cast<double>(playback_buffer_.DroppedFrameCount())/received;
     }
 
     void User::CheckSpeakingState()
@@ -10,6 +10,7 @@
 #include <Core.h>
 #include <QTimer>
 #include <QTime>
+#include "JitterBuffer.h"
 
 namespace MumbleClient
 {
@@ -62,10 +63,17 @@ namespace MumbleVoip
         //! @return length of playback buffer is ms for this user 
         virtual int PlaybackBufferLengthMs() const ;
 
-        //! @return oldest audio frame available for playback 
-        //! @note caller must delete audio frame object after usage
+        //! @return oldest audio frame due for playback, 0 if none
+        //! @note the frame is owned by the playback buffer, caller must call ReleaseAudioFrame after usage
         virtual PCMAudioFrame* GetAudioFrame();
 
+        //! Gives back the audio frame returned by GetAudioFrame
+        virtual void ReleaseAudioFrame();
+
+        //! @return frame to decode received audio data into, 0 if playback buffer is full.
+        //! Called from the mumbleclient thread, frame is added to playback buffer with AddToPlaybackBuffer
+        virtual PCMAudioFrame* GetPlaybackBufferFrame();
+
         //! Set user status to be left
         virtual void SetLeft() { left_ = true; emit Left(); }
 
@@ -79,10 +87,9 @@ namespace MumbleVoip
         virtual int CurrentChannelID() const; 
 
     public slots:
-        //! Put audio frame to end of playback buffer 
-        //! If playback buffer is full it is cleared first.
-        //! @param farme Audio data frame received from network and ment to be for playback locally
-        void AddToPlaybackBuffer(PCMAudioFrame* frame);
+        //! Put the audio frame returned by GetPlaybackBufferFrame to end of playback buffer 
+        //! Called from the mumbleclient thread. If there was no free frame, counts a dropped packet.
+        void AddToPlaybackBuffer();
 
         //! Updatedes user last known position
         //! Also set position_known_ flag up
@@ -95,18 +102,16 @@ namespace MumbleVoip
 
     private:
         static const int SPEAKING_TIMEOUT_MS = 100; // time to emit StopSpeaking after las audio packet is received
-        static const int PLAYBACK_BUFFER_MAX_LENGTH_MS_= 200;
 
         const MumbleClient::User& user_;
         bool speaking_;
         Vector3df position_;
         bool position_known_;
 
-        QList<PCMAudioFrame*> playback_queue_;
+        JitterBuffer playback_buffer_;
+        bool playback_buffer_frame_taken_;
         bool left_;
         MumbleVoip::Channel* channel_;
-        int received_voice_packet_count_;
-        int voice_packet_drop_count_;
         //QTimer channel_update_timer_;
         //QTimer timer_;
         QTime last_audio_frame_time_;
@@ -0,0 +1,320 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+
+#include "VoiceMixer.h"
+#include "User.h"
+#include "PCMAudioFrame.h"
+#include "MumbleDefines.h"
+#include "MumbleVoipModule.h"
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VOICEMIXER_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "MemoryLeakCheck.h"
+
+namespace MumbleVoip
+{
+    // Same range as the sound channels use by default
+    static const Real INNER_RADIUS = 1.0f;
+    static const Real OUTER_RADIUS = 50.0f;
+    static const Real ROLLOFF = 2.0f;
+
+    static const int FRAME_DATA_SIZE = SAMPLES_IN_FRAME*SAMPLE_WIDTH/8;
+
+    static Real DistanceAttenuation(Real distance)
+    {
+        if (distance <= INNER_RADIUS)
+            return 1.0f;
+        if (distance >= OUTER_RADIUS)
+            return 0.0f;
+        return pow(1.0f - (distance - INNER_RADIUS) / (OUTER_RADIUS - INNER_RADIUS), ROLLOFF);
+    }
+
+    VoiceMixer::VoiceMixer(int max_positional_voices) :
+        max_positional_voices_(max_positional_voices),
+        stop_(0),
+        listener_position_(0, 0, 0),
+        mono_pool_(SAMPLE_RATE, SAMPLE_WIDTH, NUMBER_OF_CHANNELS, FRAME_DATA_SIZE, 16),
+        stereo_pool_(SAMPLE_RATE, SAMPLE_WIDTH, 2, 2*FRAME_DATA_SIZE, 8),
+        mix_buffer_(2*SAMPLES_IN_FRAME)
+    {
+    }
+
+    VoiceMixer::~VoiceMixer()
+    {
+        Stop();
+
+        QMutexLocker locker(&output_mutex_);
+        foreach(PositionalFrame packet, positional_output_)
+            mono_pool_.Release(packet.second);
+        positional_output_.clear();
+        foreach(PCMAudioFrame* frame, mixed_output_)
+            stereo_pool_.Release(frame);
+        mixed_output_.clear();
+    }
+
+    void VoiceMixer::SetSpeakers(const QList<Speaker>& speakers, const Vector3df& listener_position, const Quaternion& listener_orientation)
+    {
+        QMutexLocker locker(&input_mutex_);
+        speakers_ = speakers;
+        listener_position_ = listener_position;
+        listener_orientation_ = listener_orientation;
+    }
+
+    void VoiceMixer::TakeOutput(QList<PositionalFrame>& positional, QList<PCMAudioFrame*>& mixed)
+    {
+        QMutexLocker locker(&output_mutex_);
+        positional.append(positional_output_);
+        positional_output_.clear();
+        mixed.append(mixed_output_);
+        mixed_output_.clear();
+    }
+
+    void VoiceMixer::ReleaseFrame(PCMAudioFrame* frame)
+    {
+        if (!frame)
+            return;
+        if (frame->Channels() == 2)
+            stereo_pool_.Release(frame);
+        else
+            mono_pool_.Release(frame);
+    }
+
+    void VoiceMixer::Stop()
+    {
+        stop_.fetchAndStoreOrdered(1);
+        wait();
+    }
+
+    double VoiceMixer::Rms(const short* samples, int count)
+    {
+        if (count <= 0)
+            return 0;
+
+        unsigned long long sum = 0;
+        int i = 0;
+#ifdef VOICEMIXER_SSE2
+        // Squares of sample pairs are at most 2^31, so they fit unsigned 32 bit lanes.
+        // Widen to 64 bit before accumulating.
+        const __m128i zero = _mm_setzero_si128();
+        __m128i acc = _mm_setzero_si128();
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+            __m128i squares = _mm_madd_epi16(v, v);
+            acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(squares, zero));
+            acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(squares, zero));
+        }
+        unsigned long long lanes[2];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+        sum = lanes[0] + lanes[1];
+#endif
+        for (; i < count; ++i)
+            sum += (unsigned long long)((int)samples[i] * (int)samples[i]);
+
+        return sqrt((double)sum / count);
+    }
+
+    void VoiceMixer::run()
+    {
+        MumbleVoipModule::LogDebug("Voice mixer started");
+
+        QTime clock;
+        clock.start();
+        int lead_ms = 0;
+
+        while (!(int)stop_)
+        {
+            lead_ms -= clock.restart();
+            if (lead_ms < -MAX_LAG_MS_)
+                lead_ms = 0;
+
+            if (lead_ms < MIX_LEAD_MS_)
+            {
+                MixFrame();
+                lead_ms += FRAME_LENGTH_MS_;
+                continue;
+            }
+
+            msleep(FRAME_LENGTH_MS_/2);
+        }
+
+        MumbleVoipModule::LogDebug("Voice mixer stopped");
+    }
+
+    void VoiceMixer::MixFrame()
+    {
+        Vector3df listener_position;
+        Quaternion listener_orientation;
+        {
+            QMutexLocker locker(&input_mutex_);
+            current_speakers_ = speakers_;
+            listener_position = listener_position_;
+            listener_orientation = listener_orientation_;
+        }
+
+        // Take a frame of every speaker and detect voice activity
+        candidates_.clear();
+        foreach(const Speaker& speaker, current_speakers_)
+        {
+            PCMAudioFrame* frame = speaker.user->GetAudioFrame();
+            VoiceState& state = voice_states_[speaker.user];
+            if (!frame)
+            {
+                state.silent_ms += FRAME_LENGTH_MS_;
+                if (state.silent_ms > VAD_HANGOVER_MS_)
+                    state.active = false;
+                continue;
+            }
+
+            if (Rms((const short*)frame->DataPtr(), SAMPLES_IN_FRAME) > VAD_THRESHOLD_RMS_)
+            {
+                state.active = true;
+                state.silent_ms = 0;
+            }
+            else
+            {
+                state.silent_ms += FRAME_LENGTH_MS_;
+                if (state.silent_ms > VAD_HANGOVER_MS_)
+                    state.active = false;
+            }
+
+            if (speaker.muted || !state.active)
+            {
+                speaker.user->ReleaseAudioFrame();
+                continue;
+            }
+
+            Candidate candidate;
+            candidate.user = speaker.user;
+            candidate.frame = frame;
+            candidate.position = speaker.position;
+            candidate.position_known = speaker.position_known;
+            candidate.distance = speaker.position_known ? (speaker.position - listener_position).getLength() : OUTER_RADIUS;
+            // Speakers already positional keep their channel unless another one is clearly closer
+            if (state.positional)
+                candidate.distance = candidate.distance * POSITIONAL_HYSTERESIS_PERCENT_ / 100;
+            candidate.positional = false;
+            candidates_.push_back(candidate);
+        }
+
+        // Pick the closest speakers with a known position for positional playback
+        for (int n = 0; n < max_positional_voices_; ++n)
+        {
+            Candidate* closest = 0;
+            for (uint i = 0; i < candidates_.size(); ++i)
+            {
+                Candidate& c = candidates_[i];
+                if (c.positional || !c.position_known)
+                    continue;
+                if (!closest || c.distance < closest->distance)
+                    closest = &c;
+            }
+            if (!closest)
+                break;
+            closest->positional = true;
+        }
+
+        // Right hand direction of the listener, +Y is left
+        Vector3df right = listener_orientation * Vector3df(0.0f, -1.0f, 0.0f);
+
+        bool mixed = false;
+        for (uint i = 0; i < candidates_.size(); ++i)
+        {
+            Candidate& c = candidates_[i];
+            voice_states_[c.user].positional = c.positional;
+
+            if (c.positional)
+            {
+                PCMAudioFrame* out = mono_pool_.Get();
+                memcpy(out->DataPtr(), c.frame->DataPtr(), FRAME_DATA_SIZE);
+                c.user->ReleaseAudioFrame();
+
+                QMutexLocker locker(&output_mutex_);
+                positional_output_.append(PositionalFrame(c.user, out));
+                continue;
+            }
+
+            Real gain = 1.0f;
+            Real pan = 0.0f;
+            if (c.position_known)
+            {
+                Vector3df direction = c.position - listener_position;
+                Real distance = direction.getLength();
+                gain = DistanceAttenuation(distance);
+                if (distance > 0.001f)
+                    pan = direction.dotProduct(right) / distance;
+            }
+
+            if (gain > 0.0f)
+            {
+                // Equal power panning
+                Real angle = (pan + 1.0f) * 0.25f * 3.14159265f;
+                float left_gain = (float)(gain * cos(angle));
+                float right_gain = (float)(gain * sin(angle));
+
+                if (!mixed)
+                {
+                    std::fill(mix_buffer_.begin(), mix_buffer_.end(), 0.0f);
+                    mixed = true;
+                }
+                const short* samples = (const short*)c.frame->DataPtr();
+                float* dest = &mix_buffer_[0];
+                for (int s = 0; s < SAMPLES_IN_FRAME; ++s)
+                {
+                    dest[2*s] += samples[s] * left_gain;
+                    dest[2*s+1] += samples[s] * right_gain;
+                }
+            }
+
+            c.user->ReleaseAudioFrame();
+        }
+
+        if (mixed)
+        {
+            PCMAudioFrame* out = stereo_pool_.Get();
+            short* dest = (short*)out->DataPtr();
+            for (int s = 0; s < 2*SAMPLES_IN_FRAME; ++s)
+            {
+                float value = mix_buffer_[s];
+                if (value > 32767.0f)
+                    value = 32767.0f;
+                if (value < -32768.0f)
+                    value = -32768.0f;
+                dest[s] = (short)value;
+            }
+
+            QMutexLocker locker(&output_mutex_);
+            mixed_output_.append(out);
+        }
+
+        // Forget users no longer given
+        if (voice_states_.size() > current_speakers_.size())
+        {
+            QMap<User*, VoiceState>::iterator i = voice_states_.begin();
+            while (i != voice_states_.end())
+            {
+                bool found = false;
+                foreach(const Speaker& speaker, current_speakers_)
+                {
+                    if (speaker.user == i.key())
+                    {
+                        found = true;
+                        break;
+                    }
+                }
+                if (found)
+                    ++i;
+                else
+                    i = voice_states_.erase(i);
+            }
+        }
+    }
+
+} // namespace MumbleVoip
@@ -0,0 +1,133 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_MumbleVoipModule_VoiceMixer_h
+#define incl_MumbleVoipModule_VoiceMixer_h
+
+#include <QThread>
+#include <QList>
+#include <QMap>
+#include <QPair>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QTime>
+#include "Core.h"
+#include "PCMAudioFramePool.h"
+
+namespace MumbleVoip
+{
+    class User;
+    class PCMAudioFrame;
+
+    //! Mixes received voice on its own thread
+    //!
+    //! Every 10 ms the mixer takes one frame from the playback buffer of each
+    //! speaker, measures its RMS level and runs voice activity detection on it.
+    //! The closest active speakers with a known position, at most max_positional_voices,
+    //! get their frames passed through for positional playback. The frames of the
+    //! other active speakers are attenuated by distance, panned and mixed into one
+    //! stereo stream. So the number of sound channels in use stays bounded no
+    //! matter how many users are talking, and the main thread only queues the
+    //! ready frames to the sound service.
+    //!
+    //! The mixer runs a little ahead of real time so that the sound channels
+    //! always have some audio queued. It is the only reader of the users'
+    //! playback buffers while running.
+    class VoiceMixer : public QThread
+    {
+    public:
+        //! Speaker state given by the main thread
+        struct Speaker
+        {
+            User* user;
+            Vector3df position;
+            bool position_known;
+            bool muted;
+        };
+
+        //! Frame of one speaker for positional playback
+        typedef QPair<User*, PCMAudioFrame*> PositionalFrame;
+
+        //! @param max_positional_voices Number of speakers to play positionally, the rest are mixed
+        VoiceMixer(int max_positional_voices);
+
+        //! Stops the thread
+        virtual ~VoiceMixer();
+
+        //! Sets the speakers to mix and the listener transform. Called by the main thread.
+        void SetSpeakers(const QList<Speaker>& speakers, const Vector3df& listener_position, const Quaternion& listener_orientation);
+
+        //! Moves the frames mixed since the last call to the given lists. Called by the main thread.
+        //! @param positional Frames for positional playback, in order
+        //! @param mixed Stereo frames of the mixed stream, in order
+        //! @note The frames must be given back with ReleaseFrame
+        void TakeOutput(QList<PositionalFrame>& positional, QList<PCMAudioFrame*>& mixed);
+
+        //! Gives back a frame returned by TakeOutput
+        void ReleaseFrame(PCMAudioFrame* frame);
+
+        //! Stops the thread and waits for it to finish
+        void Stop();
+
+        //! @return RMS level of 16 bit samples
+        static double Rms(const short* samples, int count);
+
+    protected:
+        virtual void run();
+
+    private:
+        static const int FRAME_LENGTH_MS_ = 10;
+        static const int MIX_LEAD_MS_ = 60; // how far ahead of real time the mixer runs
+        static const int MAX_LAG_MS_ = 200; // if behind more than this, skip instead of catching up
+        static const int VAD_THRESHOLD_RMS_ = 300; // about -40 dB from full scale
+        static const int VAD_HANGOVER_MS_ = 300;
+        static const int POSITIONAL_HYSTERESIS_PERCENT_ = 80; // positional speakers stay so unless clearly farther
+
+        //! Mixes one frame of every speaker
+        void MixFrame();
+
+        //! Voice activity state of a speaker, mixer thread only
+        struct VoiceState
+        {
+            bool active;
+            int silent_ms;
+            bool positional;
+        };
+
+        //! Mix candidate of one frame, mixer thread only
+        struct Candidate
+        {
+            User* user;
+            PCMAudioFrame* frame;
+            Real distance;
+            Vector3df position;
+            bool position_known;
+            bool positional;
+        };
+
+        int max_positional_voices_;
+        QAtomicInt stop_;
+
+        // Input, guarded by input_mutex_
+        QList<Speaker> speakers_;
+        Vector3df listener_position_;
+        Quaternion listener_orientation_;
+        QMutex input_mutex_;
+
+        // Output, guarded by output_mutex_
+        QList<PositionalFrame> positional_output_;
+        QList<PCMAudioFrame*> mixed_output_;
+        QMutex output_mutex_;
+
+        PCMAudioFramePool mono_pool_;
+        PCMAudioFramePool stereo_pool_;
+
+        // Mixer thread state
+        QMap<User*, VoiceState> voice_states_;
+        QList<Speaker> current_speakers_;
+        std::vector<Candidate> candidates_;
+        std::vector<float> mix_buffer_;
+    };
+
+} // namespace MumbleVoip
+
+#endif // incl_MumbleVoipModule_VoiceMixer_h
@@ -4,13 +4,33 @@
 #include "EC_OgreMesh.h"
 #include "EC_OgreAnimationController.h"
 #include "OgreRenderingModule.h"
+#include "Renderer.h"
 
 #include <Ogre.h>
 
 namespace OgreRenderer
 {
+    //! Fraction of the screen height above which the skeleton is updated every frame
+    static const Real cLodFullScreenSize = 0.1f;
+
+    //! Fraction of the screen height below which the skeleton is updated at the low rate
+    static const Real cLodLowScreenSize = 0.02f;
+
+    //! Spreads the reduced rate updates of different controllers over different frames
+    static uint lod_stagger = 0;
+
     EC_OgreAnimationController::EC_OgreAnimationController(Foundation::ModuleInterface* module) :
-        Foundation::ComponentInterface(module->GetFramework())
+        Foundation::ComponentInterface(module->GetFramework()),
+        renderer_(checked_static_cast<OgreRenderingModule*>(module)->GetRenderer()),
+        lod_(LOD_FULL),
+        lod_frames_(lod_stagger++ % 8),
+        lod_time_(0.0),
+        lod_enabled_(module->GetFramework()->GetDefaultConfig().DeclareSetting("OgreRenderer", "animation_lod", true)),
+        lod_near_distance_(module->GetFramework()->GetDefaultConfig().DeclareSetting("OgreRenderer", "animation_lod_near_distance", 20.0f)),
+        lod_far_distance_(module->GetFramework()->GetDefaultConfig().DeclareSetting("OgreRenderer", "animation_lod_far_distance", 60.0f)),
+        lod_reduced_interval_(module->GetFramework()->GetDefaultConfig().DeclareSetting("OgreRenderer", "animation_lod_reduced_interval", 2)),
+        lod_low_interval_(module->GetFramework()->GetDefaultConfig().DeclareSetting("OgreRenderer", "animation_lod_low_interval", 5)),
+        lod_offscreen_interval_(module->GetFramework()->GetDefaultConfig().DeclareSetting("OgreRenderer", "animation_lod_offscreen_interval", 0.5))
     {
         ResetState();
     }
@@ -35,7 +55,24 @@ namespace OgreRenderer
         Ogre::Entity* entity = GetEntity();
         if (!entity) return;
         
+        if (animations_.empty())
+        {
+            lod_time_ = 0.0;
+            return;
+        }
+        
+        // Skip updates according to the LOD, and step the animations by the accumulated time when updating
+        lod_ = DetermineLod(entity);
+        lod_time_ += frametime;
+        ++lod_frames_;
+        if (!IsLodUpdateDue())
+            return;
+        frametime = lod_time_;
+        lod_time_ = 0.0;
+        lod_frames_ = 0;
+        
         std::vector<std::string> erase_list;
+        active_states_.clear();
         
         // Loop through all animations & update them as necessary
         for (AnimationMap::iterator i = animations_.begin(); i != animations_.end(); ++i)
@@ -117,6 +154,7 @@ namespace OgreRenderer
                     animstate->addTime((Ogre::Real)(i->second.speed_factor_ * frametime));
                 if (!animstate->getEnabled())
                     animstate->setEnabled(true);
+                active_states_.push_back(std::make_pair(&i->second, animstate));
             }
             else
             {
@@ -150,16 +188,15 @@ namespace OgreRenderer
             }
 
 		    // Loop through all high priority animations & update the lowpriority-blendmask based on their active tracks
-            for (AnimationMap::iterator i = animations_.begin(); i != animations_.end(); ++i)
+            for (uint i = 0; i < active_states_.size(); ++i)
 	        {
-                Ogre::AnimationState* animstate = GetAnimationState(entity, i->first);
-                if (!animstate)
-                    continue;	        
+                const Animation& anim_data = *active_states_[i].first;
+                Ogre::AnimationState* animstate = active_states_[i].second;
                 // Create blend mask if animstate doesn't have it yet
                 if (!animstate->hasBlendMask())
                     animstate->createBlendMask(skel->getNumBones());
 
-                if ((i->second.high_priority_) && (i->second.weight_ > 0.0))
+                if ((anim_data.high_priority_) && (anim_data.weight_ > 0.0))
                 {
 				    // High-priority animations get the full weight blend mask
                     animstate->_setBlendMaskData(&highpriority_mask_[0]);
@@ -177,7 +214,7 @@ namespace OgreRenderer
 					    // by this animation's weight
 					    if (id < lowpriority_mask_.size())
 					    {
-						    lowpriority_mask_[id] -= i->second.weight_;
+						    lowpriority_mask_[id] -= anim_data.weight_;
 						    if (lowpriority_mask_[id] < 0.0) lowpriority_mask_[id] = 0.0;
 					    }
 			        }
@@ -185,13 +222,10 @@ namespace OgreRenderer
             }
 
 		    // Now set the calculated blendmask on low-priority animations
-            for (AnimationMap::iterator i = animations_.begin(); i != animations_.end(); ++i)
+            for (uint i = 0; i < active_states_.size(); ++i)
 	        {
-                Ogre::AnimationState* animstate = GetAnimationState(entity, i->first);
-                if (!animstate)
-                    continue;	
-                if (i->second.high_priority_ == false)	        
-                    animstate->_setBlendMaskData(&lowpriority_mask_[0]);			    			   
+                if (active_states_[i].first->high_priority_ == false)	        
+                    active_states_[i].second->_setBlendMaskData(&lowpriority_mask_[0]);			    			   
 		    }
         }
     }
@@ -218,6 +252,72 @@ namespace OgreRenderer
     void EC_OgreAnimationController::ResetState()
     {
         animations_.clear();
+        active_states_.clear();
+    }
+    
+    EC_OgreAnimationController::AnimationLod EC_OgreAnimationController::DetermineLod(Ogre::Entity* entity)
+    {
+        if (!lod_enabled_)
+            return LOD_FULL;
+        
+        RendererPtr renderer = renderer_.lock();
+        Ogre::Camera* camera = renderer ? renderer->GetCurrentCamera() : 0;
+        if (!camera)
+            return LOD_FULL;
+        
+        if (!entity->isInScene() || !entity->isVisible())
+            return LOD_OFFSCREEN;
+        
+        const Ogre::AxisAlignedBox& box = entity->getWorldBoundingBox(true);
+        if (!box.isFinite())
+            return LOD_FULL;
+        if (!camera->isVisible(box))
+            return LOD_OFFSCREEN;
+        
+        // The better of the distance and screen size tiers is used, so that nearby or large meshes stay smooth
+        Real radius = box.getHalfSize().length();
+        Real distance = box.getCenter().distance(camera->getDerivedPosition());
+        if (distance <= radius || distance <= lod_near_distance_)
+            return LOD_FULL;
+        
+        Real screen_size = radius / (distance * Ogre::Math::Tan(camera->getFOVy() * 0.5f));
+        if (screen_size >= cLodFullScreenSize)
+            return LOD_FULL;
+        if (screen_size < cLodLowScreenSize && distance > lod_far_distance_)
+            return LOD_LOW;
+        return LOD_REDUCED;
+    }
+    
+    bool EC_OgreAnimationController::IsLodUpdateDue() const
+    {
+        switch(lod_)
+        {
+        case LOD_REDUCED:
+            return lod_frames_ >= lod_reduced_interval_;
+        case LOD_LOW:
+            return lod_frames_ >= lod_low_interval_;
+        case LOD_OFFSCREEN:
+            return lod_time_ >= lod_offscreen_interval_;
+        default:
+            return true;
+        }
+    }
+    
+    const char* EC_OgreAnimationController::GetLodName(AnimationLod lod)
+    {
+        switch(lod)
+        {
+        case LOD_FULL:
+            return "full";
+        case LOD_REDUCED:
+            return "reduced";
+        case LOD_LOW:
+            return "low";
+        case LOD_OFFSCREEN:
+            return "offscreen";
+        default:
+            return "";
+        }
     }
     
     Ogre::AnimationState* EC_OgreAnimationController::GetAnimationState(Ogre::Entity* entity, const std::string& name)
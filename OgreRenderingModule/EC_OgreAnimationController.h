@@ -16,8 +16,16 @@ namespace Ogre
 
 namespace OgreRenderer
 {
+    class Renderer;
+    typedef boost::weak_ptr<Renderer> RendererWeakPtr;
+
     //! Ogre-specific mesh entity animation controller
     /*! Needs to be told of an EC_OgreMesh component to be usable
+
+        Skeletons that are far away, small on screen or outside the view are updated less often, according to
+        the animation LOD chosen on each update from the current camera. The time of skipped updates is
+        accumulated, so animations keep their speed. The LOD can be turned off with the OgreRenderer/animation_lod
+        setting.
         \ingroup OgreRenderingModuleClient
      */
     class OGRE_MODULE_API EC_OgreAnimationController : public Foundation::ComponentInterface
@@ -78,6 +86,20 @@ namespace OgreRenderer
         
         typedef std::map<std::string, Animation> AnimationMap;
 
+        //! Animation level of detail, how often the skeleton is updated
+        enum AnimationLod
+        {
+            //! Every frame
+            LOD_FULL = 0,
+            //! Every few frames
+            LOD_REDUCED,
+            //! Every several frames
+            LOD_LOW,
+            //! A few times a second, when outside the view
+            LOD_OFFSCREEN,
+            LOD_COUNT
+        };
+
         virtual ~EC_OgreAnimationController();
 
         //! Gets mesh entity component
@@ -133,6 +155,12 @@ namespace OgreRenderer
         
         //! Returns all running animations
         const AnimationMap& GetRunningAnimations() const { return animations_; }
+
+        //! Returns the animation LOD chosen on the last update
+        AnimationLod GetLod() const { return lod_; }
+
+        //! Returns name of an animation LOD
+        static const char* GetLodName(AnimationLod lod);
         
     private:
         //! Constructor
@@ -152,6 +180,15 @@ namespace OgreRenderer
         
         //! Resets internal state
         void ResetState();
+
+        //! Chooses the animation LOD of the Ogre entity from its visibility, distance and size on screen
+        AnimationLod DetermineLod(Ogre::Entity* entity);
+
+        //! Returns whether enough frames or time has accumulated for an update in the current LOD
+        bool IsLodUpdateDue() const;
+
+        //! Renderer
+        RendererWeakPtr renderer_;
         
         //! Mesh entity component 
         Foundation::ComponentPtr mesh_entity_;
@@ -167,6 +204,34 @@ namespace OgreRenderer
 
     	//! Bone blend mask of low-priority animations
     	Ogre::AnimationState::BoneBlendMask lowpriority_mask_;        
+
+        //! Animations updated on the last update and their animation states, to look the states up only once
+        std::vector<std::pair<Animation*, Ogre::AnimationState*> > active_states_;
+
+        //! Current animation LOD
+        AnimationLod lod_;
+
+        //! Frames since the last update
+        uint lod_frames_;
+
+        //! Time since the last update
+        f64 lod_time_;
+
+        //! Whether the animation LOD is in use
+        bool lod_enabled_;
+
+        //! Distance within which the skeleton is updated every frame
+        Real lod_near_distance_;
+
+        //! Distance beyond which the skeleton is updated at the low rate
+        Real lod_far_distance_;
+
+        //! Frames between updates in the reduced and low LODs
+        uint lod_reduced_interval_;
+        uint lod_low_interval_;
+
+        //! Seconds between updates outside the view
+        f64 lod_offscreen_interval_;
     };
 }
 
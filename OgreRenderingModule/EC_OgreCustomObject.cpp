@@ -5,6 +5,7 @@
 #include "Renderer.h"
 #include "EC_OgrePlaceable.h"
 #include "EC_OgreCustomObject.h"
+#include "StaticGeometryBatcher.h"
 
 #include <Ogre.h>
 
@@ -98,14 +99,20 @@ namespace OgreRenderer
     {
         draw_distance_ = draw_distance;
         if (entity_)
+        {
             entity_->setRenderingDistance(draw_distance);
+            RefreshStaticBatch();
+        }
     }
     
     void EC_OgreCustomObject::SetCastShadows(bool enabled)
     {
         cast_shadows_ = enabled;
         if (entity_)
+        {
             entity_->setCastShadows(enabled);
+            RefreshStaticBatch();
+        }
     }
     
     bool EC_OgreCustomObject::SetMaterial(uint index, const std::string& material_name)
@@ -129,6 +136,7 @@ namespace OgreRenderer
             return false;
         }
         
+        RefreshStaticBatch();
         return true;
     }
     
@@ -161,6 +169,13 @@ namespace OgreRenderer
             Ogre::SceneNode* node = placeable->GetSceneNode();
             node->attachObject(entity_);
             attached_ = true;
+            
+            if (!renderer_.expired())
+            {
+                StaticGeometryBatcher* batcher = renderer_.lock()->GetStaticGeometryBatcher();
+                if (batcher)
+                    batcher->AddEntity(entity_);
+            }
         }
     }
     
@@ -168,6 +183,13 @@ namespace OgreRenderer
     {
         if ((placeable_) && (attached_) && (entity_))
         {
+            if (!renderer_.expired())
+            {
+                StaticGeometryBatcher* batcher = renderer_.lock()->GetStaticGeometryBatcher();
+                if (batcher)
+                    batcher->RemoveEntity(entity_);
+            }
+            
             EC_OgrePlaceable* placeable = checked_static_cast<EC_OgrePlaceable*>(placeable_.get());
             Ogre::SceneNode* node = placeable->GetSceneNode();
             node->detachObject(entity_);
@@ -175,6 +197,16 @@ namespace OgreRenderer
         }
     }
     
+    void EC_OgreCustomObject::RefreshStaticBatch()
+    {
+        if ((!attached_) || (!entity_) || (renderer_.expired()))
+            return;
+        
+        StaticGeometryBatcher* batcher = renderer_.lock()->GetStaticGeometryBatcher();
+        if (batcher)
+            batcher->RefreshEntity(entity_);
+    }
+    
     void EC_OgreCustomObject::DestroyEntity()
     {
         if (renderer_.expired())
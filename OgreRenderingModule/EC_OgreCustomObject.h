@@ -104,6 +104,9 @@ namespace OgreRenderer
         //! removes old entity and mesh
         void DestroyEntity();
         
+        //! breaks the entity out of its static geometry batch after a change in its appearance
+        void RefreshStaticBatch();
+        
         //! placeable component 
         Foundation::ComponentPtr placeable_;
         
@@ -5,6 +5,8 @@
 #include "Renderer.h"
 #include "EC_OgrePlaceable.h"
 #include "EC_OgreMesh.h"
+#include "MeshInstancer.h"
+#include "MeshCloneCache.h"
 #include "RexTypes.h"
 
 #include <Ogre.h>
@@ -16,6 +18,7 @@ namespace OgreRenderer
         Foundation::ComponentInterface(module->GetFramework()),
         renderer_(checked_static_cast<OgreRenderingModule*>(module)->GetRenderer()),
         entity_(0),
+        shared_clone_(false),
         adjustment_node_(0),
         attached_(false),
         cast_shadows_(false),
@@ -143,7 +146,10 @@ namespace OgreRenderer
     {
         draw_distance_ = draw_distance;
         if (entity_)
+        {
             entity_->setRenderingDistance(draw_distance_);
+            RefreshStaticBatch();
+        }
         for (uint i = 0; i < attachment_entities_.size(); ++i)
         {
             if (attachment_entities_[i])
@@ -151,7 +157,7 @@ namespace OgreRenderer
         }
     }
     
-    bool EC_OgreMesh::SetMesh(const std::string& mesh_name, bool clone)
+    bool EC_OgreMesh::SetMesh(const std::string& mesh_name, bool clone, const std::string& clone_key, bool* clone_created)
     {
         if (renderer_.expired())
             return false;
@@ -161,7 +167,7 @@ namespace OgreRenderer
 
         Ogre::SceneManager* scene_mgr = renderer->GetSceneManager();
         
-        Ogre::Mesh* mesh = PrepareMesh(mesh_name, clone);
+        Ogre::Mesh* mesh = PrepareMesh(mesh_name, clone, clone_key, clone_created);
         if (!mesh)
             return false;
         
@@ -201,7 +207,8 @@ namespace OgreRenderer
         return SetMesh(mesh_name.toStdString(), false);
     }
 
-    bool EC_OgreMesh::SetMeshWithSkeleton(const std::string& mesh_name, const std::string& skeleton_name, bool clone)
+    bool EC_OgreMesh::SetMeshWithSkeleton(const std::string& mesh_name, const std::string& skeleton_name, bool clone,
+        const std::string& clone_key, bool* clone_created)
     {
         if (renderer_.expired())
             return false;
@@ -218,7 +225,8 @@ namespace OgreRenderer
 
         Ogre::SceneManager* scene_mgr = renderer->GetSceneManager();
         
-        Ogre::Mesh* mesh = PrepareMesh(mesh_name, clone);
+        // The skeleton is set to the mesh, so a shared clone can only be shared by users of the same skeleton
+        Ogre::Mesh* mesh = PrepareMesh(mesh_name, clone, clone_key.empty() ? clone_key : skeleton_name + "\n" + clone_key, clone_created);
         if (!mesh)
             return false;
         
@@ -284,16 +292,23 @@ namespace OgreRenderer
         
         if (!cloned_mesh_name_.empty())
         {
-            try
-            {
-                Ogre::MeshManager::getSingleton().remove(cloned_mesh_name_);
-            }
-            catch (Ogre::Exception& e)
+            MeshCloneCache* clone_cache = renderer->GetMeshCloneCache();
+            if (shared_clone_ && clone_cache)
+                clone_cache->ReleaseClone(cloned_mesh_name_);
+            else
             {
-                OgreRenderingModule::LogWarning("Could not remove cloned mesh:" + std::string(e.what()));
+                try
+                {
+                    Ogre::MeshManager::getSingleton().remove(cloned_mesh_name_);
+                }
+                catch (Ogre::Exception& e)
+                {
+                    OgreRenderingModule::LogWarning("Could not remove cloned mesh:" + std::string(e.what()));
+                }
             }
             
             cloned_mesh_name_ = std::string();
+            shared_clone_ = false;
         }
     }
     
@@ -470,6 +485,7 @@ namespace OgreRenderer
             return false;
         }
         
+        RefreshStaticBatch();
         return true;
     }
 
@@ -510,7 +526,10 @@ namespace OgreRenderer
     {
         cast_shadows_ = enabled;
         if (entity_)
+        {
             entity_->setCastShadows(cast_shadows_);
+            RefreshStaticBatch();
+        }
         //! \todo might want to disable shadows for some attachments
         for (uint i = 0; i < attachment_entities_.size(); ++i)
         {
@@ -632,6 +651,13 @@ namespace OgreRenderer
         if ((!attached_) || (!entity_) || (!placeable_))
             return;
             
+        if (!renderer_.expired())
+        {
+            MeshInstancer* instancer = renderer_.lock()->GetMeshInstancer();
+            if (instancer)
+                instancer->RemoveEntity(entity_);
+        }
+        
         EC_OgrePlaceable* placeable = checked_static_cast<EC_OgrePlaceable*>(placeable_.get());
         Ogre::SceneNode* node = placeable->GetSceneNode();
         adjustment_node_->detachObject(entity_);
@@ -651,10 +677,30 @@ namespace OgreRenderer
         adjustment_node_->attachObject(entity_);
                 
         attached_ = true;
+        
+        if (!renderer_.expired())
+        {
+            MeshInstancer* instancer = renderer_.lock()->GetMeshInstancer();
+            if (instancer)
+                instancer->AddEntity(entity_);
+        }
+    }
+    
+    void EC_OgreMesh::RefreshStaticBatch()
+    {
+        if ((!attached_) || (!entity_) || (renderer_.expired()))
+            return;
+        
+        MeshInstancer* instancer = renderer_.lock()->GetMeshInstancer();
+        if (instancer)
+            instancer->RefreshEntity(entity_);
     }
     
-    Ogre::Mesh* EC_OgreMesh::PrepareMesh(const std::string& mesh_name, bool clone)
+    Ogre::Mesh* EC_OgreMesh::PrepareMesh(const std::string& mesh_name, bool clone, const std::string& clone_key, bool* clone_created)
     {
+        if (clone_created)
+            *clone_created = false;
+
         if (renderer_.expired())
             return 0;
         RendererPtr renderer = renderer_.lock();   
@@ -684,7 +730,19 @@ namespace OgreRenderer
             return 0;
         }
         
-        if (clone)
+        MeshCloneCache* clone_cache = renderer->GetMeshCloneCache();
+        if (clone && !clone_key.empty() && clone_cache)
+        {
+            bool created = false;
+            mesh = clone_cache->AcquireClone(mesh, clone_key, created);
+            if (mesh.isNull())
+                return 0;
+            cloned_mesh_name_ = mesh->getName();
+            shared_clone_ = true;
+            if (clone_created)
+                *clone_created = created;
+        }
+        else if (clone)
         {
             try
             {
@@ -697,6 +755,8 @@ namespace OgreRenderer
                 OgreRenderingModule::LogError("Could not clone mesh " + mesh_name + ":" + std::string(e.what()));
                 return 0;
             }
+            if (clone_created)
+                *clone_created = true;
         }
         
         if (mesh->hasSkeleton())
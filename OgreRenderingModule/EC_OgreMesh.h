@@ -52,9 +52,11 @@ namespace OgreRenderer
         /*! if mesh already sets, removes the old one
             \param mesh_name mesh to use
             \param clone whether mesh should be cloned for modifying geometry uniquely
+            \param clone_key if not empty, the clone is shared by all meshes set with the same mesh and key, see MeshCloneCache
+            \param clone_created if not null, set to whether a new clone was created, and should be modified by the caller
             \return true if successful
          */
-        bool SetMesh(const std::string& mesh_name, bool clone = false);
+        bool SetMesh(const std::string& mesh_name, bool clone = false, const std::string& clone_key = std::string(), bool* clone_created = 0);
         bool SetMesh(const QString& mesh_name); //same as above, just for PythonQt compatibility
 
         //! sets mesh with custom skeleton
@@ -62,9 +64,12 @@ namespace OgreRenderer
             \param mesh_name mesh to use
             \param skeleton_name skeleton to use
             \param clone whether mesh should be cloned for modifying geometry uniquely
+            \param clone_key if not empty, the clone is shared by all meshes set with the same mesh, skeleton and key, see MeshCloneCache
+            \param clone_created if not null, set to whether a new clone was created, and should be modified by the caller
             \return true if successful
          */
-        bool SetMeshWithSkeleton(const std::string& mesh_name, const std::string& skeleton_name, bool clone = false);
+        bool SetMeshWithSkeleton(const std::string& mesh_name, const std::string& skeleton_name, bool clone = false,
+            const std::string& clone_key = std::string(), bool* clone_created = 0);
 
         //! sets material in mesh
         /*! \param index submesh index
@@ -212,9 +217,12 @@ namespace OgreRenderer
         //! prepares a mesh for creating an entity. some safeguards are needed because of Ogre "features"
         /*! \param mesh_name Mesh to prepare
             \param clone Whether should return an uniquely named clone of the mesh, rather than the original
+            \param clone_key If not empty, the clone is acquired from the shared clone cache with this key
+            \param clone_created If not null, set to whether a new clone was created
             \return pointer to mesh, or 0 if could not be safely prepared
          */
-        Ogre::Mesh* PrepareMesh(const std::string& mesh_name, bool clone = false);
+        Ogre::Mesh* PrepareMesh(const std::string& mesh_name, bool clone = false, const std::string& clone_key = std::string(),
+            bool* clone_created = 0);
         
         //! attaches entity to placeable
         void AttachEntity();
@@ -222,6 +230,9 @@ namespace OgreRenderer
         //! detaches entity from placeable
         void DetachEntity();
         
+        //! regroups the entity for instancing or static batching after a change in its appearance
+        void RefreshStaticBatch();
+        
         //! placeable component 
         Foundation::ComponentPtr placeable_;
         
@@ -238,6 +249,9 @@ namespace OgreRenderer
         
         //! non-empty if a cloned mesh is being used; should be removed when mesh is removed
         std::string cloned_mesh_name_;
+
+        //! whether the cloned mesh is shared through the clone cache, and should be released instead of removed
+        bool shared_clone_;
         
         //! adjustment scene node (scaling/offset/orientation modifications)
         Ogre::SceneNode* adjustment_node_;
@@ -4,12 +4,15 @@
 #include "OgreRenderingModule.h"
 #include "Renderer.h"
 #include "EC_OgrePlaceable.h"
+#include "SceneManager.h"
 #include <Ogre.h>
 
 #include "XMLUtilities.h"
 
 #include <QDomDocument>
 
+#include <algorithm>
+
 using namespace RexTypes;
 
 namespace OgreRenderer
@@ -34,6 +37,13 @@ namespace OgreRenderer
     
     EC_OgrePlaceable::~EC_OgrePlaceable()
     {
+        RemoveFromSpatialIndex();
+        if (parent_)
+        {
+            std::vector<EC_OgrePlaceable*>& siblings = checked_static_cast<EC_OgrePlaceable*>(parent_.get())->children_;
+            siblings.erase(std::remove(siblings.begin(), siblings.end(), this), siblings.end());
+        }
+        
         if (renderer_.expired())
             return;
         RendererPtr renderer = renderer_.lock();  
@@ -67,8 +77,28 @@ namespace OgreRenderer
             return;
         }
         DetachNode();
+        if (parent_)
+        {
+            std::vector<EC_OgrePlaceable*>& siblings = checked_static_cast<EC_OgrePlaceable*>(parent_.get())->children_;
+            siblings.erase(std::remove(siblings.begin(), siblings.end(), this), siblings.end());
+        }
         parent_ = placeable;
+        if (parent_)
+            checked_static_cast<EC_OgrePlaceable*>(parent_.get())->children_.push_back(this);
         AttachNode();
+        UpdateSpatialIndex();
+    }
+    
+    void EC_OgrePlaceable::SetParentEntity(Scene::Entity* entity)
+    {
+        if (entity == GetParentEntity())
+            return;
+        
+        RemoveFromSpatialIndex();
+        Foundation::ComponentInterface::SetParentEntity(entity);
+        // Nodes are attached when their position is first set, until then there is no position to index
+        if (attached_)
+            UpdateSpatialIndex();
     }
     
     Vector3df EC_OgrePlaceable::GetPosition() const
@@ -93,11 +123,13 @@ namespace OgreRenderer
     {
         link_scene_node_->setPosition(Ogre::Vector3(position.x, position.y, position.z));
         AttachNode(); // Nodes become visible only after having their position set at least once
+        UpdateSpatialIndex();
     }
 
     void EC_OgrePlaceable::SetOrientation(const Quaternion& orientation)
     {
         link_scene_node_->setOrientation(Ogre::Quaternion(orientation.w, orientation.x, orientation.y, orientation.z));
+        UpdateChildSpatialIndex();
     }
 
     void EC_OgrePlaceable::LookAt(const Vector3df& look_at)
@@ -106,21 +138,25 @@ namespace OgreRenderer
         // so start in identity transform
         link_scene_node_->setOrientation(Ogre::Quaternion::IDENTITY);
         link_scene_node_->lookAt(Ogre::Vector3(look_at.x, look_at.y, look_at.z), Ogre::Node::TS_WORLD);        
+        UpdateChildSpatialIndex();
     }
     
     void EC_OgrePlaceable::Yaw(Real radians)
     {
         link_scene_node_->yaw(Ogre::Radian(radians), Ogre::Node::TS_WORLD);
+        UpdateChildSpatialIndex();
     }
 
     void EC_OgrePlaceable::Pitch(Real radians)
     {
         link_scene_node_->pitch(Ogre::Radian(radians));
+        UpdateChildSpatialIndex();
     }
  
    void EC_OgrePlaceable::Roll(Real radians)
     {
         link_scene_node_->roll(Ogre::Radian(radians));
+        UpdateChildSpatialIndex();
     } 
     
     void EC_OgrePlaceable::SetScale(const Vector3df& scale)
@@ -180,6 +216,55 @@ namespace OgreRenderer
         attached_ = false;
     }
 
+    void EC_OgrePlaceable::UpdateSpatialIndex()
+    {
+        Scene::Entity* entity = GetParentEntity();
+        if (entity && entity->GetScene())
+        {
+            // A placeable with a parent is positioned relative to it, so index the world position
+            Ogre::Vector3 pos;
+            Ogre::Quaternion orientation;
+            Ogre::Vector3 scale;
+            GetWorldTransform(pos, orientation, scale);
+            entity->GetScene()->GetSpatialIndex().SetPosition(entity->GetId(), Vector3df(pos.x, pos.y, pos.z));
+        }
+        
+        UpdateChildSpatialIndex();
+    }
+    
+    void EC_OgrePlaceable::GetWorldTransform(Ogre::Vector3& position, Ogre::Quaternion& orientation, Ogre::Vector3& scale) const
+    {
+        position = link_scene_node_->getPosition();
+        orientation = link_scene_node_->getOrientation();
+        scale = link_scene_node_->getScale();
+        if (!parent_ || !attached_)
+            return;
+        
+        // Moving a node does not mark its children for update, so their cached derived transforms are stale until
+        // the next scene graph update. Compose the transform through the parents instead.
+        Ogre::Vector3 parent_position;
+        Ogre::Quaternion parent_orientation;
+        Ogre::Vector3 parent_scale;
+        checked_static_cast<EC_OgrePlaceable*>(parent_.get())->GetWorldTransform(parent_position, parent_orientation, parent_scale);
+        position = parent_position + parent_orientation * (parent_scale * position);
+        orientation = parent_orientation * orientation;
+        scale = parent_scale * scale;
+    }
+    
+    void EC_OgrePlaceable::UpdateChildSpatialIndex()
+    {
+        // The children move along with this placeable
+        for (uint i = 0; i < children_.size(); ++i)
+            children_[i]->UpdateSpatialIndex();
+    }
+    
+    void EC_OgrePlaceable::RemoveFromSpatialIndex()
+    {
+        Scene::Entity* entity = GetParentEntity();
+        if (entity && entity->GetScene())
+            entity->GetScene()->GetSpatialIndex().Remove(entity->GetId());
+    }
+
     //experimental QVector3D acessors
     QVector3D EC_OgrePlaceable::GetQPosition() const
     {
@@ -14,6 +14,8 @@
 namespace Ogre
 {
     class SceneNode;
+    class Vector3;
+    class Quaternion;
 }
 
 namespace OgreRenderer
@@ -44,6 +46,9 @@ namespace OgreRenderer
          */
         void SetParent(Foundation::ComponentPtr placeable);
         
+        //! sets the entity of the placeable, and moves the entity into or out of the scene's spatial index
+        virtual void SetParentEntity(Scene::Entity* entity);
+        
         //! sets position
         /*! \param position new position
          */
@@ -125,6 +130,18 @@ namespace OgreRenderer
         
         //! detaches scenenode from parent
         void DetachNode();
+
+        //! updates the position of the entity and the entities of the child placeables in the scene's spatial index
+        void UpdateSpatialIndex();
+        
+        //! updates the positions of the entities of the child placeables in the scene's spatial index
+        void UpdateChildSpatialIndex();
+        
+        //! removes the entity from the scene's spatial index
+        void RemoveFromSpatialIndex();
+        
+        //! returns the world transform of the link scene node, composed through the parent placeables
+        void GetWorldTransform(Ogre::Vector3& position, Ogre::Quaternion& orientation, Ogre::Vector3& scale) const;
         
         //! renderer
         RendererWeakPtr renderer_;
@@ -132,6 +149,9 @@ namespace OgreRenderer
         //! parent placeable
         Foundation::ComponentPtr parent_;
         
+        //! child placeables. they hold a pointer to this placeable, so they remove themselves before it is destroyed
+        std::vector<EC_OgrePlaceable*> children_;
+        
         //! Ogre scene node for geometry. scale is handled here
         Ogre::SceneNode* scene_node_;
 
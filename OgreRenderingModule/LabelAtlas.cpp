@@ -0,0 +1,510 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+
+#include "LabelAtlas.h"
+#include "Renderer.h"
+#include "OgreMaterialUtils.h"
+#include "OgreRenderingModule.h"
+
+#include <Ogre.h>
+#include <OgreBillboardSet.h>
+#include <OgreBillboard.h>
+#include <OgreHardwarePixelBuffer.h>
+
+#include <QPainter>
+
+#include <algorithm>
+
+#include "MemoryLeakCheck.h"
+
+namespace OgreRenderer
+{
+    //! Width and height of a texture page in pixels
+    static const uint cPageSize = 1024;
+
+    //! Maximum number of texture pages
+    static const uint cMaxPages = 8;
+
+    //! Largest label image size in pixels, larger images are scaled down
+    static const int cMaxLabelWidth = 512;
+    static const int cMaxLabelHeight = 256;
+
+    //! Shelf heights are rounded up to a multiple of this
+    static const uint cShelfRounding = 16;
+
+    //! Transparent border around each image so that filtering does not bleed neighbours in
+    static const uint cPadding = 1;
+
+    LabelAtlas::LabelAtlas(Renderer* renderer) :
+        renderer_(renderer),
+        next_id_(1),
+        update_count_(0)
+    {
+    }
+
+    LabelAtlas::~LabelAtlas()
+    {
+        Ogre::SceneManager* scene = renderer_->GetSceneManager();
+        for(uint i = 0; i < pages_.size(); ++i)
+        {
+            Page& page = pages_[i];
+            if (scene && page.billboards_)
+                scene->destroyBillboardSet(page.billboards_);
+            Ogre::MaterialManager::getSingleton().remove(page.material_name_);
+            Ogre::TextureManager::getSingleton().remove(page.texture_->getName());
+        }
+        pages_.clear();
+        labels_.clear();
+    }
+
+    LabelAtlas::LabelId LabelAtlas::CreateLabel(Ogre::SceneNode* node, const Ogre::Vector3& offset)
+    {
+        if (!node)
+            return 0;
+
+        LabelId id = next_id_++;
+        Label& label = labels_[id];
+        label.node_name_ = node->getName();
+        label.offset_ = offset;
+        label.world_position_ = Ogre::Vector3::ZERO;
+        label.width_ = 1.0f;
+        label.height_ = 1.0f;
+        label.alpha_ = 1.0f;
+        label.visible_ = true;
+        label.page_ = -1;
+        label.shelf_ = 0;
+        label.slot_x_ = 0;
+        label.slot_width_ = 0;
+        label.billboard_ = 0;
+        label.last_seen_ = update_count_;
+        return id;
+    }
+
+    void LabelAtlas::DestroyLabel(LabelId id)
+    {
+        LabelMap::iterator i = labels_.find(id);
+        if (i == labels_.end())
+            return;
+
+        Free(i->second);
+        labels_.erase(i);
+    }
+
+    bool LabelAtlas::SetImage(LabelId id, const QImage& image, Real width, Real height)
+    {
+        Label* label = GetLabel(id);
+        if (!label)
+            return false;
+
+        label->width_ = width;
+        label->height_ = height;
+
+        if (image.isNull())
+        {
+            label->image_ = QImage();
+            Free(*label);
+            return true;
+        }
+
+        QImage scaled = image;
+        if (scaled.width() > cMaxLabelWidth || scaled.height() > cMaxLabelHeight)
+            scaled = scaled.scaled(cMaxLabelWidth, cMaxLabelHeight, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        label->image_ = scaled.convertToFormat(QImage::Format_ARGB32);
+
+        const uint padded_width = label->image_.width() + 2 * cPadding;
+        const uint padded_height = label->image_.height() + 2 * cPadding;
+
+        // Redraw in place if the image still fits the slot, give back what is left over
+        if (label->page_ >= 0)
+        {
+            Shelf& shelf = pages_[label->page_].shelves_[label->shelf_];
+            if (padded_height <= shelf.height_ && padded_width <= label->slot_width_)
+            {
+                if (padded_width < label->slot_width_)
+                {
+                    FreeSpan(shelf, label->slot_x_ + padded_width, label->slot_width_ - padded_width);
+                    label->slot_width_ = padded_width;
+                }
+                Upload(*label);
+                UpdateBillboard(*label);
+                return true;
+            }
+            Free(*label);
+        }
+
+        // Hidden labels get their slot when shown
+        if (!label->visible_)
+            return true;
+
+        bool success = Allocate(*label);
+        UpdateBillboard(*label);
+        return success;
+    }
+
+    void LabelAtlas::SetDimensions(LabelId id, Real width, Real height)
+    {
+        Label* label = GetLabel(id);
+        if (!label)
+            return;
+
+        label->width_ = width;
+        label->height_ = height;
+        if (label->billboard_)
+            label->billboard_->setDimensions(width, height);
+    }
+
+    void LabelAtlas::SetOffset(LabelId id, const Ogre::Vector3& offset)
+    {
+        Label* label = GetLabel(id);
+        if (!label)
+            return;
+
+        label->offset_ = offset;
+        if (label->billboard_)
+            PlaceBillboard(*label);
+    }
+
+    Ogre::Vector3 LabelAtlas::GetWorldPosition(LabelId id) const
+    {
+        LabelMap::const_iterator i = labels_.find(id);
+        if (i == labels_.end())
+            return Ogre::Vector3::ZERO;
+
+        const Label& label = i->second;
+        Ogre::SceneManager* scene = renderer_->GetSceneManager();
+        if (scene && scene->hasSceneNode(label.node_name_))
+            return scene->getSceneNode(label.node_name_)->_getFullTransform() * label.offset_;
+
+        return label.world_position_;
+    }
+
+    void LabelAtlas::SetVisible(LabelId id, bool visible)
+    {
+        Label* label = GetLabel(id);
+        if (!label || label->visible_ == visible)
+            return;
+
+        label->visible_ = visible;
+        label->last_seen_ = update_count_;
+        if (visible && label->page_ < 0 && !label->image_.isNull())
+            Allocate(*label);
+        UpdateBillboard(*label);
+    }
+
+    bool LabelAtlas::IsVisible(LabelId id) const
+    {
+        LabelMap::const_iterator i = labels_.find(id);
+        if (i == labels_.end())
+            return false;
+
+        return i->second.visible_;
+    }
+
+    void LabelAtlas::SetAlpha(LabelId id, Real alpha)
+    {
+        Label* label = GetLabel(id);
+        if (!label)
+            return;
+
+        label->alpha_ = alpha;
+        if (label->billboard_)
+            label->billboard_->setColour(Ogre::ColourValue(1.0f, 1.0f, 1.0f, alpha));
+    }
+
+    void LabelAtlas::Update()
+    {
+        PROFILE(LabelAtlas_Update);
+
+        ++update_count_;
+
+        for(LabelMap::iterator i = labels_.begin(); i != labels_.end(); ++i)
+        {
+            Label& label = i->second;
+            if (!label.billboard_)
+                continue;
+
+            label.last_seen_ = update_count_;
+            PlaceBillboard(label);
+        }
+
+        for(uint i = 0; i < pages_.size(); ++i)
+            if (pages_[i].billboards_->getNumBillboards())
+                pages_[i].billboards_->_updateBounds();
+    }
+
+    LabelAtlas::Label* LabelAtlas::GetLabel(LabelId id)
+    {
+        LabelMap::iterator i = labels_.find(id);
+        if (i == labels_.end())
+            return 0;
+
+        return &i->second;
+    }
+
+    bool LabelAtlas::Allocate(Label& label)
+    {
+        const uint width = label.image_.width() + 2 * cPadding;
+        const uint height = label.image_.height() + 2 * cPadding;
+
+        if (!AllocateSlot(label, width, height))
+        {
+            // Evict hidden labels, the least recently seen first, until the image fits
+            std::vector<std::pair<uint, LabelId> > candidates;
+            for(LabelMap::iterator i = labels_.begin(); i != labels_.end(); ++i)
+                if (!i->second.visible_ && i->second.page_ >= 0)
+                    candidates.push_back(std::make_pair(i->second.last_seen_, i->first));
+            std::sort(candidates.begin(), candidates.end());
+
+            bool success = false;
+            for(uint i = 0; i < candidates.size() && !success; ++i)
+            {
+                Free(labels_[candidates[i].second]);
+                success = AllocateSlot(label, width, height);
+            }
+
+            if (!success)
+            {
+                OgreRenderingModule::LogWarning("LabelAtlas: no room for a label of " + ToString(width) + "x" +
+                    ToString(height) + " pixels");
+                return false;
+            }
+        }
+
+        Upload(label);
+        return true;
+    }
+
+    bool LabelAtlas::AllocateSlot(Label& label, uint width, uint height)
+    {
+        const uint shelf_height = (height + cShelfRounding - 1) / cShelfRounding * cShelfRounding;
+
+        // First try the existing shelves of about the right height
+        for(uint p = 0; p < pages_.size(); ++p)
+        {
+            std::vector<Shelf>& shelves = pages_[p].shelves_;
+            for(uint s = 0; s < shelves.size(); ++s)
+            {
+                Shelf& shelf = shelves[s];
+                if (shelf.height_ < shelf_height || shelf.height_ > shelf_height + shelf_height / 2)
+                    continue;
+
+                for(uint f = 0; f < shelf.free_.size(); ++f)
+                {
+                    Span& span = shelf.free_[f];
+                    if (span.width_ < width)
+                        continue;
+
+                    label.page_ = p;
+                    label.shelf_ = s;
+                    label.slot_x_ = span.x_;
+                    label.slot_width_ = width;
+                    span.x_ += width;
+                    span.width_ -= width;
+                    if (!span.width_)
+                        shelf.free_.erase(shelf.free_.begin() + f);
+                    return true;
+                }
+            }
+        }
+
+        // Then open a new shelf, on a new page if needed
+        int page_index = -1;
+        for(uint p = 0; p < pages_.size(); ++p)
+        {
+            if (cPageSize - pages_[p].used_height_ >= shelf_height)
+            {
+                page_index = p;
+                break;
+            }
+        }
+        if (page_index < 0)
+        {
+            if (!CreatePage())
+                return false;
+            page_index = pages_.size() - 1;
+        }
+
+        Page& page = pages_[page_index];
+        Shelf shelf;
+        shelf.y_ = page.used_height_;
+        shelf.height_ = shelf_height;
+        Span rest = { width, cPageSize - width };
+        shelf.free_.push_back(rest);
+        page.shelves_.push_back(shelf);
+        page.used_height_ += shelf_height;
+
+        label.page_ = page_index;
+        label.shelf_ = page.shelves_.size() - 1;
+        label.slot_x_ = 0;
+        label.slot_width_ = width;
+        return true;
+    }
+
+    void LabelAtlas::Free(Label& label)
+    {
+        if (label.page_ < 0)
+            return;
+
+        Page& page = pages_[label.page_];
+        if (label.billboard_)
+        {
+            page.billboards_->removeBillboard(label.billboard_);
+            label.billboard_ = 0;
+        }
+
+        FreeSpan(page.shelves_[label.shelf_], label.slot_x_, label.slot_width_);
+        label.page_ = -1;
+
+        // Drop the empty shelves at the end of the page so that the space can be used for other heights
+        while(!page.shelves_.empty())
+        {
+            const Shelf& last = page.shelves_.back();
+            if (last.free_.size() != 1 || last.free_[0].width_ != cPageSize)
+                break;
+            page.used_height_ -= last.height_;
+            page.shelves_.pop_back();
+        }
+    }
+
+    void LabelAtlas::FreeSpan(Shelf& shelf, uint x, uint width)
+    {
+        std::vector<Span>::iterator next = shelf.free_.begin();
+        while(next != shelf.free_.end() && next->x_ < x)
+            ++next;
+
+        Span span = { x, width };
+        next = shelf.free_.insert(next, span);
+
+        // Merge with the following span
+        std::vector<Span>::iterator following = next + 1;
+        if (following != shelf.free_.end() && next->x_ + next->width_ == following->x_)
+        {
+            next->width_ += following->width_;
+            shelf.free_.erase(following);
+        }
+
+        // Merge with the preceding span
+        if (next != shelf.free_.begin())
+        {
+            std::vector<Span>::iterator preceding = next - 1;
+            if (preceding->x_ + preceding->width_ == next->x_)
+            {
+                preceding->width_ += next->width_;
+                shelf.free_.erase(next);
+            }
+        }
+    }
+
+    void LabelAtlas::Upload(Label& label)
+    {
+        if (label.page_ < 0 || label.image_.isNull())
+            return;
+
+        Page& page = pages_[label.page_];
+        const Shelf& shelf = page.shelves_[label.shelf_];
+
+        // Copy the image into a cleared padded buffer, so that no edge of the previous slot owner is left over
+        QImage padded(label.image_.width() + 2 * cPadding, label.image_.height() + 2 * cPadding, QImage::Format_ARGB32);
+        padded.fill(0);
+        {
+            QPainter painter(&padded);
+            painter.setCompositionMode(QPainter::CompositionMode_Source);
+            painter.drawImage(cPadding, cPadding, label.image_);
+        }
+
+        Ogre::PixelBox source(padded.width(), padded.height(), 1, Ogre::PF_A8R8G8B8, (void*)padded.bits());
+        Ogre::Box target(label.slot_x_, shelf.y_, label.slot_x_ + padded.width(), shelf.y_ + padded.height());
+        page.texture_->getBuffer()->blitFromMemory(source, target);
+    }
+
+    void LabelAtlas::UpdateBillboard(Label& label)
+    {
+        bool show = label.visible_ && label.page_ >= 0 && !label.image_.isNull();
+        if (!show)
+        {
+            if (label.billboard_)
+            {
+                pages_[label.page_].billboards_->removeBillboard(label.billboard_);
+                label.billboard_ = 0;
+            }
+            return;
+        }
+
+        Page& page = pages_[label.page_];
+        if (!label.billboard_)
+        {
+            label.billboard_ = page.billboards_->createBillboard(label.world_position_);
+            if (!label.billboard_)
+                return;
+        }
+
+        const Shelf& shelf = page.shelves_[label.shelf_];
+        const Real scale = 1.0f / cPageSize;
+        label.billboard_->setTexcoordRect(
+            (label.slot_x_ + cPadding) * scale,
+            (shelf.y_ + cPadding) * scale,
+            (label.slot_x_ + cPadding + label.image_.width()) * scale,
+            (shelf.y_ + cPadding + label.image_.height()) * scale);
+        PlaceBillboard(label);
+    }
+
+    void LabelAtlas::PlaceBillboard(Label& label)
+    {
+        Ogre::SceneManager* scene = renderer_->GetSceneManager();
+        Ogre::SceneNode* node = 0;
+        if (scene && scene->hasSceneNode(label.node_name_))
+            node = scene->getSceneNode(label.node_name_);
+
+        // Not drawn while the node is gone or out of the scene graph
+        if (!node || !node->isInSceneGraph())
+        {
+            label.billboard_->setDimensions(0.0f, 0.0f);
+            return;
+        }
+
+        label.world_position_ = node->_getFullTransform() * label.offset_;
+        label.billboard_->setPosition(label.world_position_);
+        label.billboard_->setDimensions(label.width_, label.height_);
+        label.billboard_->setColour(Ogre::ColourValue(1.0f, 1.0f, 1.0f, label.alpha_));
+    }
+
+    bool LabelAtlas::CreatePage()
+    {
+        Ogre::SceneManager* scene = renderer_->GetSceneManager();
+        if (!scene || pages_.size() >= cMaxPages)
+            return false;
+
+        Page page;
+        page.used_height_ = 0;
+
+        std::string texture_name = "LabelAtlasTexture" + renderer_->GetUniqueObjectName();
+        page.texture_ = Ogre::TextureManager::getSingleton().createManual(texture_name,
+            Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME, Ogre::TEX_TYPE_2D, cPageSize, cPageSize, 0,
+            Ogre::PF_A8R8G8B8, Ogre::TU_DEFAULT);
+        if (page.texture_.isNull())
+            return false;
+
+        // Start from a transparent page
+        std::vector<u32> clear(cPageSize * cPageSize, 0);
+        page.texture_->getBuffer()->blitFromMemory(Ogre::PixelBox(cPageSize, cPageSize, 1, Ogre::PF_A8R8G8B8, &clear[0]));
+
+        page.material_name_ = "LabelAtlasMaterial" + renderer_->GetUniqueObjectName();
+        Ogre::MaterialPtr material = CloneMaterial("LabelAtlas", page.material_name_);
+        SetTextureUnitOnMaterial(material, texture_name);
+
+        page.billboards_ = scene->createBillboardSet(renderer_->GetUniqueObjectName(), 64);
+        page.billboards_->setMaterialName(page.material_name_);
+        page.billboards_->setCastShadows(false);
+        page.billboards_->setQueryFlags(0);
+        page.billboards_->setBillboardType(Ogre::BBT_ORIENTED_COMMON);
+        page.billboards_->setCommonUpVector(Ogre::Vector3::UNIT_Z);
+        page.billboards_->setBillboardsInWorldSpace(true);
+        page.billboards_->setSortingEnabled(true);
+        scene->getRootSceneNode()->attachObject(page.billboards_);
+
+        pages_.push_back(page);
+        return true;
+    }
+}
@@ -0,0 +1,193 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_OgreRenderer_LabelAtlas_h
+#define incl_OgreRenderer_LabelAtlas_h
+
+#include "OgreModuleApi.h"
+
+#include <OgreVector3.h>
+#include <OgreTexture.h>
+
+#include <QImage>
+
+namespace Ogre
+{
+    class SceneNode;
+    class BillboardSet;
+    class Billboard;
+}
+
+namespace OgreRenderer
+{
+    class Renderer;
+
+    //! Shared texture pages and billboard sets for the text labels hovering over entities.
+    /*! Hovering texts, chat bubbles and name tags used to have a texture, a material and a billboard set each,
+        which cost a batch per label and recreated the texture on every redraw. LabelAtlas packs the label images
+        into a few large texture pages instead, and draws all labels of a page with one world space billboard set,
+        so the labels of the whole scene take a batch per page.
+
+        Images are packed to shelves of similar height. A slot is reused in place when a label is redrawn with an
+        image that still fits. When a page is full, the hidden labels that were seen least recently give up their
+        slots; they keep their image and are uploaded again when shown. Labels are oriented around the world Z
+        axis, like the entity-attached billboards were.
+
+        Each label follows a scene node: Update(), called by Renderer before rendering, moves the billboards to
+        the node's current transform. If the node is destroyed the label is just not drawn. Owned by Renderer,
+        use Renderer::GetLabelAtlas().
+        \ingroup OgreRenderingModuleClient
+     */
+    class OGRE_MODULE_API LabelAtlas
+    {
+    public:
+        //! Label identifier, 0 is never a valid label.
+        typedef uint LabelId;
+
+        //! Constructor
+        //! \param renderer Renderer whose scene the labels are shown in.
+        explicit LabelAtlas(Renderer* renderer);
+
+        //! Destructor. Destroys the texture pages, materials and billboard sets.
+        ~LabelAtlas();
+
+        //! Creates a new label. It is visible, but shows nothing until an image is set.
+        /*! \param node Scene node to follow.
+            \param offset Position relative to the node, transformed with the node.
+            \return Id of the new label, 0 if node is null.
+         */
+        LabelId CreateLabel(Ogre::SceneNode* node, const Ogre::Vector3& offset);
+
+        //! Destroys a label and frees its slot.
+        void DestroyLabel(LabelId id);
+
+        //! Sets the image of a label.
+        /*! Images larger than the largest label size are scaled down, the world size is not affected.
+            \param image Image to show. Transparent areas are blended.
+            \param width Width of the label in world units.
+            \param height Height of the label in world units.
+            \return True if the image got a slot in the atlas. If not, the label is hidden until one frees up.
+         */
+        bool SetImage(LabelId id, const QImage& image, Real width, Real height);
+
+        //! Sets the world size of a label.
+        void SetDimensions(LabelId id, Real width, Real height);
+
+        //! Sets the position of a label relative to its scene node.
+        void SetOffset(LabelId id, const Ogre::Vector3& offset);
+
+        //! Returns the current world position of a label, or zero vector if the label does not exist.
+        Ogre::Vector3 GetWorldPosition(LabelId id) const;
+
+        //! Shows or hides a label.
+        void SetVisible(LabelId id, bool visible);
+
+        //! Returns whether a label is visible.
+        bool IsVisible(LabelId id) const;
+
+        //! Sets the opacity of a label, 0.0 - 1.0.
+        void SetAlpha(LabelId id, Real alpha);
+
+        //! Moves the visible labels to follow their scene nodes. Called by Renderer each frame.
+        void Update();
+
+        //! Returns number of texture pages in use.
+        uint GetNumPages() const { return pages_.size(); }
+
+        //! Returns number of labels.
+        uint GetNumLabels() const { return labels_.size(); }
+
+    private:
+        //! Free horizontal span on a shelf.
+        struct Span
+        {
+            uint x_;
+            uint width_;
+        };
+
+        //! A row of slots of similar height on a texture page.
+        struct Shelf
+        {
+            uint y_;
+            uint height_;
+            std::vector<Span> free_;
+        };
+
+        //! A texture page and the billboard set drawing its labels.
+        struct Page
+        {
+            Ogre::TexturePtr texture_;
+            std::string material_name_;
+            Ogre::BillboardSet* billboards_;
+            std::vector<Shelf> shelves_;
+            //! Height of the page taken by the shelves.
+            uint used_height_;
+        };
+
+        struct Label
+        {
+            //! Name of the scene node followed.
+            std::string node_name_;
+            Ogre::Vector3 offset_;
+            Ogre::Vector3 world_position_;
+            //! Image scaled to atlas size, kept for re-uploading after eviction.
+            QImage image_;
+            Real width_;
+            Real height_;
+            Real alpha_;
+            bool visible_;
+            //! Page index, -1 if the label has no slot.
+            int page_;
+            uint shelf_;
+            //! Allocated slot, including the padding.
+            uint slot_x_;
+            uint slot_width_;
+            //! Billboard, exists only while the label is visible and has a slot.
+            Ogre::Billboard* billboard_;
+            //! Update count when the label was last visible.
+            uint last_seen_;
+        };
+
+        typedef std::map<LabelId, Label> LabelMap;
+
+        //! Returns label by id, or null.
+        Label* GetLabel(LabelId id);
+
+        //! Finds a slot for the label image and uploads it. Evicts hidden labels if needed.
+        bool Allocate(Label& label);
+
+        //! Tries to find a slot for an image of given padded size without evicting anything.
+        bool AllocateSlot(Label& label, uint width, uint height);
+
+        //! Frees the slot of a label.
+        void Free(Label& label);
+
+        //! Returns a span to the free list of a shelf, merging it with its neighbours.
+        static void FreeSpan(Shelf& shelf, uint x, uint width);
+
+        //! Uploads the label image to its slot.
+        void Upload(Label& label);
+
+        //! Creates or destroys the billboard of a label according to its state.
+        void UpdateBillboard(Label& label);
+
+        //! Positions and colours the billboard of a label.
+        void PlaceBillboard(Label& label);
+
+        //! Creates a new texture page. Returns false if the page limit is reached.
+        bool CreatePage();
+
+        Renderer* renderer_;
+
+        std::vector<Page> pages_;
+
+        LabelMap labels_;
+
+        //! Next label id to hand out.
+        LabelId next_id_;
+
+        //! Number of updates done, used to find the least recently seen labels.
+        uint update_count_;
+    };
+}
+
+#endif
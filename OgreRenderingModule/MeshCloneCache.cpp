@@ -0,0 +1,102 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+
+#include "MeshCloneCache.h"
+#include "Renderer.h"
+#include "OgreRenderingModule.h"
+
+#include <Ogre.h>
+
+#include "MemoryLeakCheck.h"
+
+namespace OgreRenderer
+{
+    MeshCloneCache::MeshCloneCache(Renderer* renderer) :
+        renderer_(renderer),
+        num_references_(0)
+    {
+    }
+
+    MeshCloneCache::~MeshCloneCache()
+    {
+    }
+
+    Ogre::MeshPtr MeshCloneCache::AcquireClone(Ogre::MeshPtr mesh, const std::string& key, bool& created)
+    {
+        created = false;
+        if (mesh.isNull())
+            return Ogre::MeshPtr();
+
+        // Mesh names can not contain a newline, so the combined key is unique
+        const std::string cache_key = mesh->getName() + "\n" + key;
+        CloneMap::iterator i = clones_.find(cache_key);
+        if (i != clones_.end())
+        {
+            Ogre::MeshPtr clone = Ogre::MeshManager::getSingleton().getByName(i->second.name_);
+            if (!clone.isNull())
+            {
+                ++i->second.references_;
+                ++num_references_;
+                return clone;
+            }
+
+            // The clone has been removed behind our back, create it again
+            num_references_ -= i->second.references_;
+            keys_.erase(i->second.name_);
+            clones_.erase(i);
+        }
+
+        Ogre::MeshPtr clone;
+        try
+        {
+            clone = mesh->clone(renderer_->GetUniqueObjectName());
+            clone->setAutoBuildEdgeLists(false);
+        }
+        catch (Ogre::Exception& e)
+        {
+            OgreRenderingModule::LogError("Could not clone mesh " + mesh->getName() + ":" + std::string(e.what()));
+            return Ogre::MeshPtr();
+        }
+
+        Clone& entry = clones_[cache_key];
+        entry.name_ = clone->getName();
+        entry.references_ = 1;
+        keys_[entry.name_] = cache_key;
+        ++num_references_;
+        created = true;
+        return clone;
+    }
+
+    bool MeshCloneCache::ReleaseClone(const std::string& clone_name)
+    {
+        std::map<std::string, std::string>::iterator k = keys_.find(clone_name);
+        if (k == keys_.end())
+            return false;
+
+        CloneMap::iterator i = clones_.find(k->second);
+        if (i == clones_.end())
+        {
+            keys_.erase(k);
+            return false;
+        }
+
+        --num_references_;
+        if (--i->second.references_ > 0)
+            return true;
+
+        try
+        {
+            Ogre::MeshManager::getSingleton().remove(clone_name);
+        }
+        catch (Ogre::Exception& e)
+        {
+            OgreRenderingModule::LogWarning("Could not remove cloned mesh:" + std::string(e.what()));
+        }
+
+        clones_.erase(i);
+        keys_.erase(k);
+        return true;
+    }
+}
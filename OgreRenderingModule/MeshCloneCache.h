@@ -0,0 +1,79 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_OgreRenderer_MeshCloneCache_h
+#define incl_OgreRenderer_MeshCloneCache_h
+
+#include "OgreModuleApi.h"
+
+#include <OgreMesh.h>
+
+#include <map>
+
+namespace OgreRenderer
+{
+    class Renderer;
+
+    //! Mesh clones shared by the entities that modify a mesh in the same way.
+    /*! Some meshes are cloned so that their geometry can be modified per entity, like avatar base meshes that
+        hide the vertices covered by attachments. Entities with the same mesh and the same modification, like
+        avatars wearing the same outfit, can use the same clone. A clone is identified by the source mesh and a
+        key describing the modification. The first user to acquire a clone creates it and makes the modification,
+        later users share it. Clones are reference counted, and destroyed when the last user releases them.
+
+        Use through EC_OgreMesh::SetMesh() and EC_OgreMesh::SetMeshWithSkeleton() with a clone key.
+        Owned by Renderer, use Renderer::GetMeshCloneCache().
+        \ingroup OgreRenderingModuleClient
+     */
+    class OGRE_MODULE_API MeshCloneCache
+    {
+    public:
+        //! Constructor
+        //! \param renderer Renderer to get unique names for the clones from.
+        explicit MeshCloneCache(Renderer* renderer);
+
+        //! Destructor. The remaining clones are left to be destroyed with the mesh manager.
+        ~MeshCloneCache();
+
+        //! Returns the clone of a mesh for a key, and adds a reference to it.
+        /*! \param mesh Source mesh.
+            \param key Identifies the modification made to the clone. Users with the same mesh and key get the same clone.
+            \param created Set to true if the clone was created by this call, and should be modified by the caller.
+            \return The clone, or null if the mesh could not be cloned.
+         */
+        Ogre::MeshPtr AcquireClone(Ogre::MeshPtr mesh, const std::string& key, bool& created);
+
+        //! Releases a reference to a clone. The clone is destroyed when no references remain.
+        //! \return false if the mesh is not a clone from the cache.
+        bool ReleaseClone(const std::string& clone_name);
+
+        //! Returns number of clones that exist
+        uint GetNumClones() const { return clones_.size(); }
+
+        //! Returns number of references to the clones, that is, the number of meshes sharing a clone
+        uint GetNumReferences() const { return num_references_; }
+
+    private:
+        struct Clone
+        {
+            //! Name of the cloned mesh
+            std::string name_;
+            //! Number of users of the clone
+            uint references_;
+        };
+
+        //! Clones by source mesh name and key
+        typedef std::map<std::string, Clone> CloneMap;
+
+        Renderer* renderer_;
+
+        CloneMap clones_;
+
+        //! Cache keys by clone name, for release
+        std::map<std::string, std::string> keys_;
+
+        //! Total number of references
+        uint num_references_;
+    };
+}
+
+#endif
@@ -0,0 +1,752 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+
+#include "MeshInstancer.h"
+#include "StaticGeometryBatcher.h"
+#include "Renderer.h"
+#include "OgreRenderingModule.h"
+#include "ConfigurationManager.h"
+
+#include <Ogre.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "MemoryLeakCheck.h"
+
+namespace OgreRenderer
+{
+    //! Instances drawn by one batch. Must match the size of the transform array in the instanced vertex programs
+    static const uint cMaxObjectsPerBatch = 64;
+
+    //! Vertices a batch can address with 16-bit indices
+    static const uint cMaxBatchVertices = 65535;
+
+    //! Maximum number of groups built or dissolved per frame
+    static const uint cMaxRebuildsPerFrame = 2;
+
+    //! Size of the cells by which instances are ordered into batches
+    static const Real cSortCellSize = 32.0f;
+
+    //! Shadow caster vertex program for instanced materials
+    static const std::string cShadowCasterProgram = "rex/ShadowCasterInstancedVP";
+
+    //! Tolerances for deciding whether an instanced entity has moved
+    static const Real cPositionTolerance = 0.001f;
+    static const Real cOrientationTolerance = 0.001f;
+
+    //! Returns name of the instanced variant of a vertex program
+    static std::string GetInstancedProgram(const std::string& program_name)
+    {
+        if ((program_name.length() > 2) && (program_name.substr(program_name.length() - 2) == "VP"))
+            return program_name.substr(0, program_name.length() - 2) + "InstancedVP";
+        else
+            return program_name + "Instanced";
+    }
+
+    //! Returns whether all passes of the first technique of a material have an instanced vertex program
+    static bool IsInstancable(Ogre::MaterialPtr material)
+    {
+        if (material.isNull() || !material->getNumTechniques())
+            return false;
+
+        Ogre::HighLevelGpuProgramManager& pm = Ogre::HighLevelGpuProgramManager::getSingleton();
+        Ogre::Technique::PassIterator iter = material->getTechnique(0)->getPassIterator();
+        while(iter.hasMoreElements())
+        {
+            Ogre::Pass* pass = iter.getNext();
+            if (!pass->hasVertexProgram() || !pm.resourceExists(GetInstancedProgram(pass->getVertexProgramName())))
+                return false;
+        }
+
+        return true;
+    }
+
+    //! Returns whether vertex data has exactly one texture coordinate set. Ogre::InstancedGeometry adds the instance index
+    //! as the next set, and the instanced vertex programs read it from TEXCOORD1
+    static bool HasInstanceIndexSlot(const Ogre::VertexData* data)
+    {
+        if (!data)
+            return false;
+
+        uint num_sets = 0;
+        const Ogre::VertexDeclaration::VertexElementList& elements = data->vertexDeclaration->getElements();
+        for(Ogre::VertexDeclaration::VertexElementList::const_iterator i = elements.begin(); i != elements.end(); ++i)
+        {
+            if (i->getSemantic() == Ogre::VES_TEXTURE_COORDINATES)
+                ++num_sets;
+        }
+
+        return num_sets == 1;
+    }
+
+    //! Orders entities by the cell they are in
+    struct EntityCellLess
+    {
+        bool operator() (const std::pair<std::pair<int, int>, Ogre::Entity*>& lhs, const std::pair<std::pair<int, int>, Ogre::Entity*>& rhs) const
+        {
+            return lhs.first < rhs.first;
+        }
+    };
+
+    MeshInstancer::MeshInstancer(Renderer* renderer) :
+        renderer_(renderer),
+        num_instanced_(0),
+        num_instanced_groups_(0)
+    {
+        Foundation::Framework* framework = renderer_->GetFramework();
+        enabled_ = framework->GetDefaultConfig().DeclareSetting("OgreRenderer", "mesh_instancing", true);
+        min_instances_ = framework->GetDefaultConfig().DeclareSetting("OgreRenderer", "instancing_min_instances", 16);
+        if (min_instances_ < 2)
+            min_instances_ = 2;
+
+        Ogre::Root* root = Ogre::Root::getSingletonPtr();
+        Ogre::RenderSystem* rendersystem = root ? root->getRenderSystem() : 0;
+        const Ogre::RenderSystemCapabilities* caps = rendersystem ? rendersystem->getCapabilities() : 0;
+        if ((enabled_) && ((!caps) || ((!caps->isShaderProfileSupported("vs_3_0")) && (!caps->isShaderProfileSupported("vp40")))))
+        {
+            OgreRenderingModule::LogInfo("Mesh instancing disabled, vertex shader model 3 not supported");
+            enabled_ = false;
+        }
+    }
+
+    MeshInstancer::~MeshInstancer()
+    {
+        for(GroupMap::iterator i = groups_.begin(); i != groups_.end(); ++i)
+            DestroyGeometry(i->second);
+
+        StaticGeometryBatcher* batcher = renderer_->GetStaticGeometryBatcher();
+        if (batcher)
+        {
+            for(NodeEntityMap::iterator i = node_entities_.begin(); i != node_entities_.end(); ++i)
+                batcher->UnwatchNode(const_cast<Ogre::Node*>(i->first));
+        }
+    }
+
+    void MeshInstancer::AddEntity(Ogre::Entity* entity)
+    {
+        if (!entity || members_.find(entity) != members_.end())
+            return;
+
+        StaticGeometryBatcher* batcher = renderer_->GetStaticGeometryBatcher();
+        std::string key;
+        if (enabled_)
+            key = GetGroupKey(entity);
+        if (key.empty())
+        {
+            if (batcher)
+                batcher->AddEntity(entity);
+            return;
+        }
+
+        Group& group = groups_[key];
+        if (group.members_.empty())
+        {
+            group.mesh_name_ = entity->getMesh()->getName();
+            group.cast_shadows_ = entity->getCastShadows();
+            group.materials_.clear();
+            for(uint i = 0; i < entity->getNumSubEntities(); ++i)
+                group.materials_.push_back(entity->getSubEntity(i)->getMaterialName());
+        }
+
+        Member& member = members_[entity];
+        member.group_ = key;
+        member.node_ = entity->getParentSceneNode();
+        member.object_ = 0;
+        member.batch_ = 0;
+        member.visibility_flags_ = 0;
+        group.members_.insert(entity);
+
+        std::vector<Ogre::Entity*>& node_members = node_entities_[member.node_];
+        if (node_members.empty() && batcher)
+            batcher->WatchNode(member.node_, this);
+        node_members.push_back(entity);
+
+        if (group.geometry_)
+        {
+            // Reuse a free instance, or make room for the entity
+            if (group.free_.empty())
+                dirty_groups_.insert(key);
+            else if (IsDrawable(entity))
+            {
+                FreeInstance instance = group.free_.back();
+                group.free_.pop_back();
+                AssignInstance(entity, member, instance.object_, instance.batch_);
+            }
+        }
+        else
+        {
+            // Members of groups that are not drawn instanced may still be batched as static geometry
+            if (batcher)
+                batcher->AddEntity(entity);
+            if (group.members_.size() >= min_instances_)
+                dirty_groups_.insert(key);
+        }
+    }
+
+    void MeshInstancer::RemoveEntity(Ogre::Entity* entity)
+    {
+        StaticGeometryBatcher* batcher = renderer_->GetStaticGeometryBatcher();
+        MemberMap::iterator i = members_.find(entity);
+        if (i == members_.end())
+        {
+            if (batcher)
+                batcher->RemoveEntity(entity);
+            return;
+        }
+
+        Member& member = i->second;
+        std::string key = member.group_;
+        GroupMap::iterator g = groups_.find(key);
+        if (g != groups_.end())
+        {
+            Group& group = g->second;
+            if (member.object_)
+                ReleaseInstance(entity, member, group);
+            group.members_.erase(entity);
+
+            if (group.geometry_)
+            {
+                // The freed instance is left for new members, unless the group became too small
+                if (group.members_.size() < min_instances_ / 2)
+                    dirty_groups_.insert(key);
+            }
+            else
+            {
+                if (batcher)
+                    batcher->RemoveEntity(entity);
+                if (group.members_.empty())
+                {
+                    dirty_groups_.erase(key);
+                    groups_.erase(g);
+                }
+            }
+        }
+
+        NodeEntityMap::iterator n = node_entities_.find(member.node_);
+        if (n != node_entities_.end())
+        {
+            std::vector<Ogre::Entity*>& entities = n->second;
+            entities.erase(std::remove(entities.begin(), entities.end(), entity), entities.end());
+            if (entities.empty())
+            {
+                if (batcher)
+                    batcher->UnwatchNode(member.node_);
+                node_entities_.erase(n);
+                moved_nodes_.erase(member.node_);
+            }
+        }
+
+        members_.erase(i);
+    }
+
+    void MeshInstancer::RefreshEntity(Ogre::Entity* entity)
+    {
+        MemberMap::iterator i = members_.find(entity);
+        std::string key;
+        if (enabled_)
+            key = GetGroupKey(entity);
+
+        if (i == members_.end() && key.empty())
+        {
+            StaticGeometryBatcher* batcher = renderer_->GetStaticGeometryBatcher();
+            if (batcher)
+                batcher->RefreshEntity(entity);
+            return;
+        }
+
+        if (i != members_.end() && i->second.group_ == key)
+        {
+            // Same mesh and material names, but the materials themselves or the draw distance may have changed
+            GroupMap::iterator g = groups_.find(key);
+            if (g != groups_.end())
+            {
+                if (g->second.geometry_)
+                    g->second.materials_dirty_ = true;
+                else
+                {
+                    StaticGeometryBatcher* batcher = renderer_->GetStaticGeometryBatcher();
+                    if (batcher)
+                        batcher->RefreshEntity(entity);
+                }
+            }
+            return;
+        }
+
+        RemoveEntity(entity);
+        AddEntity(entity);
+    }
+
+    void MeshInstancer::Update(f64 frametime)
+    {
+        if (members_.empty() && groups_.empty())
+            return;
+
+        PROFILE(MeshInstancer_Update);
+
+        // Nodes moved since the last frame are otherwise updated, and reported to nodeUpdated, only when the frame
+        // is rendered, so bring the scene graph up to date to keep the instances from lagging a frame behind
+        Ogre::SceneManager* scene = renderer_->GetSceneManager();
+        if (scene && !node_entities_.empty())
+            scene->getRootSceneNode()->_update(true, false);
+
+        for(GroupMap::iterator i = groups_.begin(); i != groups_.end(); ++i)
+        {
+            Group& group = i->second;
+            if (!group.geometry_)
+                continue;
+
+            if (group.materials_dirty_)
+            {
+                group.materials_dirty_ = false;
+                for(uint j = 0; j < group.materials_.size(); ++j)
+                {
+                    if (GetInstancedMaterial(group.materials_[j]).empty())
+                        dirty_groups_.insert(i->first);
+                }
+                UpdateRenderingDistance(group);
+            }
+
+            // Follow entities being hidden and shown
+            for(std::set<Ogre::Entity*>::iterator j = group.members_.begin(); j != group.members_.end(); ++j)
+            {
+                Ogre::Entity* entity = *j;
+                Member& member = members_[entity];
+                if (member.object_)
+                {
+                    if (!IsDrawable(entity))
+                        ReleaseInstance(entity, member, group);
+                }
+                else if (IsDrawable(entity))
+                {
+                    if (group.free_.empty())
+                        dirty_groups_.insert(i->first);
+                    else
+                    {
+                        FreeInstance instance = group.free_.back();
+                        group.free_.pop_back();
+                        AssignInstance(entity, member, instance.object_, instance.batch_);
+                    }
+                }
+            }
+        }
+
+        UpdateMovedInstances();
+
+        // Batches are culled by their bounds, so keep them around the moved instances
+        for(std::set<BatchInstance*>::iterator i = moved_batches_.begin(); i != moved_batches_.end(); ++i)
+            (*i)->updateBoundingBox();
+        moved_batches_.clear();
+
+        for(uint i = 0; (i < cMaxRebuildsPerFrame) && (!dirty_groups_.empty()); ++i)
+        {
+            std::string key = *dirty_groups_.begin();
+            dirty_groups_.erase(dirty_groups_.begin());
+            RebuildGroup(key);
+        }
+    }
+
+    void MeshInstancer::nodeUpdated(const Ogre::Node* node)
+    {
+        moved_nodes_.insert(node);
+    }
+
+    void MeshInstancer::nodeDetached(const Ogre::Node* node)
+    {
+        moved_nodes_.insert(node);
+    }
+
+    void MeshInstancer::nodeDestroyed(const Ogre::Node* node)
+    {
+        moved_nodes_.erase(node);
+
+        NodeEntityMap::iterator n = node_entities_.find(node);
+        if (n == node_entities_.end())
+            return;
+
+        // The entities were detached from the node, stop tracking them. RemoveEntity erases the node entry
+        std::vector<Ogre::Entity*> entities = n->second;
+        for(uint i = 0; i < entities.size(); ++i)
+            RemoveEntity(entities[i]);
+    }
+
+    std::string MeshInstancer::GetGroupKey(Ogre::Entity* entity)
+    {
+        // Animated meshes are not instanced, neither are entities attached to bones
+        if (!entity || entity->hasSkeleton() || entity->getMesh()->hasVertexAnimation() || !entity->getParentSceneNode())
+            return std::string();
+
+        Ogre::MeshPtr mesh = entity->getMesh();
+        for(uint i = 0; i < mesh->getNumSubMeshes(); ++i)
+        {
+            Ogre::SubMesh* submesh = mesh->getSubMesh(i);
+            if (!HasInstanceIndexSlot(submesh->useSharedVertices ? mesh->sharedVertexData : submesh->vertexData))
+                return std::string();
+        }
+
+        Ogre::MaterialManager& mm = Ogre::MaterialManager::getSingleton();
+        std::string key = mesh->getName();
+        key += entity->getCastShadows() ? "\n1" : "\n0";
+        for(uint i = 0; i < entity->getNumSubEntities(); ++i)
+        {
+            const std::string& material_name = entity->getSubEntity(i)->getMaterialName();
+            if (!IsInstancable(mm.getByName(material_name)))
+                return std::string();
+            key += "\n" + material_name;
+        }
+
+        return key;
+    }
+
+    std::string MeshInstancer::GetInstancedMaterial(const std::string& material_name)
+    {
+        Ogre::MaterialManager& mm = Ogre::MaterialManager::getSingleton();
+        Ogre::MaterialPtr material = mm.getByName(material_name);
+        if (!IsInstancable(material))
+            return std::string();
+
+        std::string instanced_name = material_name + "/Instanced";
+        Ogre::MaterialPtr instanced = mm.getByName(instanced_name);
+        if (instanced.isNull())
+        {
+            instanced = mm.create(instanced_name, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+            assert(instanced.get());
+        }
+
+        material->copyDetailsTo(instanced);
+
+        // Fallback techniques would draw all instances of a batch at the origin
+        while(instanced->getNumTechniques() > 1)
+            instanced->removeTechnique(1);
+
+        bool caster_exists = Ogre::HighLevelGpuProgramManager::getSingleton().resourceExists(cShadowCasterProgram);
+        Ogre::Technique::PassIterator iter = instanced->getTechnique(0)->getPassIterator();
+        while(iter.hasMoreElements())
+        {
+            Ogre::Pass* pass = iter.getNext();
+            pass->setVertexProgram(GetInstancedProgram(pass->getVertexProgramName()));
+            if (caster_exists)
+                pass->setShadowCasterVertexProgram(cShadowCasterProgram);
+        }
+
+        instanced->load();
+        if (!instanced->getNumSupportedTechniques())
+            return std::string();
+
+        return instanced_name;
+    }
+
+    bool MeshInstancer::IsDrawable(Ogre::Entity* entity)
+    {
+        return entity->getParentSceneNode() && entity->isInScene() && entity->getVisible();
+    }
+
+    void MeshInstancer::AssignInstance(Ogre::Entity* entity, Member& member, InstancedObject* object, BatchInstance* batch)
+    {
+        member.object_ = object;
+        member.batch_ = batch;
+        UpdateInstance(entity, member);
+
+        // Only rendering is affected, the query flags stay so raycasts still hit the entity
+        member.visibility_flags_ = entity->getVisibilityFlags();
+        entity->setVisibilityFlags(0);
+        ++num_instanced_;
+    }
+
+    void MeshInstancer::ReleaseInstance(Ogre::Entity* entity, Member& member, Group& group)
+    {
+        if (!member.object_)
+            return;
+
+        // Keep the position, so that the bounds of the batch do not grow
+        member.object_->setScale(Ogre::Vector3::ZERO);
+        FreeInstance instance;
+        instance.object_ = member.object_;
+        instance.batch_ = member.batch_;
+        group.free_.push_back(instance);
+
+        entity->setVisibilityFlags(member.visibility_flags_);
+        member.object_ = 0;
+        member.batch_ = 0;
+        --num_instanced_;
+    }
+
+    void MeshInstancer::UpdateInstance(Ogre::Entity* entity, Member& member)
+    {
+        Ogre::Node* node = entity->getParentSceneNode();
+        member.position_ = node->_getDerivedPosition();
+        member.orientation_ = node->_getDerivedOrientation();
+        member.scale_ = node->_getDerivedScale();
+
+        member.object_->setPosition(member.position_);
+        member.object_->setOrientation(member.orientation_);
+        member.object_->setScale(member.scale_);
+        moved_batches_.insert(member.batch_);
+    }
+
+    void MeshInstancer::UpdateMovedInstances()
+    {
+        // Reading the derived transforms may update nodes and call nodeUpdated, so take the current set first
+        std::set<const Ogre::Node*> moved_nodes;
+        moved_nodes.swap(moved_nodes_);
+        for(std::set<const Ogre::Node*>::iterator i = moved_nodes.begin(); i != moved_nodes.end(); ++i)
+        {
+            NodeEntityMap::iterator n = node_entities_.find(*i);
+            if (n == node_entities_.end())
+                continue;
+
+            const std::vector<Ogre::Entity*>& entities = n->second;
+            for(uint j = 0; j < entities.size(); ++j)
+            {
+                Ogre::Entity* entity = entities[j];
+                Member& member = members_[entity];
+                if (!member.object_ || !IsDrawable(entity))
+                    continue;
+
+                // Updates that do not change anything, such as repeated object updates, leave the batch bounds be
+                Ogre::Node* node = member.node_;
+                if (!member.position_.positionEquals(node->_getDerivedPosition(), cPositionTolerance) ||
+                    !member.orientation_.equals(node->_getDerivedOrientation(), Ogre::Radian(cOrientationTolerance)) ||
+                    !member.scale_.positionEquals(node->_getDerivedScale(), cPositionTolerance))
+                    UpdateInstance(entity, member);
+            }
+        }
+    }
+
+    void MeshInstancer::RebuildGroup(const std::string& key)
+    {
+        GroupMap::iterator i = groups_.find(key);
+        if (i == groups_.end())
+            return;
+
+        Group& group = i->second;
+        StaticGeometryBatcher* batcher = renderer_->GetStaticGeometryBatcher();
+
+        std::vector<Ogre::Entity*> entities;
+        for(std::set<Ogre::Entity*>::iterator j = group.members_.begin(); j != group.members_.end(); ++j)
+        {
+            if (IsDrawable(*j))
+                entities.push_back(*j);
+        }
+
+        // Instanced groups are kept until half the members are gone, so that they do not toggle back and forth
+        bool had_geometry = group.geometry_ != 0;
+        uint needed = had_geometry ? std::max(min_instances_ / 2, 2u) : min_instances_;
+        if (entities.size() < needed)
+        {
+            DissolveGroup(group);
+            if (group.members_.empty())
+                groups_.erase(i);
+            return;
+        }
+
+        // Take the members from the batcher before hiding them, as it shows the entities it lets go of
+        if (had_geometry)
+            DestroyGeometry(group);
+        else if (batcher)
+        {
+            for(std::set<Ogre::Entity*>::iterator j = group.members_.begin(); j != group.members_.end(); ++j)
+                batcher->RemoveEntity(*j);
+        }
+
+        if (!BuildGroup(group, entities) && batcher)
+        {
+            for(std::set<Ogre::Entity*>::iterator j = group.members_.begin(); j != group.members_.end(); ++j)
+                batcher->AddEntity(*j);
+        }
+    }
+
+    bool MeshInstancer::BuildGroup(Group& group, std::vector<Ogre::Entity*>& entities)
+    {
+        Ogre::SceneManager* scene = renderer_->GetSceneManager();
+        Ogre::MeshPtr mesh = Ogre::MeshManager::getSingleton().getByName(group.mesh_name_);
+        if (!scene || mesh.isNull())
+            return false;
+
+        StringVector materials;
+        for(uint i = 0; i < group.materials_.size(); ++i)
+        {
+            std::string material = GetInstancedMaterial(group.materials_[i]);
+            if (material.empty())
+                return false;
+            materials.push_back(material);
+        }
+        group.materials_dirty_ = false;
+
+        // Each batch holds a copy of the mesh per instance
+        uint max_vertices = 1;
+        for(uint i = 0; i < mesh->getNumSubMeshes(); ++i)
+        {
+            Ogre::SubMesh* submesh = mesh->getSubMesh(i);
+            Ogre::VertexData* data = submesh->useSharedVertices ? mesh->sharedVertexData : submesh->vertexData;
+            if (data)
+                max_vertices = std::max(max_vertices, (uint)data->vertexCount);
+        }
+        group.objects_per_batch_ = std::min(cMaxObjectsPerBatch, cMaxBatchVertices / max_vertices);
+        if (group.objects_per_batch_ < 2)
+            return false;
+
+        // Order the instances by cell, so that each batch covers a compact area
+        std::vector<std::pair<std::pair<int, int>, Ogre::Entity*> > sorted;
+        for(uint i = 0; i < entities.size(); ++i)
+        {
+            const Ogre::Vector3& position = entities[i]->getParentSceneNode()->_getDerivedPosition();
+            std::pair<int, int> cell((int)floor(position.x / cSortCellSize), (int)floor(position.y / cSortCellSize));
+            sorted.push_back(std::make_pair(cell, entities[i]));
+        }
+        std::stable_sort(sorted.begin(), sorted.end(), EntityCellLess());
+        uint num_batches = (sorted.size() + group.objects_per_batch_ - 1) / group.objects_per_batch_;
+
+        Ogre::Entity* source = 0;
+        try
+        {
+            // The batches are built from an entity that uses the instanced materials
+            source = scene->createEntity(renderer_->GetUniqueObjectName(), group.mesh_name_);
+            for(uint i = 0; (i < source->getNumSubEntities()) && (i < materials.size()); ++i)
+                source->getSubEntity(i)->setMaterialName(materials[i]);
+
+            group.geometry_ = scene->createInstancedGeometry(renderer_->GetUniqueObjectName());
+            group.geometry_->setCastShadows(group.cast_shadows_);
+            for(uint i = 0; i < group.objects_per_batch_; ++i)
+                group.geometry_->addEntity(source, Ogre::Vector3::ZERO);
+            group.geometry_->build();
+            for(uint i = 1; i < num_batches; ++i)
+                group.geometry_->addBatchInstance();
+
+            scene->destroyEntity(source);
+            source = 0;
+            UpdateRenderingDistance(group);
+        }
+        catch (Ogre::Exception& e)
+        {
+            OgreRenderingModule::LogError("Could not build instanced geometry: " + std::string(e.what()));
+            if (source)
+                scene->destroyEntity(source);
+            if (group.geometry_)
+            {
+                scene->destroyInstancedGeometry(group.geometry_);
+                group.geometry_ = 0;
+            }
+            return false;
+        }
+
+        ++num_instanced_groups_;
+        group.free_.clear();
+
+        uint next = 0;
+        Ogre::Vector3 spare_position = sorted.front().second->getParentSceneNode()->_getDerivedPosition();
+        Ogre::InstancedGeometry::BatchInstanceIterator batches = group.geometry_->getBatchInstanceIterator();
+        while(batches.hasMoreElements())
+        {
+            BatchInstance* batch = batches.getNext();
+
+            BatchInstance::InstancedObjectIterator objects = batch->getObjectIterator();
+            while(objects.hasMoreElements())
+            {
+                InstancedObject* object = objects.getNext();
+                if (next < sorted.size())
+                {
+                    Ogre::Entity* entity = sorted[next].second;
+                    AssignInstance(entity, members_[entity], object, batch);
+                    spare_position = object->getPosition();
+                    ++next;
+                }
+                else
+                {
+                    // Spare instances are hidden near the others, so that they do not grow the bounds of the batch
+                    object->setPosition(spare_position);
+                    object->setScale(Ogre::Vector3::ZERO);
+                    FreeInstance instance;
+                    instance.object_ = object;
+                    instance.batch_ = batch;
+                    group.free_.push_back(instance);
+                }
+            }
+
+            batch->updateBoundingBox();
+            moved_batches_.erase(batch);
+        }
+
+        return true;
+    }
+
+    void MeshInstancer::UpdateRenderingDistance(Group& group)
+    {
+        if (!group.geometry_)
+            return;
+
+        // The group is drawn as far as its farthest drawn member
+        Real draw_distance = 0.0f;
+        bool limited = true;
+        for(std::set<Ogre::Entity*>::iterator i = group.members_.begin(); i != group.members_.end(); ++i)
+        {
+            Real distance = (*i)->getRenderingDistance();
+            if (distance <= 0.0f)
+                limited = false;
+            else if (distance > draw_distance)
+                draw_distance = distance;
+        }
+        group.geometry_->setRenderingDistance(limited ? draw_distance : 0.0f);
+    }
+
+    void MeshInstancer::DissolveGroup(Group& group)
+    {
+        if (!group.geometry_)
+            return;
+
+        DestroyGeometry(group);
+
+        StaticGeometryBatcher* batcher = renderer_->GetStaticGeometryBatcher();
+        if (batcher)
+        {
+            for(std::set<Ogre::Entity*>::iterator i = group.members_.begin(); i != group.members_.end(); ++i)
+                batcher->AddEntity(*i);
+        }
+    }
+
+    void MeshInstancer::DestroyGeometry(Group& group)
+    {
+        if (!group.geometry_)
+            return;
+
+        for(std::set<Ogre::Entity*>::iterator i = group.members_.begin(); i != group.members_.end(); ++i)
+        {
+            Member& member = members_[*i];
+            if (member.object_)
+            {
+                (*i)->setVisibilityFlags(member.visibility_flags_);
+                member.object_ = 0;
+                member.batch_ = 0;
+                --num_instanced_;
+            }
+        }
+
+        Ogre::InstancedGeometry::BatchInstanceIterator batches = group.geometry_->getBatchInstanceIterator();
+        while(batches.hasMoreElements())
+            moved_batches_.erase(batches.getNext());
+
+        Ogre::SceneManager* scene = renderer_->GetSceneManager();
+        if (scene)
+            scene->destroyInstancedGeometry(group.geometry_);
+        group.geometry_ = 0;
+        group.free_.clear();
+        --num_instanced_groups_;
+
+        // Remove the instanced copies of the materials, unless another instanced group still uses them
+        Ogre::MaterialManager& mm = Ogre::MaterialManager::getSingleton();
+        for(uint i = 0; i < group.materials_.size(); ++i)
+        {
+            const std::string& material_name = group.materials_[i];
+            bool in_use = false;
+            for(GroupMap::const_iterator j = groups_.begin(); (j != groups_.end()) && (!in_use); ++j)
+            {
+                if (j->second.geometry_ && std::find(j->second.materials_.begin(), j->second.materials_.end(), material_name) != j->second.materials_.end())
+                    in_use = true;
+            }
+            if (!in_use)
+                mm.remove(material_name + "/Instanced");
+        }
+    }
+}
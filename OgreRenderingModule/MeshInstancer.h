@@ -0,0 +1,208 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_OgreRenderer_MeshInstancer_h
+#define incl_OgreRenderer_MeshInstancer_h
+
+#include "OgreModuleApi.h"
+
+#include <OgreInstancedGeometry.h>
+#include <OgreNode.h>
+#include <OgreVector3.h>
+#include <OgreQuaternion.h>
+
+#include <set>
+
+namespace Ogre
+{
+    class Entity;
+}
+
+namespace OgreRenderer
+{
+    class Renderer;
+
+    //! Draws entities that share a mesh and materials with shader based hardware instancing.
+    /*! Scenes reuse the same meshes a lot, such as trees and furniture, and each entity costs a batch per submesh.
+        EC_OgreMesh registers its entities here when attached. Entities with the same mesh, materials and shadow
+        casting are grouped, and once a group has instancing_min_instances members it is drawn from an
+        Ogre::InstancedGeometry. Each of its batches draws up to 64 instances in one call, taking the instance
+        transforms from a shader constant array.
+
+        Instances are assigned to batches in spatial order, so that each batch covers a compact area and is frustum
+        culled as a unit. Instanced entities may move: the scene nodes of the members are watched through the node
+        listener of StaticGeometryBatcher, and only the transforms of the nodes updated since the last frame are
+        copied to their instances. Entities leaving a group free their instance, which new
+        members reuse without rebuilding the batches.
+
+        Cloned meshes, animated meshes and meshes with materials that have no instanced vertex program (name of
+        the vertex program with Instanced before the VP suffix) are passed on to StaticGeometryBatcher, as are
+        members of groups that are not drawn instanced. Like there, instanced entities stay in the scene for
+        raycasts, and are only hidden from rendering by clearing their visibility flags.
+
+        InstancedGeometry adds the instance index to the vertices as the texture coordinate set after the ones of
+        the mesh, and the instanced vertex programs read it from TEXCOORD1, so only meshes with exactly one texture
+        coordinate set are instanced. The instanced copies of the materials are removed when no group drawn
+        instanced uses them anymore.
+
+        Owned by Renderer, use Renderer::GetMeshInstancer().
+        \ingroup OgreRenderingModuleClient
+     */
+    class OGRE_MODULE_API MeshInstancer : public Ogre::Node::Listener
+    {
+    public:
+        //! Constructor
+        //! \param renderer Renderer whose scene the entities are in.
+        explicit MeshInstancer(Renderer* renderer);
+
+        //! Destructor. Shows the instanced entities and destroys the instanced geometry.
+        virtual ~MeshInstancer();
+
+        //! Starts tracking an entity attached to a scene node, or passes it on to the static geometry batcher.
+        void AddEntity(Ogre::Entity* entity);
+
+        //! Stops tracking an entity. Must be called before the entity is detached or destroyed.
+        void RemoveEntity(Ogre::Entity* entity);
+
+        //! Regroups an entity after its appearance has changed.
+        void RefreshEntity(Ogre::Entity* entity);
+
+        //! Updates instance transforms, and builds or dissolves instanced groups. Called by Renderer each frame.
+        void Update(f64 frametime);
+
+        //! Returns number of entities drawn instanced.
+        uint GetNumInstancedEntities() const { return num_instanced_; }
+
+        //! Returns number of groups drawn instanced.
+        uint GetNumInstancedGroups() const { return num_instanced_groups_; }
+
+        //! Ogre::Node::Listener override, passed on by StaticGeometryBatcher. Marks the members of the node as moved.
+        virtual void nodeUpdated(const Ogre::Node* node);
+
+        //! Ogre::Node::Listener override, passed on by StaticGeometryBatcher. Stops tracking the members of the node.
+        virtual void nodeDestroyed(const Ogre::Node* node);
+
+        //! Ogre::Node::Listener override, passed on by StaticGeometryBatcher. Marks the members of the node as moved.
+        virtual void nodeDetached(const Ogre::Node* node);
+
+    private:
+        typedef Ogre::InstancedGeometry::InstancedObject InstancedObject;
+        typedef Ogre::InstancedGeometry::BatchInstance BatchInstance;
+
+        struct Member
+        {
+            //! Key of the group the entity is in
+            std::string group_;
+            //! Scene node the entity is attached to
+            Ogre::Node* node_;
+            //! Instance drawing the entity, null if the entity is drawn as it is
+            InstancedObject* object_;
+            //! Batch the instance belongs to
+            BatchInstance* batch_;
+            //! Visibility flags to restore when the entity is no longer instanced
+            Ogre::uint32 visibility_flags_;
+            //! Derived transform last copied to the instance
+            Ogre::Vector3 position_;
+            Ogre::Quaternion orientation_;
+            Ogre::Vector3 scale_;
+        };
+
+        //! An unused instance, hidden by scaling it to zero
+        struct FreeInstance
+        {
+            InstancedObject* object_;
+            BatchInstance* batch_;
+        };
+
+        struct Group
+        {
+            Group() : geometry_(0), objects_per_batch_(0), cast_shadows_(false), materials_dirty_(false) {}
+
+            //! Instanced geometry, null if the members are drawn as they are
+            Ogre::InstancedGeometry* geometry_;
+            //! Number of instances in one batch
+            uint objects_per_batch_;
+            bool cast_shadows_;
+            //! Whether the instanced copies of the materials and the rendering distance need to be set up again
+            bool materials_dirty_;
+            std::string mesh_name_;
+            //! Materials of the submeshes
+            StringVector materials_;
+            std::set<Ogre::Entity*> members_;
+            std::vector<FreeInstance> free_;
+        };
+
+        typedef std::map<Ogre::Entity*, Member> MemberMap;
+        typedef std::map<std::string, Group> GroupMap;
+        typedef std::map<const Ogre::Node*, std::vector<Ogre::Entity*> > NodeEntityMap;
+
+        //! Returns key of the group of an entity, or empty if the entity can not be instanced.
+        std::string GetGroupKey(Ogre::Entity* entity);
+
+        //! Returns name of the instanced copy of a material, or empty if the material can not be instanced.
+        /*! The copy is set up again from the material on each call, so that it follows changes to the material.
+         */
+        static std::string GetInstancedMaterial(const std::string& material_name);
+
+        //! Returns whether an entity is currently drawn.
+        static bool IsDrawable(Ogre::Entity* entity);
+
+        //! Draws an entity with an instance of its group.
+        void AssignInstance(Ogre::Entity* entity, Member& member, InstancedObject* object, BatchInstance* batch);
+
+        //! Frees the instance of an entity and shows the entity.
+        void ReleaseInstance(Ogre::Entity* entity, Member& member, Group& group);
+
+        //! Copies the derived transform of an entity to its instance.
+        void UpdateInstance(Ogre::Entity* entity, Member& member);
+
+        //! Copies the transforms of the moved nodes to the instances of their members.
+        void UpdateMovedInstances();
+
+        //! Builds the instanced geometry of a group for its current members, or dissolves a group that became too small.
+        void RebuildGroup(const std::string& key);
+
+        //! Creates the instanced geometry of a group and assigns instances to entities. Returns false on failure.
+        bool BuildGroup(Group& group, std::vector<Ogre::Entity*>& entities);
+
+        //! Sets the rendering distance of a group from the draw distances of its members.
+        void UpdateRenderingDistance(Group& group);
+
+        //! Destroys the instanced geometry of a group and passes its members to the static geometry batcher.
+        void DissolveGroup(Group& group);
+
+        //! Destroys the instanced geometry of a group, shows its members and removes the unused instanced materials.
+        void DestroyGeometry(Group& group);
+
+        Renderer* renderer_;
+
+        //! Whether instancing is enabled and supported
+        bool enabled_;
+
+        //! Members needed for a group to be drawn instanced
+        uint min_instances_;
+
+        MemberMap members_;
+
+        GroupMap groups_;
+
+        //! Groups waiting to be built or dissolved
+        std::set<std::string> dirty_groups_;
+
+        //! Batches whose bounds need to be updated after instances moved
+        std::set<BatchInstance*> moved_batches_;
+
+        //! Members by the scene node they are attached to
+        NodeEntityMap node_entities_;
+
+        //! Nodes updated since the last Update
+        std::set<const Ogre::Node*> moved_nodes_;
+
+        //! Number of entities drawn instanced
+        uint num_instanced_;
+
+        //! Number of groups drawn instanced
+        uint num_instanced_groups_;
+    };
+}
+
+#endif
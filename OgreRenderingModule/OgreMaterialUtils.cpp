@@ -49,6 +49,15 @@ namespace OgreRenderer
         "fbvcolalpha" // vertex color alpha fullbright
     };
 
+    //! Vertex program for skinned copies of passes that have no vertex program
+    static const std::string cSkinnedProgram = "rex/SkinnedVP";
+    
+    //! Shadow caster vertex program for skinned materials
+    static const std::string cSkinnedShadowCasterProgram = "rex/ShadowCasterSkinnedVP";
+    
+    //! Skinned material copies by name, with whether the copy was unused on the previous RemoveUnusedSkinnedMaterials()
+    std::map<std::string, bool> SkinnedMaterials;
+    
     bool IsMaterialSuffixValid(const std::string& suffix)
     {
         for (uint i = 0; i < MAX_MATERIAL_VARIATIONS; ++i)
@@ -116,51 +125,176 @@ namespace OgreRenderer
         return material;
     }
 
-    void CreateLegacyMaterials(const std::string& texture_name, bool update)
+    //! Book-keeping of a created legacy material
+    struct LegacyMaterial
+    {
+        std::string texture_name_;
+        uint variation_;
+        //! Whether the material has the texture set, or the missing texture texture
+        bool has_texture_;
+        //! Whether the material was set up from the alpha base material
+        bool has_alpha_;
+        //! Whether the material is kept even if unused
+        bool persistent_;
+        //! Whether the material was unused on the previous RemoveUnusedLegacyMaterials()
+        bool unused_;
+    };
+    
+    typedef std::map<std::string, LegacyMaterial> LegacyMaterialMap;
+    
+    //! Legacy materials by material name
+    LegacyMaterialMap LegacyMaterials;
+    
+    uint GetMaterialVariation(const std::string& suffix)
+    {
+        for (uint i = 0; i < MAX_MATERIAL_VARIATIONS; ++i)
+        {
+            if (suffix == MaterialSuffix[i])
+                return i;
+        }
+        
+        return LEGACYMAT_NORMAL;
+    }
+    
+    //! Sets up a legacy material from the base material of its variation and the texture's current state
+    static void SetupLegacyMaterial(const std::string& material_name, LegacyMaterial& info)
     {
         Ogre::TextureManager &tm = Ogre::TextureManager::getSingleton();
         Ogre::MaterialManager &mm = Ogre::MaterialManager::getSingleton();
         
-        Ogre::TexturePtr tex = tm.getByName(texture_name);
-        bool has_alpha = false;
-        if (!tex.isNull())
+        Ogre::TexturePtr tex = tm.getByName(info.texture_name_);
+        info.has_texture_ = !tex.isNull();
+        info.has_alpha_ = info.has_texture_ && Ogre::PixelUtil::hasAlpha(tex->getFormat());
+        
+        Ogre::MaterialPtr material = mm.getByName(material_name);
+        if (!material.get())
         {
-            if (Ogre::PixelUtil::hasAlpha(tex->getFormat()))
-                has_alpha = true;
+            material = mm.create(material_name, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+            assert(material.get());
         }
         
-        // Early out: if texture does not yet exist and materials have already been created once
-        if (((tex.isNull()) || (!update)) && (!mm.getByName(texture_name).isNull()))
+        Ogre::MaterialPtr base_material;
+        if (!info.has_alpha_)
+            base_material = mm.getByName(BaseMaterials[info.variation_]);
+        else
+            base_material = mm.getByName(AlphaBaseMaterials[info.variation_]);
+        if (!base_material.get())
+        {
+            OgreRenderingModule::LogError("Could not find " + MaterialSuffix[info.variation_] + " base material for " + info.texture_name_);
             return;
+        }
+        
+        base_material->copyDetailsTo(material);
+        SetTextureUnitOnMaterial(material, info.texture_name_, 0);
+    }
+    
+    void CreateLegacyMaterials(const std::string& texture_name, bool update)
+    {
+        Ogre::TexturePtr tex = Ogre::TextureManager::getSingleton().getByName(texture_name);
+        bool has_texture = !tex.isNull();
+        bool has_alpha = has_texture && Ogre::PixelUtil::hasAlpha(tex->getFormat());
         
         for (uint i = 0; i < MAX_MATERIAL_VARIATIONS; ++i)
         {
-            const std::string& base_material_name = BaseMaterials[i];
-            const std::string& alpha_base_material_name = AlphaBaseMaterials[i];
-            
             std::string material_name = texture_name + MaterialSuffix[i];
-            Ogre::MaterialPtr material = mm.getByName(material_name);
-
-            if (!material.get())
+            LegacyMaterialMap::iterator j = LegacyMaterials.find(material_name);
+            if (j == LegacyMaterials.end())
             {
-                material = mm.create(material_name, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
-                assert(material.get());
+                // Meshes refer to the normal variation by texture name, so it always exists
+                if (i == LEGACYMAT_NORMAL)
+                    GetLegacyMaterial(texture_name, i);
+                continue;
             }
             
-            Ogre::MaterialPtr base_material;
-            if (!has_alpha)
-                base_material = mm.getByName(base_material_name);
-            else
-                base_material = mm.getByName(alpha_base_material_name);
-            if (!base_material.get())
+            LegacyMaterial& info = j->second;
+            // Early out: the texture is updated in place, so unless it appeared or its alpha changed, the material is fine
+            if (!update && info.has_texture_ == has_texture && info.has_alpha_ == has_alpha &&
+                !Ogre::MaterialManager::getSingleton().getByName(material_name).isNull())
+                continue;
+            
+            SetupLegacyMaterial(material_name, info);
+        }
+    }
+    
+    std::string GetLegacyMaterial(const std::string& texture_name, uint variation, bool persistent)
+    {
+        if (variation >= MAX_MATERIAL_VARIATIONS)
+        {
+            OgreRenderingModule::LogWarning("Requested non-existing material variation " + ToString<uint>(variation));
+            variation = LEGACYMAT_NORMAL;
+        }
+        
+        std::string material_name = texture_name + MaterialSuffix[variation];
+        LegacyMaterialMap::iterator i = LegacyMaterials.find(material_name);
+        if (i != LegacyMaterials.end())
+        {
+            LegacyMaterial& info = i->second;
+            info.persistent_ |= persistent;
+            info.unused_ = false;
+            // Recreate if someone removed the material behind our back
+            if (Ogre::MaterialManager::getSingleton().getByName(material_name).isNull())
+                SetupLegacyMaterial(material_name, info);
+            return material_name;
+        }
+        
+        LegacyMaterial info;
+        info.texture_name_ = texture_name;
+        info.variation_ = variation;
+        info.has_texture_ = false;
+        info.has_alpha_ = false;
+        info.persistent_ = persistent;
+        info.unused_ = false;
+        SetupLegacyMaterial(material_name, info);
+        LegacyMaterials[material_name] = info;
+        
+        return material_name;
+    }
+    
+    uint RemoveUnusedLegacyMaterials()
+    {
+        Ogre::MaterialManager &mm = Ogre::MaterialManager::getSingleton();
+        uint removed = 0;
+        
+        LegacyMaterialMap::iterator i = LegacyMaterials.begin();
+        while (i != LegacyMaterials.end())
+        {
+            LegacyMaterial& info = i->second;
+            if ((info.variation_ == LEGACYMAT_NORMAL) || (info.persistent_))
             {
-                OgreRenderingModule::LogError("Could not find " + MaterialSuffix[i] + " base material for " + texture_name);
-                return;
+                ++i;
+                continue;
             }
-
-            base_material->copyDetailsTo(material);
-            SetTextureUnitOnMaterial(material, texture_name, 0);
+            
+            Ogre::MaterialPtr material = mm.getByName(i->first);
+            if (material.isNull())
+            {
+                LegacyMaterials.erase(i++);
+                continue;
+            }
+            
+            // Entities, static geometry and billboard sets hold a pointer to their material. Beyond the references of
+            // the resource system, there is only the one we just took if none of them use the material
+            bool used = material.useCount() > Ogre::ResourceGroupManager::RESOURCE_SYSTEM_NUM_REFERENCE_COUNTS + 1;
+            // Keep the material for one more round after it was found unused, so that a prim that is just
+            // being rebuilt does not need to create it again
+            if ((used) || (!info.unused_))
+            {
+                info.unused_ = !used;
+                ++i;
+                continue;
+            }
+            
+            RemoveMaterial(material);
+            LegacyMaterials.erase(i++);
+            ++removed;
         }
+        
+        return removed;
+    }
+    
+    uint GetNumLegacyMaterials()
+    {
+        return LegacyMaterials.size();
     }
 
     void SetTextureUnitOnMaterial(Ogre::MaterialPtr material, const std::string& texture_name, uint index)
@@ -302,4 +436,141 @@ namespace OgreRenderer
             }
         }
     }
+    
+    //! Returns name of the skinned variant of a vertex program
+    static std::string GetSkinnedProgram(const std::string& program_name)
+    {
+        if ((program_name.length() > 2) && (program_name.substr(program_name.length() - 2) == "VP"))
+            return program_name.substr(0, program_name.length() - 2) + "SkinnedVP";
+        else
+            return program_name + "Skinned";
+    }
+    
+    bool CanSkinInHardware(Ogre::Entity* entity)
+    {
+        if (!entity || !entity->hasSkeleton())
+            return false;
+        
+        Ogre::RenderSystem* render_system = Ogre::Root::getSingleton().getRenderSystem();
+        if (!render_system || !render_system->getCapabilities()->hasCapability(Ogre::RSC_VERTEX_PROGRAM))
+            return false;
+        
+        Ogre::MeshPtr mesh = entity->getMesh();
+        if (mesh->sharedBlendIndexToBoneIndexMap.size() > MAX_SKINNED_BONES)
+            return false;
+        for (uint i = 0; i < mesh->getNumSubMeshes(); ++i)
+        {
+            Ogre::SubMesh* submesh = mesh->getSubMesh(i);
+            if (submesh->blendIndexToBoneIndexMap.size() > MAX_SKINNED_BONES)
+                return false;
+            
+            // The skinned vertex programs blend four weights. Ogre gives the vertices only as many weights as the
+            // vertex with the most bone assignments has, and the missing components would not read as zero
+            Ogre::VertexData* data = submesh->useSharedVertices ? mesh->sharedVertexData : submesh->vertexData;
+            if (!data)
+                return false;
+            const Ogre::VertexElement* weights = data->vertexDeclaration->findElementBySemantic(Ogre::VES_BLEND_WEIGHTS);
+            if (!weights || weights->getType() != Ogre::VET_FLOAT4 ||
+                !data->vertexDeclaration->findElementBySemantic(Ogre::VES_BLEND_INDICES))
+                return false;
+        }
+        
+        return true;
+    }
+    
+    std::string GetSkinnedMaterial(const std::string& material_name)
+    {
+        Ogre::MaterialManager& mm = Ogre::MaterialManager::getSingleton();
+        Ogre::MaterialPtr material = mm.getByName(material_name);
+        if (material.isNull() || !material->getNumTechniques())
+            return std::string();
+        
+        // Check that all passes of the first technique can be skinned before making the copy
+        Ogre::HighLevelGpuProgramManager& pm = Ogre::HighLevelGpuProgramManager::getSingleton();
+        if (!pm.resourceExists(cSkinnedProgram))
+            return std::string();
+        Ogre::Technique::PassIterator check_iter = material->getTechnique(0)->getPassIterator();
+        while (check_iter.hasMoreElements())
+        {
+            Ogre::Pass* pass = check_iter.getNext();
+            if (pass->hasVertexProgram())
+            {
+                if (!pm.resourceExists(GetSkinnedProgram(pass->getVertexProgramName())))
+                    return std::string();
+            }
+            // The fixed function replacement does not provide what fragment programs expect
+            else if (pass->hasFragmentProgram())
+                return std::string();
+        }
+        
+        std::string skinned_name = material_name + "/Skinned";
+        Ogre::MaterialPtr skinned = mm.getByName(skinned_name);
+        if (skinned.isNull())
+        {
+            skinned = mm.create(skinned_name, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+            assert(skinned.get());
+        }
+        
+        material->copyDetailsTo(skinned);
+        
+        // Keep only the first technique, so that every pass of the entity blends the same way
+        while (skinned->getNumTechniques() > 1)
+            skinned->removeTechnique(1);
+        
+        bool caster_exists = pm.resourceExists(cSkinnedShadowCasterProgram);
+        Ogre::Technique::PassIterator iter = skinned->getTechnique(0)->getPassIterator();
+        while (iter.hasMoreElements())
+        {
+            Ogre::Pass* pass = iter.getNext();
+            if (pass->hasVertexProgram())
+                pass->setVertexProgram(GetSkinnedProgram(pass->getVertexProgramName()));
+            else
+                pass->setVertexProgram(cSkinnedProgram);
+            if (caster_exists)
+                pass->setShadowCasterVertexProgram(cSkinnedShadowCasterProgram);
+        }
+        
+        skinned->load();
+        if (!skinned->getNumSupportedTechniques())
+        {
+            SkinnedMaterials.erase(skinned_name);
+            RemoveMaterial(skinned);
+            return std::string();
+        }
+        
+        SkinnedMaterials[skinned_name] = false;
+        return skinned_name;
+    }
+    
+    uint RemoveUnusedSkinnedMaterials()
+    {
+        Ogre::MaterialManager &mm = Ogre::MaterialManager::getSingleton();
+        uint removed = 0;
+        
+        std::map<std::string, bool>::iterator i = SkinnedMaterials.begin();
+        while (i != SkinnedMaterials.end())
+        {
+            Ogre::MaterialPtr material = mm.getByName(i->first);
+            if (material.isNull())
+            {
+                SkinnedMaterials.erase(i++);
+                continue;
+            }
+            
+            // Like legacy materials, the copies are kept for one more round after they were found unused
+            bool used = material.useCount() > Ogre::ResourceGroupManager::RESOURCE_SYSTEM_NUM_REFERENCE_COUNTS + 1;
+            if ((used) || (!i->second))
+            {
+                i->second = !used;
+                ++i;
+                continue;
+            }
+            
+            RemoveMaterial(material);
+            SkinnedMaterials.erase(i++);
+            ++removed;
+        }
+        
+        return removed;
+    }
 }
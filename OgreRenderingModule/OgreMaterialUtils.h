@@ -8,6 +8,11 @@
 #include "OgreModuleApi.h"
 #include "ResourceInterface.h"
 
+namespace Ogre
+{
+    class Entity;
+}
+
 namespace OgreRenderer
 {
     //! Standard legacy variation (lit)
@@ -30,6 +35,9 @@ namespace OgreRenderer
     
     //! Maximum legacy material variations
     const uint MAX_MATERIAL_VARIATIONS = 10;
+    
+    //! Maximum bones a submesh may use to be drawn with skinned materials. Must match the skinned vertex programs
+    const uint MAX_SKINNED_BONES = 60;
 
     //! Gets material suffix by variation type
     std::string OGRE_MODULE_API GetMaterialSuffix(uint variation);
@@ -47,12 +55,36 @@ namespace OgreRenderer
 
     Ogre::MaterialPtr OGRE_MODULE_API CloneMaterial(const std::string& sourceMaterialName, const std::string &newName);
 
-    //! Creates legacy material variations from texture
-    /*! @param texture_name texture to use
-        @param update if true, will recreate the materials even if they already exist (used when updating the texture, and
-        texture alpha settings possibly change)
+    //! Returns variation type by material suffix, or LEGACYMAT_NORMAL if suffix is not valid
+    uint OGRE_MODULE_API GetMaterialVariation(const std::string& suffix);
+    
+    //! Creates the normal legacy material of a texture, and updates the other legacy variations that exist
+    /*! Other variations are created only when asked for with GetLegacyMaterial().
+        @param texture_name texture to use
+        @param update if true, will set up the materials again even if the texture is already set and its alpha
+        settings did not change
      */
     void OGRE_MODULE_API CreateLegacyMaterials(const std::string& texture_name, bool update = false);
+    
+    //! Returns name of a legacy material variation of a texture, and creates the material if it does not exist yet
+    /*! If the texture does not exist yet, the material uses the missing texture texture until CreateLegacyMaterials()
+        is called for the texture. Variations other than LEGACYMAT_NORMAL are destroyed by RemoveUnusedLegacyMaterials()
+        once no renderable uses them, so use the material right away.
+        @param texture_name texture to use
+        @param variation variation type
+        @param persistent if true, the variation is never destroyed. Use for materials that are only referred to by name,
+        like in particle scripts
+     */
+    std::string OGRE_MODULE_API GetLegacyMaterial(const std::string& texture_name, uint variation, bool persistent = false);
+    
+    //! Destroys legacy material variations that no renderable has used since the previous call
+    /*! The normal variations and persistent variations are kept.
+        @return number of materials destroyed
+     */
+    uint OGRE_MODULE_API RemoveUnusedLegacyMaterials();
+    
+    //! Returns number of legacy materials that exist
+    uint OGRE_MODULE_API GetNumLegacyMaterials();
 
     //! Sets texture unit on a material to a given texture name.
     /*! If texture cannot actually be found, uses the missing texture texture
@@ -72,6 +104,27 @@ namespace OgreRenderer
     
     //! Deletes a material. Note: the material pointer passed in will be set to null
     void OGRE_MODULE_API RemoveMaterial(Ogre::MaterialPtr& material);
+    
+    //! Returns whether an entity's skeletal animation can be blended in the vertex program with skinned materials
+    /*! Requires vertex program support, that no submesh uses more than MAX_SKINNED_BONES bones, and that the
+        vertices have four blend weights, which Ogre gives them if some vertex has four bone assignments.
+     */
+    bool OGRE_MODULE_API CanSkinInHardware(Ogre::Entity* entity);
+    
+    //! Returns name of a copy of a material that blends skeletal animation in the vertex program
+    /*! Ogre blends the vertices of an entity in hardware instead of software once all its materials do this.
+        Passes without a vertex program use rex/SkinnedVP, which lights the vertices like the fixed function pipeline.
+        Passes with a vertex program use its Skinned variant (Skinned before the VP suffix), if one exists. The copy
+        is set up again from the material on each call, so that it follows changes to the material. Copies are
+        destroyed by RemoveUnusedSkinnedMaterials() once no renderable uses them, so use the material right away.
+        @param material_name material to copy
+        @return name of the copy, or empty if the material can not be skinned in hardware
+     */
+    std::string OGRE_MODULE_API GetSkinnedMaterial(const std::string& material_name);
+    
+    //! Destroys skinned material copies that no renderable has used since the previous call
+    //! @return number of materials destroyed
+    uint OGRE_MODULE_API RemoveUnusedSkinnedMaterials();
 }
 
 #endif
@@ -131,7 +131,8 @@ namespace OgreRenderer
                                             variation = "";
                                             
                                         references_.push_back(Foundation::ResourceReference(mat_name, OgreTextureResource::GetTypeStatic()));
-                                        line = "material " + mat_name + variation;
+                                        // The script refers to the material by name only, so keep the variation around
+                                        line = "material " + GetLegacyMaterial(mat_name, GetMaterialVariation(variation), true);
                                     }
                                 }
                             }
@@ -8,13 +8,19 @@
 #include "ResourceHandler.h"
 #include "OgreRenderingModule.h"
 #include "OgreConversionUtils.h"
+#include "OgreMaterialUtils.h"
 #include "EC_OgrePlaceable.h"
 #include "EC_OgreCamera.h"
 #include "EC_OgreMovableTextOverlay.h"
+#include "LabelAtlas.h"
+#include "StaticGeometryBatcher.h"
+#include "MeshInstancer.h"
+#include "MeshCloneCache.h"
 #include "QOgreUIView.h"
 #include "QOgreWorldView.h"
 
 #include "SceneEvents.h"
+#include "SceneManager.h"
 
 #include "ConfigurationManager.h"
 #include "EventManager.h"
@@ -25,6 +31,8 @@
 
 #include <Ogre.h>
 
+#include <set>
+
 #include <QApplication>
 #include <QDesktopWidget>
 #include <QIcon>
@@ -92,6 +100,7 @@ namespace OgreRenderer
         last_width_(0),
         last_height_(0),
         resized_dirty_(0),
+        legacy_material_cleanup_time_(0.0),
         view_distance_(500.0)
     {
         InitializeQt();
@@ -144,6 +153,10 @@ namespace OgreRenderer
             framework_->GetDefaultConfig().SetSetting("OgreRenderer", "view_distance", view_distance_);
         }
 
+        label_atlas_.reset();
+        mesh_instancer_.reset();
+        static_geometry_batcher_.reset();
+        mesh_clone_cache_.reset();
         resource_handler_.reset();
         root_.reset();
         SAFE_DELETE(q_ogre_world_view_);
@@ -417,6 +430,27 @@ namespace OgreRenderer
     void Renderer::Update(f64 frametime)
     {
         Ogre::WindowEventUtilities::messagePump();
+
+        // The instancer passes entities to and from the batcher, so update it first
+        if (mesh_instancer_)
+            mesh_instancer_->Update(frametime);
+        if (static_geometry_batcher_)
+            static_geometry_batcher_->Update(frametime);
+
+        // Legacy material variations and skinned material copies are created on demand, destroy the ones no longer
+        // used every now and then
+        legacy_material_cleanup_time_ += frametime;
+        if ((initialized_) && (legacy_material_cleanup_time_ >= 10.0))
+        {
+            PROFILE(Renderer_RemoveUnusedLegacyMaterials);
+            legacy_material_cleanup_time_ = 0.0;
+            uint removed = RemoveUnusedLegacyMaterials();
+            if (removed)
+                OgreRenderingModule::LogDebug("Removed " + ToString<uint>(removed) + " unused legacy materials");
+            removed = RemoveUnusedSkinnedMaterials();
+            if (removed)
+                OgreRenderingModule::LogDebug("Removed " + ToString<uint>(removed) + " unused skinned materials");
+        }
     }
     
     void Renderer::SetCurrentCamera(Ogre::Camera* camera)
@@ -470,10 +504,57 @@ namespace OgreRenderer
                 resized_dirty_--;
         }
         
+        if (label_atlas_)
+            label_atlas_->Update();
+
         q_ogre_world_view_->RenderOneFrame();
         q_ogre_ui_view_->setDirty(false);
     }
 
+    LabelAtlas* Renderer::GetLabelAtlas()
+    {
+        if (!initialized_ || !scenemanager_)
+            return 0;
+
+        if (!label_atlas_)
+            label_atlas_ = LabelAtlasPtr(new LabelAtlas(this));
+
+        return label_atlas_.get();
+    }
+
+    StaticGeometryBatcher* Renderer::GetStaticGeometryBatcher()
+    {
+        if (!initialized_ || !scenemanager_)
+            return 0;
+
+        if (!static_geometry_batcher_)
+            static_geometry_batcher_ = StaticGeometryBatcherPtr(new StaticGeometryBatcher(this));
+
+        return static_geometry_batcher_.get();
+    }
+
+    MeshInstancer* Renderer::GetMeshInstancer()
+    {
+        if (!initialized_ || !scenemanager_)
+            return 0;
+
+        if (!mesh_instancer_)
+            mesh_instancer_ = MeshInstancerPtr(new MeshInstancer(this));
+
+        return mesh_instancer_.get();
+    }
+
+    MeshCloneCache* Renderer::GetMeshCloneCache()
+    {
+        if (!initialized_)
+            return 0;
+
+        if (!mesh_clone_cache_)
+            mesh_clone_cache_ = MeshCloneCachePtr(new MeshCloneCache(this));
+
+        return mesh_clone_cache_.get();
+    }
+
     uint GetSubmeshFromIndexRange(uint index, const std::vector<uint>& submeshstartindex)
     {
         for(uint i = 0; i < submeshstartindex.size(); ++i)
@@ -490,7 +571,7 @@ namespace OgreRenderer
         return 0; // should never happen
     }
 
-    // Get the mesh information for the given mesh. Version which supports animation
+    // Get the mesh information for the given mesh. For skinned meshes this is the binding pose, see RaycastSkinnedEntity()
     // Adapted from http://www.ogre3d.org/wiki/index.php/Raycasting_to_the_polygon_level
     void GetMeshInformation(
         Ogre::Entity *entity,
@@ -511,10 +592,6 @@ namespace OgreRenderer
         size_t index_count = 0;
         Ogre::MeshPtr mesh = entity->getMesh();
 
-        bool useSoftwareBlendingVertices = entity->hasSkeleton();
-        if (useSoftwareBlendingVertices)
-            entity->_updateAnimation();
-
         submeshstartindex.resize(mesh->getNumSubMeshes());
 
         // Calculate how many vertices and indices we're going to need
@@ -553,14 +630,7 @@ namespace OgreRenderer
             Ogre::SubMesh* submesh = mesh->getSubMesh(i);
 
             // Get vertex data
-            //Ogre::VertexData* vertex_data = submesh->useSharedVertices ? mesh->sharedVertexData : submesh->vertexData;
-            Ogre::VertexData* vertex_data;
-
-            //When there is animation:
-            if (useSoftwareBlendingVertices)
-                vertex_data = submesh->useSharedVertices ? entity->_getSkelAnimVertexData() : entity->getSubEntity(i)->_getSkelAnimVertexData();
-            else
-                vertex_data = submesh->useSharedVertices ? mesh->sharedVertexData : submesh->vertexData;
+            Ogre::VertexData* vertex_data = submesh->useSharedVertices ? mesh->sharedVertexData : submesh->vertexData;
 
             if ((!submesh->useSharedVertices)||(submesh->useSharedVertices && !added_shared))
             {
@@ -628,22 +698,12 @@ namespace OgreRenderer
         }
     }
 
-    Ogre::Vector2 FindUVs(
-        const Ogre::Ray& ray,
-        float distance,
-        const std::vector<Ogre::Vector3>& vertices,
-        const std::vector<Ogre::Vector2>& texcoords,
-        const std::vector<uint> indices, uint foundindex)
+    // Interpolate the texture coordinates of a triangle at a point on it
+    Ogre::Vector2 FindTriangleUV(const Ogre::Vector3& point, const Ogre::Vector3* corners, const Ogre::Vector2* texcoords)
     {
-        Ogre::Vector3 point = ray.getPoint(distance);
-
-        Ogre::Vector3 t1 = vertices[indices[foundindex]];
-        Ogre::Vector3 t2 = vertices[indices[foundindex+1]];
-        Ogre::Vector3 t3 = vertices[indices[foundindex+2]];
-
-        Ogre::Vector3 v1 = point - t1;
-        Ogre::Vector3 v2 = point - t2;
-        Ogre::Vector3 v3 = point - t3;
+        Ogre::Vector3 v1 = point - corners[0];
+        Ogre::Vector3 v2 = point - corners[1];
+        Ogre::Vector3 v3 = point - corners[2];
 
         float area1 = (v2.crossProduct(v3)).length() / 2.0f;
         float area2 = (v1.crossProduct(v3)).length() / 2.0f;
@@ -653,9 +713,230 @@ namespace OgreRenderer
             return Ogre::Vector2(0.0f, 0.0f);
 
         Ogre::Vector3 bary(area1 / sum_area, area2 / sum_area, area3 / sum_area);
-        Ogre::Vector2 t = texcoords[indices[foundindex]] * bary.x + texcoords[indices[foundindex+1]] * bary.y + texcoords[indices[foundindex+2]] * bary.z;
+        return texcoords[0] * bary.x + texcoords[1] * bary.y + texcoords[2] * bary.z;
+    }
+
+    //! Maximum number of meshes to remember the skinning information of
+    static const uint cMaxSkinnedMeshes = 256;
+
+    //! Binding pose geometry and bone assignments of a skinned mesh for raycasts
+    struct SkinnedMeshInfo
+    {
+        //! Handle of the mesh, in case it has been recreated with the same name
+        Ogre::ResourceHandle handle_;
+        //! Vertices, texture coordinates and indices of all submeshes in binding pose, as from GetMeshInformation()
+        std::vector<Ogre::Vector3> vertices_;
+        std::vector<Ogre::Vector2> texcoords_;
+        std::vector<uint> indices_;
+        std::vector<uint> submesh_start_index_;
+        //! Bones and weights of each vertex
+        std::vector<std::vector<std::pair<unsigned short, Ogre::Real> > > vertex_bones_;
+        //! Bounds of the vertices assigned to each bone
+        std::vector<Ogre::AxisAlignedBox> bone_bounds_;
+        //! First indices of the triangles that have a vertex assigned to each bone
+        std::vector<std::vector<uint> > bone_triangles_;
+    };
+
+    // Adds the bone assignments of the vertices of a vertex data, whose first vertex is at offset in the vertex list
+    void AddBoneAssignments(
+        SkinnedMeshInfo& info,
+        uint offset,
+        uint vertex_count,
+        Ogre::Mesh::BoneAssignmentIterator assignments)
+    {
+        while (assignments.hasMoreElements())
+        {
+            const Ogre::VertexBoneAssignment& assignment = assignments.getNext();
+            if ((assignment.weight <= 0.0f) || (assignment.boneIndex >= info.bone_bounds_.size()) || (assignment.vertexIndex >= vertex_count))
+                continue;
+
+            uint vertex = offset + assignment.vertexIndex;
+            info.vertex_bones_[vertex].push_back(std::make_pair(assignment.boneIndex, assignment.weight));
+            info.bone_bounds_[assignment.boneIndex].merge(info.vertices_[vertex]);
+        }
+    }
+
+    // Get the binding pose geometry and bone assignments of a skinned mesh. Remembered per mesh, as they don't change
+    // with animation
+    const SkinnedMeshInfo& GetSkinnedMeshInfo(Ogre::Entity* entity)
+    {
+        typedef std::map<std::string, SkinnedMeshInfo> SkinnedMeshMap;
+        static SkinnedMeshMap skinned_meshes;
+
+        Ogre::MeshPtr mesh = entity->getMesh();
+        SkinnedMeshMap::iterator i = skinned_meshes.find(mesh->getName());
+        if ((i != skinned_meshes.end()) && (i->second.handle_ == mesh->getHandle()))
+            return i->second;
+
+        if (skinned_meshes.size() >= cMaxSkinnedMeshes)
+            skinned_meshes.clear();
+
+        SkinnedMeshInfo& info = skinned_meshes[mesh->getName()];
+        info.handle_ = mesh->getHandle();
+        GetMeshInformation(entity, info.vertices_, info.texcoords_, info.indices_, info.submesh_start_index_,
+            Ogre::Vector3::ZERO, Ogre::Quaternion::IDENTITY, Ogre::Vector3::UNIT_SCALE);
+
+        uint num_bones = entity->getSkeleton()->getNumBones();
+        info.vertex_bones_.clear();
+        info.vertex_bones_.resize(info.vertices_.size());
+        info.bone_bounds_.clear();
+        info.bone_bounds_.resize(num_bones);
+        info.bone_triangles_.clear();
+        info.bone_triangles_.resize(num_bones);
+
+        // The vertices are in the order GetMeshInformation() adds them, the shared ones at the first submesh using them
+        uint offset = 0;
+        bool added_shared = false;
+        for(unsigned short j = 0; j < mesh->getNumSubMeshes(); ++j)
+        {
+            Ogre::SubMesh* submesh = mesh->getSubMesh(j);
+            if (submesh->useSharedVertices)
+            {
+                if (!added_shared)
+                {
+                    AddBoneAssignments(info, offset, mesh->sharedVertexData->vertexCount, mesh->getBoneAssignmentIterator());
+                    offset += mesh->sharedVertexData->vertexCount;
+                    added_shared = true;
+                }
+            }
+            else
+            {
+                AddBoneAssignments(info, offset, submesh->vertexData->vertexCount, submesh->getBoneAssignmentIterator());
+                offset += submesh->vertexData->vertexCount;
+            }
+        }
+
+        for(uint j = 0; j + 2 < info.indices_.size(); j += 3)
+        {
+            for(uint k = j; k < j + 3; ++k)
+            {
+                const std::vector<std::pair<unsigned short, Ogre::Real> >& bones = info.vertex_bones_[info.indices_[k]];
+                for(uint l = 0; l < bones.size(); ++l)
+                {
+                    std::vector<uint>& triangles = info.bone_triangles_[bones[l].first];
+                    if (triangles.empty() || (triangles.back() != j))
+                        triangles.push_back(j);
+                }
+            }
+        }
+
+        return info;
+    }
+
+    // Get the position of a skinned mesh vertex in the current pose, blended like Ogre does
+    Ogre::Vector3 BlendSkinnedVertex(
+        const SkinnedMeshInfo& info,
+        const std::vector<Ogre::Matrix4>& transforms,
+        const Ogre::Matrix4& world,
+        uint index)
+    {
+        const Ogre::Vector3& vertex = info.vertices_[index];
+        const std::vector<std::pair<unsigned short, Ogre::Real> >& bones = info.vertex_bones_[index];
+
+        Ogre::Vector3 blended = Ogre::Vector3::ZERO;
+        Ogre::Real total_weight = 0.0f;
+        for(uint i = 0; i < bones.size(); ++i)
+        {
+            blended += transforms[bones[i].first].transformAffine(vertex) * bones[i].second;
+            total_weight += bones[i].second;
+        }
+
+        // Vertices without bones follow the entity
+        if (total_weight <= 0.0f)
+            return world.transformAffine(vertex);
+        return blended / total_weight;
+    }
+
+    // Raycast against a skinned entity in its current pose without blending all its vertices in software. The ray is
+    // transformed to the binding pose space of each bone and tested against the bounds of the vertices of the bone.
+    // Only the triangles of the bones that are hit are blended and tested
+    std::pair<bool, Ogre::Real> RaycastSkinnedEntity(
+        Ogre::Entity* entity,
+        const Ogre::Ray& ray,
+        Ogre::Vector3& point,
+        uint& submesh,
+        Ogre::Vector2& uv)
+    {
+        std::pair<bool, Ogre::Real> closest(false, 0.0f);
+        Ogre::SkeletonInstance* skeleton = entity->getSkeleton();
+        if (!skeleton || !entity->getParentNode())
+            return closest;
+
+        const SkinnedMeshInfo& info = GetSkinnedMeshInfo(entity);
+        const Ogre::Matrix4& world = entity->getParentNode()->_getFullTransform();
+
+        // Transforms from binding pose to world space by bone
+        std::vector<Ogre::Matrix4> transforms(info.bone_bounds_.size());
+        for(unsigned short i = 0; i < transforms.size(); ++i)
+        {
+            if (i < skeleton->getNumBones())
+            {
+                Ogre::Matrix4 offset;
+                skeleton->getBone(i)->_getOffsetTransform(offset);
+                transforms[i] = world * offset;
+            }
+            else
+                transforms[i] = world;
+        }
+
+        std::set<uint> tested;
+        for(unsigned short i = 0; i < transforms.size(); ++i)
+        {
+            if (info.bone_bounds_[i].isNull())
+                continue;
+
+            Ogre::Matrix4 inverse = transforms[i].inverseAffine();
+            Ogre::Vector3 origin = inverse.transformAffine(ray.getOrigin());
+            Ogre::Vector3 direction = inverse.transformAffine(ray.getOrigin() + ray.getDirection()) - origin;
+            if (!Ogre::Math::intersects(Ogre::Ray(origin, direction), info.bone_bounds_[i]).first)
+                continue;
+
+            const std::vector<uint>& triangles = info.bone_triangles_[i];
+            for(uint j = 0; j < triangles.size(); ++j)
+            {
+                uint first = triangles[j];
+                if (!tested.insert(first).second)
+                    continue;
+
+                Ogre::Vector3 corners[3];
+                Ogre::Vector2 texcoords[3];
+                for(uint k = 0; k < 3; ++k)
+                {
+                    uint index = info.indices_[first + k];
+                    corners[k] = BlendSkinnedVertex(info, transforms, world, index);
+                    texcoords[k] = info.texcoords_[index];
+                }
+
+                std::pair<bool, Ogre::Real> hit = Ogre::Math::intersects(ray, corners[0], corners[1], corners[2], true, false);
+                if (hit.first && (!closest.first || (hit.second < closest.second)))
+                {
+                    closest = hit;
+                    point = ray.getPoint(hit.second);
+                    submesh = GetSubmeshFromIndexRange(first, info.submesh_start_index_);
+                    uv = FindTriangleUV(point, corners, texcoords);
+                }
+            }
+        }
 
-        return t;
+        return closest;
+    }
+
+    Ogre::Vector2 FindUVs(
+        const Ogre::Ray& ray,
+        float distance,
+        const std::vector<Ogre::Vector3>& vertices,
+        const std::vector<Ogre::Vector2>& texcoords,
+        const std::vector<uint> indices, uint foundindex)
+    {
+        Ogre::Vector3 corners[3];
+        Ogre::Vector2 uvs[3];
+        for(uint i = 0; i < 3; ++i)
+        {
+            corners[i] = vertices[indices[foundindex+i]];
+            uvs[i] = texcoords[indices[foundindex+i]];
+        }
+
+        return FindTriangleUV(ray.getPoint(distance), corners, uvs);
     }
 
     Foundation::RaycastResult Renderer::Raycast(int x, int y)
@@ -764,6 +1045,34 @@ namespace OgreRenderer
                 Ogre::Entity* ogre_entity = static_cast<Ogre::Entity*>(entry.movable);
                 assert(ogre_entity != 0);
 
+                if (ogre_entity->hasSkeleton())
+                {
+                    // Skinned entities are tested in their current pose without making Ogre blend all their
+                    // vertices in software
+                    Ogre::Vector3 point;
+                    uint submesh = 0;
+                    Ogre::Vector2 uv;
+                    std::pair<bool, Ogre::Real> hit = RaycastSkinnedEntity(ogre_entity, ray, point, submesh, uv);
+                    if (hit.first)
+                    {
+                        if ((closest_distance < 0.0f) || (hit.second < closest_distance) || (current_priority > closest_priority))
+                        {
+                            if (current_priority >= closest_priority)
+                            {
+                                closest_distance = hit.second;
+                                closest_priority = current_priority;
+
+                                result.entity_ = entity;
+                                result.pos_ = Vector3df(point.x, point.y, point.z);
+                                result.submesh_ = submesh;
+                                result.u_ = uv.x;
+                                result.v_ = uv.y;
+                            }
+                        }
+                    }
+                    continue;
+                }
+
                 // get the mesh information
                 GetMeshInformation(ogre_entity, vertices, texcoords, indices, submeshstartindex,
                     ogre_entity->getParentNode()->_getDerivedPosition(),
@@ -837,10 +1146,32 @@ namespace OgreRenderer
     //qt wrapper / upcoming replacement for the one above
     QVariantList Renderer::FrustumQuery(QRect &viewrect)
     {
+        PROFILE(Renderer_FrustumQuery);
+
         QVariantList l;
-        l << 1;
-        l << 2;
-        l << 3;
+        Scene::ScenePtr scene = framework_->GetDefaultWorldScene();
+        const int width = GetWindowWidth();
+        const int height = GetWindowHeight();
+        if (!initialized_ || !camera_ || !scene || width <= 0 || height <= 0)
+            return l;
+
+        // The volume of the camera frustum that projects inside the rectangle
+        QRect rect = viewrect.normalized();
+        Ogre::PlaneBoundedVolume volume = camera_->getCameraToViewportBoxVolume(rect.left() / (Real)width,
+            rect.top() / (Real)height, (rect.right() + 1) / (Real)width, (rect.bottom() + 1) / (Real)height, true);
+
+        Scene::SpatialPlaneVector planes;
+        for (uint i = 0; i < volume.planes.size(); ++i)
+        {
+            const Ogre::Plane& plane = volume.planes[i];
+            planes.push_back(Scene::SpatialPlane(Vector3df(plane.normal.x, plane.normal.y, plane.normal.z), plane.d));
+        }
+
+        Scene::EntityIdVector entities;
+        scene->GetSpatialIndex().QueryFrustum(planes, entities);
+        for (uint i = 0; i < entities.size(); ++i)
+            l << entities[i];
+
         return l;
     }
 
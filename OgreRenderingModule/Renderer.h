@@ -42,10 +42,18 @@ namespace OgreRenderer
     class ResourceHandler;
     class QOgreUIView;
     class QOgreWorldView;
+    class LabelAtlas;
+    class StaticGeometryBatcher;
+    class MeshInstancer;
+    class MeshCloneCache;
 
     typedef boost::shared_ptr<Ogre::Root> OgreRootPtr;
     typedef boost::shared_ptr<LogListener> OgreLogListenerPtr;
     typedef boost::shared_ptr<ResourceHandler> ResourceHandlerPtr;
+    typedef boost::shared_ptr<LabelAtlas> LabelAtlasPtr;
+    typedef boost::shared_ptr<StaticGeometryBatcher> StaticGeometryBatcherPtr;
+    typedef boost::shared_ptr<MeshInstancer> MeshInstancerPtr;
+    typedef boost::shared_ptr<MeshCloneCache> MeshCloneCachePtr;
 
     //! Ogre renderer
     /*! Created by OgreRenderingModule. Implements the RenderServiceInterface.
@@ -175,6 +183,26 @@ namespace OgreRenderer
         //! Returns resource handler
         ResourceHandlerPtr GetResourceHandler() const { return resource_handler_; }
 
+        //! Returns the shared atlas for hovering text labels, created on first use
+        /*! Returns null if the renderer is not initialized.
+         */
+        LabelAtlas* GetLabelAtlas();
+
+        //! Returns the batcher merging non-moving meshes into static geometry, created on first use
+        /*! Returns null if the renderer is not initialized.
+         */
+        StaticGeometryBatcher* GetStaticGeometryBatcher();
+
+        //! Returns the instancer drawing repeated meshes with hardware instancing, created on first use
+        /*! Returns null if the renderer is not initialized.
+         */
+        MeshInstancer* GetMeshInstancer();
+
+        //! Returns the cache of mesh clones shared by entities, created on first use
+        /*! Returns null if the renderer is not initialized.
+         */
+        MeshCloneCache* GetMeshCloneCache();
+
         //! Removes log listener
         void RemoveLogListener();
 
@@ -189,7 +217,8 @@ namespace OgreRenderer
         void PostInitialize();
 
         //! Performs update. Called by OgreRenderingModule
-        /*! Pumps Ogre window events.
+        /*! Pumps Ogre window events, updates the instanced meshes and static geometry batches, and periodically
+            destroys unused legacy material variations.
          */
         void Update(f64 frametime);
 
@@ -212,6 +241,9 @@ namespace OgreRenderer
 
     public slots:
         //! Do a frustum query to the world from viewport coordinates.
+        /*! Uses the spatial index of the default world scene.
+            \return Ids of the entities whose placeable position projects inside the rectangle
+         */
         virtual QVariantList FrustumQuery(QRect &viewrect);
 
     private:
@@ -268,6 +300,18 @@ namespace OgreRenderer
         //! Resource handler
         ResourceHandlerPtr resource_handler_;
 
+        //! Hovering text label atlas
+        LabelAtlasPtr label_atlas_;
+
+        //! Static geometry batcher
+        StaticGeometryBatcherPtr static_geometry_batcher_;
+
+        //! Mesh instancer
+        MeshInstancerPtr mesh_instancer_;
+
+        //! Shared mesh clones
+        MeshCloneCachePtr mesh_clone_cache_;
+
         //! Renderer event category
         event_category_id_t renderercategory_id_;
 
@@ -311,6 +355,9 @@ namespace OgreRenderer
         //! resized dirty count
         int resized_dirty_;
 
+        //! Time since unused legacy materials were last removed
+        f64 legacy_material_cleanup_time_;
+
         //! For render function
         QImage ui_buffer_;
         QRect last_view_rect_;
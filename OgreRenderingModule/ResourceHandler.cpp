@@ -274,8 +274,8 @@ namespace OgreRenderer
         {
             resources_[source_tex->GetId()] = tex;
             
-            // Create legacy material(s) based on the texture
-            CreateLegacyMaterials(source_tex->GetId(), true);
+            // Create the normal legacy material based on the texture, and update the variations in use
+            CreateLegacyMaterials(source_tex->GetId());
             
             const RequestTagVector& tags = request_tags_[source_tex->GetId()];
             for (uint i = 0; i < tags.size(); ++i)
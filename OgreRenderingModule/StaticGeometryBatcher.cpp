@@ -0,0 +1,441 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+
+#include "StaticGeometryBatcher.h"
+#include "Renderer.h"
+#include "OgreRenderingModule.h"
+#include "ConfigurationManager.h"
+
+#include <Ogre.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "MemoryLeakCheck.h"
+
+namespace OgreRenderer
+{
+    //! Cells with fewer members are not worth a batch of their own
+    static const uint cMinCellMembers = 2;
+
+    //! Maximum number of cells built for new members per frame. Cells that lost members are always rebuilt
+    static const uint cMaxRebuildsPerFrame = 2;
+
+    //! Height of a cell, large enough to contain any region
+    static const Real cCellHeight = 8192.0f;
+
+    //! Tolerances for deciding whether an assigned entity has moved
+    static const Real cPositionTolerance = 0.001f;
+    static const Real cOrientationTolerance = 0.001f;
+
+    StaticGeometryBatcher::StaticGeometryBatcher(Renderer* renderer) :
+        renderer_(renderer),
+        time_(0.0),
+        num_batched_(0)
+    {
+        Foundation::Framework* framework = renderer_->GetFramework();
+        enabled_ = framework->GetDefaultConfig().DeclareSetting("OgreRenderer", "static_batching", true);
+        static_delay_ = framework->GetDefaultConfig().DeclareSetting("OgreRenderer", "static_batch_delay", 10.0);
+        cell_size_ = framework->GetDefaultConfig().DeclareSetting("OgreRenderer", "static_batch_cell_size", 64.0f);
+        if (static_delay_ < 0.1)
+            static_delay_ = 0.1;
+        if (cell_size_ < 1.0f)
+            cell_size_ = 1.0f;
+    }
+
+    StaticGeometryBatcher::~StaticGeometryBatcher()
+    {
+        for(MemberMap::iterator i = members_.begin(); i != members_.end(); ++i)
+        {
+            if (i->second.batched_)
+                Show(i->first, i->second);
+            if (i->second.node_->getListener() == this)
+                i->second.node_->setListener(0);
+        }
+
+        for(NodeListenerMap::iterator i = watched_nodes_.begin(); i != watched_nodes_.end(); ++i)
+        {
+            Ogre::Node* node = const_cast<Ogre::Node*>(i->first);
+            if (node->getListener() == this)
+                node->setListener(0);
+        }
+
+        Ogre::SceneManager* scene = renderer_->GetSceneManager();
+        for(CellMap::iterator i = cells_.begin(); i != cells_.end(); ++i)
+        {
+            if (scene && i->second.geometry_)
+                scene->destroyStaticGeometry(i->second.geometry_);
+        }
+    }
+
+    void StaticGeometryBatcher::AddEntity(Ogre::Entity* entity)
+    {
+        if (!enabled_ || !entity || members_.find(entity) != members_.end())
+            return;
+
+        // Animated meshes change every frame, and entities attached to bones follow them
+        if (entity->hasSkeleton() || entity->getMesh()->hasVertexAnimation() || !entity->getParentSceneNode())
+            return;
+
+        Ogre::Node* node = entity->getParentSceneNode();
+        Member& member = members_[entity];
+        member.node_ = node;
+        member.candidate_ = false;
+        member.moved_time_ = time_;
+        member.in_cell_ = false;
+        member.batched_ = false;
+        member.visibility_flags_ = 0;
+        MakeCandidate(entity, member);
+
+        node_entities_[node].push_back(entity);
+        node->setListener(this);
+    }
+
+    void StaticGeometryBatcher::RemoveEntity(Ogre::Entity* entity)
+    {
+        MemberMap::iterator i = members_.find(entity);
+        if (i == members_.end())
+            return;
+
+        Member& member = i->second;
+        if (member.in_cell_)
+            BreakOut(entity, member);
+        if (member.candidate_)
+            candidates_.erase(member.candidate_pos_);
+
+        NodeEntityMap::iterator n = node_entities_.find(member.node_);
+        if (n != node_entities_.end())
+        {
+            std::vector<Ogre::Entity*>& entities = n->second;
+            entities.erase(std::remove(entities.begin(), entities.end(), entity), entities.end());
+            if (entities.empty())
+            {
+                if (member.node_->getListener() == this && watched_nodes_.find(member.node_) == watched_nodes_.end())
+                    member.node_->setListener(0);
+                node_entities_.erase(n);
+                moved_nodes_.erase(member.node_);
+            }
+        }
+
+        members_.erase(i);
+    }
+
+    void StaticGeometryBatcher::RefreshEntity(Ogre::Entity* entity)
+    {
+        MemberMap::iterator i = members_.find(entity);
+        if (i == members_.end())
+            return;
+
+        if (i->second.in_cell_)
+            BreakOut(entity, i->second);
+        MakeCandidate(entity, i->second);
+    }
+
+    void StaticGeometryBatcher::WatchNode(Ogre::Node* node, Ogre::Node::Listener* listener)
+    {
+        if (!node || !listener)
+            return;
+
+        watched_nodes_[node] = listener;
+        node->setListener(this);
+    }
+
+    void StaticGeometryBatcher::UnwatchNode(Ogre::Node* node)
+    {
+        NodeListenerMap::iterator i = watched_nodes_.find(node);
+        if (i == watched_nodes_.end())
+            return;
+
+        watched_nodes_.erase(i);
+        if (node->getListener() == this && node_entities_.find(node) == node_entities_.end())
+            node->setListener(0);
+    }
+
+    void StaticGeometryBatcher::Update(f64 frametime)
+    {
+        if (members_.empty() && cells_.empty())
+            return;
+
+        PROFILE(StaticGeometryBatcher_Update);
+
+        time_ += frametime;
+
+        // Reading the derived transforms may update nodes and call nodeUpdated, so take the current set first
+        std::set<const Ogre::Node*> moved_nodes;
+        moved_nodes.swap(moved_nodes_);
+        for(std::set<const Ogre::Node*>::iterator i = moved_nodes.begin(); i != moved_nodes.end(); ++i)
+        {
+            NodeEntityMap::iterator n = node_entities_.find(*i);
+            if (n == node_entities_.end())
+                continue;
+
+            const std::vector<Ogre::Entity*>& entities = n->second;
+            for(uint j = 0; j < entities.size(); ++j)
+            {
+                Member& member = members_[entities[j]];
+                // Updates that do not change anything, such as repeated object updates, keep the entity batched
+                if (member.in_cell_)
+                {
+                    if (!HasChanged(entities[j], member))
+                        continue;
+                    BreakOut(entities[j], member);
+                }
+                MakeCandidate(entities[j], member);
+            }
+        }
+
+        // Assign the entities that have been still long enough to cells
+        while(!candidates_.empty())
+        {
+            Ogre::Entity* entity = candidates_.front();
+            Member& member = members_[entity];
+            if (time_ - member.moved_time_ < static_delay_)
+                break;
+
+            candidates_.pop_front();
+            member.candidate_ = false;
+            if (IsBatchable(entity))
+                AssignToCell(entity, member);
+            else
+                MakeCandidate(entity, member);
+        }
+
+        // Cells that lost built members are rebuilt before rendering, so that no entity is drawn twice
+        while(!broken_cells_.empty())
+        {
+            CellKey key = *broken_cells_.begin();
+            broken_cells_.erase(broken_cells_.begin());
+            dirty_cells_.erase(key);
+            RebuildCell(key);
+        }
+
+        // New members are drawn as they are until their cell is built, so those can be spread over frames
+        for(uint i = 0; (i < cMaxRebuildsPerFrame) && (!dirty_cells_.empty()); ++i)
+        {
+            CellKey key = *dirty_cells_.begin();
+            dirty_cells_.erase(dirty_cells_.begin());
+            RebuildCell(key);
+        }
+    }
+
+    void StaticGeometryBatcher::nodeUpdated(const Ogre::Node* node)
+    {
+        moved_nodes_.insert(node);
+
+        NodeListenerMap::iterator i = watched_nodes_.find(node);
+        if (i != watched_nodes_.end())
+            i->second->nodeUpdated(node);
+    }
+
+    void StaticGeometryBatcher::nodeDetached(const Ogre::Node* node)
+    {
+        moved_nodes_.insert(node);
+
+        NodeListenerMap::iterator i = watched_nodes_.find(node);
+        if (i != watched_nodes_.end())
+            i->second->nodeDetached(node);
+    }
+
+    void StaticGeometryBatcher::nodeDestroyed(const Ogre::Node* node)
+    {
+        moved_nodes_.erase(node);
+
+        // The watching listener may unwatch the node in turn, so stop watching it first
+        NodeListenerMap::iterator w = watched_nodes_.find(node);
+        if (w != watched_nodes_.end())
+        {
+            Ogre::Node::Listener* listener = w->second;
+            watched_nodes_.erase(w);
+            listener->nodeDestroyed(node);
+        }
+
+        NodeEntityMap::iterator n = node_entities_.find(node);
+        if (n == node_entities_.end())
+            return;
+
+        // The entities were detached from the node, stop tracking them
+        const std::vector<Ogre::Entity*>& entities = n->second;
+        for(uint i = 0; i < entities.size(); ++i)
+        {
+            MemberMap::iterator j = members_.find(entities[i]);
+            if (j == members_.end())
+                continue;
+            if (j->second.in_cell_)
+                BreakOut(j->first, j->second);
+            if (j->second.candidate_)
+                candidates_.erase(j->second.candidate_pos_);
+            members_.erase(j);
+        }
+
+        node_entities_.erase(n);
+    }
+
+    bool StaticGeometryBatcher::IsBatchable(Ogre::Entity* entity)
+    {
+        return entity->getParentSceneNode() && entity->isInScene() && entity->getVisible();
+    }
+
+    bool StaticGeometryBatcher::HasChanged(Ogre::Entity* entity, const Member& member)
+    {
+        if (!IsBatchable(entity) || entity->getParentSceneNode() != member.node_)
+            return true;
+
+        Ogre::Node* node = member.node_;
+        return !member.position_.positionEquals(node->_getDerivedPosition(), cPositionTolerance) ||
+            !member.orientation_.equals(node->_getDerivedOrientation(), Ogre::Radian(cOrientationTolerance)) ||
+            !member.scale_.positionEquals(node->_getDerivedScale(), cPositionTolerance);
+    }
+
+    void StaticGeometryBatcher::MakeCandidate(Ogre::Entity* entity, Member& member)
+    {
+        if (member.candidate_)
+            candidates_.erase(member.candidate_pos_);
+
+        member.candidate_pos_ = candidates_.insert(candidates_.end(), entity);
+        member.candidate_ = true;
+        member.moved_time_ = time_;
+    }
+
+    void StaticGeometryBatcher::AssignToCell(Ogre::Entity* entity, Member& member)
+    {
+        member.position_ = member.node_->_getDerivedPosition();
+        member.orientation_ = member.node_->_getDerivedOrientation();
+        member.scale_ = member.node_->_getDerivedScale();
+
+        CellKey key;
+        key.x_ = (int)floor(member.position_.x / cell_size_);
+        key.y_ = (int)floor(member.position_.y / cell_size_);
+        key.cast_shadows_ = entity->getCastShadows();
+
+        cells_[key].members_.insert(entity);
+        member.in_cell_ = true;
+        member.cell_ = key;
+        dirty_cells_.insert(key);
+    }
+
+    void StaticGeometryBatcher::BreakOut(Ogre::Entity* entity, Member& member)
+    {
+        member.in_cell_ = false;
+
+        CellMap::iterator i = cells_.find(member.cell_);
+        if (i == cells_.end())
+            return;
+
+        Cell& cell = i->second;
+        cell.members_.erase(entity);
+        if (member.batched_)
+        {
+            Show(entity, member);
+            broken_cells_.insert(member.cell_);
+        }
+        else if (!cell.geometry_ && cell.members_.empty())
+        {
+            dirty_cells_.erase(member.cell_);
+            cells_.erase(i);
+        }
+    }
+
+    void StaticGeometryBatcher::RebuildCell(const CellKey& key)
+    {
+        CellMap::iterator i = cells_.find(key);
+        if (i == cells_.end())
+            return;
+
+        Cell& cell = i->second;
+        Ogre::SceneManager* scene = renderer_->GetSceneManager();
+        if (!scene)
+            return;
+
+        if (cell.members_.size() < cMinCellMembers)
+        {
+            // Not worth a batch of its own, draw the members as they are
+            for(std::set<Ogre::Entity*>::iterator j = cell.members_.begin(); j != cell.members_.end(); ++j)
+            {
+                Member& member = members_[*j];
+                if (member.batched_)
+                    Show(*j, member);
+            }
+            if (cell.geometry_)
+            {
+                scene->destroyStaticGeometry(cell.geometry_);
+                cell.geometry_ = 0;
+            }
+            if (cell.members_.empty())
+                cells_.erase(i);
+            return;
+        }
+
+        try
+        {
+            if (!cell.geometry_)
+            {
+                cell.geometry_ = scene->createStaticGeometry(renderer_->GetUniqueObjectName());
+                cell.geometry_->setRegionDimensions(Ogre::Vector3(cell_size_, cell_size_, cCellHeight));
+                cell.geometry_->setOrigin(Ogre::Vector3(key.x_ * cell_size_, key.y_ * cell_size_, -cCellHeight * 0.5f));
+            }
+            else
+                cell.geometry_->reset();
+
+            cell.geometry_->setCastShadows(key.cast_shadows_);
+
+            // The cell is drawn as far as its farthest drawn member
+            Real draw_distance = 0.0f;
+            bool limited = true;
+            for(std::set<Ogre::Entity*>::iterator j = cell.members_.begin(); j != cell.members_.end(); ++j)
+            {
+                const Member& member = members_[*j];
+                cell.geometry_->addEntity(*j, member.position_, member.orientation_, member.scale_);
+                Real distance = (*j)->getRenderingDistance();
+                if (distance <= 0.0f)
+                    limited = false;
+                else if (distance > draw_distance)
+                    draw_distance = distance;
+            }
+            cell.geometry_->setRenderingDistance(limited ? draw_distance : 0.0f);
+            cell.geometry_->build();
+        }
+        catch (Ogre::Exception& e)
+        {
+            OgreRenderingModule::LogError("Could not build static geometry: " + std::string(e.what()));
+            for(std::set<Ogre::Entity*>::iterator j = cell.members_.begin(); j != cell.members_.end(); ++j)
+            {
+                Member& member = members_[*j];
+                if (member.batched_)
+                    Show(*j, member);
+            }
+            if (cell.geometry_)
+            {
+                scene->destroyStaticGeometry(cell.geometry_);
+                cell.geometry_ = 0;
+            }
+            return;
+        }
+
+        for(std::set<Ogre::Entity*>::iterator j = cell.members_.begin(); j != cell.members_.end(); ++j)
+            Hide(*j, members_[*j]);
+    }
+
+    void StaticGeometryBatcher::Show(Ogre::Entity* entity, Member& member)
+    {
+        if (!member.batched_)
+            return;
+
+        entity->setVisibilityFlags(member.visibility_flags_);
+        member.batched_ = false;
+        --num_batched_;
+    }
+
+    void StaticGeometryBatcher::Hide(Ogre::Entity* entity, Member& member)
+    {
+        if (member.batched_)
+            return;
+
+        // Only rendering is affected, the query flags stay so raycasts still hit the entity
+        member.visibility_flags_ = entity->getVisibilityFlags();
+        entity->setVisibilityFlags(0);
+        member.batched_ = true;
+        ++num_batched_;
+    }
+}
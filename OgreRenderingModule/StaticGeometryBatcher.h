@@ -0,0 +1,210 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_OgreRenderer_StaticGeometryBatcher_h
+#define incl_OgreRenderer_StaticGeometryBatcher_h
+
+#include "OgreModuleApi.h"
+
+#include <OgreNode.h>
+#include <OgreVector3.h>
+#include <OgreQuaternion.h>
+
+#include <list>
+#include <set>
+
+namespace Ogre
+{
+    class Entity;
+    class StaticGeometry;
+}
+
+namespace OgreRenderer
+{
+    class Renderer;
+
+    //! Merges the meshes of entities that do not move into static geometry, to cut down the number of batches.
+    /*! Every prim has its own mesh entity and scene node, so a built-up region costs a batch per prim and
+        submesh even though most prims never move. EC_OgreMesh and EC_OgreCustomObject register their entities
+        here when attached. Once an entity has not moved for static_batch_delay seconds it is assigned to a
+        cell of static_batch_cell_size world units, and the cell is rebuilt into an Ogre::StaticGeometry, which
+        groups the geometry of the whole cell by material. Skeletal and vertex animated meshes are not batched.
+
+        A batched entity stays attached to its scene node with its user data and query flags, so
+        Renderer::Raycast still resolves to the right Scene::Entity. It is only hidden from rendering by clearing
+        its visibility flags. When its node is moved, hidden or detached, the entity is broken out: it is shown
+        again, and its cell is rebuilt without it before the next frame. Material, shadow and draw distance
+        changes break the entity out too, through RefreshEntity(). Cells that only got new members are rebuilt
+        a few per frame.
+
+        Ogre nodes have only one listener, so the batcher also listens to the nodes of entities tracked by
+        MeshInstancer, see WatchNode().
+
+        Owned by Renderer, use Renderer::GetStaticGeometryBatcher().
+        \ingroup OgreRenderingModuleClient
+     */
+    class OGRE_MODULE_API StaticGeometryBatcher : public Ogre::Node::Listener
+    {
+    public:
+        //! Constructor
+        //! \param renderer Renderer whose scene the entities are in.
+        explicit StaticGeometryBatcher(Renderer* renderer);
+
+        //! Destructor. Shows the batched entities and destroys the static geometry.
+        virtual ~StaticGeometryBatcher();
+
+        //! Starts tracking an entity attached to a scene node. Does nothing if batching is disabled.
+        void AddEntity(Ogre::Entity* entity);
+
+        //! Stops tracking an entity. Must be called before the entity is detached or destroyed.
+        void RemoveEntity(Ogre::Entity* entity);
+
+        //! Breaks an entity out of its batch after its appearance has changed, and restarts its static time.
+        void RefreshEntity(Ogre::Entity* entity);
+
+        //! Breaks out moved entities, batches entities that have been static long enough, and rebuilds cells.
+        //! Called by Renderer each frame.
+        void Update(f64 frametime);
+
+        //! Listens to a scene node on behalf of another listener, and passes the node events on to it.
+        void WatchNode(Ogre::Node* node, Ogre::Node::Listener* listener);
+
+        //! Stops passing on the events of a node watched with WatchNode().
+        void UnwatchNode(Ogre::Node* node);
+
+        //! Returns number of entities drawn from static geometry.
+        uint GetNumBatchedEntities() const { return num_batched_; }
+
+        //! Returns number of cells with static geometry or pending members.
+        uint GetNumCells() const { return cells_.size(); }
+
+        //! Ogre::Node::Listener override. Marks the entities of the node as possibly moved.
+        virtual void nodeUpdated(const Ogre::Node* node);
+
+        //! Ogre::Node::Listener override. Stops tracking the entities of the node.
+        virtual void nodeDestroyed(const Ogre::Node* node);
+
+        //! Ogre::Node::Listener override. Marks the entities of the node as possibly moved.
+        virtual void nodeDetached(const Ogre::Node* node);
+
+    private:
+        //! Cell coordinates. Shadow casters and other entities are in separate static geometry.
+        struct CellKey
+        {
+            int x_;
+            int y_;
+            bool cast_shadows_;
+
+            bool operator < (const CellKey& rhs) const
+            {
+                if (x_ != rhs.x_)
+                    return x_ < rhs.x_;
+                if (y_ != rhs.y_)
+                    return y_ < rhs.y_;
+                return cast_shadows_ < rhs.cast_shadows_;
+            }
+        };
+
+        typedef std::list<Ogre::Entity*> EntityList;
+
+        struct Member
+        {
+            Ogre::Node* node_;
+            //! Position in the candidate list, valid if candidate_ is set
+            EntityList::iterator candidate_pos_;
+            bool candidate_;
+            //! Time the entity last moved, or was found not batchable
+            f64 moved_time_;
+            //! Whether the entity is assigned to a cell
+            bool in_cell_;
+            CellKey cell_;
+            //! Whether the entity is hidden and drawn from the static geometry of its cell
+            bool batched_;
+            //! Visibility flags to restore when the entity is broken out
+            Ogre::uint32 visibility_flags_;
+            //! Derived transform when assigned to the cell
+            Ogre::Vector3 position_;
+            Ogre::Quaternion orientation_;
+            Ogre::Vector3 scale_;
+        };
+
+        struct Cell
+        {
+            Cell() : geometry_(0) {}
+
+            //! Static geometry, null until the cell has been built with enough members
+            Ogre::StaticGeometry* geometry_;
+            //! Assigned entities, built or pending
+            std::set<Ogre::Entity*> members_;
+        };
+
+        typedef std::map<Ogre::Entity*, Member> MemberMap;
+        typedef std::map<CellKey, Cell> CellMap;
+        typedef std::map<const Ogre::Node*, std::vector<Ogre::Entity*> > NodeEntityMap;
+        typedef std::map<const Ogre::Node*, Ogre::Node::Listener*> NodeListenerMap;
+
+        //! Returns whether an entity can currently be drawn from static geometry.
+        static bool IsBatchable(Ogre::Entity* entity);
+
+        //! Returns whether an assigned entity has moved, been hidden or left the scene since it was assigned.
+        static bool HasChanged(Ogre::Entity* entity, const Member& member);
+
+        //! Puts an entity to the end of the candidate list, restarting its static time.
+        void MakeCandidate(Ogre::Entity* entity, Member& member);
+
+        //! Assigns a candidate entity to the cell at its position.
+        void AssignToCell(Ogre::Entity* entity, Member& member);
+
+        //! Removes an entity from its cell and shows it.
+        void BreakOut(Ogre::Entity* entity, Member& member);
+
+        //! Rebuilds the static geometry of a cell. Destroys the cell if it has no members.
+        void RebuildCell(const CellKey& key);
+
+        //! Shows an entity that was drawn from static geometry.
+        void Show(Ogre::Entity* entity, Member& member);
+
+        //! Hides an entity that is now drawn from static geometry.
+        void Hide(Ogre::Entity* entity, Member& member);
+
+        Renderer* renderer_;
+
+        //! Whether batching is enabled
+        bool enabled_;
+
+        //! Seconds an entity must stay still before it is batched
+        f64 static_delay_;
+
+        //! Cell size in world units
+        Real cell_size_;
+
+        //! Time since creation, for static times
+        f64 time_;
+
+        MemberMap members_;
+
+        //! Entities not assigned to a cell, least recently moved first
+        EntityList candidates_;
+
+        CellMap cells_;
+
+        //! Cells with new members waiting to be built
+        std::set<CellKey> dirty_cells_;
+
+        //! Cells that lost built members and are rebuilt before the next frame
+        std::set<CellKey> broken_cells_;
+
+        //! Tracked entities by the scene node they are attached to
+        NodeEntityMap node_entities_;
+
+        //! Nodes updated since the last Update
+        std::set<const Ogre::Node*> moved_nodes_;
+
+        //! Listeners of the nodes watched with WatchNode()
+        NodeListenerMap watched_nodes_;
+
+        //! Number of entities drawn from static geometry
+        uint num_batched_;
+    };
+}
+
+#endif
@@ -49,6 +49,10 @@ namespace OpenALAudio
         Foundation::EventManagerPtr event_manager = framework_->GetEventManager();
         asset_event_category_ = event_manager->QueryEventCategory("Asset");
         task_event_category_ = event_manager->QueryEventCategory("Task");
+        
+        RegisterConsoleCommand(Console::CreateCommand(
+            "SoundCacheStats", "Prints sound cache hit rates and sizes.", 
+            Console::Bind(this, &OpenALAudioModule::ConsoleSoundCacheStats)));
     }
 
     void OpenALAudioModule::Uninitialize()
@@ -67,6 +71,25 @@ namespace OpenALAudio
         RESETPROFILER;
     }
 
+    Console::CommandResult OpenALAudioModule::ConsoleSoundCacheStats(const StringVector &params)
+    {
+        if (!soundsystem_)
+            return Console::ResultFailure("Sound system not initialized.");
+        
+        SoundCacheStats stats = soundsystem_->GetCacheStats();
+        uint requests = stats.hits_ + stats.compressed_hits_ + stats.misses_;
+        if (!requests)
+            requests = 1;
+        
+        std::stringstream output;
+        output << "Decoded: " << stats.sounds_ << " sounds, " << stats.size_ / 1024 << " kB, hit rate "
+            << stats.hits_ * 100 / requests << "%" << std::endl;
+        output << "Compressed: " << stats.compressed_sounds_ << " sounds, " << stats.compressed_size_ / 1024
+            << " kB, hit rate " << stats.compressed_hits_ * 100 / requests << "%" << std::endl;
+        output << "Misses: " << stats.misses_ << " of " << stats.hits_ + stats.compressed_hits_ + stats.misses_ << " requests";
+        return Console::ResultSuccess(output.str());
+    }
+    
     bool OpenALAudioModule::HandleEvent(event_category_id_t category_id, event_id_t event_id, Foundation::EventDataInterface* data)
     {
         if (category_id == asset_event_category_)
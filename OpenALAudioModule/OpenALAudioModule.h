@@ -5,6 +5,7 @@
 
 #include "ModuleInterface.h"
 #include "ModuleLoggingFunctions.h"
+#include "ConsoleCommandServiceInterface.h"
 #include "OpenALAudioModuleApi.h"
 
 namespace Foundation
@@ -44,6 +45,9 @@ namespace OpenALAudio
         bool HandleEvent(event_category_id_t category_id, event_id_t event_id, Foundation::EventDataInterface* data);
                 
     private:
+        //! Console command for printing sound cache statistics
+        Console::CommandResult ConsoleSoundCacheStats(const StringVector &params);
+        
 		SoundSystemPtr soundsystem_;
 		SoundSettingsPtr soundsettings_;
 				
@@ -9,8 +9,7 @@ namespace OpenALAudio
     Sound::Sound(const std::string& name) : 
         name_(name),
         handle_(0), 
-        size_(0), 
-        age_(0.0)
+        size_(0)
     {
     }
     
@@ -21,23 +20,11 @@ namespace OpenALAudio
     
     bool Sound::LoadFromBuffer(const Foundation::SoundServiceInterface::SoundBuffer& buffer)
     {
-        DeleteBuffer();
+        // Keep the OpenAL buffer if there is one, so that recycled sounds do not allocate a new one
+        compressed_data_.reset();
+        size_ = 0;
         
-        ALenum openal_format;
-        if (!buffer.stereo_)
-        {
-            if (!buffer.sixteenbit_)
-                openal_format = AL_FORMAT_MONO8;
-            else
-                openal_format = AL_FORMAT_MONO16;
-        }
-        else
-        {
-            if (!buffer.sixteenbit_)
-                openal_format = AL_FORMAT_STEREO8;
-            else
-                openal_format = AL_FORMAT_STEREO16;
-        }
+        ALenum openal_format = GetOpenALFormat(buffer);
         
         if (!CreateBuffer())
             return false;
@@ -54,6 +41,42 @@ namespace OpenALAudio
         return true;
     }
     
+    ALenum Sound::GetOpenALFormat(const Foundation::SoundServiceInterface::SoundBuffer& buffer)
+    {
+        if (!buffer.stereo_)
+        {
+            if (!buffer.sixteenbit_)
+                return AL_FORMAT_MONO8;
+            else
+                return AL_FORMAT_MONO16;
+        }
+        else
+        {
+            if (!buffer.sixteenbit_)
+                return AL_FORMAT_STEREO8;
+            else
+                return AL_FORMAT_STEREO16;
+        }
+    }
+    
+    void Sound::LoadCompressed(const u8* data, uint size)
+    {
+        DeleteBuffer();
+        
+        compressed_data_ = CompressedDataPtr(new std::vector<u8>(data, data + size));
+        size_ = size;
+    }
+    
+    void Sound::LoadCompressed(CompressedDataPtr data)
+    {
+        DeleteBuffer();
+        
+        if (!data)
+            return;
+        compressed_data_ = data;
+        size_ = data->size();
+    }
+    
     bool Sound::CreateBuffer()
     {    
         if (!handle_)
@@ -70,6 +93,11 @@ namespace OpenALAudio
         
     void Sound::DeleteBuffer()
     {
+        if (compressed_data_)
+        {
+            compressed_data_.reset();
+            size_ = 0;
+        }
         if (handle_)
         {
             alDeleteBuffers(1, &handle_);
@@ -9,7 +9,12 @@
 
 namespace OpenALAudio
 {
+    typedef boost::shared_ptr<std::vector<u8> > CompressedDataPtr;
+    
     //! A sound buffer containing sound data. Uses OpenAL
+    /*! Long sounds are not decoded up front: they keep only the compressed ogg vorbis data, which
+        SoundChannel decodes in chunks while playing.
+     */
     class Sound
     {
     public:
@@ -19,23 +24,35 @@ namespace OpenALAudio
         ~Sound();
         
         //! Load raw data from buffer
-        /*! Any existing sound data will be erased.
+        /*! Any existing sound data will be erased. An existing OpenAL buffer is reused.
          */
         bool LoadFromBuffer(const Foundation::SoundServiceInterface::SoundBuffer& buffer);
+        
+        //! Store compressed ogg vorbis data for streamed playback
+        /*! Any existing sound data will be erased.
+         */
+        void LoadCompressed(const u8* data, uint size);
+        
+        //! Store compressed ogg vorbis data for streamed playback, sharing the data
+        /*! Any existing sound data will be erased.
+         */
+        void LoadCompressed(CompressedDataPtr data);
 
+        //! Return OpenAL format matching a sound buffer
+        static ALenum GetOpenALFormat(const Foundation::SoundServiceInterface::SoundBuffer& buffer);
+        
         //! Return sound name
         const std::string& GetName() const { return name_; }
         //! Return OpenAL handle
-        ALuint GetHandle() const { ResetAge(); return handle_; }
-        //! Return datasize of sound in bytes
+        ALuint GetHandle() const { return handle_; }
+        //! Return datasize of sound in bytes. For streamed sounds, this is the compressed size
         uint GetSize() const { return size_; }
-
-        //! Return age of sound (for caching)
-        f64 GetAge() const { return age_; }
-        //! Reset age of sound (for caching)
-        void ResetAge() const { age_ = 0.0; }
-        //! Add age to sound (for caching)
-        void AddAge(f64 time) const { age_ += time; }
+        //! Return whether sound is played by streaming the compressed data
+        bool IsStreamed() const { return compressed_data_.get() != 0; }
+        //! Return compressed data of a streamed sound
+        CompressedDataPtr GetCompressedData() const { return compressed_data_; }
+        //! Return whether sound has data to play
+        bool IsLoaded() const { return (handle_ != 0) || IsStreamed(); }
         
     private:
         //! Create sound buffer if one does not exist
@@ -49,8 +66,8 @@ namespace OpenALAudio
         ALuint handle_;
         //! Total size of audio data
         uint size_;    
-        //! Age of sound (resetted when last accessed)
-        mutable f64 age_;
+        //! Compressed data, if streamed
+        CompressedDataPtr compressed_data_;
     };
     
     typedef boost::shared_ptr<Sound> SoundPtr;        
@@ -10,6 +10,12 @@ namespace OpenALAudio
     static const Real DEFAULT_ROLLOFF = 2.0f;
     static const Real DEFAULT_INNER_RADIUS = 1.0f;
     static const Real DEFAULT_OUTER_RADIUS = 50.0f;
+    //! Number of OpenAL buffers in the ring of a streamed sound
+    static const uint STREAM_BUFFERS = 4;
+    //! Size of one decoded chunk of a streamed sound, about 0.4 seconds of 44.1kHz 16bit stereo
+    static const uint STREAM_CHUNK_SIZE = 65536;
+    //! Maximum number of played sound buffers kept for reuse in buffered mode
+    static const uint MAX_FREE_BUFFERS = 16;
     
     SoundChannel::SoundChannel(Foundation::SoundServiceInterface::SoundType type) :
         type_(type),
@@ -25,7 +31,9 @@ namespace OpenALAudio
         positional_(false),
         looped_(false),
         buffered_mode_(false),
-        state_(Foundation::SoundServiceInterface::Stopped)
+        state_(Foundation::SoundServiceInterface::Stopped),
+        stream_request_pending_(false),
+        stream_ended_(false)
     { 
     }
     
@@ -41,6 +49,10 @@ namespace OpenALAudio
         QueueBuffers();
         UnqueueBuffers();
         
+        // A stream that ended before any data could be queued
+        if ((stream_) && (stream_ended_) && (state_ == Foundation::SoundServiceInterface::Pending))
+            state_ = Foundation::SoundServiceInterface::Stopped;
+        
         if (state_ == Foundation::SoundServiceInterface::Playing)
         {
             if (handle_)
@@ -49,6 +61,9 @@ namespace OpenALAudio
                 alGetSourcei(handle_, AL_SOURCE_STATE, &playing);
                 if (playing != AL_PLAYING)
                 {
+                    // If a stream ran out of decoded data, playback resumes when the next chunks are queued
+                    if ((stream_) && (!stream_ended_))
+                        return;
                     // Stopped state may trigger removal of audio channel, so don't
                     // do that in buffered mode
                     if (buffered_mode_)
@@ -79,8 +94,15 @@ namespace OpenALAudio
     
     void SoundChannel::AddBuffer(const Foundation::SoundServiceInterface::SoundBuffer& buffer)
     {
-        // Construct a sound from the buffer
-        SoundPtr new_sound(new Sound("buffer"));
+        // Construct a sound from the buffer, reusing a played one if possible
+        SoundPtr new_sound;
+        if (free_buffers_.size())
+        {
+            new_sound = free_buffers_.back();
+            free_buffers_.pop_back();
+        }
+        else
+            new_sound = SoundPtr(new Sound("buffer"));
         new_sound->LoadFromBuffer(buffer);
         // If failed for some reason (out of memory?), bail out
         if (!new_sound->GetHandle())
@@ -109,7 +131,7 @@ namespace OpenALAudio
         }   
         
         alSourcef(handle_, AL_PITCH, pitch_);
-        alSourcei(handle_, AL_LOOPING, looped_ ? AL_TRUE : AL_FALSE);
+        alSourcei(handle_, AL_LOOPING, (looped_ && !stream_) ? AL_TRUE : AL_FALSE);
         // No matter whether sound is positional or not, we use own attenuation, so OpenAL rolloff is 0
         alSourcef(handle_, AL_ROLLOFF_FACTOR, 0.0);
         
@@ -139,6 +161,7 @@ namespace OpenALAudio
             alSourcei(handle_, AL_BUFFER, 0);
         }
         
+        StopStream();
         pending_sounds_.clear();
         playing_sounds_.clear();
         
@@ -178,8 +201,9 @@ namespace OpenALAudio
             enable = false;
         
         looped_ = enable;
+        // A stream loops by rewinding the decoder, not the source
         if (handle_)
-            alSourcei(handle_, AL_LOOPING, looped_ ? AL_TRUE : AL_FALSE);
+            alSourcei(handle_, AL_LOOPING, (looped_ && !stream_) ? AL_TRUE : AL_FALSE);
     }
     
     void SoundChannel::SetPitch(Real pitch)
@@ -282,7 +306,7 @@ namespace OpenALAudio
         // See that we do have waiting sounds and they're ready to play
         if (!pending_sounds_.size())
             return;
-        if ((*pending_sounds_.begin())->GetHandle() == 0)
+        if (!(*pending_sounds_.begin())->IsLoaded())
             return;
         
         // Create source now if did not exist already
@@ -293,6 +317,16 @@ namespace OpenALAudio
             return;
         }
         
+        // A streamed sound takes over the source. Playback starts once the first chunks are decoded
+        if ((*pending_sounds_.begin())->IsStreamed())
+        {
+            SoundPtr sound = *pending_sounds_.begin();
+            pending_sounds_.clear();
+            if (!StartStream(sound))
+                state_ = Foundation::SoundServiceInterface::Stopped;
+            return;
+        }
+        
         bool queued = false;
         
         // Buffer pending sounds, move them to playing vector
@@ -355,12 +389,21 @@ namespace OpenALAudio
                 alSourceUnqueueBuffers(handle_, 1, &buffer);
                 if (buffer)
                 {
+                    // Processed buffers of a stream are refilled
+                    if (stream_)
+                    {
+                        free_stream_buffers_.push_back(buffer);
+                        continue;
+                    }
                     // See if we find matching buffer from the sounds vector.
                     // If found, erase so that the sound may be freed if not used elsewhere
                     for (uint i = 0; i < playing_sounds_.size(); ++i)
                     {
                         if (playing_sounds_[i]->GetHandle() == buffer)
                         {
+                            // Buffers of buffered mode are not shared, recycle them
+                            if ((buffered_mode_) && (playing_sounds_[i].unique()) && (free_buffers_.size() < MAX_FREE_BUFFERS))
+                                free_buffers_.push_back(playing_sounds_[i]);
                             playing_sounds_.erase(playing_sounds_.begin() + i);
                             break;
                         }
@@ -370,4 +413,106 @@ namespace OpenALAudio
         }
     }
     
-}
\ No newline at end of file
+    bool SoundChannel::StartStream(SoundPtr sound)
+    {
+        if (!handle_)
+            return false;
+        
+        alSourceStop(handle_);
+        alSourcei(handle_, AL_BUFFER, 0);
+        StopStream();
+        
+        stream_buffers_.resize(STREAM_BUFFERS);
+        alGetError();
+        alGenBuffers(STREAM_BUFFERS, &stream_buffers_[0]);
+        ALenum error = alGetError();
+        if (error != AL_NONE)
+        {
+            OpenALAudioModule::LogError("Could not create OpenAL stream buffers: " + ToString<int>(error));
+            stream_buffers_.clear();
+            return false;
+        }
+        
+        free_stream_buffers_ = stream_buffers_;
+        stream_ = VorbisStreamPtr(new VorbisStream(sound->GetCompressedData()));
+        alSourcei(handle_, AL_LOOPING, AL_FALSE);
+        // Keep the sound for its name
+        playing_sounds_.push_back(sound);
+        
+        return true;
+    }
+    
+    void SoundChannel::StopStream()
+    {
+        if (stream_buffers_.size())
+        {
+            alDeleteBuffers(stream_buffers_.size(), &stream_buffers_[0]);
+            stream_buffers_.clear();
+        }
+        
+        free_stream_buffers_.clear();
+        stream_.reset();
+        stream_request_pending_ = false;
+        stream_ended_ = false;
+    }
+    
+    VorbisStreamRequestPtr SoundChannel::GetStreamRequest(sound_id_t channel)
+    {
+        if ((!stream_) || (stream_request_pending_) || (stream_ended_) || (free_stream_buffers_.empty()))
+            return VorbisStreamRequestPtr();
+        
+        VorbisStreamRequestPtr request(new VorbisStreamRequest());
+        request->channel_ = channel;
+        request->stream_ = stream_;
+        request->chunks_ = free_stream_buffers_.size();
+        request->chunk_size_ = STREAM_CHUNK_SIZE;
+        request->looped_ = looped_;
+        stream_request_pending_ = true;
+        
+        return request;
+    }
+    
+    void SoundChannel::AddStreamData(const VorbisStreamResult& result)
+    {
+        // The channel may have been stopped or started another sound meanwhile
+        if ((!stream_) || (result.stream_ != stream_) || (!handle_))
+            return;
+        
+        stream_request_pending_ = false;
+        if (result.ended_)
+            stream_ended_ = true;
+        
+        bool queued = false;
+        
+        for (uint i = 0; i < result.chunks_.size(); ++i)
+        {
+            const Foundation::SoundServiceInterface::SoundBuffer& chunk = result.chunks_[i];
+            if ((free_stream_buffers_.empty()) || (!chunk.data_.size()))
+                break;
+            
+            ALuint buffer = free_stream_buffers_.back();
+            alGetError();
+            alBufferData(buffer, Sound::GetOpenALFormat(chunk), (u8*)&chunk.data_[0], chunk.data_.size(), chunk.frequency_);
+            alSourceQueueBuffers(handle_, 1, &buffer);
+            ALenum error = alGetError();
+            if (error != AL_NONE)
+            {
+                OpenALAudioModule::LogError("Could not queue OpenAL stream buffer: " + ToString<int>(error));
+                break;
+            }
+            
+            free_stream_buffers_.pop_back();
+            queued = true;
+        }
+        
+        // Start playback, or resume after running out of data
+        if (queued)
+        {
+            ALint playing;
+            alGetSourcei(handle_, AL_SOURCE_STATE, &playing);
+            if (playing != AL_PLAYING)
+                alSourcePlay(handle_);
+            state_ = Foundation::SoundServiceInterface::Playing;
+        }
+    }
+}
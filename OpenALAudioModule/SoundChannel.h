@@ -4,10 +4,15 @@
 
 #include "SoundServiceInterface.h"
 #include "Sound.h"
+#include "VorbisDecoder.h"
 
 namespace OpenALAudio
 {
     //! An OpenAL sound channel (source)
+    /*! Streamed sounds are played through a small ring of OpenAL buffers. Whenever buffers have been
+        processed, the channel hands out a request to decode the next chunks on the VorbisDecoder thread,
+        and queues the decoded data back into the freed buffers.
+     */
     class SoundChannel
     {
     public:
@@ -49,12 +54,22 @@ namespace OpenALAudio
         const std::string& GetSoundName() const;
         //! Return sound type
         Foundation::SoundServiceInterface::SoundType GetSoundType() const { return type_; }
+        //! Return request to decode more data of the streamed sound, or null if none needed now
+        /*! \param channel Id of this channel, returned in the result
+         */
+        VorbisStreamRequestPtr GetStreamRequest(sound_id_t channel);
+        //! Queue decoded data of the streamed sound into free buffers and play
+        void AddStreamData(const VorbisStreamResult& result);
         
     private:
         //! Queue buffers and start playing
         void QueueBuffers();
         //! Remove processed buffers
         void UnqueueBuffers();
+        //! Start streaming a sound. Creates the buffer ring
+        bool StartStream(SoundPtr sound);
+        //! Stop streaming & delete the buffer ring. Buffers must be unqueued first
+        void StopStream();
         //! Create OpenAL source if one does not exist yet
         bool CreateSource();
         //! Delete OpenAL source
@@ -74,6 +89,8 @@ namespace OpenALAudio
         std::list<SoundPtr> pending_sounds_;
         //! Currently playing sound buffers
         std::vector<SoundPtr> playing_sounds_;
+        //! Played sound buffers of buffered mode, reused by AddBuffer
+        std::vector<SoundPtr> free_buffers_;
         //! Pitch
         Real pitch_;
         //! Gain
@@ -98,6 +115,16 @@ namespace OpenALAudio
         Vector3df position_;
         //! State 
         Foundation::SoundServiceInterface::SoundState state_;
+        //! Decoder state of the streamed sound, null if not streaming
+        VorbisStreamPtr stream_;
+        //! Buffer ring of the streamed sound
+        std::vector<ALuint> stream_buffers_;
+        //! Buffers of the ring not queued to the source
+        std::vector<ALuint> free_stream_buffers_;
+        //! Whether a stream decode request is in progress
+        bool stream_request_pending_;
+        //! Whether the stream has been decoded to the end
+        bool stream_ended_;
     };
     
     typedef boost::shared_ptr<SoundChannel> SoundChannelPtr;
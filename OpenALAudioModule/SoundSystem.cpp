@@ -19,7 +19,11 @@
 namespace OpenALAudio
 {
     const uint DEFAULT_SOUND_CACHE_SIZE = 32 * 1024 * 1024;
+    //! Ogg vorbis compresses roughly 10:1, so this keeps several times the decoded cache's worth of sounds
+    const uint DEFAULT_COMPRESSED_SOUND_CACHE_SIZE = 16 * 1024 * 1024;
     const f64 CACHE_CHECK_INTERVAL = 1.0;
+    //! Ogg vorbis data larger than this is streamed instead of decoded whole. About 10 seconds of music
+    const uint DEFAULT_STREAM_THRESHOLD = 128 * 1024;
     
     SoundSystem::SoundSystem(Foundation::Framework *framework) : 
         framework_(framework),
@@ -31,10 +35,17 @@ namespace OpenALAudio
         capture_sample_size_(0),
         next_channel_id_(0),
         sound_cache_size_(DEFAULT_SOUND_CACHE_SIZE),
+        compressed_sound_cache_size_(DEFAULT_COMPRESSED_SOUND_CACHE_SIZE),
+        cached_size_(0),
+        compressed_cached_size_(0),
+        stream_threshold_(DEFAULT_STREAM_THRESHOLD),
         update_time_(0),
         listener_position_(0.0, 0.0, 0.0)
     {
         sound_cache_size_ = framework_->GetDefaultConfig().DeclareSetting("SoundSystem", "sound_cache_size", DEFAULT_SOUND_CACHE_SIZE);
+        compressed_sound_cache_size_ = framework_->GetDefaultConfig().DeclareSetting("SoundSystem", "compressed_sound_cache_size", DEFAULT_COMPRESSED_SOUND_CACHE_SIZE);
+        memset(&cache_stats_, 0, sizeof(cache_stats_));
+        stream_threshold_ = framework_->GetDefaultConfig().DeclareSetting("SoundSystem", "stream_threshold", DEFAULT_STREAM_THRESHOLD);
         
         // By default, initialize default playback device
         Initialize();
@@ -112,6 +123,11 @@ namespace OpenALAudio
         
         channels_.clear();
         sounds_.clear();
+        sounds_lru_.clear();
+        cached_size_ = 0;
+        compressed_sounds_.clear();
+        compressed_sounds_lru_.clear();
+        compressed_cached_size_ = 0;
         
         if (context_)
         {
@@ -190,6 +206,10 @@ namespace OpenALAudio
         while (i != channels_.end())
         {
             i->second->Update(listener_position_);
+            // Decode more of streamed sounds on the decoder thread
+            VorbisStreamRequestPtr stream_request = i->second->GetStreamRequest(i->first);
+            if (stream_request)
+                framework_->GetThreadTaskManager()->AddRequest("VorbisDecoder", stream_request);
             if (i->second->GetState() == Foundation::SoundServiceInterface::Stopped)
             {
                 channels_to_delete.push_back(i);
@@ -388,10 +408,20 @@ namespace OpenALAudio
         SoundMap::iterator i = sounds_.find(name);
         if (i != sounds_.end())
         {
-            i->second->ResetAge();
-            return i->second;
+            ++cache_stats_.hits_;
+            TouchSound(i);
+            return i->second.sound_;
         }
         
+        // Redecode from the compressed data if still cached
+        SoundPtr compressed_sound = LoadFromCompressedCache(name);
+        if (compressed_sound)
+        {
+            ++cache_stats_.compressed_hits_;
+            return compressed_sound;
+        }
+        
+        ++cache_stats_.misses_;
         if (local)
         {
             // Loading of local wav sound
@@ -402,7 +432,7 @@ namespace OpenALAudio
                 SoundPtr new_sound(new Sound(name));
                 if (WavLoader::LoadFromFile(new_sound.get(), name))
                 {
-                    sounds_[name] = new_sound;
+                    AddToCache(new_sound);
                     return new_sound;
                 }
             }
@@ -415,8 +445,8 @@ namespace OpenALAudio
                 // See if the file exists. If it does, read it and post a decode request
                 if (DecodeLocalOggFile(new_sound.get(), name))
                 {
-                    // Now the sound exists in cache with no data yet. We'll fill in later
-                    sounds_[name] = new_sound;
+                    // Now the sound exists in cache with no data yet, unless streamed. We'll fill in later
+                    AddToCache(new_sound);
                     return new_sound;
                 }
             }
@@ -428,7 +458,7 @@ namespace OpenALAudio
             if (asset_service)
             {
                 SoundPtr new_sound(new Sound(name));
-                sounds_[name] = new_sound;
+                AddToCache(new_sound);
                 
                 // The sound will be filled with data later
                 asset_service->RequestAsset(name, RexTypes::ASSETTYPENAME_SOUNDVORBIS);
@@ -448,31 +478,136 @@ namespace OpenALAudio
         if (update_time_ < CACHE_CHECK_INTERVAL)
             return;
         
-        uint total_size = 0;
-        SoundMap::iterator oldest_sound = sounds_.end();
-        f64 oldest_age = 0.0;
+        // Sounds that were playing when the cache went over budget may be free now
+        if (cached_size_ > sound_cache_size_)
+            TrimCache();
+        
+        update_time_ = 0.0;
+    }
+    
+    void SoundSystem::AddToCache(const SoundPtr& sound)
+    {
+        CachedSound& cached = sounds_[sound->GetName()];
+        cached.sound_ = sound;
+        cached.size_ = sound->GetSize();
+        cached.lru_ = sounds_lru_.insert(sounds_lru_.end(), sound->GetName());
+        cached_size_ += cached.size_;
+        
+        if (cached_size_ > sound_cache_size_)
+            TrimCache();
+    }
+    
+    void SoundSystem::TouchSound(SoundMap::iterator i)
+    {
+        sounds_lru_.splice(sounds_lru_.end(), sounds_lru_, i->second.lru_);
+    }
+    
+    void SoundSystem::UpdateCachedSize(const std::string& name)
+    {
+        SoundMap::iterator i = sounds_.find(name);
+        if (i == sounds_.end())
+            return;
+        
+        cached_size_ -= i->second.size_;
+        i->second.size_ = i->second.sound_->GetSize();
+        cached_size_ += i->second.size_;
         
-        SoundMap::iterator i = sounds_.begin();
-        while (i != sounds_.end())
+        if (cached_size_ > sound_cache_size_)
+            TrimCache();
+    }
+    
+    void SoundSystem::TrimCache()
+    {
+        // Visit each sound at most once. Sounds that are kept are moved to the most recently used end
+        uint count = sounds_lru_.size();
+        while ((cached_size_ > sound_cache_size_) && (count--))
         {
-            i->second->AddAge(update_time_);   
-            total_size += i->second->GetSize();
-            // Don't erase zero size sounds, because they haven't been created yet and are probably waiting for assetdata
-            if ((i->second->GetAge() >= oldest_age) && (i->second->GetSize()))
+            SoundMap::iterator i = sounds_.find(sounds_lru_.front());
+            // Don't erase zero size sounds, because they haven't been created yet and are probably waiting for
+            // assetdata. Sounds referenced by channels are still playing
+            if ((!i->second.size_) || (!i->second.sound_.unique()))
             {
-                oldest_age = i->second->GetAge();
-                oldest_sound = i;
+                TouchSound(i);
+                continue;
             }
-            ++i;
+            
+            cached_size_ -= i->second.size_;
+            sounds_lru_.pop_front();
+            sounds_.erase(i);
         }
-
-        if (total_size > sound_cache_size_)
+    }
+    
+    void SoundSystem::AddToCompressedCache(const std::string& name, CompressedDataPtr data)
+    {
+        if ((!data) || (data->size() > compressed_sound_cache_size_))
+            return;
+        
+        CompressedSoundMap::iterator i = compressed_sounds_.find(name);
+        if (i != compressed_sounds_.end())
         {
-            if (oldest_sound != sounds_.end())
-                sounds_.erase(oldest_sound);
+            compressed_cached_size_ -= i->second.data_->size();
+            compressed_sounds_lru_.splice(compressed_sounds_lru_.end(), compressed_sounds_lru_, i->second.lru_);
+            i->second.data_ = data;
         }
+        else
+        {
+            CompressedSound& compressed = compressed_sounds_[name];
+            compressed.data_ = data;
+            compressed.lru_ = compressed_sounds_lru_.insert(compressed_sounds_lru_.end(), name);
+        }
+        compressed_cached_size_ += data->size();
         
-        update_time_ = 0.0;
+        TrimCompressedCache();
+    }
+    
+    void SoundSystem::TrimCompressedCache()
+    {
+        while ((compressed_cached_size_ > compressed_sound_cache_size_) && (!compressed_sounds_lru_.empty()))
+        {
+            CompressedSoundMap::iterator i = compressed_sounds_.find(compressed_sounds_lru_.front());
+            compressed_cached_size_ -= i->second.data_->size();
+            compressed_sounds_lru_.pop_front();
+            compressed_sounds_.erase(i);
+        }
+    }
+    
+    SoundPtr SoundSystem::LoadFromCompressedCache(const std::string& name)
+    {
+        CompressedSoundMap::iterator i = compressed_sounds_.find(name);
+        if (i == compressed_sounds_.end())
+            return SoundPtr();
+        
+        compressed_sounds_lru_.splice(compressed_sounds_lru_.end(), compressed_sounds_lru_, i->second.lru_);
+        
+        SoundPtr new_sound(new Sound(name));
+        CompressedDataPtr data = i->second.data_;
+        if (IsStreamedSize(data->size()))
+            new_sound->LoadCompressed(data);
+        else
+        {
+            VorbisDecodeRequestPtr new_request(new VorbisDecodeRequest());
+            new_request->name_ = name;
+            new_request->buffer_ = *data;
+            framework_->GetThreadTaskManager()->AddRequest("VorbisDecoder", new_request);
+        }
+        
+        AddToCache(new_sound);
+        return new_sound;
+    }
+    
+    SoundCacheStats SoundSystem::GetCacheStats() const
+    {
+        SoundCacheStats stats = cache_stats_;
+        stats.sounds_ = sounds_.size();
+        stats.size_ = cached_size_;
+        stats.compressed_sounds_ = compressed_sounds_.size();
+        stats.compressed_size_ = compressed_cached_size_;
+        return stats;
+    }
+    
+    bool SoundSystem::IsStreamedSize(uint size) const
+    {
+        return (stream_threshold_) && (size > stream_threshold_);
     }
     
     bool SoundSystem::DecodeLocalOggFile(Sound* sound, const std::string& name)
@@ -485,16 +620,25 @@ namespace OpenALAudio
             return false;
         }
 
-        VorbisDecodeRequestPtr new_request(new VorbisDecodeRequest());
-        new_request->name_ = name;
-    
         std::filebuf *pbuf = file.rdbuf();
         size_t size = pbuf->pubseekoff(0, std::ios::end, std::ios::in);
-        new_request->buffer_.resize(size);
+        CompressedDataPtr data(new std::vector<u8>(size));
         pbuf->pubseekpos(0, std::ios::in);
-        pbuf->sgetn((char *)&new_request->buffer_[0], size);
+        pbuf->sgetn((char *)&(*data)[0], size);
         file.close();
         
+        AddToCompressedCache(name, data);
+        
+        // Long sounds are streamed from the compressed data
+        if (IsStreamedSize(size))
+        {
+            sound->LoadCompressed(data);
+            return true;
+        }
+        
+        VorbisDecodeRequestPtr new_request(new VorbisDecodeRequest());
+        new_request->name_ = name;
+        new_request->buffer_ = *data;
         framework_->GetThreadTaskManager()->AddRequest("VorbisDecoder", new_request);
         return true;
     }
@@ -503,6 +647,16 @@ namespace OpenALAudio
     {
         if (event_id != Task::Events::REQUEST_COMPLETED)
             return false;
+        
+        VorbisStreamResult* stream_result = dynamic_cast<VorbisStreamResult*>(data);
+        if (stream_result && stream_result->task_description_ == "VorbisDecoder")
+        {
+            SoundChannelMap::iterator i = channels_.find(stream_result->channel_);
+            if (i != channels_.end())
+                i->second->AddStreamData(*stream_result);
+            return true;
+        }
+        
         VorbisDecodeResult* result = dynamic_cast<VorbisDecodeResult*>(data);
         if (!result || result->task_description_ != "VorbisDecoder")
             return false;
@@ -544,12 +698,13 @@ namespace OpenALAudio
         if (i == sounds_.end())
             return false;
         // If sound already has data, do not stuff again
-        if (i->second->GetSize() != 0)
+        if (i->second.sound_->GetSize() != 0)
             return true;
         if (!result->buffer_.data_.size())
             return true;
         
-        i->second->LoadFromBuffer(result->buffer_);
+        i->second.sound_->LoadFromBuffer(result->buffer_);
+        UpdateCachedSize(result->name_);
         return true;
     }
     
@@ -577,8 +732,21 @@ namespace OpenALAudio
                 if (i == sounds_.end())
                     return false;
                 // If sound already has data, do not queue another decode request
-                if (i->second->GetSize() != 0)
+                if (i->second.sound_->GetSize() != 0)
                     return false;
+                
+                // Keep the compressed data for redecoding once the decoded sound is evicted
+                const u8* asset_data = event_data->asset_->GetData();
+                CompressedDataPtr data(new std::vector<u8>(asset_data, asset_data + event_data->asset_->GetSize()));
+                AddToCompressedCache(event_data->asset_id_, data);
+                
+                // Long sounds are streamed, keep only the compressed data
+                if (IsStreamedSize(data->size()))
+                {
+                    i->second.sound_->LoadCompressed(data);
+                    UpdateCachedSize(event_data->asset_id_);
+                    return false;
+                }
             }
             
             VorbisDecodeRequestPtr new_request(new VorbisDecodeRequest());
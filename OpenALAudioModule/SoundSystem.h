@@ -9,6 +9,8 @@
 #include <AL/al.h>
 #include <AL/alc.h>
 
+#include <list>
+
 namespace Foundation
 {
     class Framework;
@@ -18,9 +20,54 @@ namespace Foundation
 namespace OpenALAudio
 {
     typedef std::map<sound_id_t, SoundChannelPtr> SoundChannelMap;
-    typedef std::map<std::string, SoundPtr> SoundMap;
+    
+    //! Least recently used first order of cached sound names
+    typedef std::list<std::string> SoundLruList;
+    
+    //! Decoded (or streamed) sound in the sound cache
+    struct CachedSound
+    {
+        SoundPtr sound_;
+        //! Size the sound is accounted with in the cache
+        uint size_;
+        //! Position in the LRU list
+        SoundLruList::iterator lru_;
+    };
+    
+    //! Original ogg vorbis data of a sound, kept for redecoding without loading the asset again
+    struct CompressedSound
+    {
+        CompressedDataPtr data_;
+        //! Position in the LRU list
+        SoundLruList::iterator lru_;
+    };
+    
+    typedef std::map<std::string, CachedSound> SoundMap;
+    typedef std::map<std::string, CompressedSound> CompressedSoundMap;
+    
+    //! Sound cache statistics
+    struct SoundCacheStats
+    {
+        //! Sound requests served from decoded sounds
+        uint hits_;
+        //! Sound requests served by redecoding cached compressed data
+        uint compressed_hits_;
+        //! Sound requests that had to load the file or asset
+        uint misses_;
+        //! Number and total size of decoded sounds
+        uint sounds_;
+        uint size_;
+        //! Number and total size of compressed sounds
+        uint compressed_sounds_;
+        uint compressed_size_;
+    };
       
     //! Sound service implementation. Owned by OpenALAudioModule.
+    /*! Sounds are cached in two tiers. Decoded sounds are kept up to sound_cache_size bytes and evicted least
+        recently used first, except while channels are playing them. The original ogg vorbis data of loaded
+        sounds is kept up to compressed_sound_cache_size bytes, so an evicted sound is redecoded on the decoder
+        thread instead of being loaded again. Streamed sounds share their data with the compressed tier.
+     */
     class SoundSystem : public Foundation::SoundServiceInterface
     {
     public:
@@ -210,6 +257,9 @@ namespace OpenALAudio
         
         //! Returns initialized status
         bool IsInitialized() const { return initialized_; }
+        
+        //! Returns sound cache statistics
+        SoundCacheStats GetCacheStats() const;
 
     private:
         //! Uninitialize OpenAL sound
@@ -229,10 +279,30 @@ namespace OpenALAudio
         /* \return true if file could be found & decode initiated. This does not yet tell if the data is valid, though
          */
         bool DecodeLocalOggFile(Sound* sound, const std::string& name);
+        //! Return whether ogg vorbis data of given size should be streamed instead of decoded whole
+        bool IsStreamedSize(uint size) const;
         
-        //! Update sound cache. Ages sounds and removes oldest if cache too big
+        //! Update sound cache. Periodically evicts sounds that were in use while the cache was over budget
         void UpdateCache(f64 frametime);
         
+        //! Add a new sound to the decoded cache as the most recently used
+        void AddToCache(const SoundPtr& sound);
+        //! Mark a cached sound as the most recently used
+        void TouchSound(SoundMap::iterator i);
+        //! Reaccount the size of a cached sound after its data has changed, and evict if over budget
+        void UpdateCachedSize(const std::string& name);
+        //! Evict least recently used decoded sounds until within budget. Sounds in use or still loading are kept
+        void TrimCache();
+        
+        //! Keep the ogg vorbis data of a sound in the compressed cache
+        void AddToCompressedCache(const std::string& name, CompressedDataPtr data);
+        //! Evict least recently used compressed data until within budget
+        void TrimCompressedCache();
+        //! Create a sound from cached compressed data, posting a decode request unless it is streamed
+        /*! \return Null if the sound is not in the compressed cache
+         */
+        SoundPtr LoadFromCompressedCache(const std::string& name);
+        
         //! Framework
         Foundation::Framework* framework_;
         //! Initialized flag
@@ -249,8 +319,24 @@ namespace OpenALAudio
         SoundChannelMap channels_;
         //! Currently loaded sounds
         SoundMap sounds_;
+        //! Decoded sounds, least recently used first
+        SoundLruList sounds_lru_;
+        //! Compressed data of recently loaded sounds
+        CompressedSoundMap compressed_sounds_;
+        //! Compressed sounds, least recently used first
+        SoundLruList compressed_sounds_lru_;
         //! Sound cache size
         uint sound_cache_size_;
+        //! Compressed sound cache size
+        uint compressed_sound_cache_size_;
+        //! Total size of decoded sounds
+        uint cached_size_;
+        //! Total size of compressed sounds
+        uint compressed_cached_size_;
+        //! Sound cache statistics
+        SoundCacheStats cache_stats_;
+        //! Compressed size above which sounds are streamed, 0 to never stream
+        uint stream_threshold_;
         //! Update timer (for cache)
         f64 update_time_;
         //! Next channel id
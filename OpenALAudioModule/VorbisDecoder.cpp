@@ -97,7 +97,8 @@ namespace OpenALAudio
         {
             WaitForRequests();
             
-            VorbisDecodeRequestPtr request = GetNextRequest<VorbisDecodeRequest>();
+            Foundation::ThreadTaskRequestPtr next = GetNextRequest();
+            VorbisDecodeRequestPtr request = boost::dynamic_pointer_cast<VorbisDecodeRequest>(next);
             if (request)
             {
                 {
@@ -105,6 +106,15 @@ namespace OpenALAudio
                     PerformDecode(request);
                 }
             }
+            
+            VorbisStreamRequestPtr stream_request = boost::dynamic_pointer_cast<VorbisStreamRequest>(next);
+            if (stream_request)
+            {
+                {
+                    PROFILE(VorbisDecoder_StreamDecode);
+                    PerformStreamDecode(stream_request);
+                }
+            }
 
             RESETPROFILER
         }
@@ -178,4 +188,131 @@ namespace OpenALAudio
         ov_clear(&vf);
         QueueResult<VorbisDecodeResult>(result);
     }
+    
+    void VorbisDecoder::PerformStreamDecode(VorbisStreamRequestPtr request)
+    {
+        if (!request || !request->stream_)
+            return;
+        
+        VorbisStreamResultPtr result(new VorbisStreamResult());
+        result->channel_ = request->channel_;
+        result->stream_ = request->stream_;
+        result->ended_ = false;
+        result->chunks_.reserve(request->chunks_);
+        
+        for (uint i = 0; i < request->chunks_; ++i)
+        {
+            result->chunks_.push_back(Foundation::SoundServiceInterface::SoundBuffer());
+            Foundation::SoundServiceInterface::SoundBuffer& chunk = result->chunks_.back();
+            if (!request->stream_->Decode(chunk, request->chunk_size_, request->looped_))
+            {
+                if (!chunk.data_.size())
+                    result->chunks_.pop_back();
+                result->ended_ = true;
+                break;
+            }
+        }
+        
+        QueueResult<VorbisStreamResult>(result);
+    }
+    
+    VorbisStream::VorbisStream(CompressedDataPtr data) :
+        data_(data),
+        source_(0),
+        vf_(0),
+        frequency_(0),
+        stereo_(false),
+        open_(false),
+        failed_(false)
+    {
+    }
+    
+    VorbisStream::~VorbisStream()
+    {
+        if (vf_)
+        {
+            if (open_)
+                ov_clear(vf_);
+            delete vf_;
+        }
+        delete source_;
+    }
+    
+    bool VorbisStream::Open()
+    {
+        if (open_)
+            return true;
+        if (failed_ || !data_ || !data_->size())
+            return false;
+        
+        source_ = new OggMemDataSource(&(*data_)[0], data_->size());
+        vf_ = new OggVorbis_File;
+        
+        ov_callbacks cb;
+        cb.read_func = &OggReadCallback;
+        cb.seek_func = &OggSeekCallback;
+        cb.tell_func = &OggTellCallback;
+        cb.close_func = 0;
+        
+        if (ov_open_callbacks(source_, vf_, 0, 0, cb) < 0)
+        {
+            OpenALAudioModule::LogError("Not ogg vorbis format");
+            failed_ = true;
+            return false;
+        }
+        open_ = true;
+        
+        vorbis_info* vi = ov_info(vf_, -1);
+        if (!vi)
+        {
+            OpenALAudioModule::LogError("No ogg vorbis stream info");
+            failed_ = true;
+            return false;
+        }
+        
+        std::ostringstream msg;
+        msg << "Streaming ogg vorbis stream with " << vi->channels << " channels, frequency " << vi->rate; 
+        OpenALAudioModule::LogDebug(msg.str()); 
+        
+        frequency_ = vi->rate;
+        stereo_ = (vi->channels == 2);
+        return true;
+    }
+    
+    bool VorbisStream::Decode(Foundation::SoundServiceInterface::SoundBuffer& buffer, uint size, bool looped)
+    {
+        buffer.data_.clear();
+        if (!Open() || failed_)
+            return false;
+        
+        buffer.frequency_ = frequency_;
+        buffer.sixteenbit_ = true;
+        buffer.stereo_ = stereo_;
+        buffer.data_.resize(size);
+        
+        uint decoded_bytes = 0;
+        bool rewound = false;
+        while (decoded_bytes < size)
+        {
+            int bitstream;
+            long ret = ov_read(vf_, (char*)&buffer.data_[decoded_bytes], size - decoded_bytes, 0, 2, 1, &bitstream);
+            if (ret == OV_HOLE)
+                continue;
+            if (ret < 0)
+                break;
+            if (ret == 0)
+            {
+                // End of stream. Rewind if looping, unless the stream is empty
+                if (!looped || rewound || ov_pcm_seek(vf_, 0) != 0)
+                    break;
+                rewound = true;
+                continue;
+            }
+            rewound = false;
+            decoded_bytes += ret;
+        }
+        
+        buffer.data_.resize(decoded_bytes);
+        return decoded_bytes == size;
+    }
 }
\ No newline at end of file
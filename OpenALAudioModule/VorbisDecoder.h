@@ -4,9 +4,90 @@
 
 #include "SoundServiceInterface.h"
 #include "ThreadTask.h"
+#include "Sound.h"
+
+struct OggVorbis_File;
 
 namespace OpenALAudio
 {
+    class OggMemDataSource;
+    
+    //! Incremental decoder state of one streamed ogg vorbis sound
+    /*! Only accessed from the VorbisDecoder thread once created. The compressed data is shared with the
+        Sound it came from, so the stream stays valid even if the sound is dropped from the cache.
+     */
+    class VorbisStream
+    {
+    public:
+        //! Constructor
+        /*! \param data Ogg vorbis datastream
+         */
+        VorbisStream(CompressedDataPtr data);
+        //! Destructor
+        ~VorbisStream();
+        
+        //! Decode the next chunk of the stream
+        /*! \param buffer Buffer to receive the decoded 16bit data and format
+            \param size Maximum amount of bytes to decode
+            \param looped Whether to continue from start once the end is reached
+            \return false if the stream ended or could not be decoded
+         */
+        bool Decode(Foundation::SoundServiceInterface::SoundBuffer& buffer, uint size, bool looped);
+        
+    private:
+        //! Open the vorbis stream on first decode
+        bool Open();
+        
+        //! Ogg vorbis datastream
+        CompressedDataPtr data_;
+        //! Read position into the datastream
+        OggMemDataSource* source_;
+        //! Vorbisfile state
+        OggVorbis_File* vf_;
+        //! Frequency of the stream
+        uint frequency_;
+        //! Stereo flag of the stream
+        bool stereo_;
+        //! Opened flag
+        bool open_;
+        //! Failed flag, set if stream could not be opened
+        bool failed_;
+    };
+    
+    typedef boost::shared_ptr<VorbisStream> VorbisStreamPtr;
+    
+    //! Request to decode more data of a streamed sound
+    class VorbisStreamRequest : public Foundation::ThreadTaskRequest
+    {
+    public:
+        //! Channel the data is for
+        sound_id_t channel_;
+        //! Stream to decode
+        VorbisStreamPtr stream_;
+        //! Number of chunks to decode
+        uint chunks_;
+        //! Size of one chunk in bytes
+        uint chunk_size_;
+        //! Whether to continue from start once the end is reached
+        bool looped_;
+    };
+    
+    class VorbisStreamResult : public Foundation::ThreadTaskResult
+    {
+    public:
+        //! Channel the data is for
+        sound_id_t channel_;
+        //! Stream that was decoded, used to check that the channel still plays it
+        VorbisStreamPtr stream_;
+        //! Decoded chunks, each to be queued as one OpenAL buffer
+        std::vector<Foundation::SoundServiceInterface::SoundBuffer> chunks_;
+        //! Whether the stream ended
+        bool ended_;
+    };
+    
+    typedef boost::shared_ptr<VorbisStreamRequest> VorbisStreamRequestPtr;
+    typedef boost::shared_ptr<VorbisStreamResult> VorbisStreamResultPtr;
+
     //! Ogg vorbis decode request
     class VorbisDecodeRequest : public Foundation::ThreadTaskRequest
     {
@@ -31,7 +112,7 @@ namespace OpenALAudio
     typedef boost::shared_ptr<VorbisDecodeRequest> VorbisDecodeRequestPtr;
     typedef boost::shared_ptr<VorbisDecodeResult> VorbisDecodeResultPtr;
 
-    //! Ogg Vorbis decoder that runs in a thread and serves decode requests, used by SoundSystem
+    //! Ogg Vorbis decoder that runs in a thread and serves decode & stream requests, used by SoundSystem
     class VorbisDecoder : public Foundation::ThreadTask
     {
     public:
@@ -47,6 +128,11 @@ namespace OpenALAudio
          */
         void PerformDecode(VorbisDecodeRequestPtr request);
         
+        //! decode next chunks of a stream & queue result
+        /*! \param request stream request to serve
+         */
+        void PerformStreamDecode(VorbisStreamRequestPtr request);
+        
         uint decodes_per_frame_;
     };
 }
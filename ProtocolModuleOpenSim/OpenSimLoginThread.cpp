@@ -14,6 +14,7 @@
 #include "OpenSim/BuddyListParser.h"
 #include "Inventory/InventoryParser.h"
 #include "Inventory/InventorySkeleton.h"
+#include "Login/LoginReplyParser.h"
 #include "Md5.h"
 #include "Framework.h"
 #include "ConfigurationManager.h"
@@ -236,9 +237,16 @@ namespace OpenSimProtocol
         //           SEND CALL             //
         /////////////////////////////////////
 
+        // The login_to_simulator reply carries the whole inventory skeleton, so it is read with the streaming parser
+        // instead of building the xmlrpc-epi value tree.
+        std::vector<u8> rawReply;
+        LoginReplyParser reply(threadState_->parameters);
         try
         {
-            call.Send();
+            if (callMethod_ == LOGIN_TO_SIMULATOR)
+                call.SendRaw(rawReply);
+            else
+                call.Send();
         }
         catch(XmlRpcException& ex)
         {
@@ -256,24 +264,18 @@ namespace OpenSimProtocol
 
         try
         {
+            if (callMethod_ == LOGIN_TO_SIMULATOR)
+                reply.Parse((const char *)&rawReply[0], (int)rawReply.size());
+
             if (authentication_ == OPENSIM_AUTHENTICATION && callMethod_ == LOGIN_TO_SIMULATOR)
             {
-                // Grid url, Session ID, Agent ID, Cirtuit Code, Seed Caps
-                threadState_->parameters.sessionID.FromString(call.GetReply<std::string>("session_id"));
-                threadState_->parameters.agentID.FromString(call.GetReply<std::string>("agent_id"));
-                threadState_->parameters.circuitCode = call.GetReply<int>("circuit_code");
-                threadState_->parameters.seedCapabilities = call.GetReply<std::string>("seed_capability");
-                threadState_->parameters.gridUrl = GridParser::ExtractGridAddressFromXMLRPCReply(call);
-
-                if (call.HasReply("webdav_inventory"))
-                    threadState_->parameters.webdavInventoryUrl = call.GetReply<std::string>("webdav_inventory");
+                // Grid url, Session ID, Agent ID, Cirtuit Code, Seed Caps, Webdav inventory and region coordinates
+                // were filled by the parser. Check that the mandatory ones were present.
+                reply.GetValue("session_id");
+                reply.GetValue("agent_id");
+                reply.GetValue("circuit_code");
+                reply.GetValue("seed_capability");
 
-                if (call.HasReply("region_x") && call.HasReply("region_y"))
-                {
-                    threadState_->parameters.regionX = static_cast<uint16_t>((call.GetReply<long>("region_x"))/256);
-                    threadState_->parameters.regionY = static_cast<uint16_t>((call.GetReply<long>("region_y"))/256);
-                }
-                
                 if (threadState_->parameters.gridUrl.size() == 0)
                     throw XmlRpcException("Failed to extract sim_ip and sim_port from login_to_simulator reply!");
                 if (threadState_->parameters.sessionID.ToString() == std::string("") ||
@@ -284,7 +286,7 @@ namespace OpenSimProtocol
                 // Inventory
                 try
                 {
-                    threadState_->parameters.inventory = InventoryParser::ExtractInventoryFromXMLRPCReply(call);
+                    threadState_->parameters.inventory = reply.ExtractInventory();
                 }
                 catch (XmlRpcException &e)
                 {
@@ -293,16 +295,7 @@ namespace OpenSimProtocol
                     InventoryParser::SetErrorFolder(threadState_->parameters.inventory->GetRoot());
                 }
 
-                // Buddy List
-                try
-                {
-                    threadState_->parameters.buddy_list = BuddyListParser::ExtractBuddyListFromXMLRPCReply(call);
-                }
-                catch (XmlRpcException &e)
-                {
-                    ProtocolModuleOpenSim::LogWarning(QString("Failed to read buddy list: %1").arg(e.what()).toStdString());
-                    threadState_->parameters.buddy_list = BuddyListPtr(new BuddyList());
-                }
+                // Buddy List was filled by the parser.
             }
             else if (authentication_ == REALXTEND_AUTHENTICATION && callMethod_ == CLIENT_AUTHENTICATION) 
             {
@@ -315,27 +308,22 @@ namespace OpenSimProtocol
             }
             else if (authentication_ == REALXTEND_AUTHENTICATION && callMethod_ == LOGIN_TO_SIMULATOR)
             {
-                // Grid url, Session ID, Agent ID, Cirtuit Code, Seed Caps
-                threadState_->parameters.sessionID.FromString(call.GetReply<std::string>("session_id"));
-                threadState_->parameters.agentID.FromString(call.GetReply<std::string>("agent_id"));
-                threadState_->parameters.circuitCode = call.GetReply<int>("circuit_code");
-                threadState_->parameters.seedCapabilities = call.GetReply<std::string>("seed_capability");
-                if (call.HasReply("region_x") && call.HasReply("region_y"))
-                {
-                    threadState_->parameters.regionX = static_cast<uint16_t>((call.GetReply<long>("region_x"))/256);
-                    threadState_->parameters.regionY = static_cast<uint16_t>((call.GetReply<long>("region_y"))/256);
-                }
+                // Grid url, Session ID, Agent ID, Cirtuit Code, Seed Caps and region coordinates were filled by the parser.
+                reply.GetValue("session_id");
+                reply.GetValue("agent_id");
+                reply.GetValue("circuit_code");
+                reply.GetValue("seed_capability");
+
                 ///\bug related to one 10 lines above. instead of using port defined in authentication server, 
                 /// use the one given by simulator.
                 /// Does this still apply? -jj. Is this a bug in the rex auth server? If so, flag as a workaround or something similar.
-                threadState_->parameters.gridUrl = GridParser::ExtractGridAddressFromXMLRPCReply(call);
                 if (threadState_->parameters.gridUrl.size() == 0)
                     throw XmlRpcException("Failed to extract sim_ip and sim_port from login_to_simulator reply!");
 
                 // Inventory
                 try
                 {
-                    threadState_->parameters.inventory = InventoryParser::ExtractInventoryFromXMLRPCReply(call);
+                    threadState_->parameters.inventory = reply.ExtractInventory();
                 }
                 catch(XmlRpcException &e)
                 {
@@ -344,16 +332,7 @@ namespace OpenSimProtocol
                     InventoryParser::SetErrorFolder(threadState_->parameters.inventory->GetRoot());
                 }
 
-                // Buddy List
-                try
-                {
-                    threadState_->parameters.buddy_list = BuddyListParser::ExtractBuddyListFromXMLRPCReply(call);
-                }
-                catch(XmlRpcException &e)
-                {
-                    ProtocolModuleOpenSim::LogWarning(QString("Failed to read buddy list: %1").arg(e.what()).toStdString());
-                    threadState_->parameters.buddy_list = BuddyListPtr(new BuddyList());
-                }
+                // Buddy List was filled by the parser.
             }
             else
                 throw XmlRpcException(QString("Undefined login method %1 at parsing call results in PerformXMLRPCLogin()").arg(callMethod_.c_str()).toStdString());
@@ -363,7 +342,10 @@ namespace OpenSimProtocol
             ProtocolModuleOpenSim::LogError(QString("Login procedure threw a XMLRPCException >>> Reason: %1").arg(ex.what()).toStdString());
             try
             {
-                threadState_->errorMessage = call.GetReply<std::string>("message");
+                if (callMethod_ == LOGIN_TO_SIMULATOR)
+                    threadState_->errorMessage = reply.GetValue("message");
+                else
+                    threadState_->errorMessage = call.GetReply<std::string>("message");
                 ProtocolModuleOpenSim::LogError(QString(">>> Message: %1").arg(QString(threadState_->errorMessage.c_str())).toStdString());
             }
             catch (XmlRpcException &/*ex*/)
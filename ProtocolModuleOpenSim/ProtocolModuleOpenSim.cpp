@@ -11,10 +11,14 @@
 #include "ModuleManager.h"
 #include "RealXtend/RexProtocolMsgIDs.h"
 #include "HttpRequest.h"
+#include "CoreStringUtils.h"
 
 #include <Poco/Net/NetException.h>
 #include <Poco/ClassLibrary.h>
 
+#include <map>
+#include <functional>
+
 #include <QUrl>
 #include <QStringList>
 
@@ -26,7 +30,9 @@ namespace OpenSimProtocol
     ProtocolModuleOpenSim::ProtocolModuleOpenSim() :
         ModuleInterfaceImpl(Foundation::Module::MT_OpenSimProtocol),
         connected_(false),
-        authenticationType_(ProtocolUtilities::AT_Unknown)
+        authenticationType_(ProtocolUtilities::AT_Unknown),
+        exitAfterReplay_(false),
+        replayReported_(false)
     {
     }
 
@@ -127,6 +133,17 @@ namespace OpenSimProtocol
                     DisconnectFromServer();
                 }
             }
+
+            if (connected_ && !replayReported_ && networkManager_->IsReplaying() &&
+                networkManager_->GetReplayConnection()->IsFinished())
+            {
+                replayReported_ = true;
+                StringVector report = GetReplayReport();
+                for(size_t i = 0; i < report.size(); ++i)
+                    LogInfo(report[i]);
+                if (exitAfterReplay_)
+                    framework_->Exit();
+            }
         }
         RESETPROFILER;
     }
@@ -171,22 +188,33 @@ namespace OpenSimProtocol
             loginWorker_.SetConnectionState(ProtocolUtilities::Connection::STATE_CONNECTED);
             connected_ = true;
 
+            if (!captureFilename_.empty() && !networkManager_->IsReplaying())
+            {
+                if (networkManager_->StartCapture(captureFilename_, clientParameters_))
+                    LogInfo("Recording inbound network traffic to " + captureFilename_);
+                else
+                    LogError("Could not create network trace file " + captureFilename_);
+            }
+
             // Send event indicating a succesfull connection
-            ProtocolUtilities::AuthenticationEventData auth_data(authenticationType_, "", loginWorker_.GetClientParameters().gridUrl);
-            auth_data.inventorySkeleton = loginWorker_.GetClientParameters().inventory;
+            ProtocolUtilities::AuthenticationEventData auth_data(authenticationType_, "", clientParameters_.gridUrl);
+            auth_data.inventorySkeleton = clientParameters_.inventory;
 
             // Fill in webdav information if exists
-            if (loginWorker_.GetClientParameters().webdavInventoryUrl != "")
+            if (clientParameters_.webdavInventoryUrl != "")
             {
-                auth_data.webdav_host = loginWorker_.GetClientParameters().webdavInventoryUrl;
+                auth_data.webdav_host = clientParameters_.webdavInventoryUrl;
                 auth_data.webdav_identity = loginWorker_.GetUsername();
                 auth_data.webdav_password = loginWorker_.GetPassword();
                 auth_data.type = ProtocolUtilities::AT_Taiga;
             }
             eventManager_->SendEvent(networkStateEventCategory_, ProtocolUtilities::Events::EVENT_SERVER_CONNECTED, &auth_data);
 
-            // Request capabilities from the server.
-            Thread thread(boost::bind(&ProtocolModuleOpenSim::RequestCapabilities, this, GetClientParameters().seedCapabilities));
+            // Request capabilities from the server. There is no server to ask when playing back a trace.
+            if (!networkManager_->IsReplaying())
+            {
+                Thread thread(boost::bind(&ProtocolModuleOpenSim::RequestCapabilities, this, GetClientParameters().seedCapabilities));
+            }
             return true;
         }
         else
@@ -212,6 +240,68 @@ namespace OpenSimProtocol
         eventManager_->SendEvent(networkStateEventCategory_, ProtocolUtilities::Events::EVENT_SERVER_DISCONNECTED, 0);
     }
 
+    bool ProtocolModuleOpenSim::StartReplay(const std::string &filename, double speed, bool exitWhenFinished)
+    {
+        if (!networkManager_)
+        {
+            LogError("Network events must be registered before playing back a trace.");
+            return false;
+        }
+
+        if (connected_)
+        {
+            LogError("Can not play back a trace while connected.");
+            return false;
+        }
+
+        boost::shared_ptr<ProtocolUtilities::TraceConnection> replay(new ProtocolUtilities::TraceConnection(speed));
+        if (!replay->Load(filename))
+        {
+            LogError("Could not load network trace " + filename);
+            return false;
+        }
+
+        LogInfo("Playing back network trace " + filename + " with " + ToString(replay->GetDatagramCount()) + " datagrams.");
+
+        // The trace has no login reply, so services that need one, such as the inventory, stay disabled.
+        clientParameters_ = replay->GetClientParameters();
+        authenticationType_ = ProtocolUtilities::AT_Unknown;
+        exitAfterReplay_ = exitWhenFinished;
+        replayReported_ = false;
+        networkManager_->SetReplayConnection(replay);
+        loginWorker_.SetConnectionState(ProtocolUtilities::Connection::STATE_INIT_UDP);
+        return true;
+    }
+
+    StringVector ProtocolModuleOpenSim::GetReplayReport() const
+    {
+        StringVector report;
+        if (!networkManager_ || !networkManager_->IsReplaying())
+            return report;
+
+        boost::shared_ptr<ProtocolUtilities::TraceConnection> replay = networkManager_->GetReplayConnection();
+        report.push_back("Played back " + ToString(replay->GetReplayedCount()) + " of " + ToString(replay->GetDatagramCount()) +
+            " datagrams in " + ToString(replay->GetReplayTime()) + " seconds.");
+
+        // Sort the message types by the total time spent handling them.
+        typedef std::multimap<double, ProtocolUtilities::NetMsgID, std::greater<double> > TimeSortedMap;
+        TimeSortedMap sorted;
+        const ProtocolUtilities::TraceConnection::HandlingTimeMap &times = replay->GetHandlingTimes();
+        for(ProtocolUtilities::TraceConnection::HandlingTimeMap::const_iterator iter = times.begin(); iter != times.end(); ++iter)
+            sorted.insert(std::make_pair(iter->second.seconds, iter->first));
+
+        report.push_back("Message, count, total ms, average us:");
+        for(TimeSortedMap::const_iterator iter = sorted.begin(); iter != sorted.end(); ++iter)
+        {
+            const ProtocolUtilities::TraceHandlingTime &time = times.find(iter->second)->second;
+            const ProtocolUtilities::NetMessageInfo *info = networkManager_->GetMessageInfoByID(iter->second);
+            report.push_back((info ? info->name : ToString(iter->second)) + ", " + ToString(time.count) + ", " +
+                ToString(time.seconds * 1000.0) + ", " + ToString(time.seconds * 1000000.0 / time.count));
+        }
+
+        return report;
+    }
+
     void ProtocolModuleOpenSim::DumpNetworkMessage(ProtocolUtilities::NetMsgID id, ProtocolUtilities::NetInMessage *msg)
     {
         networkManager_->DumpNetworkMessage(id, msg);
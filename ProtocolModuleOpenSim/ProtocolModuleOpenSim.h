@@ -123,6 +123,27 @@ namespace OpenSimProtocol
 
         virtual ProtocolUtilities::NetMessageManager *GetNetworkMessageManager() { return networkManager_.get(); }
 
+        /// Sets the file the inbound datagrams of the next connections are recorded to. Empty disables recording.
+        /// The recorded trace can be played back with StartReplay.
+        void SetCaptureFilename(const std::string &filename) { captureFilename_ = filename; }
+
+        /// @return The file the inbound datagrams are recorded to, or empty if recording is disabled.
+        const std::string &GetCaptureFilename() const { return captureFilename_; }
+
+        /// Connects to a recorded trace instead of a server. The network events must be registered, and the
+        /// connection is created the same way as after a login, but the inbound messages come from the trace and
+        /// outbound messages are discarded. When all datagrams have been played back, the time spent handling each
+        /// type of inbound message is logged.
+        /// @param filename Trace file recorded with SetCaptureFilename.
+        /// @param speed Playback speed relative to the recording, or 0 to play back as fast as the messages are handled.
+        /// @param exitWhenFinished If true, exits the framework after the trace has been played back.
+        /// @return True if the trace could be loaded.
+        bool StartReplay(const std::string &filename, double speed, bool exitWhenFinished);
+
+        /// @return Lines describing the progress of the playback and the time spent handling each type of inbound
+        ///         message, or empty if no trace is being played back.
+        StringVector GetReplayReport() const;
+
     private:
         ProtocolModuleOpenSim(const ProtocolModuleOpenSim &);
         void operator=(const ProtocolModuleOpenSim &);
@@ -171,6 +192,15 @@ namespace OpenSimProtocol
 
         /// Server-spesific capabilities.
         caps_map_t capabilities_;
+
+        /// File the inbound datagrams are recorded to.
+        std::string captureFilename_;
+
+        /// Exit the framework when the trace being played back has finished.
+        bool exitAfterReplay_;
+
+        /// The report of the trace has been logged.
+        bool replayReported_;
     };
     /// @}
 }
@@ -14,6 +14,7 @@
 #include "OpenSim/BuddyListParser.h"
 #include "Inventory/InventoryParser.h"
 #include "Inventory/InventorySkeleton.h"
+#include "Login/LoginReplyParser.h"
 #include "Md5.h"
 #include "Platform.h"
 #include "Framework.h"
@@ -132,9 +133,12 @@ namespace TaigaProtocol
         //           SEND CALL             //
         /////////////////////////////////////
 
+        // The reply carries the whole inventory skeleton, so it is read with the streaming parser.
+        std::vector<u8> rawReply;
+        LoginReplyParser reply(threadState_->parameters);
         try
         {
-            call.Send();
+            call.SendRaw(rawReply);
         }
         catch (XmlRpcException& ex)
         {
@@ -149,15 +153,12 @@ namespace TaigaProtocol
 
         try
         {
-            // Grid url, Session ID, Agent ID, Cirtuit Code, Seed Caps
-            threadState_->parameters.sessionID.FromString(call.GetReply<std::string>("session_id"));
-            threadState_->parameters.agentID.FromString(call.GetReply<std::string>("agent_id"));
-            threadState_->parameters.circuitCode = call.GetReply<int>("circuit_code");
-            threadState_->parameters.seedCapabilities = call.GetReply<std::string>("seed_capability");
-            threadState_->parameters.gridUrl = GridParser::ExtractGridAddressFromXMLRPCReply(call);
-
-            if (call.HasReply("webdav_inventory"))
-                threadState_->parameters.webdavInventoryUrl = call.GetReply<std::string>("webdav_inventory");
+            // Grid url, Session ID, Agent ID, Cirtuit Code, Seed Caps and Webdav inventory are filled by the parser.
+            reply.Parse((const char *)&rawReply[0], (int)rawReply.size());
+            reply.GetValue("session_id");
+            reply.GetValue("agent_id");
+            reply.GetValue("circuit_code");
+            reply.GetValue("seed_capability");
 
             if (threadState_->parameters.gridUrl.size() == 0)
                 throw XmlRpcException("Failed to extract sim_ip and sim_port from login_to_simulator reply!");
@@ -169,7 +170,7 @@ namespace TaigaProtocol
             // Inventory
             try
             {
-                threadState_->parameters.inventory = InventoryParser::ExtractInventoryFromXMLRPCReply(call);
+                threadState_->parameters.inventory = reply.ExtractInventory();
             }
             catch (XmlRpcException &e)
             {
@@ -178,23 +179,14 @@ namespace TaigaProtocol
                 InventoryParser::SetErrorFolder(threadState_->parameters.inventory->GetRoot());
             }
 
-            // Buddy List
-            try
-            {
-                threadState_->parameters.buddy_list = BuddyListParser::ExtractBuddyListFromXMLRPCReply(call);
-            }
-            catch (XmlRpcException &e)
-            {
-                ProtocolModuleTaiga::LogWarning(QString("Failed to read buddy list: %1").arg(e.what()).toStdString());
-                threadState_->parameters.buddy_list = BuddyListPtr(new BuddyList());
-            }
+            // Buddy List was filled by the parser.
         }
         catch(XmlRpcException& ex)
         {
             ProtocolModuleTaiga::LogError(QString("Login procedure threw a XMLRPCException >>> Reason: %1").arg(ex.what()).toStdString());
             try
             {
-                threadState_->errorMessage = call.GetReply<std::string>("message");
+                threadState_->errorMessage = reply.GetValue("message");
                 ProtocolModuleTaiga::LogError(QString(">>> Message: %1").arg(QString(threadState_->errorMessage.c_str())).toStdString());
             }
             catch (XmlRpcException &/*ex*/)
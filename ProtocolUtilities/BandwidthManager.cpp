@@ -0,0 +1,166 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+/**
+ *  @file   BandwidthManager.cpp
+ *  @brief  Adapts the AgentThrottle values sent to the server to the measured inbound traffic.
+ */
+
+#include "StableHeaders.h"
+#include "BandwidthManager.h"
+#include "NetworkMessages/NetMessageManager.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ProtocolUtilities
+{
+
+/// Base share of the budget for each category. These are the ratios the client used to send as static throttles.
+static const Real cBaseWeights[TC_NumCategories] = { 0.1f, 0.1f, 0.02f, 0.02f, 0.25f, 0.26f, 0.25f };
+
+/// How often the traffic is measured and the throttles recomputed, in seconds.
+static const f64 cMeasurementInterval = 2.0;
+
+/// The budget is never lowered below this, in bits per second.
+static const Real cMinBitsPerSecond = 100000.0f;
+
+/// Smoothing factor for the rate and loss measurements. Larger reacts faster.
+static const Real cSmoothing = 0.5f;
+
+/// Loss rate above which the budget is lowered.
+static const Real cHighLoss = 0.05f;
+
+/// Loss rate below which the budget may be raised.
+static const Real cLowLoss = 0.01f;
+
+/// The throttles are resent only if some category changed by more than this fraction.
+static const Real cResendThreshold = 0.1f;
+
+BandwidthManager::BandwidthManager(Real maxBitsPerSecond) :
+    maxBitsPerSecond_(std::max(maxBitsPerSecond, cMinBitsPerSecond)),
+    generation_(0)
+{
+    Reset();
+}
+
+void BandwidthManager::SetMaxBitsPerSecond(Real maxBitsPerSecond)
+{
+    maxBitsPerSecond_ = std::max(maxBitsPerSecond, cMinBitsPerSecond);
+    budget_ = std::min(budget_, maxBitsPerSecond_);
+    ComputeThrottles();
+}
+
+void BandwidthManager::Reset()
+{
+    budget_ = maxBitsPerSecond_;
+    lossRate_ = 0.0f;
+    lastReceivedPackets_ = 0;
+    lastLostPackets_ = 0;
+    haveBaseline_ = false;
+    timeSinceMeasurement_ = 0.0;
+    pendingTextures_ = 0;
+    pendingAssets_ = 0;
+
+    for(int i = 0; i < TC_NumCategories; ++i)
+    {
+        measuredRates_[i] = 0.0f;
+        lastBytes_[i] = 0;
+        sentThrottles_[i] = 0.0f;
+    }
+
+    ComputeThrottles();
+}
+
+bool BandwidthManager::IsMeasurementDue(f64 frametime) const
+{
+    return !haveBaseline_ || timeSinceMeasurement_ + frametime >= cMeasurementInterval;
+}
+
+bool BandwidthManager::Update(f64 frametime, const NetMessageManager &network, size_t pendingTextures, size_t pendingAssets)
+{
+    timeSinceMeasurement_ += frametime;
+    if (haveBaseline_ && timeSinceMeasurement_ < cMeasurementInterval)
+        return false;
+
+    const uint64_t receivedPackets = network.GetReceivedPacketCount();
+    const uint64_t lostPackets = network.GetLostPacketCount();
+
+    if (!haveBaseline_)
+    {
+        // The counters of the message manager keep running over connections, so start measuring from here.
+        for(int i = 0; i < TC_NumCategories; ++i)
+            lastBytes_[i] = network.GetReceivedBytes((ThrottleCategory)i);
+        lastReceivedPackets_ = receivedPackets;
+        lastLostPackets_ = lostPackets;
+        haveBaseline_ = true;
+        timeSinceMeasurement_ = 0.0;
+        return false;
+    }
+
+    Real totalRate = 0.0f;
+    for(int i = 0; i < TC_NumCategories; ++i)
+    {
+        const uint64_t bytes = network.GetReceivedBytes((ThrottleCategory)i);
+        Real rate = (Real)((bytes - lastBytes_[i]) * 8 / timeSinceMeasurement_);
+        measuredRates_[i] += cSmoothing * (rate - measuredRates_[i]);
+        totalRate += measuredRates_[i];
+        lastBytes_[i] = bytes;
+    }
+
+    const uint64_t newReceived = receivedPackets - lastReceivedPackets_;
+    const uint64_t newLost = lostPackets - lastLostPackets_;
+    if (newReceived + newLost > 0)
+    {
+        Real loss = (Real)newLost / (Real)(newReceived + newLost);
+        lossRate_ += cSmoothing * (loss - lossRate_);
+    }
+    lastReceivedPackets_ = receivedPackets;
+    lastLostPackets_ = lostPackets;
+
+    pendingTextures_ = pendingTextures;
+    pendingAssets_ = pendingAssets;
+    timeSinceMeasurement_ = 0.0;
+
+    // Back off multiplicatively on loss. Probe upwards only when the budget is actually being used, otherwise an idle
+    // link would climb back to the maximum and give no protection the next time a burst of downloads starts.
+    if (lossRate_ > cHighLoss)
+        budget_ = std::max(budget_ * 0.8f, cMinBitsPerSecond);
+    else if (lossRate_ < cLowLoss && totalRate > budget_ * 0.7f)
+        budget_ = std::min(budget_ * 1.1f, maxBitsPerSecond_);
+
+    ComputeThrottles();
+
+    for(int i = 0; i < TC_NumCategories; ++i)
+        if (fabs(throttles_[i] - sentThrottles_[i]) > sentThrottles_[i] * cResendThreshold)
+            return true;
+
+    return false;
+}
+
+u32 BandwidthManager::ThrottlesSent()
+{
+    for(int i = 0; i < TC_NumCategories; ++i)
+        sentThrottles_[i] = throttles_[i];
+    return generation_++;
+}
+
+void BandwidthManager::ComputeThrottles()
+{
+    Real weights[TC_NumCategories];
+    for(int i = 0; i < TC_NumCategories; ++i)
+        weights[i] = cBaseWeights[i];
+
+    // Downloads in progress pull bandwidth to their category, idle download categories keep only a trickle so that
+    // new requests get started quickly.
+    weights[TC_Texture] *= (pendingTextures_ == 0) ? 0.2f : 1.0f + std::min<size_t>(pendingTextures_, 32) / 16.0f;
+    weights[TC_Asset] *= (pendingAssets_ == 0) ? 0.2f : 1.0f + std::min<size_t>(pendingAssets_, 16) / 8.0f;
+
+    Real sum = 0.0f;
+    for(int i = 0; i < TC_NumCategories; ++i)
+        sum += weights[i];
+
+    for(int i = 0; i < TC_NumCategories; ++i)
+        throttles_[i] = budget_ * weights[i] / sum;
+}
+
+}
@@ -0,0 +1,123 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+/**
+ *  @file   BandwidthManager.h
+ *  @brief  Adapts the AgentThrottle values sent to the server to the measured inbound traffic.
+ */
+
+#ifndef incl_ProtocolUtilities_BandwidthManager_h
+#define incl_ProtocolUtilities_BandwidthManager_h
+
+#include "CoreTypes.h"
+#include "RexTypes.h"
+#include "NetworkMessages/NetThrottleCategory.h"
+
+namespace ProtocolUtilities
+{
+    class NetMessageManager;
+
+    /** Decides the per-category bandwidth limits which the client asks the server to use with AgentThrottle.
+
+        Every few seconds the inbound throughput of each category is measured from the byte counters of
+        NetMessageManager, and the inbound packet loss is estimated from the gaps in the sequence numbers.
+        - The total budget backs off when loss is high, and grows back towards the configured maximum while the
+          link is being used and loss is low.
+        - The budget is split between the categories by fixed base weights. The texture and asset weights are
+          scaled by the number of pending downloads, so idle categories give their share to the ones with work.
+        Update returns true when the limits have changed enough to be worth sending to the server again.
+    */
+    class BandwidthManager
+    {
+    public:
+        /// Constructor.
+        /// @param maxBitsPerSecond The largest total budget, in bits per second.
+        explicit BandwidthManager(Real maxBitsPerSecond);
+
+        /// Sets the largest total budget. If the current budget is above it, the budget is lowered.
+        void SetMaxBitsPerSecond(Real maxBitsPerSecond);
+
+        /// @return The largest total budget, in bits per second.
+        Real GetMaxBitsPerSecond() const { return maxBitsPerSecond_; }
+
+        /// Starts over with the full budget. Call when a new connection is made.
+        void Reset();
+
+        /// Measures the traffic and recomputes the throttles if the measurement interval has elapsed.
+        /// @param frametime Seconds since the last call.
+        /// @param network The message manager of the current connection.
+        /// @param pendingTextures Number of texture downloads in progress.
+        /// @param pendingAssets Number of other asset downloads in progress.
+        /// @return True if the throttles should be sent to the server.
+        bool Update(f64 frametime, const NetMessageManager &network, size_t pendingTextures, size_t pendingAssets);
+
+        /// @return True if the next Update with the given frametime will measure the traffic, and so needs the
+        ///         pending download counts. Lets the caller skip counting the downloads on other frames.
+        bool IsMeasurementDue(f64 frametime) const;
+
+        /// Marks the current throttles as sent to the server.
+        /// @return The generation counter to send with the throttles.
+        u32 ThrottlesSent();
+
+        /// @return The current limit for the category, in bits per second.
+        Real GetThrottle(ThrottleCategory category) const { return throttles_[category]; }
+
+        /// @return The measured inbound throughput of the category, in bits per second.
+        Real GetMeasuredRate(ThrottleCategory category) const { return measuredRates_[category]; }
+
+        /// @return The current total budget, in bits per second.
+        Real GetBudget() const { return budget_; }
+
+        /// @return The estimated fraction of inbound packets lost, 0-1.
+        Real GetLossRate() const { return lossRate_; }
+
+        /// @return Number of pending texture downloads at the last measurement.
+        size_t GetPendingTextures() const { return pendingTextures_; }
+
+        /// @return Number of pending asset downloads at the last measurement.
+        size_t GetPendingAssets() const { return pendingAssets_; }
+
+    private:
+        /// Splits the budget between the categories.
+        void ComputeThrottles();
+
+        /// The largest total budget, in bits per second.
+        Real maxBitsPerSecond_;
+
+        /// The current total budget, in bits per second.
+        Real budget_;
+
+        /// Current limits per category, in bits per second.
+        Real throttles_[TC_NumCategories];
+
+        /// The limits last sent to the server, in bits per second.
+        Real sentThrottles_[TC_NumCategories];
+
+        /// Smoothed inbound throughput per category, in bits per second.
+        Real measuredRates_[TC_NumCategories];
+
+        /// Smoothed inbound loss rate.
+        Real lossRate_;
+
+        /// Byte counters of NetMessageManager at the previous measurement.
+        uint64_t lastBytes_[TC_NumCategories];
+
+        /// Packet counters of NetMessageManager at the previous measurement.
+        uint64_t lastReceivedPackets_;
+        uint64_t lastLostPackets_;
+
+        /// False until the first measurement has been taken after Reset.
+        bool haveBaseline_;
+
+        /// Seconds since the previous measurement.
+        f64 timeSinceMeasurement_;
+
+        /// Download queue depths at the last measurement.
+        size_t pendingTextures_;
+        size_t pendingAssets_;
+
+        /// Generation counter of the AgentThrottle message.
+        u32 generation_;
+    };
+}
+
+#endif // incl_ProtocolUtilities_BandwidthManager_h
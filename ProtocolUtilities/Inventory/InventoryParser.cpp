@@ -11,9 +11,51 @@
 #include "Inventory/InventorySkeleton.h"
 #include "InventoryParser.h"
 
+#include <map>
+#include <deque>
+
 namespace ProtocolUtilities
 {
 
+/// Reads the folder array of inventory-skeleton or inventory-skel-lib into a flat list.
+static void ReadDetachedFolders(XMLRPC_VALUE node, DetachedInventoryFolderVector &folders)
+{
+    folders.reserve(XMLRPC_VectorSize(node));
+
+    XMLRPC_VALUE item = XMLRPC_VectorRewind(node);
+    while(item)
+    {
+        XMLRPC_VALUE_TYPE type = XMLRPC_GetValueType(item);
+        if (type == xmlrpc_vector) // xmlrpc-epi handles structs as arrays.
+        {
+            folders.push_back(DetachedInventoryFolder());
+            DetachedInventoryFolder &folder = folders.back();
+
+            XMLRPC_VALUE val = XMLRPC_VectorGetValueWithID(item, "name");
+            if (val && XMLRPC_GetValueType(val) == xmlrpc_string)
+                folder.folder.name = XMLRPC_GetValueString(val);
+
+            val = XMLRPC_VectorGetValueWithID(item, "parent_id");
+            if (val && XMLRPC_GetValueType(val) == xmlrpc_string)
+                folder.parent_id.FromString(XMLRPC_GetValueString(val));
+
+            val = XMLRPC_VectorGetValueWithID(item, "version");
+            if (val && XMLRPC_GetValueType(val) == xmlrpc_int)
+                folder.folder.version = XMLRPC_GetValueInt(val);
+
+            val = XMLRPC_VectorGetValueWithID(item, "type_default");
+            if (val && XMLRPC_GetValueType(val) == xmlrpc_int)
+                folder.folder.type_default = XMLRPC_GetValueInt(val);
+
+            val = XMLRPC_VectorGetValueWithID(item, "folder_id");
+            if (val && XMLRPC_GetValueType(val) == xmlrpc_string)
+                folder.folder.id.FromString(XMLRPC_GetValueString(val));
+        }
+
+        item = XMLRPC_VectorNext(node);
+    }
+}
+
 // static
 bool InventoryParser::IsHardcodedOpenSimFolder(const char *name)
 {
@@ -58,43 +100,8 @@ boost::shared_ptr<ProtocolUtilities::InventorySkeleton> InventoryParser::Extract
     if (!inventoryNode || XMLRPC_GetValueType(inventoryNode) != xmlrpc_vector)
         throw XmlRpcException("Failed to read inventory, inventory-skeleton in the reply was not properly formed!");
 
-    typedef std::pair<RexUUID, ProtocolUtilities::InventoryFolderSkeleton> DetachedInventoryFolder;
-    typedef std::list<DetachedInventoryFolder> DetachedInventoryFolderList;
-    DetachedInventoryFolderList folders;
-
-    XMLRPC_VALUE item = XMLRPC_VectorRewind(inventoryNode);
-    while(item)
-    {
-        XMLRPC_VALUE_TYPE type = XMLRPC_GetValueType(item);
-        if (type == xmlrpc_vector) // xmlrpc-epi handles structs as arrays.
-        {
-            DetachedInventoryFolder folder;
-
-            XMLRPC_VALUE val = XMLRPC_VectorGetValueWithID(item, "name");
-            if (val && XMLRPC_GetValueType(val) == xmlrpc_string)
-                folder.second.name = XMLRPC_GetValueString(val);
-
-            val = XMLRPC_VectorGetValueWithID(item, "parent_id");
-            if (val && XMLRPC_GetValueType(val) == xmlrpc_string)
-                folder.first.FromString(XMLRPC_GetValueString(val));
-
-            val = XMLRPC_VectorGetValueWithID(item, "version");
-            if (val && XMLRPC_GetValueType(val) == xmlrpc_int)
-                folder.second.version = XMLRPC_GetValueInt(val);
-
-            val = XMLRPC_VectorGetValueWithID(item, "type_default");
-            if (val && XMLRPC_GetValueType(val) == xmlrpc_int)
-                folder.second.type_default = XMLRPC_GetValueInt(val);
-
-            val = XMLRPC_VectorGetValueWithID(item, "folder_id");
-            if (val && XMLRPC_GetValueType(val) == xmlrpc_string)
-                folder.second.id.FromString(XMLRPC_GetValueString(val));
-
-            folders.push_back(folder);
-        }
-
-        item = XMLRPC_VectorNext(inventoryNode);
-    }
+    DetachedInventoryFolderVector folders;
+    ReadDetachedFolders(inventoryNode, folders);
 
     // Find and set the inventory root folder.
     XMLRPC_VALUE inventoryRootNode = XMLRPC_VectorGetValueWithID(result, "inventory-root");
@@ -116,51 +123,10 @@ boost::shared_ptr<ProtocolUtilities::InventorySkeleton> InventoryParser::Extract
     if (inventoryRootFolderID.IsNull())
         throw XmlRpcException("Failed to read inventory, inventory-root value folder_id was null or unparseable!");
 
-    // Find the root folder from the list of detached folders, and set it as the root folder to start with.
-    for(DetachedInventoryFolderList::iterator iter = folders.begin(); iter != folders.end(); ++iter)
-    {
-        if (iter->second.id == inventoryRootFolderID)
-        {
-            ProtocolUtilities::InventoryFolderSkeleton *root = inventory->GetRoot();
-            iter->second.editable = false;
-            root->AddChildFolder(iter->second);
-            folders.erase(iter);
-            break;
-        }
-    }
-
-    if (inventory->GetFirstChildFolderByName("My Inventory")->id != inventoryRootFolderID)
+    // Attach the root folder and all its descendants.
+    if (!AttachFolders(*inventory, folders, inventoryRootFolderID, false))
         throw XmlRpcException("Failed to read inventory, inventory-root value folder_id pointed to a nonexisting folder!");
 
-    // Insert the detached folders onto the tree view until all folders have been added or there are orphans left
-    // that cannot be added, and quit.
-    bool progress = true;
-    while(folders.size() > 0 && progress)
-    {
-        progress = false;
-        DetachedInventoryFolderList::iterator iter = folders.begin();
-        while(iter != folders.end())
-        {
-            DetachedInventoryFolderList::iterator next = iter;
-            ++next;
-
-            ProtocolUtilities::InventoryFolderSkeleton *parent = inventory->GetChildFolderById(iter->first);
-            if (parent)
-            {
-                // Mark harcoded OpenSim Library folders non-editable.
-                if (parent->id == inventoryRootFolderID &&
-                    IsHardcodedOpenSimFolder(iter->second.name.c_str()))
-                    iter->second.editable = false;
-
-                parent->AddChildFolder(iter->second);
-                progress = true;
-                folders.erase(iter);
-            }
-
-            iter = next;
-        }
-    }
-
     /********** World Library **********/
 
     // Find and set the inventory-lib-owner uuid.
@@ -209,41 +175,8 @@ boost::shared_ptr<ProtocolUtilities::InventorySkeleton> InventoryParser::Extract
         return inventory;
     }
 
-    DetachedInventoryFolderList library_folders;
-
-    item = XMLRPC_VectorRewind(inventoryLibraryNode);
-    while(item)
-    {
-        XMLRPC_VALUE_TYPE type = XMLRPC_GetValueType(item);
-        if (type == xmlrpc_vector) // xmlrpc-epi handles structs as arrays.
-        {
-            DetachedInventoryFolder folder;
-
-            XMLRPC_VALUE val = XMLRPC_VectorGetValueWithID(item, "name");
-            if (val && XMLRPC_GetValueType(val) == xmlrpc_string)
-                folder.second.name = XMLRPC_GetValueString(val);
-
-            val = XMLRPC_VectorGetValueWithID(item, "parent_id");
-            if (val && XMLRPC_GetValueType(val) == xmlrpc_string)
-                folder.first.FromString(XMLRPC_GetValueString(val));
-
-            val = XMLRPC_VectorGetValueWithID(item, "version");
-            if (val && XMLRPC_GetValueType(val) == xmlrpc_int)
-                folder.second.version = XMLRPC_GetValueInt(val);
-
-            val = XMLRPC_VectorGetValueWithID(item, "type_default");
-            if (val && XMLRPC_GetValueType(val) == xmlrpc_int)
-                folder.second.type_default = XMLRPC_GetValueInt(val);
-
-            val = XMLRPC_VectorGetValueWithID(item, "folder_id");
-            if (val && XMLRPC_GetValueType(val) == xmlrpc_string)
-                folder.second.id.FromString(XMLRPC_GetValueString(val));
-
-            library_folders.push_back(folder);
-        }
-
-        item = XMLRPC_VectorNext(inventoryLibraryNode);
-    }
+    DetachedInventoryFolderVector library_folders;
+    ReadDetachedFolders(inventoryLibraryNode, library_folders);
 
     // Find and set the world library root folder.
     XMLRPC_VALUE inventoryLibraryRootNode = XMLRPC_VectorGetValueWithID(result, "inventory-lib-root");
@@ -265,49 +198,10 @@ boost::shared_ptr<ProtocolUtilities::InventorySkeleton> InventoryParser::Extract
     if (inventoryLibraryRootFolderID.IsNull())
         throw XmlRpcException("Failed to read inventory, inventory-lib-root value folder_id was null or unparseable!");
 
-    // Find the root folder from the list of detached folders, and set it as the root folder to start with.
-    for(DetachedInventoryFolderList::iterator iter = library_folders.begin(); iter != library_folders.end(); ++iter)
-    {
-        if (iter->second.id == inventoryLibraryRootFolderID)
-        {
-            ProtocolUtilities::InventoryFolderSkeleton *root = inventory->GetRoot();
-            iter->second.editable = false;
-            root->AddChildFolder(iter->second);
-            library_folders.erase(iter);
-            break;
-        }
-    }
-
-    ProtocolUtilities::InventoryFolderSkeleton *worldLibrary = inventory->GetChildFolderById(inventoryLibraryRootFolderID);
-    if (!worldLibrary)
+    // Attach the World Library root folder and all its descendants.
+    if (!AttachFolders(*inventory, library_folders, inventoryLibraryRootFolderID, true))
         throw XmlRpcException("Failed to read inventory, inventory-lib-root value folder_id pointed to a nonexisting folder!");
 
-    // Insert the detached folders onto the tree view until all folders have been added or there are orphans left
-    // that cannot be added, and quit.
-    progress = true;
-    while(library_folders.size() > 0 && progress)
-    {
-        progress = false;
-        DetachedInventoryFolderList::iterator iter = library_folders.begin();
-        while(iter != library_folders.end())
-        {
-            DetachedInventoryFolderList::iterator next = iter;
-            ++next;
-
-            ProtocolUtilities::InventoryFolderSkeleton *parent = inventory->GetChildFolderById(iter->first);
-            if (parent)
-            {
-                // Mark all World Libary folder descendents non-editable.
-                iter->second.editable = false;
-                parent->AddChildFolder(iter->second);
-                progress = true;
-                library_folders.erase(iter);
-            }
-
-            iter = next;
-        }
-    }
-
     return inventory;
 }
 
@@ -319,4 +213,54 @@ void InventoryParser::SetErrorFolder(ProtocolUtilities::InventoryFolderSkeleton
     root->AddChildFolder(errorFolder);
 }
 
+// static
+InventoryFolderSkeleton *InventoryParser::AttachFolders(InventorySkeleton &inventory, const DetachedInventoryFolderVector &folders,
+    const RexUUID &root_id, bool library)
+{
+    typedef std::multimap<RexUUID, size_t> ChildIndexMap;
+    typedef std::pair<ChildIndexMap::const_iterator, ChildIndexMap::const_iterator> ChildRange;
+
+    // Index the folders by their parent id. Folders arrive in arbitrary order, so a child may be listed before its parent.
+    ChildIndexMap children;
+    const DetachedInventoryFolder *rootFolder = 0;
+    for(size_t i = 0; i < folders.size(); ++i)
+    {
+        if (folders[i].folder.id == root_id)
+            rootFolder = &folders[i];
+        else
+            children.insert(std::make_pair(folders[i].parent_id, i));
+    }
+
+    if (!rootFolder)
+        return 0;
+
+    InventoryFolderSkeleton *root = inventory.GetRoot()->AddChildFolder(rootFolder->folder);
+    root->editable = false;
+
+    // Walk the hierarchy breadth-first. Each folder is attached exactly once, and since the skeleton keeps its
+    // children in a std::list, the pointers to already attached folders stay valid while we add their children.
+    std::deque<InventoryFolderSkeleton *> pending;
+    pending.push_back(root);
+    while(!pending.empty())
+    {
+        InventoryFolderSkeleton *parent = pending.front();
+        pending.pop_front();
+
+        ChildRange range = children.equal_range(parent->id);
+        for(ChildIndexMap::const_iterator iter = range.first; iter != range.second; ++iter)
+        {
+            InventoryFolderSkeleton *child = parent->AddChildFolder(folders[iter->second].folder);
+            // Mark all World Libary folder descendents and the harcoded OpenSim folders non-editable.
+            if (library || (parent == root && IsHardcodedOpenSimFolder(child->name.c_str())))
+                child->editable = false;
+            pending.push_back(child);
+        }
+
+        // A malformed reply could contain a cycle; forget the children once they're attached so we can't loop.
+        children.erase(range.first, range.second);
+    }
+
+    return root;
+}
+
 }
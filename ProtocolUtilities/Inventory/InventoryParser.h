@@ -8,9 +8,21 @@
 #ifndef incl_Protocol_InventoryParser_h
 #define incl_Protocol_InventoryParser_h
 
+#include "Inventory/InventorySkeleton.h"
+
 namespace ProtocolUtilities
 {
-    class InventoryFolderSkeleton;
+    /// Inventory folder read from the login reply, not yet attached to its parent.
+    struct DetachedInventoryFolder
+    {
+        /// Id of the parent folder.
+        RexUUID parent_id;
+
+        /// The folder itself. Has no children.
+        InventoryFolderSkeleton folder;
+    };
+
+    typedef std::vector<DetachedInventoryFolder> DetachedInventoryFolderVector;
 
     class InventoryParser
     {
@@ -22,7 +34,19 @@ namespace ProtocolUtilities
 
         static void SetErrorFolder(ProtocolUtilities::InventoryFolderSkeleton *root);
 
-    private:
+        /// Attaches a flat list of folders under the inventory root. The folder with id @c root_id is added as a
+        /// direct child of the inventory root and all its descendants are attached below it. Parents are looked up
+        /// from a parent id -> folder index map, so this is O(n log n) in the folder count regardless of the order
+        /// the folders appear in the list. Folders that are not reachable from @c root_id are dropped.
+        /// @param inventory Inventory to attach to.
+        /// @param folders Folders read from the reply.
+        /// @param root_id Id of the root folder of this hierarchy (inventory-root or inventory-lib-root).
+        /// @param library If true, all folders are marked non-editable (World Library). Otherwise only the
+        ///        root folder and the hardcoded OpenSim folders directly under it are.
+        /// @return The attached root folder, or null if no folder with @c root_id was found.
+        static InventoryFolderSkeleton *AttachFolders(InventorySkeleton &inventory, const DetachedInventoryFolderVector &folders,
+            const RexUUID &root_id, bool library);
+
         /// Checks if the name of the folder belongs to the harcoded OpenSim folders.
         /// @param name name of the folder.
         /// @return True if one of the harcoded folders, false if not.
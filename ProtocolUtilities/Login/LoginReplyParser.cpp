@@ -0,0 +1,378 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+/**
+ *  @file   LoginReplyParser.cpp
+ *  @brief  Streaming parser for the login_to_simulator XML-RPC reply.
+ */
+
+#include "StableHeaders.h"
+#include "XmlRpcException.h"
+
+#include "Login/LoginReplyParser.h"
+#include "OpenSim/BuddyList.h"
+
+#include <QXmlStreamReader>
+
+namespace ProtocolUtilities
+{
+
+LoginReplyParser::LoginReplyParser(ClientParameters &parameters) :
+    parameters_(parameters),
+    hasInventory_(false),
+    hasLibrary_(false)
+{
+}
+
+void LoginReplyParser::Parse(const char *data, int size)
+{
+    parameters_.buddy_list = BuddyListPtr(new BuddyList());
+
+    QXmlStreamReader xml(QByteArray::fromRawData(data, size));
+
+    if (!xml.readNextStartElement() || xml.name() != "methodResponse")
+        throw XmlRpcException("Failed to parse login reply, methodResponse element not found!");
+
+    if (!xml.readNextStartElement())
+        throw XmlRpcException("Failed to parse login reply, the reply was empty!");
+
+    if (xml.name() == "fault")
+    {
+        StructFields fault;
+        QString scalar;
+        if (xml.readNextStartElement() && xml.name() == "value" && EnterValue(xml, scalar) == VT_Struct)
+            ReadFlatStruct(xml, fault);
+        throw XmlRpcException(std::string("Login reply was a fault: ") + fault["faultString"].toStdString());
+    }
+
+    // <params><param><value><struct>
+    if (xml.name() != "params" || !xml.readNextStartElement() || xml.name() != "param" ||
+        !xml.readNextStartElement() || xml.name() != "value")
+        throw XmlRpcException("Failed to parse login reply, params were not properly formed!");
+
+    QString scalar;
+    if (EnterValue(xml, scalar) != VT_Struct)
+        throw XmlRpcException("Failed to parse login reply, the reply did not contain a struct!");
+
+    while(xml.readNextStartElement())
+    {
+        if (xml.name() == "member")
+            ReadMember(xml);
+        else
+            xml.skipCurrentElement();
+    }
+
+    if (xml.hasError())
+        throw XmlRpcException(std::string("Failed to parse login reply: ") + xml.errorString().toStdString());
+
+    // The grid address is composed from two members which may arrive in any order.
+    parameters_.gridUrl = "";
+    if (HasValue("sim_ip") && HasValue("sim_port"))
+    {
+        const std::string &sim_ip = values_["sim_ip"];
+        int region_udp_port = QString(values_["sim_port"].c_str()).toInt();
+        if (sim_ip.size() > 0 && region_udp_port > 0 && region_udp_port < 65536)
+        {
+            std::stringstream out;
+            out << sim_ip << ":" << region_udp_port;
+            parameters_.gridUrl = out.str();
+        }
+    }
+}
+
+bool LoginReplyParser::HasValue(const std::string &name) const
+{
+    return values_.find(name) != values_.end();
+}
+
+std::string LoginReplyParser::GetValue(const std::string &name) const
+{
+    std::map<std::string, std::string>::const_iterator iter = values_.find(name);
+    if (iter == values_.end())
+        throw XmlRpcException(std::string("Login reply did not contain value ") + name);
+    return iter->second;
+}
+
+InventoryPtr LoginReplyParser::ExtractInventory() const
+{
+    InventoryPtr inventory(new InventorySkeleton);
+
+    /********** My Inventory **********/
+    if (!hasInventory_)
+        throw XmlRpcException("Failed to read inventory, inventory-skeleton in the reply was not properly formed!");
+
+    if (inventoryRootId_.IsNull())
+        throw XmlRpcException("Failed to read inventory, inventory-root value folder_id was null or unparseable!");
+
+    if (!InventoryParser::AttachFolders(*inventory, folders_, inventoryRootId_, false))
+        throw XmlRpcException("Failed to read inventory, inventory-root value folder_id pointed to a nonexisting folder!");
+
+    /********** World Library **********/
+    if (libraryOwnerId_.IsNull())
+        throw XmlRpcException("Failed to read inventory, inventory-lib-owner value agent_id was null or unparseable!");
+
+    inventory->worldLibraryOwnerId = libraryOwnerId_;
+
+    // Note: E.g. ScienceSim doens't have have World Library.
+    if (!hasLibrary_)
+        return inventory;
+
+    if (libraryRootId_.IsNull())
+        throw XmlRpcException("Failed to read inventory, inventory-lib-root value folder_id was null or unparseable!");
+
+    if (!InventoryParser::AttachFolders(*inventory, libraryFolders_, libraryRootId_, true))
+        throw XmlRpcException("Failed to read inventory, inventory-lib-root value folder_id pointed to a nonexisting folder!");
+
+    return inventory;
+}
+
+void LoginReplyParser::ReadMember(QXmlStreamReader &xml)
+{
+    if (!xml.readNextStartElement() || xml.name() != "name")
+    {
+        xml.skipCurrentElement();
+        return;
+    }
+
+    QString name = xml.readElementText();
+
+    if (!xml.readNextStartElement() || xml.name() != "value")
+    {
+        xml.skipCurrentElement();
+        return;
+    }
+
+    QString scalar;
+    ValueType type = EnterValue(xml, scalar);
+    if (type == VT_Scalar)
+    {
+        // In Taiga inventory-lib-owner isn't array, just single value.
+        if (name == "inventory-lib-owner")
+            libraryOwnerId_.FromString(scalar.toStdString());
+        SetValue(name, scalar);
+    }
+    else if (type == VT_Array)
+    {
+        StructArrayType arrayType = SA_Ignore;
+        if (name == "inventory-skeleton")
+        {
+            arrayType = SA_Folders;
+            hasInventory_ = true;
+        }
+        else if (name == "inventory-skel-lib")
+        {
+            arrayType = SA_LibraryFolders;
+            hasLibrary_ = true;
+        }
+        else if (name == "inventory-root")
+            arrayType = SA_InventoryRoot;
+        else if (name == "inventory-lib-root")
+            arrayType = SA_LibraryRoot;
+        else if (name == "inventory-lib-owner")
+            arrayType = SA_LibraryOwner;
+        else if (name == "buddy-list")
+            arrayType = SA_BuddyList;
+
+        if (arrayType != SA_Ignore)
+            ReadStructArray(xml, arrayType);
+        else
+            xml.skipCurrentElement();
+        LeaveValue(xml);
+    }
+    else if (type == VT_Struct)
+    {
+        xml.skipCurrentElement();
+        LeaveValue(xml);
+    }
+
+    // Skip to </member>.
+    while(xml.readNextStartElement())
+        xml.skipCurrentElement();
+}
+
+void LoginReplyParser::ReadStructArray(QXmlStreamReader &xml, StructArrayType type)
+{
+    if (!xml.readNextStartElement() || xml.name() != "data")
+    {
+        xml.skipCurrentElement();
+        return;
+    }
+
+    StructFields fields;
+    int index = 0;
+
+    while(xml.readNextStartElement())
+    {
+        if (xml.name() != "value")
+        {
+            xml.skipCurrentElement();
+            continue;
+        }
+
+        QString scalar;
+        ValueType valueType = EnterValue(xml, scalar);
+        if (valueType == VT_Struct)
+        {
+            fields.clear();
+            ReadFlatStruct(xml, fields);
+            HandleArrayStruct(type, fields, index++);
+        }
+        else if (valueType == VT_Array)
+            xml.skipCurrentElement();
+
+        LeaveValue(xml);
+    }
+
+    // Skip to </array>.
+    while(xml.readNextStartElement())
+        xml.skipCurrentElement();
+}
+
+void LoginReplyParser::HandleArrayStruct(StructArrayType type, const StructFields &fields, int index)
+{
+    StructFields::const_iterator iter;
+    switch(type)
+    {
+    case SA_Folders:
+    case SA_LibraryFolders:
+    {
+        DetachedInventoryFolderVector &folders = (type == SA_Folders) ? folders_ : libraryFolders_;
+        folders.push_back(DetachedInventoryFolder());
+        DetachedInventoryFolder &folder = folders.back();
+
+        if ((iter = fields.find("name")) != fields.end())
+            folder.folder.name = iter->second.toStdString();
+        if ((iter = fields.find("parent_id")) != fields.end())
+            folder.parent_id.FromString(iter->second.toStdString());
+        if ((iter = fields.find("version")) != fields.end())
+            folder.folder.version = iter->second.toInt();
+        if ((iter = fields.find("type_default")) != fields.end())
+            folder.folder.type_default = iter->second.toInt();
+        if ((iter = fields.find("folder_id")) != fields.end())
+            folder.folder.id.FromString(iter->second.toStdString());
+        break;
+    }
+    case SA_InventoryRoot:
+    case SA_LibraryRoot:
+        // Only the first element is used.
+        if (index == 0 && (iter = fields.find("folder_id")) != fields.end())
+            (type == SA_InventoryRoot ? inventoryRootId_ : libraryRootId_).FromString(iter->second.toStdString());
+        break;
+    case SA_LibraryOwner:
+        // In legacy servers inventory-lib-owner is array.
+        if (index == 0 && (iter = fields.find("agent_id")) != fields.end())
+            libraryOwnerId_.FromString(iter->second.toStdString());
+        break;
+    case SA_BuddyList:
+    {
+        RexUUID id;
+        int rights_given = 0;
+        int rights_has = 0;
+
+        if ((iter = fields.find("buddy_id")) != fields.end())
+            id.FromString(iter->second.toStdString());
+        if ((iter = fields.find("buddy_rights_given")) != fields.end())
+            rights_given = iter->second.toInt();
+        if ((iter = fields.find("buddy_rights_has")) != fields.end())
+            rights_has = iter->second.toInt();
+
+        parameters_.buddy_list->AddBuddy(new Buddy(id, rights_given, rights_has));
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void LoginReplyParser::SetValue(const QString &name, const QString &value)
+{
+    std::string stdValue = value.toStdString();
+    values_[name.toStdString()] = stdValue;
+
+    if (name == "session_id")
+        parameters_.sessionID.FromString(stdValue);
+    else if (name == "agent_id")
+        parameters_.agentID.FromString(stdValue);
+    else if (name == "circuit_code")
+        parameters_.circuitCode = value.toUInt();
+    else if (name == "seed_capability")
+        parameters_.seedCapabilities = stdValue;
+    else if (name == "webdav_inventory")
+        parameters_.webdavInventoryUrl = stdValue;
+    else if (name == "region_x")
+        parameters_.regionX = static_cast<uint16_t>(value.toLong() / 256);
+    else if (name == "region_y")
+        parameters_.regionY = static_cast<uint16_t>(value.toLong() / 256);
+}
+
+// static
+LoginReplyParser::ValueType LoginReplyParser::EnterValue(QXmlStreamReader &xml, QString &scalar)
+{
+    scalar.clear();
+    while(!xml.atEnd())
+    {
+        switch(xml.readNext())
+        {
+        case QXmlStreamReader::Characters:
+            // A value without a type element is a string.
+            scalar += xml.text();
+            break;
+        case QXmlStreamReader::StartElement:
+            if (xml.name() == "array")
+                return VT_Array;
+            if (xml.name() == "struct")
+                return VT_Struct;
+            scalar = xml.readElementText(QXmlStreamReader::SkipChildElements);
+            LeaveValue(xml);
+            return VT_Scalar;
+        case QXmlStreamReader::EndElement:
+            return VT_Scalar;
+        default:
+            break;
+        }
+    }
+
+    return VT_Invalid;
+}
+
+// static
+void LoginReplyParser::LeaveValue(QXmlStreamReader &xml)
+{
+    while(!xml.atEnd() && !(xml.isEndElement() && xml.name() == "value"))
+        xml.readNext();
+}
+
+// static
+void LoginReplyParser::ReadFlatStruct(QXmlStreamReader &xml, StructFields &fields)
+{
+    while(xml.readNextStartElement())
+    {
+        if (xml.name() != "member")
+        {
+            xml.skipCurrentElement();
+            continue;
+        }
+
+        QString name;
+        while(xml.readNextStartElement())
+        {
+            if (xml.name() == "name")
+                name = xml.readElementText();
+            else if (xml.name() == "value")
+            {
+                QString scalar;
+                ValueType type = EnterValue(xml, scalar);
+                if (type == VT_Scalar)
+                    fields[name] = scalar;
+                else if (type != VT_Invalid)
+                {
+                    xml.skipCurrentElement();
+                    LeaveValue(xml);
+                }
+            }
+            else
+                xml.skipCurrentElement();
+        }
+    }
+}
+
+}
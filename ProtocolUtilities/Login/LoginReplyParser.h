@@ -0,0 +1,135 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+/**
+ *  @file   LoginReplyParser.h
+ *  @brief  Streaming parser for the login_to_simulator XML-RPC reply.
+ */
+
+#ifndef incl_Protocol_LoginReplyParser_h
+#define incl_Protocol_LoginReplyParser_h
+
+#include "NetworkEvents.h"
+#include "Inventory/InventoryParser.h"
+
+#include <QString>
+#include <map>
+
+class QXmlStreamReader;
+
+namespace ProtocolUtilities
+{
+    /** Reads the login_to_simulator reply in one forward pass over the raw xml, without building the xmlrpc-epi
+        value tree. Scalar reply values are written to ClientParameters as they are encountered, the buddy list is
+        filled as its entries arrive and the inventory folders are collected into flat lists which are then attached
+        to an InventorySkeleton with InventoryParser::AttachFolders.
+
+        @code
+        std::vector<u8> reply;
+        call.SendRaw(reply);
+        LoginReplyParser parser(parameters);
+        parser.Parse((const char *)&reply[0], reply.size());
+        parameters.inventory = parser.ExtractInventory();
+        @endcode
+    */
+    class LoginReplyParser
+    {
+    public:
+        /// Constructor.
+        /// @param parameters Client parameters to fill.
+        explicit LoginReplyParser(ClientParameters &parameters);
+
+        /// Parses the reply. A new buddy list is set to the client parameters.
+        /// @param data Raw xml data of the reply.
+        /// @param size Size of the data in bytes.
+        /// @throw XmlRpcException if the xml is malformed or the reply is a fault.
+        void Parse(const char *data, int size);
+
+        /// @return True if the reply contained a top-level scalar member with the given name.
+        bool HasValue(const std::string &name) const;
+
+        /// @return Value of a top-level scalar member as a string.
+        /// @throw XmlRpcException if the reply did not contain such member.
+        std::string GetValue(const std::string &name) const;
+
+        /// Builds the inventory skeleton from the folders read from the reply.
+        /// @return The inventory object.
+        /// @throw XmlRpcException if the inventory data in the reply was missing or malformed.
+        InventoryPtr ExtractInventory() const;
+
+    private:
+        /// Kinds of arrays of structs that we read from the reply.
+        enum StructArrayType
+        {
+            SA_Folders,
+            SA_LibraryFolders,
+            SA_InventoryRoot,
+            SA_LibraryRoot,
+            SA_LibraryOwner,
+            SA_BuddyList,
+            SA_Ignore
+        };
+
+        /// What EnterValue found inside a <value> element.
+        enum ValueType
+        {
+            VT_Scalar,
+            VT_Array,
+            VT_Struct,
+            VT_Invalid
+        };
+
+        typedef std::map<QString, QString> StructFields;
+
+        /// Reads a top-level struct member. The reader is positioned at the <member> start element.
+        void ReadMember(QXmlStreamReader &xml);
+
+        /// Reads an array of structs. The reader is positioned at the <array> start element.
+        void ReadStructArray(QXmlStreamReader &xml, StructArrayType type);
+
+        /// Handles one struct of an array read by ReadStructArray.
+        void HandleArrayStruct(StructArrayType type, const StructFields &fields, int index);
+
+        /// Stores a top-level scalar member, and writes it to the client parameters if it is one of the known fields.
+        void SetValue(const QString &name, const QString &value);
+
+        /// Enters a <value> element. For scalars the reader is left at the </value> end element and the text is
+        /// returned in @c scalar. For arrays and structs the reader is left at the <array>/<struct> start element.
+        static ValueType EnterValue(QXmlStreamReader &xml, QString &scalar);
+
+        /// Advances the reader to the </value> end element of the current value.
+        static void LeaveValue(QXmlStreamReader &xml);
+
+        /// Reads a struct of scalar members. Nested arrays and structs are skipped.
+        /// The reader is positioned at the <struct> start element.
+        static void ReadFlatStruct(QXmlStreamReader &xml, StructFields &fields);
+
+        /// Client parameters that are filled.
+        ClientParameters &parameters_;
+
+        /// All top-level scalar members of the reply.
+        std::map<std::string, std::string> values_;
+
+        /// My Inventory folders.
+        DetachedInventoryFolderVector folders_;
+
+        /// World Library folders.
+        DetachedInventoryFolderVector libraryFolders_;
+
+        /// Value of inventory-root.
+        RexUUID inventoryRootId_;
+
+        /// Value of inventory-lib-root.
+        RexUUID libraryRootId_;
+
+        /// Value of inventory-lib-owner.
+        RexUUID libraryOwnerId_;
+
+        /// Did the reply contain inventory-skeleton.
+        bool hasInventory_;
+
+        /// Did the reply contain inventory-skel-lib.
+        bool hasLibrary_;
+    };
+}
+
+#endif // incl_Protocol_LoginReplyParser_h
@@ -1,6 +1,7 @@
 // For conditions of distribution and use, see copyright notice in license.txt
 #include "StableHeaders.h"
 
+#include <cstring>
 #include <utility>
 
 #include "NetworkConnection.h"
@@ -19,6 +20,10 @@ NetworkConnection::NetworkConnection(const char *address, int port): bOpen(true)
     socket.setSendBufferSize(cBufferSize);
 }
 
+NetworkConnection::NetworkConnection(): bOpen(true)
+{
+}
+
 NetworkConnection::~NetworkConnection()
 {
 }
@@ -51,4 +56,36 @@ void NetworkConnection::Close()
     bOpen = false;
 }
 
+LoopbackConnection::LoopbackConnection()
+{
+}
+
+LoopbackConnection::~LoopbackConnection()
+{
+}
+
+bool LoopbackConnection::PacketsAvailable() const
+{
+    return Open() && !datagrams.empty();
+}
+
+int LoopbackConnection::ReceiveBytes(uint8_t *bytes, size_t maxCount)
+{
+    if (!PacketsAvailable())
+        return 0;
+
+    const std::vector<uint8_t> &datagram = datagrams.front();
+    const size_t numBytes = min(datagram.size(), maxCount);
+    if (numBytes > 0)
+        memcpy(bytes, &datagram[0], numBytes);
+    datagrams.pop_front();
+
+    return (int)numBytes;
+}
+
+void LoopbackConnection::SendBytes(const uint8_t *bytes, size_t count)
+{
+    datagrams.push_back(std::vector<uint8_t>(bytes, bytes + count));
+}
+
 }
\ No newline at end of file
@@ -5,40 +5,73 @@
 #include "Poco/Net/DatagramSocket.h"
 #include "RexTypes.h"
 
+#include <list>
+#include <vector>
+
 namespace ProtocolUtilities
 {
-    /// NetworkConnection represents the socket of a bidirectional UDP connection.
+    /// NetworkConnection represents the socket of a bidirectional UDP connection. The socket operations are virtual,
+    /// so that the connection can be replaced with a recorded trace, see TraceConnection.
     class NetworkConnection
     {
     public:
         /// Connects to the given address.
         NetworkConnection(const char *address, int port);
-        ~NetworkConnection();
+        virtual ~NetworkConnection();
 
         /// @return True if there are available UDP packets in the stream and the socket is open. 
-        bool PacketsAvailable() const;
+        virtual bool PacketsAvailable() const;
 
         /// Reads bytes from the socket. Doesn't block, but returns 0 if no bytes available.
         /// @param maxCount The maximum number of bytes to fill into the buffer.
         /// @return The number of bytes that was actually filled into the buffer.
-        int ReceiveBytes(uint8_t *bytes, size_t maxCount);
+        virtual int ReceiveBytes(uint8_t *bytes, size_t maxCount);
 
         /// Pushes out a packet with the given contents.
-        void SendBytes(const uint8_t *bytes, size_t count);
+        virtual void SendBytes(const uint8_t *bytes, size_t count);
 
         /// Closes the socket.
-        void Close();
+        virtual void Close();
 
         /// @return True if the socket is open.
         bool Open() const { return bOpen; }
 
+    protected:
+        /// Creates an open connection whose socket is not connected anywhere. For subclasses that don't use the socket.
+        NetworkConnection();
+
     private:
+        NetworkConnection(const NetworkConnection &);
+        void operator=(const NetworkConnection &);
+
         /// PoCo UDP socket.
         Poco::Net::DatagramSocket socket;
 
         /// Signals that socket is open for use. ///\todo Remove this boolean altogether. -jj.
         bool bOpen;
     };
+
+    /// A stand-in for the UDP connection that receives every datagram sent to it. Used with
+    /// NetMessageManager::ConnectLoopback to run the whole send and receive path without a server, e.g. in self-tests.
+    class LoopbackConnection : public NetworkConnection
+    {
+    public:
+        LoopbackConnection();
+        virtual ~LoopbackConnection();
+
+        /// @return True if there are sent datagrams that have not been received yet.
+        virtual bool PacketsAvailable() const;
+
+        /// Copies the oldest sent datagram to the buffer.
+        virtual int ReceiveBytes(uint8_t *bytes, size_t maxCount);
+
+        /// Queues the datagram to be received.
+        virtual void SendBytes(const uint8_t *bytes, size_t count);
+
+    private:
+        /// Sent datagrams that have not been received yet, oldest first.
+        std::list<std::vector<uint8_t> > datagrams;
+    };
 }
 
 #endif
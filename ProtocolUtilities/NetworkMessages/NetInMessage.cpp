@@ -6,6 +6,7 @@
 #include "Poco/Net/DatagramSocket.h" // To get htons etc.
 
 #include "NetInMessage.h"
+#include "NetMessageBufferPool.h"
 #include "ZeroCode.h"
 
 #include "QuatUtils.h"
@@ -99,39 +100,71 @@ static uint8_t *ComputeMessageContentStartAddrAndLength(uint8_t *data, size_t nu
 }
 */
 
-NetInMessage::NetInMessage(size_t seqNum, const uint8_t *data, size_t numBytes, bool zeroCoded) :
-    messageInfo(0), sequenceNumber(seqNum)
+NetInMessage::NetInMessage(size_t seqNum, const uint8_t *data, size_t numBytes, bool zeroCoded, NetMessageBufferPool *pool) :
+    messageInfo(0), sequenceNumber(seqNum), messageData(0), messageSize(0), bufferPool(pool), pooledBuffer(0)
 {
-    if (zeroCoded)
+    if (zeroCoded && bufferPool)
+    {
+        // Decode straight into a pooled buffer in one pass.
+        pooledBuffer = bufferPool->Acquire();
+        size_t decodedLength = ZeroDecodeSinglePass(pooledBuffer->data, NetMessageBuffer::cSize, data, numBytes);
+        if (decodedLength > 0)
+        {
+            messageData = pooledBuffer->data;
+            messageSize = decodedLength;
+        }
+        else
+            ReleaseData(); // Either malformed or too big for a pooled buffer, the heap path below tells which.
+    }
+
+    if (zeroCoded && !messageData)
     {
         size_t decodedLength = CountZeroDecodedLength(data, numBytes);
         if (decodedLength == 0)
             throw Exception("Corrupted zero-encoded stream received!");
-        messageData.resize(decodedLength, 0); ///\todo Can optimize here for extra-extra bit of performance if profiling shows the need for so..
-        bool success = ZeroDecode(&messageData[0], decodedLength, data, numBytes);
+        heapData.resize(decodedLength, 0);
+        bool success = ZeroDecode(&heapData[0], decodedLength, data, numBytes);
         if (!success)
+        {
+            ReleaseData();
             throw Exception("Zero-decoding input data failed!");
+        }
+        messageData = &heapData[0];
+        messageSize = decodedLength;
     }
-    else
+    else if (!zeroCoded && bufferPool)
+    {
+        // Read the datagram in place, no copy needed.
+        messageData = data;
+        messageSize = numBytes;
+    }
+    else if (!zeroCoded)
     {
-        messageData.reserve(numBytes);
-        messageData.insert(messageData.end(), data, data + numBytes);
+        heapData.reserve(numBytes);
+        heapData.insert(heapData.end(), data, data + numBytes);
+        messageData = heapData.empty() ? 0 : &heapData[0];
+        messageSize = numBytes;
     }
 
     size_t messageIDLength = 0;
-    messageID = ExtractNetworkMessageID(&messageData[0], numBytes, &messageIDLength);
+    messageID = ExtractNetworkMessageID(messageData, messageSize, &messageIDLength);
     if (messageIDLength == 0)
+    {
+        ReleaseData();
         throw Exception("Malformed SLUDP packet read! MessageID not present!");
+    }
     
-    // We remove the messageID from the beginning of the message data buffer, since we just want to store the message content.
-    messageData.erase(messageData.begin(), messageData.begin() + messageIDLength);
+    // We skip the messageID from the beginning of the message data buffer, since we just want to store the message content.
+    messageData += messageIDLength;
+    messageSize -= messageIDLength;
 }
 
-NetInMessage::NetInMessage(const NetInMessage &rhs)
+NetInMessage::NetInMessage(const NetInMessage &rhs) :
+    messageData(0), messageSize(0), bufferPool(rhs.bufferPool), pooledBuffer(0)
 {
     sequenceNumber = rhs.sequenceNumber;
     messageInfo = rhs.messageInfo;
-    messageData = rhs.messageData;
+    CopyData(rhs.messageData, rhs.messageSize);
     currentBlock = rhs.currentBlock;
     currentBlockInstanceNumber = rhs.currentBlockInstanceNumber;
     currentBlockInstanceCount = rhs.currentBlockInstanceCount;
@@ -139,10 +172,38 @@ NetInMessage::NetInMessage(const NetInMessage &rhs)
     currentVariableSize = rhs.currentVariableSize;
     bytesRead = rhs.bytesRead;
     messageID = rhs.messageID;
+    variableCountBlockNext = rhs.variableCountBlockNext;
 }
 
 NetInMessage::~NetInMessage()
 {
+    ReleaseData();
+}
+
+void NetInMessage::CopyData(const uint8_t *data, size_t numBytes)
+{
+    // A copy can outlive the datagram the original was read from, so it always owns its data.
+    if (bufferPool && numBytes <= NetMessageBuffer::cSize)
+    {
+        pooledBuffer = bufferPool->Acquire();
+        if (numBytes > 0)
+            memcpy(pooledBuffer->data, data, numBytes);
+        messageData = pooledBuffer->data;
+    }
+    else
+    {
+        heapData.assign(data, data + numBytes);
+        messageData = heapData.empty() ? 0 : &heapData[0];
+    }
+    messageSize = numBytes;
+}
+
+void NetInMessage::ReleaseData()
+{
+    if (pooledBuffer && bufferPool)
+        bufferPool->Release(pooledBuffer);
+    pooledBuffer = 0;
+    heapData.clear();
 }
 
 void NetInMessage::SetMessageInfo(const NetMessageInfo *info)
@@ -619,7 +680,7 @@ void NetInMessage::StartReadingNextBlock()
         return;
     case NetBlockVariable:
         // Malformity check.
-        if (bytesRead >= messageData.size())
+        if (bytesRead >= messageSize)
         {
             SkipToPacketEnd();
             return;
@@ -633,7 +694,7 @@ void NetInMessage::StartReadingNextBlock()
             ++currentBlock;
 
             // Malformity check.
-            if (bytesRead >= messageData.size() || currentBlock >= messageInfo->blocks.size())
+            if (bytesRead >= messageSize || currentBlock >= messageInfo->blocks.size())
             {
                 SkipToPacketEnd();
                 return;
@@ -667,7 +728,7 @@ void NetInMessage::ReadNextVariableSize()
     {
     case NetVarBufferByte:
         // Variable-sized variable, size denoted with 1 byte.
-        if (bytesRead >= messageData.size())
+        if (bytesRead >= messageSize)
         {
             SkipToPacketEnd();
             return;
@@ -679,7 +740,7 @@ void NetInMessage::ReadNextVariableSize()
         return;
     case NetVarBuffer2Bytes:
         // Variable-sized variable, size denoted with 2 bytes.
-        if (bytesRead + 1 >= messageData.size())
+        if (bytesRead + 1 >= messageSize)
         {
             SkipToPacketEnd();
             return;
@@ -707,17 +768,17 @@ void NetInMessage::ReadNextVariableSize()
 
 void *NetInMessage::ReadBytesUnchecked(size_t count)
 {
-    if (bytesRead >= messageData.size() || count == 0)
+    if (bytesRead >= messageSize || count == 0)
         return 0;
 
-    if (bytesRead + count > messageData.size())
+    if (bytesRead + count > messageSize)
     {
-        bytesRead = messageData.size(); // Jump to the end of the whole message so that we don't after this read anything.
+        bytesRead = messageSize; // Jump to the end of the whole message so that we don't after this read anything.
         std::cout << "Error: Size of the message exceeded. Can't read bytes anymore." << std::endl;
         return 0;
     }
 
-    void *data = &messageData[bytesRead];
+    void *data = const_cast<uint8_t *>(&messageData[bytesRead]);
     bytesRead += count;
 
     return data;
@@ -731,7 +792,7 @@ void NetInMessage::SkipToPacketEnd()
     currentBlockInstanceCount = 0;
     currentVariable = 0;
     currentVariableSize = 0;
-    bytesRead = messageData.size();
+    bytesRead = messageSize;
 }
 
 void NetInMessage::RequireNextVariableType(NetVariableType type)
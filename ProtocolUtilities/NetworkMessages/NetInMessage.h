@@ -13,6 +13,8 @@ class RexUUID;
 
 namespace ProtocolUtilities
 {
+    struct NetMessageBuffer;
+    class NetMessageBufferPool;
 
     /** Helps parsing inbound packets by supporting convenient reading of new data from the message. Also
         tracks that the message is read with the right structure.
@@ -26,7 +28,10 @@ namespace ProtocolUtilities
         /// @param data Data buffer.
         /// @param numBytes Number of bytes.
         /// @param zerEncoded Is this data zero-encoded.
-        NetInMessage(size_t seqNum, const uint8_t *data, size_t numBytes, bool zeroEncoded);
+        /// @param bufferPool If non-null, zero-encoded data is decoded into a buffer acquired from this pool, and data
+        ///        that is not zero-encoded is not copied at all but read in place. In the latter case @c data must stay
+        ///        valid for the lifetime of the message. If null, the message keeps its own heap copy of the data.
+        NetInMessage(size_t seqNum, const uint8_t *data, size_t numBytes, bool zeroEncoded, NetMessageBufferPool *bufferPool = 0);
 
         /// Destructor.
         ~NetInMessage();
@@ -116,10 +121,10 @@ namespace ProtocolUtilities
         const NetMessageInfo *GetMessageInfo() const { return messageInfo; }
 
         /// @return The original message data.
-        const std::vector<uint8_t> &GetData() const { return messageData; }
+        const uint8_t *GetData() const { return messageData; }
 
         /// @return The size of the data (message body, the header is excluded). 
-        size_t GetDataSize() const { return messageData.size(); }
+        size_t GetDataSize() const { return messageSize; }
 
         /// @return The amount of read bytes.
         uint32_t BytesRead() const { return (uint32_t)bytesRead; }
@@ -158,8 +163,26 @@ namespace ProtocolUtilities
         /// Identifies what kind of packet we're handling.
         const NetMessageInfo *messageInfo;
         
-        /// A pointer to the inbound message body
-        std::vector<uint8_t> messageData;
+        /// Copies the given data to storage owned by this message and points messageData to it.
+        void CopyData(const uint8_t *data, size_t numBytes);
+
+        /// Releases the storage owned by this message.
+        void ReleaseData();
+
+        /// A pointer to the inbound message body. Points either to the caller's datagram, pooledBuffer or heapData.
+        const uint8_t *messageData;
+
+        /// The size of the message body, in bytes.
+        size_t messageSize;
+
+        /// The pool the message body buffer is acquired from, or null.
+        NetMessageBufferPool *bufferPool;
+
+        /// The pooled buffer owned by this message, or null.
+        NetMessageBuffer *pooledBuffer;
+
+        /// Heap storage for the message body, used when no pool was given.
+        std::vector<uint8_t> heapData;
         
         /// Index of the current block.
         size_t currentBlock;
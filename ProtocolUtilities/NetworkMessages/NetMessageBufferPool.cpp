@@ -0,0 +1,60 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+#include "StableHeaders.h"
+
+#include "NetMessageBufferPool.h"
+
+namespace ProtocolUtilities
+{
+    NetMessageBufferPool::NetMessageBufferPool(size_t buffersPerSlab) :
+        freeList_(0),
+        buffersPerSlab_(buffersPerSlab > 0 ? buffersPerSlab : 1),
+        buffersInUse_(0)
+    {
+    }
+
+    NetMessageBufferPool::~NetMessageBufferPool()
+    {
+        assert(buffersInUse_ == 0 && "Warning! NetMessageBufferPool destroyed while its buffers are still in use!");
+
+        for(size_t i = 0; i < slabs_.size(); ++i)
+            delete[] slabs_[i];
+        slabs_.clear();
+        freeList_ = 0;
+    }
+
+    NetMessageBuffer *NetMessageBufferPool::Acquire()
+    {
+        if (!freeList_)
+            AllocateSlab();
+
+        NetMessageBuffer *buffer = freeList_;
+        freeList_ = buffer->nextFree;
+        buffer->nextFree = 0;
+        ++buffersInUse_;
+
+        return buffer;
+    }
+
+    void NetMessageBufferPool::Release(NetMessageBuffer *buffer)
+    {
+        if (!buffer)
+            return;
+
+        assert(buffersInUse_ > 0);
+        buffer->nextFree = freeList_;
+        freeList_ = buffer;
+        --buffersInUse_;
+    }
+
+    void NetMessageBufferPool::AllocateSlab()
+    {
+        NetMessageBuffer *slab = new NetMessageBuffer[buffersPerSlab_];
+        slabs_.push_back(slab);
+
+        for(size_t i = 0; i < buffersPerSlab_; ++i)
+        {
+            slab[i].nextFree = freeList_;
+            freeList_ = &slab[i];
+        }
+    }
+}
@@ -0,0 +1,92 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+#ifndef incl_ProtocolUtilities_NetMessageBufferPool_h
+#define incl_ProtocolUtilities_NetMessageBufferPool_h
+
+#include <vector>
+
+#include "RexTypes.h"
+
+namespace ProtocolUtilities
+{
+    /// A fixed-size byte buffer handed out by NetMessageBufferPool. Large enough to hold any inbound datagram and
+    /// the zero-decoded or zero-encoded form of any message we handle.
+    struct NetMessageBuffer
+    {
+        /// Size of the data array, in bytes.
+        static const size_t cSize = 8192;
+
+        /// Link to the next free buffer. Only valid while the buffer is in the pool's free list.
+        NetMessageBuffer *nextFree;
+
+        /// The buffer memory.
+        uint8_t data[cSize];
+    };
+
+    /// Slab allocator for NetMessageBuffers, shared by the inbound and outbound message paths of NetMessageManager.
+    /// Buffers are allocated from the heap in slabs of several buffers at a time and recycled through an intrusive
+    /// free list, so Acquire and Release are both O(1) and, once the working set has been reached, the protocol
+    /// hot path doesn't touch the heap at all. Not thread-safe; NetMessageManager uses it from the main thread only.
+    class NetMessageBufferPool
+    {
+    public:
+        /// @param buffersPerSlab How many buffers to allocate at a time when the free list runs out.
+        explicit NetMessageBufferPool(size_t buffersPerSlab = 16);
+
+        /// Frees all slabs. All buffers must have been released before this.
+        ~NetMessageBufferPool();
+
+        /// @return An unused buffer. The contents of the buffer are undefined.
+        NetMessageBuffer *Acquire();
+
+        /// Returns a buffer to the pool.
+        void Release(NetMessageBuffer *buffer);
+
+        /// @return The number of buffers currently handed out.
+        size_t BuffersInUse() const { return buffersInUse_; }
+
+        /// @return The total number of buffers allocated.
+        size_t BuffersAllocated() const { return slabs_.size() * buffersPerSlab_; }
+
+        /// @return The number of heap allocations done by the pool so far. Stays constant in the steady state.
+        size_t SlabAllocations() const { return slabs_.size(); }
+
+    private:
+        NetMessageBufferPool(const NetMessageBufferPool &);
+        void operator=(const NetMessageBufferPool &);
+
+        /// Allocates a new slab and puts its buffers to the free list.
+        void AllocateSlab();
+
+        /// All allocated slabs.
+        std::vector<NetMessageBuffer *> slabs_;
+
+        /// Head of the free list.
+        NetMessageBuffer *freeList_;
+
+        /// How many buffers to allocate at a time.
+        size_t buffersPerSlab_;
+
+        /// The number of buffers currently handed out.
+        size_t buffersInUse_;
+    };
+
+    /// Holds a buffer acquired from a NetMessageBufferPool for the lifetime of a scope.
+    class ScopedNetMessageBuffer
+    {
+    public:
+        explicit ScopedNetMessageBuffer(NetMessageBufferPool &pool) : pool_(pool), buffer_(pool.Acquire()) {}
+        ~ScopedNetMessageBuffer() { pool_.Release(buffer_); }
+
+        /// @return The buffer memory.
+        uint8_t *Data() const { return buffer_->data; }
+
+    private:
+        ScopedNetMessageBuffer(const ScopedNetMessageBuffer &);
+        void operator=(const ScopedNetMessageBuffer &);
+
+        NetMessageBufferPool &pool_;
+        NetMessageBuffer *buffer_;
+    };
+}
+
+#endif // incl_ProtocolUtilities_NetMessageBufferPool_h
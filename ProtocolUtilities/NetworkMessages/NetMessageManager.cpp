@@ -79,29 +79,21 @@ namespace ProtocolUtilities
         return data + 6 + extraHeaderSize;
     }
 
-    /// Returns a list of appended acks from packet
+    /// Returns the number of appended acks in the packet, and where they start.
     /// @param data A pointer to the message data.
     /// @param numBytes The size of data, in bytes.
-    static std::vector<uint32_t> GetAppendedAckList(uint8_t *data, size_t numBytes)
+    /// @param firstAck [out] Index of the first appended ack in data.
+    static size_t GetAppendedAckCount(const uint8_t *data, size_t numBytes, size_t *firstAck)
     {
-        std::vector<uint32_t> acks;
-        if ((data[0] & NetFlagAck) && (numBytes > 6))
-        {
-            if (numBytes > 6)
-            {
-                size_t num_acks = data[numBytes-1];
-                acks.resize(num_acks);
-                
-                int idx = numBytes - 1 - num_acks * 4;
-                if (idx < 6) return acks;
-                
-                for (size_t i = 0; i < num_acks; ++i)
-                {
-                    acks.push_back((uint32_t)ntohl(*(u_long*)&data[idx]));
-                }
-            }
-        }
-        return acks;
+        if (!(data[0] & NetFlagAck) || numBytes <= 6)
+            return 0;
+
+        size_t num_acks = data[numBytes-1];
+        if (numBytes - 1 < num_acks * 4 || numBytes - 1 - num_acks * 4 < 6)
+            return 0;
+
+        *firstAck = numBytes - 1 - num_acks * 4;
+        return num_acks;
     }
 
     /// const version of above.
@@ -126,6 +118,37 @@ namespace ProtocolUtilities
        return (uint32_t)ntohl(*(u_long*)&data[1]);//((data[1] << 24) + (data[2] << 16) + (data[3] << 8) + data[4]);    
     }
 
+    /// @return The throttle category the server sends the given message in.
+    /// @param msg The message, whose read position is not modified.
+    /// @param resent True if the datagram was flagged as a resend.
+    static ThrottleCategory GetThrottleCategory(const NetInMessage &msg, bool resent)
+    {
+        if (resent)
+            return TC_Resend;
+
+        switch(msg.GetMessageID())
+        {
+        case RexNetMsgLayerData:
+        {
+            // The first variable of LayerData is the layer type.
+            const uint8_t type = msg.GetDataSize() > 0 ? msg.GetData()[0] : 0;
+            if (type == '7' || type == '9')
+                return TC_Wind;
+            if (type == '8' || type == ':')
+                return TC_Cloud;
+            return TC_Land;
+        }
+        case RexNetMsgImageData:
+        case RexNetMsgImagePacket:
+            return TC_Texture;
+        case RexNetMsgTransferInfo:
+        case RexNetMsgTransferPacket:
+            return TC_Asset;
+        default:
+            return TC_Task;
+        }
+    }
+
     const char *VariableTypeToStr(NetVariableType type)
     {
         const char *data[] = { "Invalid", "U8", "U16", "U32", "U64", "S8", "S16", "S32", "S64", "F32", "F64", "LLVector3", "LLVector3d", "LLVector4",
@@ -140,7 +163,13 @@ namespace ProtocolUtilities
     :messageList(boost::shared_ptr<NetMessageList>(new NetMessageList(messageListFilename)))
     ,messageListener(0), 
     sequenceNumber(1), // Note here: We always start outbound communication with PacketID==1.
-    lastReceivedSequenceNumber(0)
+    lastReceivedSequenceNumber(0),
+    unusedMessages(0),
+    usedMessageCount(0),
+    lastPingID(0),
+    pingPending(false),
+    receivedPacketCount(0),
+    lostPacketCount(0)
 #ifdef PROFILING
     ,sentDatagrams(65536)
     ,sentDatabytes(65536)
@@ -152,6 +181,8 @@ namespace ProtocolUtilities
 #endif
     {      
         receivedSequenceNumbers.clear();        
+        for(int i = 0; i < TC_NumCategories; ++i)
+            receivedBytesByCategory[i] = 0;
     }
 
     NetMessageManager::~NetMessageManager()
@@ -213,13 +244,14 @@ namespace ProtocolUtilities
         return messageList->GetMessageInfoByID(id);
     }
 
-    void NetMessageManager::HandleInboundBytes(std::vector<uint8_t> &data)
+    void NetMessageManager::HandleInboundBytes(uint8_t *data, size_t numBytes)
     {
-        const size_t numBytes = data.size();
 #ifdef PROFILING
         receivedDatagrams.InsertRecord(1.0);
         receivedDatabytes.InsertRecord(numBytes);
 #endif
+        lastReceiveTime.update();
+        ++receivedPacketCount;
 
         if (!messageListener)
         {
@@ -228,16 +260,19 @@ namespace ProtocolUtilities
             return;
         }
 
-        uint32_t seqNum = ExtractNetworkMessageSequenceNumber(&data[0], numBytes);
+        uint32_t seqNum = ExtractNetworkMessageSequenceNumber(data, numBytes);
 
-#ifdef PROFILING
         if (receivedSequenceNumbers.size() > 0 && seqNum - lastReceivedSequenceNumber < 16)
         {
             for(int i = lastReceivedSequenceNumber+1; i < seqNum; ++i)
                 if (receivedSequenceNumbers.find(i) == receivedSequenceNumbers.end())
+                {
+                    ++lostPacketCount;
+#ifdef PROFILING
                     lostPackets.InsertRecord(1.0);
-        }
 #endif
+                }
+        }
         lastReceivedSequenceNumber = seqNum;
 
         // Send ACK for reliable messages.
@@ -258,18 +293,20 @@ namespace ProtocolUtilities
 //        NetMsgID id = ExtractNetworkMessageNumber(&data[0], numBytes);
 
         size_t messageLength = 0;
-        const uint8_t *message = ComputeMessageBodyStartAddrAndLength(&data[0], numBytes, &messageLength);
+        const uint8_t *message = ComputeMessageBodyStartAddrAndLength(data, numBytes, &messageLength);
         if (!message)
         {
             cout << "Malformed packet received, could not determine message size" << endl;
             return;
         }
         
-        std::vector<uint32_t> appended_acks = GetAppendedAckList(&data[0], numBytes);
-        
+        size_t firstAppendedAck = 0;
+        const size_t numAppendedAcks = GetAppendedAckCount(data, numBytes, &firstAppendedAck);
+
         try
         {
-            NetInMessage msg(seqNum, &message[0], messageLength, (data[0] & NetFlagZeroCode) != 0);
+            // The message is read in place from the datagram, or zero-decoded into a pooled buffer.
+            NetInMessage msg(seqNum, &message[0], messageLength, (data[0] & NetFlagZeroCode) != 0, &bufferPool);
 
             const NetMessageInfo *messageInfo = messageList->GetMessageInfoByID(msg.GetMessageID());
             if (!messageInfo)
@@ -279,12 +316,11 @@ namespace ProtocolUtilities
             }
             msg.SetMessageInfo(messageInfo);
 
+            receivedBytesByCategory[GetThrottleCategory(msg, (data[0] & NetFlagResent) != 0)] += numBytes;
+
             // Process appended acks
-            if (appended_acks.size() > 0)
-            {
-                for(unsigned i = 0; i < appended_acks.size(); ++i)
-                    ProcessPacketACK(appended_acks[i]);
-            }
+            for(size_t i = 0; i < numAppendedAcks; ++i)
+                ProcessPacketACK((uint32_t)ntohl(*(u_long*)&data[firstAppendedAck + i * 4]));
             
             // NetMessageManager handles all Acks and Pings. Those are not passed to the application.
             switch(msg.GetMessageID())
@@ -295,9 +331,19 @@ namespace ProtocolUtilities
             case RexNetMsgStartPingCheck:
                 SendCompletePingCheck(msg.ReadU8());
                 break;
+            case RexNetMsgCompletePingCheck:
+                ProcessCompletePingCheck(msg.ReadU8());
+                break;
             default:
                 // Pass the message to the listener(s).
-                messageListener->OnNetworkMessageReceived(msg.GetMessageID(), &msg);
+                if (IsReplaying())
+                {
+                    Poco::Timestamp handlingStart;
+                    messageListener->OnNetworkMessageReceived(msg.GetMessageID(), &msg);
+                    replayConnection->AddHandlingTime(msg.GetMessageID(), handlingStart.elapsed() / 1000000.0);
+                }
+                else
+                    messageListener->OnNetworkMessageReceived(msg.GetMessageID(), &msg);
                 break;
             }
         }
@@ -308,11 +354,11 @@ namespace ProtocolUtilities
         }
     }
 
-    static void FlipBits(std::vector<uint8_t> &data, int numBitsToFlip)
+    static void FlipBits(uint8_t *data, size_t numBytes, int numBitsToFlip)
     {
         while(numBitsToFlip-- > 0)
         {
-            int idx = rand() % data.size();
+            int idx = rand() % numBytes;
             uint8_t bit = 1 << (rand() % 8);
             data[idx] ^= bit;
         }
@@ -325,24 +371,33 @@ namespace ProtocolUtilities
         if (!connection)
             return;
             
-        if (!ResendQueueIsEmpty())
+        if (!resendScheduler.IsEmpty())
             ProcessResendQueue();
+
+        // Ping the server now and then to keep the round-trip time estimate fresh even when we are not sending
+        // any reliable messages.
+        static const Poco::Timestamp::TimeDiff cPingInterval = 5000000;
+        if (lastPingTime.isElapsed(cPingInterval))
+            SendStartPingCheck();
         
         // Process network messages for max. 0.1 seconds, to prevent lack of rendering/mainloop execution during heavy processing
         static const double MAX_PROCESS_TIME = 0.1;
         boost::timer timer;
         
         PROFILE(NetMessageManager_WhilePacketsAvailable);
+        // All datagrams of this frame are received into the same pooled buffer.
+        ScopedNetMessageBuffer datagram(bufferPool);
         while(connection->PacketsAvailable() && timer.elapsed() < MAX_PROCESS_TIME)
         {
             const int cMaxPayload = 2048;
-            std::vector<uint8_t> data(cMaxPayload, 0);
-            int numBytes = connection->ReceiveBytes(&data[0], cMaxPayload);
+            uint8_t *data = datagram.Data();
+            int numBytes = connection->ReceiveBytes(data, cMaxPayload);
             
-            if (numBytes == 0)
+            if (numBytes <= 0)
                 break;
 
-            data.resize(numBytes);
+            if (captureWriter.IsOpen())
+                captureWriter.WriteDatagram(data, numBytes);
 
 #ifdef PROTOCOL_STRESS_TEST
             const int numDuplications = 10;
@@ -350,13 +405,17 @@ namespace ProtocolUtilities
             for(int i = 0; i < numDuplications; ++i)
             {
 #endif
-                HandleInboundBytes(data);
+                HandleInboundBytes(data, numBytes);
 #ifdef PROTOCOL_STRESS_TEST
-                FlipBits(data, (int)ceil(data.size() * bitErrorRate));
+                FlipBits(data, numBytes, (int)ceil(numBytes * bitErrorRate));
             }
 #endif
         }
         
+        // Acks received this frame may have made room for deferred reliable messages.
+        if (resendScheduler.HasDeferredMessages())
+            SendDeferredMessages();
+
         if (!connection->Open())
             connection.reset();
             
@@ -371,9 +430,20 @@ namespace ProtocolUtilities
 
     bool NetMessageManager::ConnectTo(const char *serverAddress, int port)
     {
+        if (replayConnection)
+        {
+            std::cout << "Playing back a trace of " << replayConnection->GetDatagramCount() << " datagrams instead of connecting to "
+                << serverAddress << ":" << port << "." << std::endl;
+            connection = replayConnection;
+            lastPingTime.update();
+            return true;
+        }
+
         try
         {
             connection = boost::shared_ptr<NetworkConnection>(new NetworkConnection(serverAddress, port));
+            // Don't ping before the circuit has been set up.
+            lastPingTime.update();
             return true;
         } catch(Poco::Net::NetException &e)
         {
@@ -382,13 +452,31 @@ namespace ProtocolUtilities
         }
     }
 
+    void NetMessageManager::ConnectLoopback()
+    {
+        connection = boost::shared_ptr<NetworkConnection>(new LoopbackConnection());
+        lastPingTime.update();
+    }
+
     void NetMessageManager::Disconnect()
     {
         connection->Close();
+        StopCapture();
         ClearMessagePoolMemory();
         receivedSequenceNumbers.clear();
     }
 
+    bool NetMessageManager::StartCapture(const std::string &filename, const ClientParameters &parameters)
+    {
+        if (!captureWriter.Open(filename, parameters))
+        {
+            std::cout << "Failed to create network trace file " << filename << "." << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
     NetOutMessage *NetMessageManager::StartNewMessage(NetMsgID id)
     {
         // There should exist a message 'template' with the given ID in the message info list. If not,
@@ -401,18 +489,22 @@ namespace ProtocolUtilities
         NetOutMessage *newMsg = 0;
 
         // Find if we have an old message struct in the unused pool that we can use.
-        if (unusedMessagePool.size() > 0)
+        if (unusedMessages)
         {
-            newMsg = unusedMessagePool.front();
-            unusedMessagePool.pop_front();
+            newMsg = unusedMessages;
+            unusedMessages = newMsg->nextFree;
+            newMsg->nextFree = 0;
             newMsg->ResetWriting();
         }
         else
+        {
             newMsg = new NetOutMessage();
+            allocatedMessages.push_back(newMsg);
+        }
 
         newMsg->SetMessageInfo(info);
         newMsg->AddMessageHeader();
-        usedMessagePool.push_back(newMsg);
+        ++usedMessageCount;
         
         return newMsg;
     }
@@ -422,24 +514,17 @@ namespace ProtocolUtilities
         assert(message);
         message->SetSequenceNumber(GetNewSequenceNumber());
 
+        assert(usedMessageCount > 0);
+        --usedMessageCount;
+
         std::vector<uint8_t> &data = message->GetData();
         if (data.size() == 0)
         {
-            unusedMessagePool.push_back(message);
+            ReleaseMessage(message);
             return;
         }
         assert(data.size() >= message->BytesFilled());
         data.resize(message->BytesFilled());
-
-        // Find and remove the given message from the usedMessagePool list, it has to be there.
-#ifdef _DEBUG
-        const size_t usedMessagePoolSize = usedMessagePool.size();
-#endif
-        std::list<NetOutMessage*>::iterator newEnd = std::remove(usedMessagePool.begin(), usedMessagePool.end(), message);
-        usedMessagePool.erase(newEnd, usedMessagePool.end());
-#ifdef _DEBUG
-        assert(usedMessagePoolSize == usedMessagePool.size() + 1);
-#endif
         
         // Try to Zero-encode the message if that is desired. If encoding worsens the size, we'll send unencoded.
         if (message->GetMessageInfo()->encoding == NetZeroEncoded)
@@ -449,32 +534,52 @@ namespace ProtocolUtilities
             assert(bodyLength < message->BytesFilled());
             size_t headerLength = message->BytesFilled() - bodyLength;
 
-            size_t encodedBodyLength = CountZeroEncodedLength(bodyData, bodyLength);
+            // Encode the body in one pass into a pooled scratch buffer. The destination is capped to one byte less
+            // than the body, so the encoder bails out early if encoding would not actually compress anything.
+            ScopedNetMessageBuffer scratch(bufferPool);
+            size_t encodedBodyLength = 0;
+            if (bodyLength > 1)
+            {
+                size_t maxEncodedLength = bodyLength - 1;
+                if (maxEncodedLength > NetMessageBuffer::cSize)
+                    maxEncodedLength = NetMessageBuffer::cSize;
+                encodedBodyLength = ZeroEncodeSinglePass(scratch.Data(), maxEncodedLength, bodyData, bodyLength);
+            }
 
             // If the encoded message would take more space than the non-coded, just send non-coded.
-            if (headerLength + encodedBodyLength >= message->BytesFilled()) 
+            if (encodedBodyLength == 0)
             {
                 data[0] &= ~NetFlagZeroCode;
             }
             else // Send out zerocoded, it's actually compressed something.
             {
+                // The encoded body is shorter, so the message vector only shrinks and doesn't reallocate.
                 data[0] |= NetFlagZeroCode;
-
-                std::vector<uint8_t> zeroCodedData;
-                zeroCodedData.resize(headerLength + encodedBodyLength, 0);
-                memcpy(&zeroCodedData[0], &data[0], headerLength);
-                ZeroEncode(&zeroCodedData[headerLength], encodedBodyLength, bodyData, bodyLength);
-                data = zeroCodedData;
+                memcpy(&data[headerLength], scratch.Data(), encodedBodyLength);
+                data.resize(headerLength + encodedBodyLength);
             }
         }
 
-        SendProcessedMessage(message);
-
-        // Push reliable messages to queue to wait ACK from the server.
         if (message->IsReliable())
-            AddMessageToResendQueue(message);
+        {
+            // Keep the send order of reliable messages: if earlier ones are still waiting for room in the
+            // congestion window, this one waits behind them.
+            if (resendScheduler.HasDeferredMessages() || !resendScheduler.CanSend(data.size()))
+                resendScheduler.Defer(message);
+            else
+                SendReliableMessage(message);
+        }
         else
-            unusedMessagePool.push_back(message);
+        {
+            SendProcessedMessage(message);
+            ReleaseMessage(message);
+        }
+    }
+
+    void NetMessageManager::ReleaseMessage(NetOutMessage *msg)
+    {
+        msg->nextFree = unusedMessages;
+        unusedMessages = msg;
     }
 
     void NetMessageManager::SendProcessedMessage(NetOutMessage *msg)
@@ -501,20 +606,20 @@ namespace ProtocolUtilities
 
     void NetMessageManager::ClearMessagePoolMemory()
     {
-        for(std::list<NetOutMessage*>::iterator iter = unusedMessagePool.begin(); iter != unusedMessagePool.end(); ++iter)
-            delete *iter;
-
         // We're supposed to free up all of our memory, but someone's using it!
-        assert(usedMessagePool.size() == 0 && "Warning! Unsafe teardown of NetMessageManager detected!");
-        for(std::list<NetOutMessage*>::iterator iter = usedMessagePool.begin(); iter != usedMessagePool.end(); ++iter)
-            delete *iter;
+        assert(usedMessageCount == 0 && "Warning! Unsafe teardown of NetMessageManager detected!");
 
-        for(MessageResendList::iterator iter = messageResendQueue.begin(); iter != messageResendQueue.end(); ++iter)
-            delete iter->second;
+        for(size_t i = 0; i < allocatedMessages.size(); ++i)
+            delete allocatedMessages[i];
 
-        unusedMessagePool.clear();
-        usedMessagePool.clear();
-        messageResendQueue.clear();
+        allocatedMessages.clear();
+        unusedMessages = 0;
+        usedMessageCount = 0;
+
+        // The messages themselves were already freed above.
+        std::vector<NetOutMessage*> resendMessages;
+        resendScheduler.Clear(resendMessages);
+        pingPending = false;
     }
 
     ///\todo Have better delay method for pending ACKs, currently sends everything accumulated just over one frame
@@ -570,7 +675,9 @@ namespace ProtocolUtilities
     void NetMessageManager::ProcessPacketACK(uint32_t id)
     {
         //std::cout << "Received ACK for packet " << id  << std::endl;
-        RemoveMessageFromResendQueue(id);
+        NetOutMessage *msg = resendScheduler.MessageAcked(id, Poco::Timestamp());
+        if (msg)
+            ReleaseMessage(msg);
     }
 
     void NetMessageManager::SendCompletePingCheck(uint8_t pingID)
@@ -581,62 +688,64 @@ namespace ProtocolUtilities
         FinishMessage(m);
     }
 
-    /// A unary find predicate that looks for a NetOutMessage that has the given desired sequence number in a resendqueue container.
-    class MsgSeqNumMatchPred
+    void NetMessageManager::SendStartPingCheck()
     {
-    public:
-        MsgSeqNumMatchPred(uint32_t seqNum_):seqNum(seqNum_) {}
+        NetOutMessage *m = StartNewMessage(RexNetMsgStartPingCheck);
+        assert(m);
+        m->AddU8(++lastPingID);
+        m->AddU32(resendScheduler.OldestUnacked());
+        FinishMessage(m);
 
-        bool operator()(const std::pair<time_t, NetOutMessage*> &elem) const { return elem.second && elem.second->GetSequenceNumber() == seqNum; }
-    private:
-        uint32_t seqNum;
-    };
+        lastPingTime.update();
+        pingPending = true;
+    }
 
-    void NetMessageManager::AddMessageToResendQueue(NetOutMessage *msg)
+    void NetMessageManager::ProcessCompletePingCheck(uint8_t id)
     {
-        // Don't add this message to the queue, if it already exists in the queue, i.e. it has already been resent once due to a timeout.
-        MessageResendList::iterator it = std::find_if(messageResendQueue.begin(), messageResendQueue.end(), MsgSeqNumMatchPred(msg->GetSequenceNumber()));
-        if (it != messageResendQueue.end())
-        {
-            // If the sequence numbers matched but these are different message structs, add the message to unusedMessagePool, it's extraneous.
-            if (it->second != msg)
-                unusedMessagePool.push_back(msg);
+        // Replies to older pings would give too long a round-trip time, ignore them.
+        if (!pingPending || id != lastPingID)
             return;
-        }
 
-        messageResendQueue.push_back(std::make_pair(time(0), msg));
+        pingPending = false;
+        resendScheduler.AddRttSample(lastPingTime.elapsed() / 1000000.0);
     }
 
-    void NetMessageManager::RemoveMessageFromResendQueue(uint32_t packetID)
+    void NetMessageManager::SendReliableMessage(NetOutMessage *msg)
     {
-        MessageResendList::iterator it = std::find_if(messageResendQueue.begin(), messageResendQueue.end(), MsgSeqNumMatchPred(packetID));
+        SendProcessedMessage(msg);
 
-        if (it != messageResendQueue.end())
-        {
-            unusedMessagePool.push_back(it->second);
-            messageResendQueue.erase(it);
-        }
+        bool tracked = resendScheduler.MessageSent(msg, msg->GetData().size(), Poco::Timestamp());
+        assert(tracked && "Reliable message sent twice with the same sequence number!");
+        if (!tracked)
+            ReleaseMessage(msg);
+    }
+
+    void NetMessageManager::SendDeferredMessages()
+    {
+        NetOutMessage *msg = 0;
+        while((msg = resendScheduler.PeekDeferredMessage()) != 0 &&
+            resendScheduler.NextSendableDeferredMessage(msg->GetData().size()) == msg)
+            SendReliableMessage(msg);
     }
 
     void NetMessageManager::ProcessResendQueue()
     {
         PROFILE(NetMessageManager_ProcessResendQueue);
-        const int cTimeoutSeconds = 5;
 
-        const time_t timeNow = time(0);
-        for(MessageResendList::iterator it = messageResendQueue.begin(); it != messageResendQueue.end(); ++it)
+        const Poco::Timestamp now;
+        NetOutMessage *msg = 0;
+        while((msg = resendScheduler.NextTimedOutMessage(now)) != 0)
         {
-            if (timeNow - it->first >= cTimeoutSeconds)
-            {
-                it->first = timeNow;
-                it->second->MarkResend();
-                SendProcessedMessage(it->second);
-                //std::cout << "Resending packet " << it->second->GetSequenceNumber() << std::endl;
+            msg->MarkResend();
+            SendProcessedMessage(msg);
+            //std::cout << "Resending packet " << msg->GetSequenceNumber() << std::endl;
 #ifdef PROFILING
-                resentPackets.InsertRecord(1.0);
+            resentPackets.InsertRecord(1.0);
 #endif
-            }
         }
+
+        if (resendScheduler.HasDeferredMessages())
+            SendDeferredMessages();
     }
 
 #ifndef RELEASE
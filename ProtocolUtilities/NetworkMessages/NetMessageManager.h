@@ -7,9 +7,13 @@
 #include <boost/shared_ptr.hpp>
 
 #include "NetworkConnection.h"
+#include "NetworkTrace.h"
 #include "NetInMessage.h"
 #include "NetOutMessage.h"
 #include "NetMessage.h"
+#include "NetMessageBufferPool.h"
+#include "NetResendScheduler.h"
+#include "NetThrottleCategory.h"
 #include "Interfaces/INetMessageListener.h"
 #include "EventHistory.h"
 
@@ -33,6 +37,34 @@ namespace ProtocolUtilities
         /// Disconnets from the current server.
         void Disconnect();
 
+        /// Connects to a LoopbackConnection instead of a server, so that every sent datagram is received back.
+        /// Used to exercise the whole message path in self-tests.
+        void ConnectLoopback();
+
+        /// Makes the next ConnectTo play back a recorded trace instead of connecting to the server. The time spent
+        /// handling each inbound message of the trace is recorded to the connection.
+        void SetReplayConnection(boost::shared_ptr<TraceConnection> replay) { replayConnection = replay; }
+
+        /// @return The trace being played back, or null if the connection is to a server.
+        boost::shared_ptr<TraceConnection> GetReplayConnection() const { return replayConnection; }
+
+        /// @return True if the connection plays back a trace.
+        bool IsReplaying() const { return replayConnection && connection == replayConnection; }
+
+        /// Starts recording the inbound datagrams to a trace file, which can be played back with SetReplayConnection.
+        /// @param parameters The client parameters of the connection, stored to the trace.
+        /// @return True if the file could be created.
+        bool StartCapture(const std::string &filename, const ClientParameters &parameters);
+
+        /// Stops recording the inbound datagrams and closes the trace file.
+        void StopCapture() { captureWriter.Close(); }
+
+        /// @return True if the inbound datagrams are being recorded.
+        bool IsCapturing() const { return captureWriter.IsOpen(); }
+
+        /// @return Number of datagrams recorded to the current trace file.
+        size_t GetCapturedCount() const { return captureWriter.GetDatagramCount(); }
+
         /// To start building a new outbound message, call this.
         /// @return An empty message holder where the message can be built.
         NetOutMessage *StartNewMessage(NetMsgID msgId);
@@ -50,6 +82,28 @@ namespace ProtocolUtilities
         /// @return The Message Info structure associated with the given message ID.
         const NetMessageInfo *GetMessageInfoByID(NetMsgID id) const;
 
+        /// @return The pool of datagram and scratch buffers used by the in- and outbound message paths.
+        const NetMessageBufferPool &GetBufferPool() const { return bufferPool; }
+
+        /// @return The number of NetOutMessage structures allocated so far. Stays constant in the steady state.
+        size_t GetOutMessagesAllocated() const { return allocatedMessages.size(); }
+
+        /// @return Round-trip time estimates and the state of the reliable message resend queue.
+        NetResendStats GetResendStats() const { return resendScheduler.GetStats(); }
+
+        /// @return Total bytes received in datagrams of the given throttle category. Messages which don't belong to
+        ///         any specific category are counted as task data.
+        uint64_t GetReceivedBytes(ThrottleCategory category) const { return receivedBytesByCategory[category]; }
+
+        /// @return Total number of datagrams received.
+        uint64_t GetReceivedPacketCount() const { return receivedPacketCount; }
+
+        /// @return Total number of inbound datagrams assumed lost, judging by gaps in the sequence numbers.
+        uint64_t GetLostPacketCount() const { return lostPacketCount; }
+
+        /// @return Time since the last datagram was received from the server, in seconds.
+        double GetTimeSinceLastReceived() const { return lastReceiveTime.elapsed() / 1000000.0; }
+
     #ifndef RELEASE
         void DebugSendHardcodedTestPacket();
         void DebugSendHardcodedRandomPacket(size_t numBytes);
@@ -76,6 +130,9 @@ namespace ProtocolUtilities
     private:
         /// Deallocates all memory used for outbound message structs.
         void ClearMessagePoolMemory();
+
+        /// Returns an outbound message struct to the free list.
+        void ReleaseMessage(NetOutMessage *msg);
     
         /// @return A new sequence number for outbound UDP messages.
         size_t GetNewSequenceNumber() { return sequenceNumber++; }
@@ -87,7 +144,9 @@ namespace ProtocolUtilities
         void SendPendingACKs();
 
         /// Processes a single raw datagram received from the network.
-        void HandleInboundBytes(std::vector<uint8_t> &data);
+        /// @param data The datagram. Inbound messages are read from it in place, so it must stay valid during the call.
+        /// @param numBytes Size of the datagram in bytes.
+        void HandleInboundBytes(uint8_t *data, size_t numBytes);
 
         /// Processes a received PacketAck message.
         void ProcessPacketACK(NetInMessage *msg);
@@ -98,19 +157,22 @@ namespace ProtocolUtilities
         /// Responds to a ping check from the server with a CompletePingCheck message.
         void SendCompletePingCheck(uint8_t pingID);
 
+        /// Sends a StartPingCheck message to the server to measure the round-trip time.
+        void SendStartPingCheck();
+
+        /// Processes the server's reply to our ping check.
+        void ProcessCompletePingCheck(uint8_t pingID);
+
         /// Called to send out a message that is already binary-mangled to the proper final format. (packet number, zerocoding, flags, ...)
         void SendProcessedMessage(NetOutMessage *msg);
 
-        /// Adds message to the queue of reliable outbound messages.
-        void AddMessageToResendQueue(NetOutMessage *msg);
-        
-        /// Removes message from the queue of reliable outbound messages.
-        void RemoveMessageFromResendQueue(uint32_t packetID);
-        
-        /// @return True, if the resend queue is empty, false otherwise.
-        bool ResendQueueIsEmpty() const { return messageResendQueue.empty(); }
+        /// Sends a reliable message and starts waiting for its ack.
+        void SendReliableMessage(NetOutMessage *msg);
 
-        /// Checks each reliable message in outbound queue and resends any of the if an Ack was not received within a time-out period.
+        /// Sends the deferred reliable messages which now fit in the congestion window.
+        void SendDeferredMessages();
+
+        /// Resends any reliable messages whose ack did not arrive within their retransmission timeout.
         void ProcessResendQueue();
 
         NetMessageManager(const NetMessageManager &);
@@ -122,22 +184,45 @@ namespace ProtocolUtilities
         /// The socket for the UDP connection.
         boost::shared_ptr<NetworkConnection> connection;
 
+        /// The trace to play back at the next ConnectTo, or being played back.
+        boost::shared_ptr<TraceConnection> replayConnection;
+
+        /// Records the inbound datagrams when capturing.
+        NetworkTraceWriter captureWriter;
+
         /// List of messages this manager can handle.
         boost::shared_ptr<NetMessageList> messageList;
 
-        /// A pool of allocated unused NetOutMessage structures. Used to avoid unnecessary allocations at runtime.
-        std::list<NetOutMessage*> unusedMessagePool;
+        /// Buffers for inbound datagrams, zero-decoded inbound messages and zero-encoded outbound messages.
+        NetMessageBufferPool bufferPool;
+
+        /// All NetOutMessage structures ever allocated, whether unused, being built by the application or waiting
+        /// in the resend queue. Only used to free them on teardown.
+        std::vector<NetOutMessage*> allocatedMessages;
 
-        /// A pool of NetOutMessage structures, which have been handed out to the application and are currently being built.
-        std::list<NetOutMessage*> usedMessagePool;
+        /// Head of the intrusive free list of unused NetOutMessage structures. Used to avoid unnecessary allocations at runtime.
+        NetOutMessage *unusedMessages;
+
+        /// The number of NetOutMessage structures which have been handed out to the application and are currently being built.
+        size_t usedMessageCount;
         
         /// Packet acks pending to be sent
         std::set<uint32_t> pendingACKs;
 
-        typedef std::list<std::pair<time_t, NetOutMessage*> > MessageResendList;
-        /// A pool of NetOutMessages that are in the outbound queue. Need to keep the unacked reliable messages in
-        /// memory for possible resending.
-        MessageResendList messageResendQueue;
+        /// The unacked reliable messages, which are kept in memory for possible resending.
+        NetResendScheduler resendScheduler;
+
+        /// When the last StartPingCheck was sent.
+        Poco::Timestamp lastPingTime;
+
+        /// When the last datagram was received.
+        Poco::Timestamp lastReceiveTime;
+
+        /// ID of the last StartPingCheck sent.
+        uint8_t lastPingID;
+
+        /// True if the reply to the last StartPingCheck has not arrived yet.
+        bool pingPending;
         
         /// A running sequence number for outbound messages.
         size_t sequenceNumber;
@@ -147,6 +232,15 @@ namespace ProtocolUtilities
         
         /// A set of received messages' sequence numbers.
         std::set<uint32_t> receivedSequenceNumbers;
+
+        /// Bytes received per throttle category.
+        uint64_t receivedBytesByCategory[TC_NumCategories];
+
+        /// Number of datagrams received.
+        uint64_t receivedPacketCount;
+
+        /// Number of inbound datagrams assumed lost.
+        uint64_t lostPacketCount;
     };
 
 }
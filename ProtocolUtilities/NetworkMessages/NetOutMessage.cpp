@@ -11,7 +11,7 @@ using namespace RexTypes;
 
 namespace ProtocolUtilities
 {
-	NetOutMessage::NetOutMessage()
+	NetOutMessage::NetOutMessage() : nextFree(0)
 	{
 		ResetWriting();
 	}
@@ -34,6 +34,7 @@ namespace ProtocolUtilities
             currentBlock = rhs.currentBlock;
             currentVariable = rhs.currentVariable;
             blockQuantityCounter = rhs.blockQuantityCounter;        
+            nextFree = 0;
         }
         
         // The following functions all append data into the message. The way this works is that the application calls the following AddX functions in the order
@@ -143,6 +144,9 @@ namespace ProtocolUtilities
         
         /// Keeps count how many times the same block must be repeated.
         size_t blockQuantityCounter;
+
+        /// Link to the next message in NetMessageManager's free list. Only valid while the message is unused.
+        NetOutMessage *nextFree;
     };
 
 }
@@ -0,0 +1,225 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+#include "StableHeaders.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "NetResendScheduler.h"
+#include "NetOutMessage.h"
+
+namespace ProtocolUtilities
+{
+    const double NetResendScheduler::cMinRto = 0.2;
+    const double NetResendScheduler::cMaxRto = 10.0;
+    const double NetResendScheduler::cInitialRto = 1.0;
+
+    /// Initial size of the congestion window, in bytes.
+    static const size_t cInitialWindow = 64 * 1024;
+
+    /// The congestion window is never reduced below this, in bytes.
+    static const size_t cMinWindow = 8 * 1024;
+
+    /// The congestion window is never grown above this, in bytes.
+    static const size_t cMaxWindow = 1024 * 1024;
+
+    /// Nominal datagram size used for growing the congestion window, in bytes.
+    static const size_t cNominalPacketSize = 1200;
+
+    /// Clock granularity term of the RTO formula, in seconds.
+    static const double cClockGranularity = 0.01;
+
+    NetResendScheduler::NetResendScheduler() :
+        srtt_(0.0),
+        rttvar_(0.0),
+        lastRtt_(0.0),
+        rto_(cInitialRto),
+        rttSamples_(0),
+        timeouts_(0),
+        bytesInFlight_(0),
+        congestionWindow_(cInitialWindow),
+        lastWindowReduction_(0)
+    {
+    }
+
+    bool NetResendScheduler::CanSend(size_t numBytes) const
+    {
+        return bytesInFlight_ == 0 || bytesInFlight_ + numBytes <= congestionWindow_;
+    }
+
+    bool NetResendScheduler::MessageSent(NetOutMessage *msg, size_t numBytes, const Poco::Timestamp &now)
+    {
+        assert(msg);
+        const uint32_t packetID = msg->GetSequenceNumber();
+        if (pending_.find(packetID) != pending_.end())
+            return false;
+
+        PendingMessage &pending = pending_[packetID];
+        pending.msg = msg;
+        pending.numBytes = numBytes;
+        pending.firstSent = now;
+        pending.sendCount = 1;
+        bytesInFlight_ += numBytes;
+
+        ScheduleDeadline(packetID, pending, now);
+        return true;
+    }
+
+    NetOutMessage *NetResendScheduler::MessageAcked(uint32_t packetID, const Poco::Timestamp &now)
+    {
+        PendingMap::iterator iter = pending_.find(packetID);
+        if (iter == pending_.end())
+            return 0;
+
+        const PendingMessage &pending = iter->second;
+
+        // Karn's algorithm: the ack of a resent message is ambiguous, so it's not used as a sample.
+        if (pending.sendCount == 1)
+            AddRttSample((now - pending.firstSent) / 1000000.0);
+
+        assert(bytesInFlight_ >= pending.numBytes);
+        bytesInFlight_ -= pending.numBytes;
+
+        // Additive increase: roughly one nominal packet per window's worth of acked data.
+        size_t growth = cNominalPacketSize * pending.numBytes / congestionWindow_;
+        congestionWindow_ = std::min(congestionWindow_ + std::max<size_t>(growth, 1), cMaxWindow);
+
+        NetOutMessage *msg = pending.msg;
+        pending_.erase(iter);
+
+        // If everything has been acked, the heap only contains outdated entries.
+        if (pending_.empty())
+            deadlines_.clear();
+
+        return msg;
+    }
+
+    NetOutMessage *NetResendScheduler::NextTimedOutMessage(const Poco::Timestamp &now)
+    {
+        while(!deadlines_.empty() && deadlines_.front().time <= now)
+        {
+            Deadline deadline = deadlines_.front();
+            std::pop_heap(deadlines_.begin(), deadlines_.end());
+            deadlines_.pop_back();
+
+            PendingMap::iterator iter = pending_.find(deadline.packetID);
+            if (iter == pending_.end() || iter->second.sendCount != deadline.sendCount)
+                continue; // Outdated entry: the message was acked or already rescheduled.
+
+            PendingMessage &pending = iter->second;
+            ++pending.sendCount;
+            ++timeouts_;
+
+            // Multiplicative decrease, once per RTO.
+            if (now - lastWindowReduction_ >= (Poco::Timestamp::TimeDiff)(rto_ * 1000000.0))
+            {
+                congestionWindow_ = std::max(congestionWindow_ / 2, cMinWindow);
+                lastWindowReduction_ = now;
+            }
+
+            ScheduleDeadline(deadline.packetID, pending, now);
+            return pending.msg;
+        }
+
+        return 0;
+    }
+
+    void NetResendScheduler::Defer(NetOutMessage *msg)
+    {
+        assert(msg);
+        deferred_.push_back(msg);
+    }
+
+    NetOutMessage *NetResendScheduler::NextSendableDeferredMessage(size_t numBytes)
+    {
+        if (deferred_.empty() || !CanSend(numBytes))
+            return 0;
+
+        NetOutMessage *msg = deferred_.front();
+        deferred_.pop_front();
+        return msg;
+    }
+
+    void NetResendScheduler::AddRttSample(double rtt)
+    {
+        if (rtt < 0.0)
+            return;
+
+        // RFC 6298, section 2.
+        if (rttSamples_ == 0)
+        {
+            srtt_ = rtt;
+            rttvar_ = rtt / 2.0;
+        }
+        else
+        {
+            const double alpha = 1.0 / 8.0;
+            const double beta = 1.0 / 4.0;
+            rttvar_ = (1.0 - beta) * rttvar_ + beta * fabs(srtt_ - rtt);
+            srtt_ = (1.0 - alpha) * srtt_ + alpha * rtt;
+        }
+
+        lastRtt_ = rtt;
+        ++rttSamples_;
+
+        rto_ = srtt_ + std::max(cClockGranularity, 4.0 * rttvar_);
+        rto_ = std::min(std::max(rto_, cMinRto), cMaxRto);
+    }
+
+    uint32_t NetResendScheduler::OldestUnacked() const
+    {
+        uint32_t oldest = 0;
+        for(PendingMap::const_iterator iter = pending_.begin(); iter != pending_.end(); ++iter)
+            if (oldest == 0 || iter->first < oldest)
+                oldest = iter->first;
+
+        return oldest;
+    }
+
+    void NetResendScheduler::Clear(std::vector<NetOutMessage *> &messages)
+    {
+        for(PendingMap::iterator iter = pending_.begin(); iter != pending_.end(); ++iter)
+            messages.push_back(iter->second.msg);
+        messages.insert(messages.end(), deferred_.begin(), deferred_.end());
+
+        pending_.clear();
+        deadlines_.clear();
+        deferred_.clear();
+        bytesInFlight_ = 0;
+    }
+
+    NetResendStats NetResendScheduler::GetStats() const
+    {
+        NetResendStats stats;
+        stats.smoothedRtt = srtt_;
+        stats.rttVariation = rttvar_;
+        stats.lastRtt = lastRtt_;
+        stats.retransmissionTimeout = rto_;
+        stats.messagesInFlight = pending_.size();
+        stats.bytesInFlight = bytesInFlight_;
+        stats.congestionWindow = congestionWindow_;
+        stats.messagesDeferred = deferred_.size();
+        stats.rttSamples = rttSamples_;
+        stats.timeouts = timeouts_;
+        return stats;
+    }
+
+    void NetResendScheduler::ScheduleDeadline(uint32_t packetID, const PendingMessage &pending, const Poco::Timestamp &now)
+    {
+        Deadline deadline;
+        deadline.time = now + BackedOffRto(pending.sendCount);
+        deadline.packetID = packetID;
+        deadline.sendCount = pending.sendCount;
+
+        deadlines_.push_back(deadline);
+        std::push_heap(deadlines_.begin(), deadlines_.end());
+    }
+
+    Poco::Timestamp::TimeDiff NetResendScheduler::BackedOffRto(int sendCount) const
+    {
+        double rto = rto_;
+        for(int i = 1; i < sendCount && rto < cMaxRto; ++i)
+            rto *= 2.0;
+
+        return (Poco::Timestamp::TimeDiff)(std::min(rto, cMaxRto) * 1000000.0);
+    }
+}
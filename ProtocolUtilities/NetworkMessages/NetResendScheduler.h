@@ -0,0 +1,197 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+#ifndef incl_ProtocolUtilities_NetResendScheduler_h
+#define incl_ProtocolUtilities_NetResendScheduler_h
+
+#include <vector>
+#include <deque>
+#include <boost/unordered_map.hpp>
+#include <Poco/Timestamp.h>
+
+#include "RexTypes.h"
+
+namespace ProtocolUtilities
+{
+    class NetOutMessage;
+
+    /// Snapshot of the state of a NetResendScheduler, for diagnostics.
+    struct NetResendStats
+    {
+        /// Smoothed round-trip time, in seconds. 0 if no samples have been taken yet.
+        double smoothedRtt;
+
+        /// Round-trip time variation, in seconds.
+        double rttVariation;
+
+        /// The most recent round-trip time sample, in seconds.
+        double lastRtt;
+
+        /// Current retransmission timeout for a message sent for the first time, in seconds.
+        double retransmissionTimeout;
+
+        /// The number of reliable messages waiting for an ack.
+        size_t messagesInFlight;
+
+        /// The number of bytes of reliable messages waiting for an ack.
+        size_t bytesInFlight;
+
+        /// The maximum number of reliable bytes allowed to be in flight at a time.
+        size_t congestionWindow;
+
+        /// The number of reliable messages held back because the congestion window was full.
+        size_t messagesDeferred;
+
+        /// The total number of round-trip time samples taken.
+        size_t rttSamples;
+
+        /// The total number of reliable message timeouts.
+        size_t timeouts;
+    };
+
+    /// Tracks the reliable outbound messages which are waiting for an ack, and decides when each of them needs to be
+    /// resent. Used by NetMessageManager, which does the actual sending.
+    ///
+    /// The retransmission timeout (RTO) is estimated from round-trip time samples as described in RFC 6298. Samples
+    /// are taken from the acks of messages which were sent only once (Karn's algorithm) and from ping checks. Each
+    /// resend of a message doubles its timeout, up to cMaxRto. Pending messages are indexed by sequence number so an
+    /// ack is handled in constant time, and the resend deadlines are kept in a heap so finding the timed out messages
+    /// doesn't need to look at every pending message.
+    ///
+    /// The number of reliable bytes in flight is limited by a congestion window which grows as acks arrive and is
+    /// halved when messages time out. Reliable messages which don't fit in the window are deferred and sent in order
+    /// when acks make room for them.
+    class NetResendScheduler
+    {
+    public:
+        NetResendScheduler();
+
+        /// The smallest retransmission timeout, in seconds.
+        static const double cMinRto;
+
+        /// The largest retransmission timeout, in seconds. Also caps the exponential backoff.
+        static const double cMaxRto;
+
+        /// The retransmission timeout used before any round-trip time samples have been taken, in seconds.
+        static const double cInitialRto;
+
+        /// @return True if a reliable message of the given size can be sent right away, or false if it should be
+        ///         deferred. Always true if nothing is in flight, so a message larger than the window still goes out.
+        bool CanSend(size_t numBytes) const;
+
+        /// Starts tracking a reliable message which was just sent for the first time.
+        /// @return False if a message with the same sequence number is already being tracked.
+        bool MessageSent(NetOutMessage *msg, size_t numBytes, const Poco::Timestamp &now);
+
+        /// Handles an ack. Takes a round-trip time sample if the message was sent only once.
+        /// @return The acked message, which is no longer tracked, or 0 if no message with the given sequence number
+        ///         was waiting for an ack (e.g. a duplicate ack).
+        NetOutMessage *MessageAcked(uint32_t packetID, const Poco::Timestamp &now);
+
+        /// Finds a message whose resend deadline has passed. The message stays tracked, its deadline is pushed
+        /// forward with exponential backoff and the congestion window is reduced. Call repeatedly until it returns 0.
+        /// @return The message to resend, or 0 if no messages have timed out.
+        NetOutMessage *NextTimedOutMessage(const Poco::Timestamp &now);
+
+        /// Adds a reliable message to the back of the queue of messages waiting for room in the congestion window.
+        void Defer(NetOutMessage *msg);
+
+        /// @return True if there are deferred messages.
+        bool HasDeferredMessages() const { return !deferred_.empty(); }
+
+        /// @return The oldest deferred message, if it now fits in the congestion window. The message is removed from
+        ///         the deferred queue. 0 if there are no deferred messages or the window is still full.
+        NetOutMessage *NextSendableDeferredMessage(size_t numBytes);
+
+        /// @return The oldest deferred message, or 0 if there are none.
+        NetOutMessage *PeekDeferredMessage() const { return deferred_.empty() ? 0 : deferred_.front(); }
+
+        /// Feeds a round-trip time sample measured outside the scheduler, e.g. from a ping check.
+        /// @param rtt The round-trip time, in seconds.
+        void AddRttSample(double rtt);
+
+        /// @return The sequence number of the oldest message waiting for an ack, or 0 if there are none.
+        uint32_t OldestUnacked() const;
+
+        /// @return True if no messages are being tracked or deferred.
+        bool IsEmpty() const { return pending_.empty() && deferred_.empty(); }
+
+        /// Stops tracking all messages. The caller is responsible for the messages.
+        /// @param messages [out] All the messages that were tracked or deferred are appended here.
+        void Clear(std::vector<NetOutMessage *> &messages);
+
+        /// @return The current state of the scheduler.
+        NetResendStats GetStats() const;
+
+    private:
+        /// A reliable message waiting for an ack.
+        struct PendingMessage
+        {
+            NetOutMessage *msg;
+            /// Size of the message, in bytes.
+            size_t numBytes;
+            /// When the message was first sent.
+            Poco::Timestamp firstSent;
+            /// How many times the message has been sent.
+            int sendCount;
+        };
+
+        /// A resend deadline in the deadline heap. Entries of acked and already resent messages are left in the heap
+        /// and skipped when they reach the top.
+        struct Deadline
+        {
+            Poco::Timestamp time;
+            uint32_t packetID;
+            /// The send count of the message when the deadline was set. Used to detect outdated entries.
+            int sendCount;
+
+            /// Orders the heap so that the earliest deadline is at the top.
+            bool operator<(const Deadline &rhs) const { return time > rhs.time; }
+        };
+
+        typedef boost::unordered_map<uint32_t, PendingMessage> PendingMap;
+
+        /// Adds a deadline for the given pending message, based on the current RTO and the message's send count.
+        void ScheduleDeadline(uint32_t packetID, const PendingMessage &pending, const Poco::Timestamp &now);
+
+        /// @return The current RTO, backed off for a message which has been sent the given number of times.
+        Poco::Timestamp::TimeDiff BackedOffRto(int sendCount) const;
+
+        /// Reliable messages waiting for an ack, by sequence number.
+        PendingMap pending_;
+
+        /// Heap of resend deadlines.
+        std::vector<Deadline> deadlines_;
+
+        /// Reliable messages waiting for room in the congestion window.
+        std::deque<NetOutMessage *> deferred_;
+
+        /// Smoothed round-trip time, in seconds.
+        double srtt_;
+
+        /// Round-trip time variation, in seconds.
+        double rttvar_;
+
+        /// The most recent round-trip time sample, in seconds.
+        double lastRtt_;
+
+        /// Retransmission timeout, in seconds.
+        double rto_;
+
+        /// Number of round-trip time samples taken.
+        size_t rttSamples_;
+
+        /// Number of message timeouts.
+        size_t timeouts_;
+
+        /// Bytes of reliable messages waiting for an ack.
+        size_t bytesInFlight_;
+
+        /// Maximum number of reliable bytes in flight.
+        size_t congestionWindow_;
+
+        /// When the congestion window was last reduced. The window is reduced at most once per RTO, so that a burst
+        /// of losses doesn't collapse it all the way down.
+        Poco::Timestamp lastWindowReduction_;
+    };
+}
+
+#endif // incl_ProtocolUtilities_NetResendScheduler_h
@@ -0,0 +1,30 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+#ifndef incl_ProtocolUtilities_NetThrottleCategory_h
+#define incl_ProtocolUtilities_NetThrottleCategory_h
+
+namespace ProtocolUtilities
+{
+    /// The traffic categories of the AgentThrottle message, in the order they appear in the throttle block.
+    enum ThrottleCategory
+    {
+        TC_Resend = 0,
+        TC_Land,
+        TC_Wind,
+        TC_Cloud,
+        TC_Task,
+        TC_Texture,
+        TC_Asset,
+        TC_NumCategories
+    };
+
+    /// @return Name of the throttle category, for diagnostics.
+    inline const char *ThrottleCategoryName(ThrottleCategory category)
+    {
+        static const char *names[TC_NumCategories] = { "resend", "land", "wind", "cloud", "task", "texture", "asset" };
+        if (category < 0 || category >= TC_NumCategories)
+            return "invalid";
+        return names[category];
+    }
+}
+
+#endif // incl_ProtocolUtilities_NetThrottleCategory_h
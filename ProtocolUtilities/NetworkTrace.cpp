@@ -0,0 +1,205 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+#include "StableHeaders.h"
+
+#include <cstring>
+
+#include "NetworkTrace.h"
+#include "CoreStringUtils.h"
+
+namespace ProtocolUtilities
+{
+
+static const char cTraceMagic[] = "RXTRACE1";
+static const size_t cTraceMagicSize = 8;
+
+/// Reads a value of type T from the trace data at the given offset, and advances the offset.
+/// @return False if there are not enough bytes left.
+template<typename T>
+static bool ReadTraceValue(const std::vector<uint8_t> &data, size_t &offset, T &value)
+{
+    if (data.size() - offset < sizeof(T))
+        return false;
+
+    memcpy(&value, &data[offset], sizeof(T));
+    offset += sizeof(T);
+    return true;
+}
+
+static bool ReadTraceString(const std::vector<uint8_t> &data, size_t &offset, std::string &str)
+{
+    uint32_t size = 0;
+    if (!ReadTraceValue(data, offset, size) || data.size() - offset < size)
+        return false;
+
+    str.assign((const char *)&data[offset], size);
+    offset += size;
+    return true;
+}
+
+NetworkTraceWriter::NetworkTraceWriter() : datagramCount(0)
+{
+}
+
+NetworkTraceWriter::~NetworkTraceWriter()
+{
+    Close();
+}
+
+bool NetworkTraceWriter::Open(const std::string &filename, const ClientParameters &parameters)
+{
+    Close();
+
+    file.open(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        return false;
+
+    file.write(cTraceMagic, cTraceMagicSize);
+    WriteString(parameters.agentID.ToString());
+    WriteString(parameters.sessionID.ToString());
+    WriteString(parameters.regionID.ToString());
+    WriteString(ToString(parameters.circuitCode));
+    WriteString(parameters.gridUrl);
+    WriteString(ToString(parameters.regionX));
+    WriteString(ToString(parameters.regionY));
+
+    startTime.update();
+    datagramCount = 0;
+    return true;
+}
+
+void NetworkTraceWriter::Close()
+{
+    if (file.is_open())
+        file.close();
+}
+
+void NetworkTraceWriter::WriteDatagram(const uint8_t *data, size_t numBytes)
+{
+    if (!file.is_open())
+        return;
+
+    const double time = startTime.elapsed() / 1000000.0;
+    const uint32_t size = (uint32_t)numBytes;
+    file.write((const char *)&time, sizeof(time));
+    file.write((const char *)&size, sizeof(size));
+    file.write((const char *)data, numBytes);
+    ++datagramCount;
+}
+
+void NetworkTraceWriter::WriteString(const std::string &str)
+{
+    const uint32_t size = (uint32_t)str.size();
+    file.write((const char *)&size, sizeof(size));
+    file.write(str.data(), str.size());
+}
+
+TraceConnection::TraceConnection(double speed_) :
+    nextDatagram(0),
+    speed(speed_),
+    started(false),
+    replayTime(0.0)
+{
+}
+
+TraceConnection::~TraceConnection()
+{
+}
+
+bool TraceConnection::Load(const std::string &filename)
+{
+    traceData.clear();
+    datagrams.clear();
+    nextDatagram = 0;
+
+    std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    file.seekg(0, std::ios::end);
+    const std::streamoff fileSize = file.tellg();
+    file.seekg(0, std::ios::beg);
+    if (fileSize < (std::streamoff)cTraceMagicSize)
+        return false;
+
+    traceData.resize((size_t)fileSize);
+    file.read((char *)&traceData[0], fileSize);
+    if (!file || memcmp(&traceData[0], cTraceMagic, cTraceMagicSize) != 0)
+        return false;
+
+    size_t offset = cTraceMagicSize;
+    std::string agentID, sessionID, regionID, circuitCode, regionX, regionY;
+    if (!ReadTraceString(traceData, offset, agentID) || !ReadTraceString(traceData, offset, sessionID) ||
+        !ReadTraceString(traceData, offset, regionID) || !ReadTraceString(traceData, offset, circuitCode) ||
+        !ReadTraceString(traceData, offset, parameters.gridUrl) || !ReadTraceString(traceData, offset, regionX) ||
+        !ReadTraceString(traceData, offset, regionY))
+        return false;
+
+    parameters.agentID.FromString(agentID);
+    parameters.sessionID.FromString(sessionID);
+    parameters.regionID.FromString(regionID);
+    parameters.circuitCode = ParseString<uint32_t>(circuitCode, 0);
+    parameters.regionX = ParseString<uint16_t>(regionX, 1000);
+    parameters.regionY = ParseString<uint16_t>(regionY, 1000);
+
+    // Index the datagrams. A datagram cut short by the end of the file is ignored.
+    for(;;)
+    {
+        Datagram datagram;
+        uint32_t size = 0;
+        if (!ReadTraceValue(traceData, offset, datagram.time) || !ReadTraceValue(traceData, offset, size) ||
+            traceData.size() - offset < size)
+            break;
+
+        datagram.offset = offset;
+        datagram.size = size;
+        datagrams.push_back(datagram);
+        offset += size;
+    }
+
+    return true;
+}
+
+double TraceConnection::GetElapsedTime() const
+{
+    if (!started)
+    {
+        startTime.update();
+        started = true;
+    }
+
+    return startTime.elapsed() / 1000000.0;
+}
+
+bool TraceConnection::PacketsAvailable() const
+{
+    if (!Open() || IsFinished())
+        return false;
+
+    return speed <= 0.0 || datagrams[nextDatagram].time <= GetElapsedTime() * speed;
+}
+
+int TraceConnection::ReceiveBytes(uint8_t *bytes, size_t maxCount)
+{
+    if (!PacketsAvailable())
+        return 0;
+
+    const Datagram &datagram = datagrams[nextDatagram++];
+    const size_t numBytes = std::min(datagram.size, maxCount);
+    memcpy(bytes, &traceData[datagram.offset], numBytes);
+
+    replayTime = GetElapsedTime();
+    return (int)numBytes;
+}
+
+void TraceConnection::SendBytes(const uint8_t *bytes, size_t count)
+{
+}
+
+void TraceConnection::AddHandlingTime(NetMsgID id, double seconds)
+{
+    TraceHandlingTime &time = handlingTimes[id];
+    ++time.count;
+    time.seconds += seconds;
+}
+
+}
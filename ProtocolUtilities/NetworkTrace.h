@@ -0,0 +1,157 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+#ifndef incl_ProtocolUtilities_NetworkTrace_h
+#define incl_ProtocolUtilities_NetworkTrace_h
+
+#include <fstream>
+#include <map>
+#include <vector>
+
+#include "Poco/Timestamp.h"
+
+#include "NetworkConnection.h"
+#include "NetworkEvents.h"
+#include "NetworkMessages/NetMessage.h"
+
+namespace ProtocolUtilities
+{
+    /// Records the inbound datagrams of a connection to a trace file, with the time each datagram was received.
+    /// The client parameters of the connection are stored in the beginning of the file, so that the trace can
+    /// be replayed with TraceConnection without a server. UDP texture and asset transfers are part of the trace,
+    /// as they arrive in datagrams.
+    ///
+    /// File format, in the byte order of the recording machine:
+    /// - 8 bytes magic "RXTRACE1"
+    /// - Client parameters as length-prefixed strings: agent ID, session ID, region ID, circuit code, grid url,
+    ///   region x, region y
+    /// - Datagrams until the end of file: f64 seconds since the recording started, u32 size, the datagram bytes
+    class NetworkTraceWriter
+    {
+    public:
+        NetworkTraceWriter();
+        ~NetworkTraceWriter();
+
+        /// Creates the trace file and writes the client parameters of the connection to it.
+        /// @return True if the file could be created.
+        bool Open(const std::string &filename, const ClientParameters &parameters);
+
+        /// Closes the trace file.
+        void Close();
+
+        /// @return True if a trace file is open.
+        bool IsOpen() const { return file.is_open(); }
+
+        /// Appends a datagram to the trace, timestamped with the time since Open().
+        void WriteDatagram(const uint8_t *data, size_t numBytes);
+
+        /// @return The number of datagrams written since Open().
+        size_t GetDatagramCount() const { return datagramCount; }
+
+    private:
+        NetworkTraceWriter(const NetworkTraceWriter &);
+        void operator=(const NetworkTraceWriter &);
+
+        void WriteString(const std::string &str);
+
+        std::ofstream file;
+
+        /// When the trace file was opened.
+        Poco::Timestamp startTime;
+
+        size_t datagramCount;
+    };
+
+    /// Time spent handling the inbound messages of one type during a replay.
+    struct TraceHandlingTime
+    {
+        TraceHandlingTime() : count(0), seconds(0.0) {}
+
+        /// Number of messages handled.
+        size_t count;
+
+        /// Total time spent in the message listener, in seconds.
+        double seconds;
+    };
+
+    /// A stand-in for the UDP connection that plays back a trace recorded with NetworkTraceWriter. Used with
+    /// NetMessageManager::SetReplayConnection to benchmark the handling of the inbound traffic of e.g. a region load
+    /// deterministically and without a server. Outbound datagrams are discarded.
+    class TraceConnection : public NetworkConnection
+    {
+    public:
+        /// @param speed Playback speed relative to the recording. With 0, all datagrams are played back as fast as
+        ///        they are asked for.
+        explicit TraceConnection(double speed);
+        virtual ~TraceConnection();
+
+        /// Reads the whole trace file into memory.
+        /// @return True if the file is a valid trace.
+        bool Load(const std::string &filename);
+
+        /// @return The client parameters of the recorded connection.
+        const ClientParameters &GetClientParameters() const { return parameters; }
+
+        /// @return True if the next datagram is due. The playback clock starts from the first call.
+        virtual bool PacketsAvailable() const;
+
+        /// Copies the next datagram to the buffer, if it is due.
+        virtual int ReceiveBytes(uint8_t *bytes, size_t maxCount);
+
+        /// Discards the datagram.
+        virtual void SendBytes(const uint8_t *bytes, size_t count);
+
+        /// @return True if all datagrams have been played back.
+        bool IsFinished() const { return nextDatagram >= datagrams.size(); }
+
+        /// @return Number of datagrams in the trace.
+        size_t GetDatagramCount() const { return datagrams.size(); }
+
+        /// @return Number of datagrams played back so far.
+        size_t GetReplayedCount() const { return nextDatagram; }
+
+        /// @return Seconds from the start of the playback to the last played back datagram.
+        double GetReplayTime() const { return replayTime; }
+
+        /// Adds the time spent handling an inbound message to the per message type timings.
+        void AddHandlingTime(NetMsgID id, double seconds);
+
+        typedef std::map<NetMsgID, TraceHandlingTime> HandlingTimeMap;
+
+        /// @return Time spent handling each type of inbound message.
+        const HandlingTimeMap &GetHandlingTimes() const { return handlingTimes; }
+
+    private:
+        struct Datagram
+        {
+            /// Seconds since the recording started.
+            double time;
+            /// Offset of the datagram in the trace data.
+            size_t offset;
+            size_t size;
+        };
+
+        /// @return Seconds since the playback started.
+        double GetElapsedTime() const;
+
+        /// The whole trace file.
+        std::vector<uint8_t> traceData;
+
+        std::vector<Datagram> datagrams;
+
+        /// Index of the next datagram to play back.
+        size_t nextDatagram;
+
+        double speed;
+
+        /// When the playback started. Set at the first poll, so that the time spent loading the trace isn't counted.
+        mutable Poco::Timestamp startTime;
+        mutable bool started;
+
+        double replayTime;
+
+        ClientParameters parameters;
+
+        HandlingTimeMap handlingTimes;
+    };
+}
+
+#endif
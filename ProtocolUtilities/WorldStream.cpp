@@ -11,6 +11,8 @@
 #include "Framework.h"
 #include "ConfigurationManager.h"
 #include "ModuleManager.h"
+#include "AssetServiceInterface.h"
+#include "NetworkMessages/NetMessageManager.h"
 
 #include <QString>
 #include <QUrl>
@@ -34,7 +36,8 @@ WorldStream::WorldStream(Foundation::Framework *framework) :
     password_(""),
     username_(""),
     auth_server_address_(""),
-    blockSerialNumber_(0)
+    blockSerialNumber_(0),
+    bandwidthManager_(framework->GetDefaultConfig().DeclareSetting("RexLogicModule", "max_bits_per_second", 1000000.0f))
 {
     clientParameters_.Reset();
     SetCurrentProtocolType(NotSet);
@@ -92,6 +95,7 @@ bool WorldStream::CreateUdpConnection()
     else
     {
         connected_ = true;
+        bandwidthManager_.Reset();
         SendLoginSuccessfullPackets();
         SendMapBlockPacket();
         LogInfo("Connected to server " + serverAddress_);
@@ -177,20 +181,13 @@ void WorldStream::SendAgentThrottlePacket()
     if (!connected_)
         return;
 
-    Real max_bits_per_second = framework_->GetDefaultConfig().DeclareSetting(
-        "RexLogicModule", "max_bits_per_second", 1000000.0f);
-
     int idx = 0;
-    static const size_t size = 7 * sizeof(Real);
+    static const size_t size = TC_NumCategories * sizeof(Real);
     u8 throttle_block[size];
 
-    WriteFloatToBytes(max_bits_per_second * 0.1f, throttle_block, idx); // resend
-    WriteFloatToBytes(max_bits_per_second * 0.1f, throttle_block, idx); // land
-    WriteFloatToBytes(max_bits_per_second * 0.02f, throttle_block, idx); // wind
-    WriteFloatToBytes(max_bits_per_second * 0.02f, throttle_block, idx); // cloud
-    WriteFloatToBytes(max_bits_per_second * 0.25f, throttle_block, idx); // task
-    WriteFloatToBytes(max_bits_per_second * 0.26f, throttle_block, idx); // texture
-    WriteFloatToBytes(max_bits_per_second * 0.25f, throttle_block, idx); // asset
+    // resend, land, wind, cloud, task, texture, asset
+    for(int i = 0; i < TC_NumCategories; ++i)
+        WriteFloatToBytes(bandwidthManager_.GetThrottle((ThrottleCategory)i), throttle_block, idx);
 
     NetOutMessage *m = StartMessageBuilding(RexNetMsgAgentThrottle);
     assert(m);
@@ -198,7 +195,7 @@ void WorldStream::SendAgentThrottlePacket()
     m->AddUUID(clientParameters_.agentID);
     m->AddUUID(clientParameters_.sessionID);
     m->AddU32(clientParameters_.circuitCode);
-    m->AddU32(0); // Generation counter
+    m->AddU32(bandwidthManager_.ThrottlesSent()); // Generation counter
     m->AddBuffer(size, throttle_block); // throttles
     m->MarkReliable();
 
@@ -1666,6 +1663,44 @@ void WorldStream::UnregisterCurrentProtocolModule()
     protocolModule_.reset();
 }
 
+void WorldStream::UpdateBandwidth(f64 frametime)
+{
+    if (!connected_)
+        return;
+
+    protocolModule_ = GetCurrentProtocolModule();
+    if (!protocolModule_.get() || !protocolModule_->GetNetworkMessageManager())
+        return;
+
+    // The download queue depths tell which categories have work waiting. Going through the transfers is not
+    // free, so only do it when the bandwidth manager is about to measure.
+    size_t pending_textures = 0;
+    size_t pending_assets = 0;
+    boost::shared_ptr<Foundation::AssetServiceInterface> asset_service;
+    if (bandwidthManager_.IsMeasurementDue(frametime))
+        asset_service = framework_->GetServiceManager()->GetService<Foundation::AssetServiceInterface>(Foundation::Service::ST_Asset).lock();
+    if (asset_service)
+    {
+        Foundation::AssetTransferInfoVector transfers = asset_service->GetAssetTransferInfo();
+        for(size_t i = 0; i < transfers.size(); ++i)
+        {
+            if (transfers[i].type_ == RexTypes::ASSETTYPENAME_TEXTURE)
+                ++pending_textures;
+            else
+                ++pending_assets;
+        }
+    }
+
+    if (bandwidthManager_.Update(frametime, *protocolModule_->GetNetworkMessageManager(), pending_textures, pending_assets))
+        SendAgentThrottlePacket();
+}
+
+void WorldStream::SetMaxBandwidth(Real bitsPerSecond)
+{
+    bandwidthManager_.SetMaxBitsPerSecond(bitsPerSecond);
+    SendAgentThrottlePacket();
+}
+
 /********************** private **********************/
 
 void WorldStream::SendLoginSuccessfullPackets()
@@ -8,6 +8,7 @@
 #include "Vector3D.h"
 #include "Quaternion.h"
 #include "NetworkEvents.h"
+#include "BandwidthManager.h"
 
 #include <QObject>
 
@@ -109,8 +110,7 @@ namespace ProtocolUtilities
         /// In reX mode, this causes the server to send the avatar appearance address
         void SendAgentWearablesRequestPacket();
 
-        /// Tells client bandwidth to the server
-        /// \todo make configurable or measure, now a fixed value
+        /// Tells the client's per-category bandwidth limits to the server. The limits are decided by the bandwidth manager.
         void SendAgentThrottlePacket();
 
         /// Sends a RexStartup state generic message
@@ -513,6 +513,17 @@ namespace ProtocolUtilities
         /// Unregisters the eventmanager from current Protocol Module
         void UnregisterCurrentProtocolModule();
 
+        /// Measures the inbound traffic and sends new throttles to the server if the bandwidth manager asks for it.
+        /// @param frametime Seconds since the last call.
+        void UpdateBandwidth(f64 frametime);
+
+        /// Sets the largest total bandwidth the server is asked to use, and sends new throttles if connected.
+        /// @param bitsPerSecond The bandwidth, in bits per second.
+        void SetMaxBandwidth(Real bitsPerSecond);
+
+        /// @return The bandwidth manager, which holds the current throttles and traffic measurements.
+        const BandwidthManager &GetBandwidthManager() const { return bandwidthManager_; }
+
     private:
         Q_DISABLE_COPY(WorldStream);
 
@@ -586,6 +597,9 @@ namespace ProtocolUtilities
 
         /// Block serial number used for AgentPause and AgentResume messages.
         uint32_t blockSerialNumber_;
+
+        /// Decides the throttles sent with AgentThrottle.
+        BandwidthManager bandwidthManager_;
     };
 }
 
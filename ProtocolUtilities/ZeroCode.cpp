@@ -3,9 +3,69 @@
 
 #include "ZeroCode.h"
 
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ZEROCODE_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
 namespace ProtocolUtilities
 {
 
+#ifdef ZEROCODE_SSE2
+    /// @return The index of the lowest set bit in a non-zero mask.
+    static inline size_t LowestSetBit(unsigned int mask)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return index;
+#else
+        return __builtin_ctz(mask);
+#endif
+    }
+#endif
+
+    /// @return The index of the first zero byte in data[i, numBytes), or numBytes if there is none.
+    static inline size_t FindZero(const uint8_t *data, size_t i, size_t numBytes)
+    {
+#ifdef ZEROCODE_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        for(; i + 16 <= numBytes; i += 16)
+        {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, zero));
+            if (mask != 0)
+                return i + LowestSetBit(mask);
+        }
+#endif
+        while(i < numBytes && data[i] != 0)
+            ++i;
+        return i;
+    }
+
+    /// @return The index of the first non-zero byte in data[i, numBytes), or numBytes if there is none.
+    static inline size_t FindNonZero(const uint8_t *data, size_t i, size_t numBytes)
+    {
+#ifdef ZEROCODE_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        for(; i + 16 <= numBytes; i += 16)
+        {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            unsigned int mask = ~(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, zero)) & 0xFFFF;
+            if (mask != 0)
+                return i + LowestSetBit(mask);
+        }
+#endif
+        while(i < numBytes && data[i] == 0)
+            ++i;
+        return i;
+    }
+
     size_t CountConsecutiveZeroes(const uint8_t *data, size_t i, size_t numBytes)
     {
         size_t count = 0;
@@ -27,7 +87,8 @@ namespace ProtocolUtilities
             if (data[i] == 0) // Hit a zero?
             {
                 size_t numZeroes = CountConsecutiveZeroes(data, i, numBytes);
-                length += 1 + numZeroes;
+                // Each run of up to 255 zeroes takes two bytes: a zero and the run length.
+                length += 2 * ((numZeroes + 254) / 255);
                 i += numZeroes;
             }
             else
@@ -115,16 +176,20 @@ namespace ProtocolUtilities
                 size_t numZeroes = CountConsecutiveZeroes(srcData, src, srcBytes);
                 src += numZeroes;
 
-                ///\bug Fails on a run of 256 or more zeroes.
-
-                ///\todo Warning log out.
-                if (dst >= dstBytes)
-                    return false; // Whoops! Caller didn't provide a buffer big enough!
-                dstData[dst++] = 0;
-                ///\todo Warning log out.
-                if (dst >= dstBytes)
-                    return false; // Whoops! Caller didn't provide a buffer big enough!
-                dstData[dst++] = numZeroes;
+                // The run length is a single byte, so split the run into runs of at most 255 zeroes.
+                while(numZeroes > 0)
+                {
+                    size_t run = numZeroes < 255 ? numZeroes : 255;
+                    ///\todo Warning log out.
+                    if (dst >= dstBytes)
+                        return false; // Whoops! Caller didn't provide a buffer big enough!
+                    dstData[dst++] = 0;
+                    ///\todo Warning log out.
+                    if (dst >= dstBytes)
+                        return false; // Whoops! Caller didn't provide a buffer big enough!
+                    dstData[dst++] = (uint8_t)run;
+                    numZeroes -= run;
+                }
             }
             else
             {
@@ -138,4 +203,83 @@ namespace ProtocolUtilities
         return true;
     }
 
-}
\ No newline at end of file
+    size_t ZeroEncodeSinglePass(uint8_t *dstData, size_t dstBytes, const uint8_t *srcData, size_t srcBytes)
+    {
+        size_t dst = 0;
+        size_t src = 0;
+
+        while(src < srcBytes)
+        {
+            // Copy the literal span up to the next zero.
+            size_t zeroPos = FindZero(srcData, src, srcBytes);
+            size_t literalBytes = zeroPos - src;
+            if (literalBytes > 0)
+            {
+                if (dst + literalBytes > dstBytes)
+                    return 0; // Whoops! Caller didn't provide a buffer big enough!
+                memcpy(dstData + dst, srcData + src, literalBytes);
+                dst += literalBytes;
+                src = zeroPos;
+            }
+
+            if (src >= srcBytes)
+                break;
+
+            // Emit the zero run, split into runs of at most 255 zeroes.
+            size_t numZeroes = FindNonZero(srcData, src, srcBytes) - src;
+            src += numZeroes;
+            while(numZeroes > 0)
+            {
+                size_t run = numZeroes < 255 ? numZeroes : 255;
+                if (dst + 2 > dstBytes)
+                    return 0; // Whoops! Caller didn't provide a buffer big enough!
+                dstData[dst++] = 0;
+                dstData[dst++] = (uint8_t)run;
+                numZeroes -= run;
+            }
+        }
+
+        return dst;
+    }
+
+    size_t ZeroDecodeSinglePass(uint8_t *dstData, size_t dstBytes, const uint8_t *srcData, size_t srcBytes)
+    {
+        size_t dst = 0;
+        size_t src = 0;
+
+        while(src < srcBytes)
+        {
+            // Copy the literal span up to the next zero.
+            size_t zeroPos = FindZero(srcData, src, srcBytes);
+            size_t literalBytes = zeroPos - src;
+            if (literalBytes > 0)
+            {
+                if (dst + literalBytes > dstBytes)
+                    return 0; // Whoops! Caller didn't provide a buffer big enough!
+                memcpy(dstData + dst, srcData + src, literalBytes);
+                dst += literalBytes;
+                src = zeroPos;
+            }
+
+            if (src >= srcBytes)
+                break;
+
+            // A zero is followed by the length of the run.
+            if (src + 1 >= srcBytes) // Malformed zero-encoded packet found! (Ends in a zero without run-length!)
+                return 0;
+
+            size_t numZeroes = srcData[src + 1];
+            if (numZeroes == 0) // A run of zero zeroes? The packet is then malformed.
+                return 0;
+            if (dst + numZeroes > dstBytes)
+                return 0; // Whoops! Caller didn't provide a buffer big enough!
+
+            memset(dstData + dst, 0, numZeroes);
+            dst += numZeroes;
+            src += 2;
+        }
+
+        return dst;
+    }
+
+}
@@ -14,7 +14,7 @@ size_t CountZeroEncodedLength(const uint8_t *data, size_t numBytes);
 ///  or 0 if the data block is malformed and can't be decoded.
 size_t CountZeroDecodedLength(const uint8_t *zeroEncodedData, size_t numBytes);
 
-/// Zero-encodes the given data block.
+/// Zero-encodes the given data block. Zero runs longer than 255 bytes are split into several runs.
 /// @param dstData [out] The resulting zero-encoded block will be written here.
 /// @param dstBytes The maximum number of bytes that can be written to dstData.
 /// @param srcData The source buffer to encode.
@@ -32,6 +32,27 @@ bool ZeroEncode(uint8_t *dstData, size_t dstBytes, const uint8_t *srcData, size_
 ///  destination buffer or if some other error occurred.
 bool ZeroDecode(uint8_t *dstData, size_t dstBytes, const uint8_t *srcData, size_t srcBytes);
 
+/// Zero-encodes the given data block in a single pass, without counting the encoded length first. Literal spans and
+/// zero runs are located 16 bytes at a time with SSE2 where available, and copied with memcpy. Zero runs longer than
+/// 255 bytes are split into several runs.
+/// @param dstData [out] The resulting zero-encoded block will be written here.
+/// @param dstBytes The maximum number of bytes that can be written to dstData. Pass less than srcBytes to encode only
+///  if the encoding actually compresses the data.
+/// @param srcData The source buffer to encode.
+/// @param srcBytes The number of bytes to encode.
+/// @return The number of bytes written to dstData, or 0 if there wasn't enough space in the destination buffer.
+size_t ZeroEncodeSinglePass(uint8_t *dstData, size_t dstBytes, const uint8_t *srcData, size_t srcBytes);
+
+/// Zero-decodes the given data block in a single pass, without counting the decoded length first. Literal spans are
+/// located 16 bytes at a time with SSE2 where available, and copied with memcpy.
+/// @param dstData [out] The resulting zero-decoded block will be written here.
+/// @param dstBytes The maximum number of bytes that can be written to dstData.
+/// @param srcData The zero-encoded source buffer to decode.
+/// @param srcBytes The number of bytes to decode.
+/// @return The number of bytes written to dstData, or 0 if the data block is malformed or there wasn't enough space
+///  in the destination buffer.
+size_t ZeroDecodeSinglePass(uint8_t *dstData, size_t dstBytes, const uint8_t *srcData, size_t srcBytes);
+
 }
 
 #endif
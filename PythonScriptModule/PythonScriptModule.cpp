@@ -1701,6 +1701,79 @@ PyObject* GetCameraPosition(PyObject *self)
     Py_RETURN_NONE;
 }
 
+static PyObject* EntityIdsToList(const Scene::EntityIdVector &ids)
+{
+    PyObject* py_ids = PyList_New(ids.size());
+    for (uint i = 0; i < ids.size(); ++i)
+        PyList_SET_ITEM(py_ids, i, Py_BuildValue("I", ids[i]));
+    return py_ids;
+}
+
+PyObject* GetEntitiesInRadius(PyObject *self, PyObject *args)
+{
+    float x, y, z, radius;
+    if (!PyArg_ParseTuple(args, "ffff", &x, &y, &z, &radius))
+    {
+        PyErr_SetString(PyExc_ValueError, "Getting entities in radius failed, params should be x, y, z and radius.");
+        return NULL;
+    }
+
+    Scene::ScenePtr scene = PythonScriptModule::GetInstance()->GetScene();
+    if (!scene)
+    {
+        PyErr_SetString(PyExc_ValueError, "Scene is none.");
+        return NULL;
+    }
+
+    Scene::EntityIdVector ids;
+    scene->GetSpatialIndex().QueryRadius(Vector3df(x, y, z), radius, ids);
+    return EntityIdsToList(ids);
+}
+
+PyObject* GetEntitiesInBox(PyObject *self, PyObject *args)
+{
+    float minx, miny, minz, maxx, maxy, maxz;
+    if (!PyArg_ParseTuple(args, "ffffff", &minx, &miny, &minz, &maxx, &maxy, &maxz))
+    {
+        PyErr_SetString(PyExc_ValueError, "Getting entities in box failed, params should be the min and max corners.");
+        return NULL;
+    }
+
+    Scene::ScenePtr scene = PythonScriptModule::GetInstance()->GetScene();
+    if (!scene)
+    {
+        PyErr_SetString(PyExc_ValueError, "Scene is none.");
+        return NULL;
+    }
+
+    Scene::EntityIdVector ids;
+    scene->GetSpatialIndex().QueryBox(Vector3df(minx, miny, minz), Vector3df(maxx, maxy, maxz), ids);
+    return EntityIdsToList(ids);
+}
+
+PyObject* GetNearestEntities(PyObject *self, PyObject *args)
+{
+    float x, y, z;
+    unsigned int count;
+    float max_distance = 0.0f;
+    if (!PyArg_ParseTuple(args, "fffI|f", &x, &y, &z, &count, &max_distance))
+    {
+        PyErr_SetString(PyExc_ValueError, "Getting nearest entities failed, params should be x, y, z, count and optionally max distance.");
+        return NULL;
+    }
+
+    Scene::ScenePtr scene = PythonScriptModule::GetInstance()->GetScene();
+    if (!scene)
+    {
+        PyErr_SetString(PyExc_ValueError, "Scene is none.");
+        return NULL;
+    }
+
+    Scene::EntityIdVector ids;
+    scene->GetSpatialIndex().QueryNearest(Vector3df(x, y, z), count, ids, max_distance);
+    return EntityIdsToList(ids);
+}
+
 PyObject* GetScreenSize(PyObject *self) 
 {
     RexLogic::RexLogicModule *rexlogic_;
@@ -1921,6 +1994,15 @@ static PyMethodDef EmbMethods[] = {
     {"getCameraPosition", (PyCFunction)GetCameraPosition, METH_VARARGS, 
     "Get the position of the camera."},
 
+    {"getEntitiesInRadius", (PyCFunction)GetEntitiesInRadius, METH_VARARGS,
+    "Get the ids of the entities within a radius of a point: x, y, z, radius."},
+
+    {"getEntitiesInBox", (PyCFunction)GetEntitiesInBox, METH_VARARGS,
+    "Get the ids of the entities within an axis-aligned box: minx, miny, minz, maxx, maxy, maxz."},
+
+    {"getNearestEntities", (PyCFunction)GetNearestEntities, METH_VARARGS,
+    "Get the ids of the entities nearest to a point, nearest first: x, y, z, count, optional max distance."},
+
     //from RexPythonQt.cpp now .. except got the fricken staticframework == null prob!
 
     //{"createCanvas", (PyCFunction)CreateCanvas, METH_VARARGS, 
@@ -9,6 +9,7 @@
 #include "Avatar/Avatar.h"
 #include "Avatar/AvatarAppearance.h"
 #include "Avatar/AvatarEditor.h"
+#include "Environment/SceneSnapshot.h"
 #include "RexLogicModule.h"
 #include "EntityComponent/EC_OpenSimAvatar.h"
 #include "EntityComponent/EC_NetworkPosition.h"
@@ -36,7 +37,7 @@
 
 namespace RexLogic
 {
-    Avatar::Avatar(RexLogicModule *owner) : avatar_appearance_(owner), owner_(owner)
+    Avatar::Avatar(RexLogicModule *owner) : avatar_appearance_(owner), overlay_manager_(owner), owner_(owner)
     {
         avatar_states_[RexUUID("6ed24bd8-91aa-4b12-ccc7-c97c857ab4e0")] = EC_OpenSimAvatar::Walk;
         avatar_states_[RexUUID("47f5f6fb-22e5-ae44-f871-73aaaf4a6022")] = EC_OpenSimAvatar::Walk;
@@ -68,6 +69,10 @@ namespace RexLogic
         }
 
         *existing = false;
+
+        // A prim restored from the scene snapshot may hold this id
+        owner_->GetSceneSnapshot()->Reconcile(entityid, fullid);
+
         entity = CreateNewAvatarEntity(entityid);
         assert(entity.get());
         if (!entity)
@@ -121,6 +126,7 @@ namespace RexLogic
             //ShowAvatarNameOverlay(entityid);
             CreateWidgetOverlay(placeable, entityid);
             CreateAvatarMesh(entityid);
+            overlay_manager_.AddAvatar(entityid, checked_static_cast<OgreRenderer::EC_OgrePlaceable*>(placeable.get())->GetPosition());
         }
 
         return entity;
@@ -438,6 +444,7 @@ namespace RexLogic
             }
         }
 
+        overlay_manager_.RemoveAvatar(objectid);
         scene->RemoveEntity(objectid);
         owner_->UnregisterFullId(fullid);
         return false;
@@ -11,6 +11,7 @@
 #include "RexUUID.h"
 #include "EntityComponent/EC_OpenSimAvatar.h"
 #include "Avatar/AvatarAppearance.h"
+#include "Avatar/AvatarOverlayManager.h"
 
 namespace ProtocolUtilities
 {
@@ -97,6 +98,9 @@ namespace RexLogic
         //! Returns the avatar appearance handler
         AvatarAppearance& GetAppearanceHandler() { return avatar_appearance_; }
 
+        //! Returns the avatar name tag and button manager
+        AvatarOverlayManager& GetOverlayManager() { return overlay_manager_; }
+
     private:
         //! Owner module.
         RexLogicModule *owner_;
@@ -147,6 +151,9 @@ namespace RexLogic
         //! Avatar appearance controller
         AvatarAppearance avatar_appearance_;
 
+        //! Avatar name tag and button manager
+        AvatarOverlayManager overlay_manager_;
+
         //! Pending avatar appearances
         typedef std::map<RexUUID, std::string> AvatarAppearanceMap;
         AvatarAppearanceMap pending_appearances_;
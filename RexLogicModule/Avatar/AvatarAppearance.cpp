@@ -3,6 +3,7 @@
 #include "StableHeaders.h"
 #include "Avatar/Avatar.h"
 #include "Avatar/AvatarAppearance.h"
+#include "Avatar/AvatarAppearanceParser.h"
 #include "Avatar/AvatarEditor.h"
 #include "Avatar/AvatarExporter.h"
 #include "LegacyAvatarSerializer.h"
@@ -31,6 +32,7 @@
 #include "RenderServiceInterface.h"
 #include "Inventory/InventoryEvents.h"
 #include "ConfigurationManager.h"
+#include "ThreadTaskManager.h"
 #include "ServiceManager.h"
 #include "EventManager.h"
 #include "WorldStream.h"
@@ -42,6 +44,11 @@
 
 #include <Ogre.h>
 
+#include <boost/cstdint.hpp>
+
+#include <algorithm>
+#include <sstream>
+
 using namespace RexTypes;
 
 static const Real FIXED_HEIGHT_OFFSET = -0.87f;
@@ -59,18 +66,27 @@ namespace RexLogic
         rexlogicmodule_(rexlogicmodule),
         inv_export_state_(Idle)
     {
-        std::string default_avatar_path = rexlogicmodule_->GetFramework()->GetDefaultConfig().DeclareSetting("RexAvatar", "default_avatar_file", std::string("./data/default_avatar.xml"));
+        Foundation::Framework* framework = rexlogicmodule_->GetFramework();
+        std::string default_avatar_path = framework->GetDefaultConfig().DeclareSetting("RexAvatar", "default_avatar_file", std::string("./data/default_avatar.xml"));
+        max_setups_per_frame_ = framework->GetDefaultConfig().DeclareSetting("RexAvatar", "max_appearance_setups_per_frame", 2);
+        hardware_skinning_ = framework->GetDefaultConfig().DeclareSetting("RexAvatar", "hardware_skinning", true);
         
         ReadDefaultAppearance(default_avatar_path);
+        
+        parser_task_manager_ = boost::shared_ptr<Foundation::ThreadTaskManager>(new Foundation::ThreadTaskManager(framework));
+        parser_task_manager_->AddThreadTask(Foundation::ThreadTaskPtr(new AvatarAppearanceParser()));
     }
 
     AvatarAppearance::~AvatarAppearance()
     {
+        parser_task_manager_.reset();
     }
 
     void AvatarAppearance::Update(f64 frametime)
     {
         ProcessAppearanceDownloads();
+        ProcessParsedAppearances();
+        ProcessAppearanceSetups();
         ProcessAvatarExport();
     }
     
@@ -344,29 +360,45 @@ namespace RexLogic
         bool need_mesh_clone = false;
         
         const AvatarAttachmentVector& attachments = appearance->GetAttachments();
-        std::set<uint> vertices_to_hide;
+        std::vector<uint> vertices_to_hide;
         for (uint i = 0; i < attachments.size(); ++i)
         {
             if (attachments[i].vertices_to_hide_.size())
             {
                 need_mesh_clone = true;
-                for (uint j = 0; j < attachments[i].vertices_to_hide_.size(); ++j)
-                    vertices_to_hide.insert(attachments[i].vertices_to_hide_[j]);
+                vertices_to_hide.insert(vertices_to_hide.end(), attachments[i].vertices_to_hide_.begin(), attachments[i].vertices_to_hide_.end());
             }
         }
         
+        // Avatars with the same base mesh and the same hidden vertices share the clone. Only the avatar creating it
+        // hides the vertices
+        std::string clone_key;
+        if (need_mesh_clone)
+        {
+            std::sort(vertices_to_hide.begin(), vertices_to_hide.end());
+            vertices_to_hide.erase(std::unique(vertices_to_hide.begin(), vertices_to_hide.end()), vertices_to_hide.end());
+            clone_key = GetHiddenVerticesKey(vertices_to_hide);
+        }
+        
+        bool clone_created = false;
         if (!appearance->GetSkeleton().GetLocalOrResourceName().empty())
-            mesh->SetMeshWithSkeleton(appearance->GetMesh().GetLocalOrResourceName(), appearance->GetSkeleton().GetLocalOrResourceName(), need_mesh_clone);
+            mesh->SetMeshWithSkeleton(appearance->GetMesh().GetLocalOrResourceName(), appearance->GetSkeleton().GetLocalOrResourceName(),
+                need_mesh_clone, clone_key, &clone_created);
         else
-            mesh->SetMesh(appearance->GetMesh().GetLocalOrResourceName(), need_mesh_clone);
+            mesh->SetMesh(appearance->GetMesh().GetLocalOrResourceName(), need_mesh_clone, clone_key, &clone_created);
             
-        if (need_mesh_clone)
+        if (clone_created)
             HideVertices(mesh->GetEntity(), vertices_to_hide);
         
         AvatarMaterialVector materials = appearance->GetMaterials();
+        StringVector material_names;
         for (uint i = 0; i < materials.size(); ++i)
+            material_names.push_back(materials[i].asset_.GetLocalOrResourceName());
+        if (hardware_skinning_)
+            GetSkinnedMaterials(mesh->GetEntity(), material_names);
+        for (uint i = 0; i < material_names.size(); ++i)
         {
-            mesh->SetMaterial(i, materials[i].asset_.GetLocalOrResourceName());
+            mesh->SetMaterial(i, material_names[i]);
         }
         
         // Store the modified materials vector (with created temp resources) to the EC
@@ -400,9 +432,15 @@ namespace RexLogic
             // Setup attachment meshes
             mesh->SetAttachmentMesh(i, attachments[i].mesh_.GetLocalOrResourceName(), attachments[i].bone_name_, attachments[i].link_skeleton_);
             // Setup attachment mesh materials
+            StringVector material_names;
             for (uint j = 0; j < attachments[i].materials_.size(); ++j)
+                material_names.push_back(attachments[i].materials_[j].asset_.GetLocalOrResourceName());
+            // Attachments that share the avatar skeleton are skinned like the avatar
+            if (hardware_skinning_ && attachments[i].link_skeleton_)
+                GetSkinnedMaterials(mesh->GetAttachmentEntity(i), material_names);
+            for (uint j = 0; j < material_names.size(); ++j)
             {
-                mesh->SetAttachmentMaterial(i, j, attachments[i].materials_[j].asset_.GetLocalOrResourceName());
+                mesh->SetAttachmentMaterial(i, j, material_names[j]);
             }
             mesh->SetAttachmentPosition(i, attachments[i].transform_.position_);
             mesh->SetAttachmentOrientation(i, attachments[i].transform_.orientation_);
@@ -410,6 +448,27 @@ namespace RexLogic
         }
     }
     
+    bool AvatarAppearance::GetSkinnedMaterials(Ogre::Entity* entity, StringVector& material_names)
+    {
+        if (!OgreRenderer::CanSkinInHardware(entity))
+            return false;
+        
+        // All submeshes must be skinned the same way, including those that keep the material of the mesh
+        StringVector skinned_names = material_names;
+        for (uint i = skinned_names.size(); i < entity->getNumSubEntities(); ++i)
+            skinned_names.push_back(entity->getSubEntity(i)->getMaterialName());
+        
+        for (uint i = 0; i < skinned_names.size(); ++i)
+        {
+            skinned_names[i] = OgreRenderer::GetSkinnedMaterial(skinned_names[i]);
+            if (skinned_names[i].empty())
+                return false;
+        }
+        
+        material_names = skinned_names;
+        return true;
+    }
+    
     void AvatarAppearance::SetupMorphs(Scene::EntityPtr entity)
     {
         EC_AvatarAppearance* appearance = entity->GetComponent<EC_AvatarAppearance>().get();
@@ -528,16 +587,13 @@ namespace RexLogic
         
         // Rotation
         {
-            Ogre::Matrix3 rot_start, rot_end, rot_base, rot_orig;
-            Ogre::Radian sx, sy, sz;
-            Ogre::Radian ex, ey, ez;
+            // Start & end euler angles have been derived when the modifier was read
+            Ogre::Matrix3 rot_base, rot_orig;
+            Ogre::Radian sx(modifier.start_euler_.x), sy(modifier.start_euler_.y), sz(modifier.start_euler_.z);
+            Ogre::Radian ex(modifier.end_euler_.x), ey(modifier.end_euler_.y), ez(modifier.end_euler_.z);
             Ogre::Radian bx, by, bz;
             Ogre::Radian rx, ry, rz;
-            OgreRenderer::ToOgreQuaternion(modifier.start_.orientation_).ToRotationMatrix(rot_start);
-            OgreRenderer::ToOgreQuaternion(modifier.end_.orientation_).ToRotationMatrix(rot_end);
             bone->getInitialOrientation().ToRotationMatrix(rot_orig);
-            rot_start.ToEulerAnglesXYZ(sx, sy, sz);
-            rot_end.ToEulerAnglesXYZ(ex, ey, ez);
             rot_orig.ToEulerAnglesXYZ(rx, ry, rz);
             
             switch (modifier.orientation_mode_)
@@ -673,64 +729,71 @@ namespace RexLogic
         return skeleton->getBone(bone_name);
     }
     
-    void AvatarAppearance::HideVertices(Ogre::Entity* entity, std::set<uint> vertices_to_hide)
+    std::string AvatarAppearance::GetHiddenVerticesKey(const std::vector<uint>& vertices_to_hide)
     {
-        if (!entity)
-            return;
-        Ogre::MeshPtr mesh = entity->getMesh();
-        if (mesh.isNull())
-            return;
-        
-        for (uint m = 0; m < 1; ++m)
+        // 64-bit FNV-1a hash of the vertex indices
+        boost::uint64_t hash = 14695981039346656037ULL;
+        for (uint i = 0; i < vertices_to_hide.size(); ++i)
         {
-            // Under current system, it seems vertices should only be hidden from first submesh
-            Ogre::SubMesh *submesh = mesh->getSubMesh(m);
-            Ogre::IndexData *data = submesh->indexData;
-            Ogre::HardwareIndexBufferSharedPtr ibuf = data->indexBuffer;
-
-            unsigned long* lIdx = static_cast<unsigned long*>(ibuf->lock(Ogre::HardwareBuffer::HBL_NORMAL));
-            unsigned short* pIdx = reinterpret_cast<unsigned short*>(lIdx);
-            bool use32bitindexes = (ibuf->getType() == Ogre::HardwareIndexBuffer::IT_32BIT);
-
-            for (uint n = 0; n < data->indexCount; n += 3)
+            uint index = vertices_to_hide[i];
+            for (uint j = 0; j < 4; ++j)
             {
-                if (!use32bitindexes)
-                {
-                    if (vertices_to_hide.find(pIdx[n]) != vertices_to_hide.end() ||
-                        vertices_to_hide.find(pIdx[n+1]) != vertices_to_hide.end() ||
-                        vertices_to_hide.find(pIdx[n+2]) != vertices_to_hide.end())
-                    {
-                        if (n + 3 < data->indexCount)
-                        {
-                            for (size_t i = n ; i<data->indexCount-3 ; ++i)
-                            {
-                                pIdx[i] = pIdx[i+3];
-                            }
-                        }
-                        data->indexCount -= 3;
-                        n -= 3;
-                    }
-                }
-                else
-                {
-                    if (vertices_to_hide.find(lIdx[n]) != vertices_to_hide.end() ||
-                        vertices_to_hide.find(lIdx[n+1]) != vertices_to_hide.end() ||
-                        vertices_to_hide.find(lIdx[n+2]) != vertices_to_hide.end())
-                    {
-                        if (n + 3 < data->indexCount)
-                        {
-                            for (size_t i = n ; i<data->indexCount-3 ; ++i)
-                            {
-                                lIdx[i] = lIdx[i+3];
-                            }
-                        }
-                        data->indexCount -= 3;
-                        n -= 3;
-                    }
-                }
+                hash ^= (index >> (j * 8)) & 0xff;
+                hash *= 1099511628211ULL;
             }
-            ibuf->unlock();
         }
+        
+        std::stringstream key;
+        key << "hide" << vertices_to_hide.size() << "_" << std::hex << hash;
+        return key.str();
+    }
+    
+    template<typename IndexType>
+    static size_t RemoveHiddenTriangles(IndexType* indices, size_t index_count, const std::vector<bool>& hidden)
+    {
+        // Compact the visible triangles to the start of the buffer
+        size_t kept = 0;
+        for (size_t n = 0; n + 2 < index_count; n += 3)
+        {
+            const IndexType a = indices[n];
+            const IndexType b = indices[n+1];
+            const IndexType c = indices[n+2];
+            if ((a < hidden.size() && hidden[a]) || (b < hidden.size() && hidden[b]) || (c < hidden.size() && hidden[c]))
+                continue;
+            
+            indices[kept++] = a;
+            indices[kept++] = b;
+            indices[kept++] = c;
+        }
+        return kept;
+    }
+    
+    void AvatarAppearance::HideVertices(Ogre::Entity* entity, const std::vector<uint>& vertices_to_hide)
+    {
+        if (!entity || vertices_to_hide.empty())
+            return;
+        Ogre::MeshPtr mesh = entity->getMesh();
+        if (mesh.isNull() || !mesh->getNumSubMeshes())
+            return;
+        
+        // Bitset over the vertex indices, for a constant time lookup per triangle corner
+        std::vector<bool> hidden(*std::max_element(vertices_to_hide.begin(), vertices_to_hide.end()) + 1, false);
+        for (uint i = 0; i < vertices_to_hide.size(); ++i)
+            hidden[vertices_to_hide[i]] = true;
+        
+        // Under current system, it seems vertices should only be hidden from first submesh
+        Ogre::SubMesh *submesh = mesh->getSubMesh(0);
+        Ogre::IndexData *data = submesh->indexData;
+        Ogre::HardwareIndexBufferSharedPtr ibuf = data->indexBuffer;
+        if (ibuf.isNull())
+            return;
+        
+        void* indices = ibuf->lock(Ogre::HardwareBuffer::HBL_NORMAL);
+        if (ibuf->getType() == Ogre::HardwareIndexBuffer::IT_32BIT)
+            data->indexCount = RemoveHiddenTriangles(static_cast<Ogre::uint32*>(indices), data->indexCount, hidden);
+        else
+            data->indexCount = RemoveHiddenTriangles(static_cast<Ogre::uint16*>(indices), data->indexCount, hidden);
+        ibuf->unlock();
     }
     
     void AvatarAppearance::ProcessAppearanceDownloads()
@@ -770,17 +833,47 @@ namespace RexLogic
     {       
         if (!entity)
             return;
+        
+        // Parse in the background, the result is applied in ProcessParsedAppearances()
+        AvatarAppearanceParseRequestPtr request(new AvatarAppearanceParseRequest());
+        request->entity_id_ = entity->GetId();
+        request->data_ = std::string((const char*)data, size);
+        request->base_url_ = base_url;
+        parser_task_manager_->AddRequest<AvatarAppearanceParseRequest>("AvatarAppearanceParse", request);
+    }
+    
+    void AvatarAppearance::ProcessParsedAppearances()
+    {
+        std::vector<Foundation::ThreadTaskResultPtr> results = parser_task_manager_->GetResults("AvatarAppearanceParse");
+        for (uint i = 0; i < results.size(); ++i)
+        {
+            AvatarAppearanceParseResultPtr result = boost::dynamic_pointer_cast<AvatarAppearanceParseResult>(results[i]);
+            if (!result)
+                continue;
+            Scene::EntityPtr entity = rexlogicmodule_->GetAvatarEntity(result->entity_id_);
+            if (entity)
+                ApplyParsedAppearance(entity, result);
+        }
+    }
+    
+    void AvatarAppearance::ApplyParsedAppearance(Scene::EntityPtr entity, AvatarAppearanceParseResultPtr result)
+    {
         EC_AvatarAppearance* appearance = entity->GetComponent<EC_AvatarAppearance>().get();
         if (!appearance)
             return;
         
-        std::string data_str((const char*)data, size);
-
-        QDomDocument avatar_doc("Avatar");
-        avatar_doc.setContent(QString::fromStdString(data_str));
-
-        // Deserialize appearance from the document into the EC
-        if (!LegacyAvatarSerializer::ReadAvatarAppearance(*appearance, avatar_doc))
+        if (result->empty_)
+        {
+            // If not found, use default appearance
+            // (at this point, it's nice to just have *some* appearance change, for example
+            // changing back to default human from fish in the fishworld, if no avatar stored)
+            RexLogicModule::LogInfo("Got empty avatar description from storage, setting default appearance");
+            SetupDefaultAppearance(entity);
+            return;
+        }
+        
+        // Deserialize appearance from the document into the EC. Bone modifiers have already been read by the parser
+        if (!LegacyAvatarSerializer::ReadAvatarAppearance(*appearance, *result->document_, true, &result->bone_modifiers_))
         {
             // If fails badly, setup default instead
             RexLogicModule::LogInfo("Failed to parse avatar description, setting default appearance");
@@ -788,35 +881,71 @@ namespace RexLogic
             return;
         }
         
-        const AvatarAssetMap& assets = appearance->GetAssetMap(); 
-        
         uint pending_requests;
-        if (base_url.isEmpty())
-            pending_requests = RequestAvatarResources(entity, assets, true);
+        if (result->storage_)
+        {
+            appearance->SetAssetMap(result->assets_);
+            pending_requests = RequestAvatarResources(entity, result->assets_);
+        }
         else
         {
-            // If base url exists, this is webdav inventory avatar
-            // Lets clear the cache as the id == url doesnt chance so
-            // we can be sure the asset is fetched again from the web
-            boost::shared_ptr<Foundation::AssetServiceInterface> asset_service = 
-                rexlogicmodule_->GetFramework()->GetServiceManager()->GetService<Foundation::AssetServiceInterface>(Foundation::Service::ST_Asset).lock();
-            if (asset_service)
+            const AvatarAssetMap& assets = appearance->GetAssetMap(); 
+            
+            if (result->base_url_.isEmpty())
+                pending_requests = RequestAvatarResources(entity, assets, true);
+            else
             {
-                AvatarAssetMap::const_iterator iter = assets.begin();
-                AvatarAssetMap::const_iterator end = assets.end();
-                while (iter != end)
+                // If base url exists, this is webdav inventory avatar
+                // Lets clear the cache as the id == url doesnt chance so
+                // we can be sure the asset is fetched again from the web
+                boost::shared_ptr<Foundation::AssetServiceInterface> asset_service = 
+                    rexlogicmodule_->GetFramework()->GetServiceManager()->GetService<Foundation::AssetServiceInterface>(Foundation::Service::ST_Asset).lock();
+                if (asset_service)
                 {
-                    std::string asset_id = iter->second;
-                    asset_service->RemoveAssetFromCache(asset_id);
-                    ++iter;
+                    AvatarAssetMap::const_iterator iter = assets.begin();
+                    AvatarAssetMap::const_iterator end = assets.end();
+                    while (iter != end)
+                    {
+                        std::string asset_id = iter->second;
+                        asset_service->RemoveAssetFromCache(asset_id);
+                        ++iter;
+                    }
                 }
+                pending_requests = RequestAvatarResources(entity, assets, false, result->base_url_);
             }
-            pending_requests = RequestAvatarResources(entity, assets, false, base_url);
         }
         
         // In the unlikely case of no requests at all, rebuild avatar now
         if (!pending_requests)
+            QueueAppearanceSetup(entity->GetId());
+    }
+    
+    void AvatarAppearance::QueueAppearanceSetup(entity_id_t id)
+    {
+        if (std::find(pending_setups_.begin(), pending_setups_.end(), id) == pending_setups_.end())
+            pending_setups_.push_back(id);
+    }
+    
+    void AvatarAppearance::ProcessAppearanceSetups()
+    {
+        uint setups = 0;
+        while (!pending_setups_.empty() && (!max_setups_per_frame_ || setups < max_setups_per_frame_))
+        {
+            entity_id_t id = pending_setups_.front();
+            pending_setups_.pop_front();
+            
+            // If the appearance has changed again since, wait for its resources instead
+            std::map<entity_id_t, uint>::const_iterator i = avatar_pending_requests_.find(id);
+            if (i != avatar_pending_requests_.end() && i->second)
+                continue;
+            
+            Scene::EntityPtr entity = rexlogicmodule_->GetAvatarEntity(id);
+            if (!entity)
+                continue;
+            
             SetupAppearance(entity);
+            ++setups;
+        }
     }
         
     uint AvatarAppearance::RequestAvatarResources(Scene::EntityPtr entity, const AvatarAssetMap& assets, bool inventorymode, QString base_url)
@@ -870,65 +999,17 @@ namespace RexLogic
     {        
         if (!entity)
             return;
-        EC_AvatarAppearance* appearance = entity->GetComponent<EC_AvatarAppearance>().get();
         EC_OpenSimAvatar* avatar = entity->GetComponent<EC_OpenSimAvatar>().get();
-        if (!appearance || !avatar)
-            return;
-        
-        std::string data_str((const char*)data, size);
-        std::map<std::string, std::string> contents = RexTypes::ParseLLSDMap(data_str);
-        
-        // Get the avatar appearance description ("generic xml")
-        std::map<std::string, std::string>::iterator i = contents.find("generic xml");
-        if (i == contents.end())
-        {
-            // If not found, use default appearance
-            // (at this point, it's nice to just have *some* appearance change, for example
-            // changing back to default human from fish in the fishworld, if no avatar stored)
-            RexLogicModule::LogInfo("Got empty avatar description from storage, setting default appearance");
-            SetupDefaultAppearance(entity);
-            return;
-        }
-        
-        std::string& appearance_str = i->second;
-
-        // Return to original format by substituting to < >
-        ReplaceSubstringInplace(appearance_str, "&lt;", "<");
-        ReplaceSubstringInplace(appearance_str, "&gt;", ">");
-        
-        QDomDocument avatar_doc("Avatar");
-        avatar_doc.setContent(QString::fromStdString(appearance_str));
-        
-        std::map<std::string, std::string>::iterator j = contents.begin();
-        // Build mapping of human-readable asset names to id's
-        std::string host = HttpUtilities::GetHostFromUrl(avatar->GetAppearanceAddress());
-        AvatarAssetMap assets;
-        while (j != contents.end())
-        {
-            // Don't add the name field or the avatar description
-            if ((j->first != "generic xml") && (j->first != "name"))
-            {
-                assets[j->first] = host + "/item/" + j->second;
-            }
-            ++j;
-        }
-        
-        // Deserialize appearance from the document into the EC
-        if (!LegacyAvatarSerializer::ReadAvatarAppearance(*appearance, avatar_doc))
-        {
-            // If fails badly, setup default instead
-            RexLogicModule::LogInfo("Failed to parse avatar description, setting default appearance");
-            SetupDefaultAppearance(entity);
+        if (!avatar)
             return;
-        }
-        
-        appearance->SetAssetMap(assets);
-
-        uint pending_requests = RequestAvatarResources(entity, assets);
         
-        // In the unlikely case of no requests at all, rebuild avatar now
-        if (!pending_requests)
-            SetupAppearance(entity);
+        // Parse in the background, the result is applied in ProcessParsedAppearances()
+        AvatarAppearanceParseRequestPtr request(new AvatarAppearanceParseRequest());
+        request->entity_id_ = entity->GetId();
+        request->data_ = std::string((const char*)data, size);
+        request->storage_ = true;
+        request->host_ = HttpUtilities::GetHostFromUrl(avatar->GetAppearanceAddress());
+        parser_task_manager_->AddRequest<AvatarAppearanceParseRequest>("AvatarAppearanceParse", request);
     }
     
     bool AvatarAppearance::HandleResourceEvent(event_id_t event_id, Foundation::EventDataInterface* data)
@@ -963,7 +1044,7 @@ namespace RexLogic
         if (avatar_pending_requests_[id] == 0)
         {
             RexLogicModule::LogDebug("All resources received, rebuilding avatar");
-            SetupAppearance(entity);
+            QueueAppearanceSetup(id);
         }
     
         return true;
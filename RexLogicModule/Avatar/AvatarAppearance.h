@@ -5,6 +5,8 @@
 
 #include "EntityComponent/EC_AvatarAppearance.h"
 
+#include <list>
+
 class QDomDocument;
 
 namespace Ogre
@@ -16,6 +18,11 @@ namespace Ogre
     class Quaternion;
 }
 
+namespace Foundation
+{
+    class ThreadTaskManager;
+}
+
 namespace HttpUtilities
 {
     class HttpTask;
@@ -29,6 +36,8 @@ namespace RexLogic
     class AvatarExporterRequest;
     typedef boost::shared_ptr<AvatarExporter> AvatarExporterPtr;
     typedef boost::shared_ptr<AvatarExporterRequest> AvatarExporterRequestPtr;
+    class AvatarAppearanceParseResult;
+    typedef boost::shared_ptr<AvatarAppearanceParseResult> AvatarAppearanceParseResultPtr;
     class EC_AvatarAppearance;
 
     //! Handles setting up and updating avatars' appearance. Owned by RexLogicModule::Avatar.
@@ -116,6 +125,12 @@ namespace RexLogic
         //! Sets up an avatar mesh
         void SetupMeshAndMaterials(Scene::EntityPtr entity);
         
+        //! Replaces material names with the skinned copies of the materials, if the entity can be skinned in hardware
+        /*! Submeshes beyond the given names are included with the materials they have, so that the names may grow.
+            \return true if the names were replaced. If any material can't be skinned, the names are left as they are.
+         */
+        bool GetSkinnedMaterials(Ogre::Entity* entity, StringVector& material_names);
+        
         //! Sets up avatar morphs
         void SetupMorphs(Scene::EntityPtr entity);
         
@@ -131,8 +146,13 @@ namespace RexLogic
         //! Applies a bone modifier
         void ApplyBoneModifier(Scene::EntityPtr entity, const BoneModifier& modifier, Real value);
         
-        //! Hides vertices from an entity's mesh. Mesh should be cloned from the base mesh and this must not be called more than once for the entity.
-        void HideVertices(Ogre::Entity*, std::set<uint> vertices_to_hide);
+        //! Hides vertices from an entity's mesh. Mesh should be cloned from the base mesh and this must not be called more than once for the clone.
+        void HideVertices(Ogre::Entity*, const std::vector<uint>& vertices_to_hide);
+        
+        //! Returns the key identifying a set of hidden vertices in the mesh clone cache
+        /*! \param vertices_to_hide sorted vertex indices without duplicates
+         */
+        static std::string GetHiddenVerticesKey(const std::vector<uint>& vertices_to_hide);
         
         //! Processes appearance downloads
         void ProcessAppearanceDownloads();
@@ -140,12 +160,24 @@ namespace RexLogic
         //! Processes avatar export (result from the avatar exporter threadtask)
         void ProcessAvatarExport();
         
-        //! Processes an avatar appearance download result
+        //! Processes an avatar appearance download result. Queues it to the appearance parser.
         void ProcessAppearanceDownload(Scene::EntityPtr entity, const u8* data, uint size);
 
-        //! Processes an avatar appearance asset (inventory based avatar)
+        //! Processes an avatar appearance asset (inventory based avatar). Queues it to the appearance parser.
         void ProcessInventoryAppearance(Scene::EntityPtr entity, const u8* data, uint size, QString base_url = QString());
         
+        //! Processes results from the appearance parser
+        void ProcessParsedAppearances();
+        
+        //! Reads a parsed appearance into the appearance EC and requests the avatar resources
+        void ApplyParsedAppearance(Scene::EntityPtr entity, AvatarAppearanceParseResultPtr result);
+        
+        //! Queues an avatar to be set up once its resources are ready. Does nothing if the avatar is already queued.
+        void QueueAppearanceSetup(entity_id_t id);
+        
+        //! Sets up queued avatars, at most max_setups_per_frame_ of them
+        void ProcessAppearanceSetups();
+        
         //! Requests needed avatar resouces
         uint RequestAvatarResources(Scene::EntityPtr entity, const AvatarAssetMap& assets, bool inventorymode = false, QString base_url = QString());
             
@@ -208,6 +240,18 @@ namespace RexLogic
         //! Amount of pending avatar resource requests. When hits 0, should be able to build avatar
         std::map<entity_id_t, uint> avatar_pending_requests_;
         
+        //! Thread task manager collecting the results of the appearance parser
+        boost::shared_ptr<Foundation::ThreadTaskManager> parser_task_manager_;
+        
+        //! Avatars waiting for SetupAppearance(), in the order their resources became ready
+        std::list<entity_id_t> pending_setups_;
+        
+        //! How many avatars to set up per frame, 0 for no limit. Spreads the cost of many avatars arriving at once over frames
+        uint max_setups_per_frame_;
+        
+        //! Whether to blend the avatar skeletal animation in the vertex programs instead of in software
+        bool hardware_skinning_;
+        
         //! Legacy storage avatar exporter task
         AvatarExporterPtr avatar_exporter_;
         
@@ -0,0 +1,81 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "Avatar/AvatarAppearanceParser.h"
+#include "LegacyAvatarSerializer.h"
+#include "RexLogicModule.h"
+#include "LLSDUtilities.h"
+
+#include <QDomDocument>
+
+using namespace RexTypes;
+
+namespace RexLogic
+{
+    AvatarAppearanceParser::AvatarAppearanceParser() : ThreadTask("AvatarAppearanceParse")
+    {
+    }
+
+    void AvatarAppearanceParser::Work()
+    {
+        while (ShouldRun())
+        {
+            WaitForRequests();
+
+            AvatarAppearanceParseRequestPtr request = GetNextRequest<AvatarAppearanceParseRequest>();
+            if (request)
+            {
+                PROFILE(AvatarAppearanceParser_Parse);
+                AvatarAppearanceParseResultPtr result(new AvatarAppearanceParseResult());
+                ProcessRequest(request, result);
+                QueueResult<AvatarAppearanceParseResult>(result);
+            }
+
+            RESETPROFILER
+        }
+    }
+
+    void AvatarAppearanceParser::ProcessRequest(AvatarAppearanceParseRequestPtr request, AvatarAppearanceParseResultPtr result)
+    {
+        result->entity_id_ = request->entity_id_;
+        result->storage_ = request->storage_;
+        result->base_url_ = request->base_url_;
+
+        std::string appearance_str;
+        if (request->storage_)
+        {
+            std::map<std::string, std::string> contents = RexTypes::ParseLLSDMap(request->data_);
+
+            // Get the avatar appearance description ("generic xml")
+            std::map<std::string, std::string>::iterator i = contents.find("generic xml");
+            if (i == contents.end())
+            {
+                result->empty_ = true;
+                return;
+            }
+
+            appearance_str = i->second;
+
+            // Return to original format by substituting to < >
+            ReplaceSubstringInplace(appearance_str, "&lt;", "<");
+            ReplaceSubstringInplace(appearance_str, "&gt;", ">");
+
+            // Build mapping of human-readable asset names to id's
+            std::map<std::string, std::string>::iterator j = contents.begin();
+            while (j != contents.end())
+            {
+                // Don't add the name field or the avatar description
+                if ((j->first != "generic xml") && (j->first != "name"))
+                    result->assets_[j->first] = request->host_ + "/item/" + j->second;
+                ++j;
+            }
+        }
+        else
+            appearance_str = request->data_;
+
+        result->document_ = boost::shared_ptr<QDomDocument>(new QDomDocument("Avatar"));
+        result->document_->setContent(QString::fromStdString(appearance_str));
+
+        LegacyAvatarSerializer::ReadBoneModifiers(result->bone_modifiers_, *result->document_);
+    }
+}
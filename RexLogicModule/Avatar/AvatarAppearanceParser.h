@@ -0,0 +1,87 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_RexLogic_AvatarAppearanceParser_h
+#define incl_RexLogic_AvatarAppearanceParser_h
+
+#include "ThreadTask.h"
+#include "EntityComponent/EC_AvatarAppearance.h"
+
+#include <QString>
+
+class QDomDocument;
+
+namespace RexLogic
+{
+    //! Request to parse a downloaded avatar appearance description
+    class AvatarAppearanceParseRequest : public Foundation::ThreadTaskRequest
+    {
+    public:
+        AvatarAppearanceParseRequest() :
+            entity_id_(0),
+            storage_(false)
+        {
+        }
+
+        //! Avatar entity the appearance belongs to
+        entity_id_t entity_id_;
+        //! Raw data of the download
+        std::string data_;
+        //! True if the data is an LLSD map from legacy avatar storage, false if it is an appearance xml from inventory
+        bool storage_;
+        //! Avatar storage host, for resolving the asset ids of a legacy storage appearance
+        std::string host_;
+        //! Base url of a webdav inventory appearance, empty for other appearances
+        QString base_url_;
+    };
+
+    //! Result of parsing an avatar appearance description
+    class AvatarAppearanceParseResult : public Foundation::ThreadTaskResult
+    {
+    public:
+        AvatarAppearanceParseResult() :
+            entity_id_(0),
+            storage_(false),
+            empty_(false)
+        {
+        }
+
+        //! Avatar entity the appearance belongs to
+        entity_id_t entity_id_;
+        //! Whether the appearance came from legacy avatar storage
+        bool storage_;
+        //! Base url of a webdav inventory appearance
+        QString base_url_;
+        //! True if the avatar storage had no appearance description
+        bool empty_;
+        //! Parsed appearance description
+        boost::shared_ptr<QDomDocument> document_;
+        //! Asset names mapped to resource ids, for a legacy storage appearance
+        AvatarAssetMap assets_;
+        //! Bone modifiers read from the description
+        BoneModifierSetVector bone_modifiers_;
+    };
+
+    typedef boost::shared_ptr<AvatarAppearanceParseRequest> AvatarAppearanceParseRequestPtr;
+    typedef boost::shared_ptr<AvatarAppearanceParseResult> AvatarAppearanceParseResultPtr;
+
+    //! Threadtask that parses downloaded avatar appearances, so that avatars arriving doesn't stall the main thread.
+    /*! Parses the LLSD data from avatar storage and the appearance xml, resolves the asset map and reads the bone
+        modifiers. What remains for the main thread is reading the rest of the document into the EC and requesting
+        the resources. Results are queued to the ThreadTaskManager the task is added to.
+     */
+    class AvatarAppearanceParser : public Foundation::ThreadTask
+    {
+    public:
+        AvatarAppearanceParser();
+
+        virtual void Work();
+
+    private:
+        //! Parses an appearance
+        void ProcessRequest(AvatarAppearanceParseRequestPtr request, AvatarAppearanceParseResultPtr result);
+    };
+
+    typedef boost::shared_ptr<AvatarAppearanceParser> AvatarAppearanceParserPtr;
+}
+
+#endif
@@ -0,0 +1,254 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "Avatar/AvatarOverlayManager.h"
+#include "RexLogicModule.h"
+#include "EntityComponent/EC_HoveringWidget.h"
+#include "Renderer.h"
+#include "SceneManager.h"
+
+#include <OgreCamera.h>
+
+namespace RexLogic
+{
+    //! Distance beyond which EC_HoveringWidget::AdjustWidgetinfo() hides widgets that are not hovered
+    static const Real cVisibleDistance = 30.0f;
+
+    //! Distance below which EC_HoveringWidget::AdjustWidgetinfo() shows the buttons
+    static const Real cNearDistance = 10.0f;
+
+    //! Ratio between the distances of consecutive buckets
+    static const Real cBucketRatio = 1.05f;
+
+    //! Bucket of avatars beyond the visible distance, and of avatars not checked yet
+    static const int cFarBucket = -1;
+    static const int cUnknownBucket = -2;
+
+    //! Camera and avatar movement smaller than this is ignored
+    static const Real cMoveEpsilon = 0.01f;
+    static const Real cTurnEpsilon = 0.001f;
+
+    //! Height of the widget above the avatar origin, and the radius used to test it against the frustum
+    static const Real cWidgetHeight = 1.3f;
+    static const Real cWidgetRadius = 2.0f;
+
+    AvatarOverlayManager::AvatarOverlayManager(RexLogicModule* owner) :
+        owner_(owner),
+        camera_fov_(0.0f),
+        camera_aspect_(0.0f),
+        num_updated_(0)
+    {
+    }
+
+    AvatarOverlayManager::~AvatarOverlayManager()
+    {
+    }
+
+    void AvatarOverlayManager::AddAvatar(entity_id_t entity_id, const Vector3df& position)
+    {
+        RemoveAvatar(entity_id);
+
+        TrackedAvatar& avatar = avatars_[entity_id];
+        avatar.position_ = position;
+        avatar.bucket_ = cUnknownBucket;
+        avatar.in_frustum_ = false;
+        dirty_.insert(entity_id);
+    }
+
+    void AvatarOverlayManager::RemoveAvatar(entity_id_t entity_id)
+    {
+        AvatarMap::iterator i = avatars_.find(entity_id);
+        if (i == avatars_.end())
+            return;
+
+        dirty_.erase(entity_id);
+        forced_.erase(entity_id);
+        hovered_.erase(entity_id);
+        in_range_.erase(entity_id);
+        avatars_.erase(i);
+    }
+
+    void AvatarOverlayManager::Clear()
+    {
+        avatars_.clear();
+        dirty_.clear();
+        forced_.clear();
+        hovered_.clear();
+        in_range_.clear();
+    }
+
+    void AvatarOverlayManager::AvatarMoved(entity_id_t entity_id, const Vector3df& position)
+    {
+        AvatarMap::iterator i = avatars_.find(entity_id);
+        if (i == avatars_.end())
+            return;
+
+        TrackedAvatar& avatar = i->second;
+        if (avatar.position_.getDistanceFromSQ(position) < cMoveEpsilon * cMoveEpsilon)
+            return;
+
+        avatar.position_ = position;
+        dirty_.insert(entity_id);
+    }
+
+    void AvatarOverlayManager::AvatarHovered(entity_id_t entity_id)
+    {
+        if (avatars_.find(entity_id) == avatars_.end())
+            return;
+
+        forced_.insert(entity_id);
+        hovered_.insert(entity_id);
+    }
+
+    void AvatarOverlayManager::Update()
+    {
+        num_updated_ = 0;
+        if (avatars_.empty())
+            return;
+
+        OgreRenderer::RendererPtr renderer = owner_->GetOgreRendererPtr();
+        if (!renderer)
+            return;
+        Ogre::Camera* camera = renderer->GetCurrentCamera();
+        if (!camera)
+            return;
+
+        const Ogre::Vector3 cam_pos = camera->getDerivedPosition();
+        const Ogre::Vector3 cam_dir = camera->getDerivedDirection();
+        const Vector3df position(cam_pos.x, cam_pos.y, cam_pos.z);
+        const Vector3df direction(cam_dir.x, cam_dir.y, cam_dir.z);
+        const Real fov = camera->getFOVy().valueRadians();
+        const Real aspect = camera->getAspectRatio();
+
+        // The camera position is only stored when it has moved enough, so that slow movement accumulates
+        bool camera_moved = position.getDistanceFromSQ(camera_position_) > cMoveEpsilon * cMoveEpsilon ||
+            direction.getDistanceFromSQ(camera_direction_) > cTurnEpsilon * cTurnEpsilon ||
+            fov != camera_fov_ || aspect != camera_aspect_;
+        if (camera_moved)
+        {
+            camera_position_ = position;
+            camera_direction_ = direction;
+            camera_fov_ = fov;
+            camera_aspect_ = aspect;
+        }
+
+        std::set<entity_id_t> candidates;
+        std::set<entity_id_t> forced;
+        candidates.swap(dirty_);
+        forced.swap(forced_);
+        candidates.insert(forced.begin(), forced.end());
+
+        // Hovered widgets are shown regardless of distance. When the hover timer stops, they need one more update.
+        std::set<entity_id_t>::iterator h = hovered_.begin();
+        while (h != hovered_.end())
+        {
+            EC_HoveringWidget* widget = GetWidget(*h);
+            if (!widget || !widget->IsHovered())
+            {
+                forced.insert(*h);
+                candidates.insert(*h);
+                hovered_.erase(h++);
+            }
+            else
+            {
+                // Hovered widgets beyond the visible distance stay in the same bucket, so rescale them explicitly
+                if (camera_moved)
+                {
+                    forced.insert(*h);
+                    candidates.insert(*h);
+                }
+                ++h;
+            }
+        }
+
+        // When the camera moves, the avatars around it may change buckets, and the ones that were in range may
+        // have left it. Avatars further away keep their widgets hidden.
+        if (camera_moved)
+        {
+            candidates.insert(in_range_.begin(), in_range_.end());
+
+            Scene::ScenePtr scene = owner_->GetCurrentActiveScene();
+            if (scene)
+            {
+                // The index has all entities of the scene, of which only the avatars are of interest. The tracked
+                // positions may differ from the indexed ones by the ignored movement, so look that much further.
+                Scene::EntityIdVector nearby;
+                scene->GetSpatialIndex().QueryRadius(camera_position_, cVisibleDistance + cMoveEpsilon, nearby);
+                for (uint i = 0; i < nearby.size(); ++i)
+                {
+                    if (avatars_.find(nearby[i]) != avatars_.end())
+                        candidates.insert(nearby[i]);
+                }
+            }
+        }
+
+        for (std::set<entity_id_t>::const_iterator i = candidates.begin(); i != candidates.end(); ++i)
+        {
+            AvatarMap::iterator avatar = avatars_.find(*i);
+            if (avatar == avatars_.end())
+                continue;
+            if (!CheckAvatar(*i, avatar->second, forced.find(*i) != forced.end(), camera))
+                RemoveAvatar(*i);
+        }
+    }
+
+    bool AvatarOverlayManager::CheckAvatar(entity_id_t entity_id, TrackedAvatar& avatar, bool force, Ogre::Camera* camera)
+    {
+        EC_HoveringWidget* widget = GetWidget(entity_id);
+        if (!widget)
+            return false;
+
+        const Real distance = avatar.position_.getDistanceFrom(camera_position_);
+        if (distance < cVisibleDistance)
+            in_range_.insert(entity_id);
+        else
+            in_range_.erase(entity_id);
+
+        // The name tag grows with distance to keep its screen size
+        const Ogre::Vector3 widget_pos(avatar.position_.x, avatar.position_.y, avatar.position_.z + cWidgetHeight);
+        const bool in_frustum = camera->isVisible(Ogre::Sphere(widget_pos, cWidgetRadius + distance * 0.1f));
+        const bool entered_frustum = in_frustum && !avatar.in_frustum_;
+        avatar.in_frustum_ = in_frustum;
+
+        // Widgets outside the frustum are not seen, and are updated when they enter it. Entering the frustum is
+        // only noticed for avatars in range though, so widgets of avatars beyond it are hidden right away.
+        const int bucket = GetDistanceBucket(distance);
+        if (!in_frustum && bucket != cFarBucket)
+            return true;
+
+        if (!force && !entered_frustum && bucket == avatar.bucket_)
+            return true;
+
+        avatar.bucket_ = bucket;
+        widget->SetCameraDistance(distance);
+        ++num_updated_;
+        return true;
+    }
+
+    EC_HoveringWidget* AvatarOverlayManager::GetWidget(entity_id_t entity_id) const
+    {
+        Scene::ScenePtr scene = owner_->GetCurrentActiveScene();
+        if (!scene)
+            return 0;
+
+        Scene::EntityPtr entity = scene->GetEntity(entity_id);
+        if (!entity)
+            return 0;
+
+        return entity->GetComponent<EC_HoveringWidget>().get();
+    }
+
+    int AvatarOverlayManager::GetDistanceBucket(Real distance) const
+    {
+        if (distance >= cVisibleDistance)
+            return cFarBucket;
+
+        // Keep the thresholds of EC_HoveringWidget::AdjustWidgetinfo() at bucket boundaries
+        const int near_bit = (distance < cNearDistance) ? 1 : 0;
+        if (distance <= 1.0f)
+            return near_bit;
+
+        const int step = (int)(log(distance) / log(cBucketRatio));
+        return step * 2 + near_bit;
+    }
+}
@@ -0,0 +1,123 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_RexLogic_AvatarOverlayManager_h
+#define incl_RexLogic_AvatarOverlayManager_h
+
+#include "CoreTypes.h"
+#include "Vector3D.h"
+
+#include <map>
+#include <set>
+
+namespace Ogre
+{
+    class Camera;
+}
+
+namespace RexLogic
+{
+    class RexLogicModule;
+    class EC_HoveringWidget;
+
+    //! Keeps the hovering name tags and buttons of avatars up to date with the camera.
+    /*! Instead of rescaling every avatar's widget every frame, widgets are only updated when something about them
+        changed: the avatar's camera distance moved to another distance bucket, the avatar entered the camera
+        frustum, or the avatar was hovered over. Buckets grow geometrically with distance, so the screen size of a
+        name tag stays within a few percent of the intended size between updates.
+
+        When the camera moves, only the avatars that the scene's spatial index finds within the visible distance
+        of the camera are checked, since avatars further away have their widgets hidden. When the camera stays
+        still, only the avatars that moved are checked. The per frame cost depends on the number of nearby and
+        changed avatars, not on the number of avatars in the scene.
+
+        Owned by the Avatar handler, use Avatar::GetOverlayManager().
+     */
+    class AvatarOverlayManager
+    {
+    public:
+        //! Constructor
+        //! \param owner Owner module
+        explicit AvatarOverlayManager(RexLogicModule* owner);
+
+        //! Destructor
+        ~AvatarOverlayManager();
+
+        //! Starts tracking an avatar
+        void AddAvatar(entity_id_t entity_id, const Vector3df& position);
+
+        //! Stops tracking an avatar
+        void RemoveAvatar(entity_id_t entity_id);
+
+        //! Stops tracking all avatars, for example when the scene is deleted
+        void Clear();
+
+        //! Notifies that an avatar moved
+        void AvatarMoved(entity_id_t entity_id, const Vector3df& position);
+
+        //! Notifies that an avatar was hovered over, which may show its buttons
+        void AvatarHovered(entity_id_t entity_id);
+
+        //! Updates the widgets that need it. Call once per frame, after the camera has been updated.
+        void Update();
+
+        //! Returns number of avatars tracked
+        uint GetNumAvatars() const { return avatars_.size(); }
+
+        //! Returns number of widgets updated during the last frame
+        uint GetNumUpdated() const { return num_updated_; }
+
+    private:
+        struct TrackedAvatar
+        {
+            //! Last known position
+            Vector3df position_;
+            //! Distance bucket the widget was last updated in
+            int bucket_;
+            //! Whether the avatar was in the camera frustum during the last check
+            bool in_frustum_;
+        };
+
+        typedef std::map<entity_id_t, TrackedAvatar> AvatarMap;
+
+        //! Returns the distance bucket of a camera distance
+        int GetDistanceBucket(Real distance) const;
+
+        //! Checks an avatar, and updates its widget if its bucket or frustum state changed
+        /*! \param force Update the widget even if nothing changed, for example after hovering
+            \return false if the avatar or its widget no longer exists
+         */
+        bool CheckAvatar(entity_id_t entity_id, TrackedAvatar& avatar, bool force, Ogre::Camera* camera);
+
+        //! Returns the widget of an avatar, or null if the avatar no longer exists
+        EC_HoveringWidget* GetWidget(entity_id_t entity_id) const;
+
+        //! Owner module
+        RexLogicModule* owner_;
+
+        //! Tracked avatars
+        AvatarMap avatars_;
+
+        //! Avatars that moved or were added since the last update
+        std::set<entity_id_t> dirty_;
+
+        //! Avatars that need an update regardless of their bucket
+        std::set<entity_id_t> forced_;
+
+        //! Avatars whose hover timer is running, and that need an update when it stops
+        std::set<entity_id_t> hovered_;
+
+        //! Avatars that were within the visible range of the camera during the last check
+        std::set<entity_id_t> in_range_;
+
+        //! Camera state during the last update
+        Vector3df camera_position_;
+        Vector3df camera_direction_;
+        Real camera_fov_;
+        Real camera_aspect_;
+
+        //! Number of widgets updated during the last frame
+        uint num_updated_;
+    };
+}
+
+#endif
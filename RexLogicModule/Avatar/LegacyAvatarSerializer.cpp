@@ -30,7 +30,17 @@ namespace RexLogic
         "cumulative"
     };
     
-    bool LegacyAvatarSerializer::ReadAvatarAppearance(RexLogic::EC_AvatarAppearance& dest, const QDomDocument& source, bool read_mesh)
+    //! Decomposes an orientation into XYZ euler angles, the way bone modifiers interpolate rotations
+    static void GetEulerAngles(Vector3df& dest, const Quaternion& orientation)
+    {
+        Ogre::Matrix3 rot;
+        Ogre::Radian x, y, z;
+        OgreRenderer::ToOgreQuaternion(orientation).ToRotationMatrix(rot);
+        rot.ToEulerAnglesXYZ(x, y, z);
+        dest = Vector3df(x.valueRadians(), y.valueRadians(), z.valueRadians());
+    }
+    
+    bool LegacyAvatarSerializer::ReadAvatarAppearance(RexLogic::EC_AvatarAppearance& dest, const QDomDocument& source, bool read_mesh, const BoneModifierSetVector* bone_modifiers)
     {
         PROFILE(Avatar_ReadAvatarAppearance);
         
@@ -123,21 +133,14 @@ namespace RexLogic
         dest.SetAttachments(attachments);
         
         // Get bone modifiers
-        QDomElement bonemodifier_elem = avatar.firstChildElement("dynamic_animation");
-        BoneModifierSetVector bonemodifiers;
-        while (!bonemodifier_elem.isNull())
-        {
-            ReadBoneModifierSet(bonemodifiers, bonemodifier_elem);
-            bonemodifier_elem = bonemodifier_elem.nextSiblingElement("dynamic_animation");
-        }        
-        // Get bone modifier parameters
-        QDomElement bonemodifierparam_elem = avatar.firstChildElement("dynamic_animation_parameter");
-        while (!bonemodifierparam_elem.isNull())
+        if (bone_modifiers)
+            dest.SetBoneModifiers(*bone_modifiers);
+        else
         {
-            ReadBoneModifierParameter(bonemodifiers, bonemodifierparam_elem);
-            bonemodifierparam_elem = bonemodifierparam_elem.nextSiblingElement("dynamic_animation_parameter");
+            BoneModifierSetVector bonemodifiers;
+            ReadBoneModifiers(bonemodifiers, source);
+            dest.SetBoneModifiers(bonemodifiers);
         }
-        dest.SetBoneModifiers(bonemodifiers);
         
         // Get morph modifiers
         QDomElement morphmodifier_elem = avatar.firstChildElement("morph_modifier");
@@ -200,6 +203,29 @@ namespace RexLogic
         return true;
     }
     
+    bool LegacyAvatarSerializer::ReadBoneModifiers(BoneModifierSetVector& dest, const QDomDocument& source)
+    {
+        QDomElement avatar = source.firstChildElement("avatar");
+        if (avatar.isNull())
+            return false;
+        
+        QDomElement bonemodifier_elem = avatar.firstChildElement("dynamic_animation");
+        while (!bonemodifier_elem.isNull())
+        {
+            ReadBoneModifierSet(dest, bonemodifier_elem);
+            bonemodifier_elem = bonemodifier_elem.nextSiblingElement("dynamic_animation");
+        }        
+        // Get bone modifier parameters
+        QDomElement bonemodifierparam_elem = avatar.firstChildElement("dynamic_animation_parameter");
+        while (!bonemodifierparam_elem.isNull())
+        {
+            ReadBoneModifierParameter(dest, bonemodifierparam_elem);
+            bonemodifierparam_elem = bonemodifierparam_elem.nextSiblingElement("dynamic_animation_parameter");
+        }
+        
+        return true;
+    }
+    
     bool LegacyAvatarSerializer::ReadBoneModifierSet(BoneModifierSetVector& dest, const QDomElement& source)
     {
         BoneModifierSet modifier_set;
@@ -225,6 +251,8 @@ namespace RexLogic
                 modifier.end_.position_ = ParseVector3(translation.attribute("end").toStdString());
                 modifier.end_.orientation_ = ParseEulerAngles(rotation.attribute("end").toStdString());
                 modifier.end_.scale_ = ParseVector3(scale.attribute("end").toStdString());
+                GetEulerAngles(modifier.start_euler_, modifier.start_.orientation_);
+                GetEulerAngles(modifier.end_euler_, modifier.end_.orientation_);
                 
                 std::string trans_mode = translation.attribute("mode").toStdString();
                 std::string rot_mode = rotation.attribute("mode").toStdString();
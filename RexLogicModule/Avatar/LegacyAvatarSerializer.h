@@ -20,9 +20,14 @@ namespace RexLogic
         /*! \param dest Destination EC_AvatarAppearance
             \param source Source XML document
             \param read_mesh Whether to read and overwrite the mesh element, default true
+            \param bone_modifiers Bone modifiers already read from the document with ReadBoneModifiers(), to use instead of reading them again
             \return true if mostly successful
          */
-        static bool ReadAvatarAppearance(EC_AvatarAppearance& dest, const QDomDocument& source, bool read_mesh = true);
+        static bool ReadAvatarAppearance(EC_AvatarAppearance& dest, const QDomDocument& source, bool read_mesh = true, const BoneModifierSetVector* bone_modifiers = 0);
+        
+        //! Reads bone modifiers only from an xml document. Does not touch any EC, so can be used from a worker thread.
+        //! \return true if successful
+        static bool ReadBoneModifiers(BoneModifierSetVector& dest, const QDomDocument& source);
         
         //! Reads animation definitions only from an xml document
         //! \return true if successful
@@ -121,6 +121,9 @@ namespace RexLogic
         BoneModifierMode position_mode_;
         //! Mode of applying rotation modification
         BoneModifierMode orientation_mode_;
+        //! Start & end rotation as XYZ euler angles in radians, derived from the orientations when the modifier is read
+        Vector3df start_euler_;
+        Vector3df end_euler_;
 
         BoneModifier() : 
             position_mode_(Relative),
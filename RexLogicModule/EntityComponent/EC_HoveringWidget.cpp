@@ -13,6 +13,7 @@
 #include "EC_OgrePlaceable.h"
 #include "Entity.h"
 #include "OgreMaterialUtils.h"
+#include "LabelAtlas.h"
 
 #include "HoveringNameController.h"
 #include "HoveringButtonsController.h"
@@ -42,9 +43,10 @@ namespace RexLogic
 
     EC_HoveringWidget::EC_HoveringWidget(Foundation::ModuleInterface* module) :
     Foundation::ComponentInterface(module->GetFramework()),
-        namebillboardSet_(0),
+        name_label_(0),
+        name_width_(0.25f),
+        name_height_(0.08f),
         buttonsbillboardSet_(0),
-        namebillboard_(0),
         buttonsbillboard_(0),
         visibility_animation_timeline_(new QTimeLine(1000, this)),
         visibility_timer_(new QTimer(this)),
@@ -94,6 +96,10 @@ namespace RexLogic
 
     EC_HoveringWidget::~EC_HoveringWidget()
     {
+        OgreRenderer::LabelAtlas* atlas = GetLabelAtlas();
+        if (atlas && name_label_)
+            atlas->DestroyLabel(name_label_);
+
         SAFE_DELETE(namewidget_);
         SAFE_DELETE(buttonswidget_);
         //SAFE_DELETE(detachedwidget_);
@@ -139,7 +145,7 @@ namespace RexLogic
             AdjustWidgetinfo();
             if(IsVisible())
             {
-                ScaleWidget(*namebillboardSet_, *namebillboard_, bb_name_size_view);
+                ScaleNameTag();
                 ScaleWidget(*buttonsbillboardSet_, *buttonsbillboard_, bb_buttons_size_view,true);
             }
         }
@@ -151,13 +157,44 @@ namespace RexLogic
             return;
         Ogre::Matrix4 worldmat;
         bset.getWorldTransforms(&worldmat);
+
+        QSizeF dimensions = ScreenSizeToWorldSize(worldmat * b.getPosition(), size);
+        b.setDimensions(dimensions.width(), dimensions.height());
+        
+        if(next_to_name_tag)
+        {
+            // The name tag is centered above the entity, see ScaleNameTag()
+            Ogre::Vector3 pos(0, 0, bb_rel_posy + name_height_*0.5);
+            pos.y += ((-name_width_*0.5)  /*+(-b.getOwnWidth()*0.5)*/);
+            pos.z -= (name_height_*0.5) + b.getOwnHeight()*0.5;
+            b.setPosition(pos.x ,pos.y ,pos.z);
+        }
+        else
+            b.setPosition(b.getPosition().x  ,b.getPosition().y  ,bb_rel_posy +  (b.getOwnHeight()/2) );
+
+    }
+
+    void EC_HoveringWidget::ScaleNameTag()
+    {
+        OgreRenderer::LabelAtlas* atlas = GetLabelAtlas();
+        if (!atlas || !name_label_)
+            return;
+
+        QSizeF dimensions = ScreenSizeToWorldSize(atlas->GetWorldPosition(name_label_), bb_name_size_view);
+        name_width_ = dimensions.width();
+        name_height_ = dimensions.height();
+        atlas->SetDimensions(name_label_, name_width_, name_height_);
+        atlas->SetOffset(name_label_, Ogre::Vector3(0, 0, bb_rel_posy + name_height_*0.5));
+    }
+
+    QSizeF EC_HoveringWidget::ScreenSizeToWorldSize(const Ogre::Vector3& world_pos, const QSizeF& size)
+    {
         Ogre::Camera* camera = renderer_.lock()->GetCurrentCamera();
 
-        Ogre::Vector3 mid_pos = b.getPosition();
         Ogre::Matrix4 viewproj = camera->getViewMatrix();
         viewproj = camera->getProjectionMatrix() * viewproj;
 
-        mid_pos = viewproj * worldmat * mid_pos;
+        Ogre::Vector3 mid_pos = viewproj * world_pos;
         
         Ogre::Vector3 pos1(mid_pos.x - size.width()/2,mid_pos.y-size.height()/2, mid_pos.z);
         Ogre::Vector3 pos2(mid_pos.x + size.width()/2, mid_pos.y+size.height()/2, mid_pos.z);
@@ -181,19 +218,14 @@ namespace RexLogic
         Ogre::Vector3 width_vec = cam_right.absDotProduct(diagonal) * cam_right;
         Ogre::Vector3 height_vec = cam_up.absDotProduct(diagonal) * cam_up;
 
-        
-        b.setDimensions(width_vec.length(), height_vec.length());
-        
-        if(next_to_name_tag)
-        {
-            Ogre::Vector3 pos(namebillboard_->getPosition());
-            pos.y += ((-namebillboard_->getOwnWidth()*0.5)  /*+(-b.getOwnWidth()*0.5)*/);
-            pos.z -= (namebillboard_->getOwnHeight()*0.5) + b.getOwnHeight()*0.5;
-            b.setPosition(pos.x ,pos.y ,pos.z);
-        }
-        else
-            b.setPosition(b.getPosition().x  ,b.getPosition().y  ,bb_rel_posy +  (b.getOwnHeight()/2) );
+        return QSizeF(width_vec.length(), height_vec.length());
+    }
 
+    OgreRenderer::LabelAtlas* EC_HoveringWidget::GetLabelAtlas() const
+    {
+        if (renderer_.expired())
+            return 0;
+        return renderer_.lock()->GetLabelAtlas();
     }
 
     void EC_HoveringWidget::AdjustWidgetinfo()
@@ -240,8 +272,9 @@ namespace RexLogic
 
     void EC_HoveringWidget::Show()
     {
-        if (namebillboardSet_ && !disabled_)
-            namebillboardSet_->setVisible(true);
+        OgreRenderer::LabelAtlas* atlas = GetLabelAtlas();
+        if (atlas && name_label_ && !disabled_)
+            atlas->SetVisible(name_label_, true);
         if (buttonsbillboardSet_ && !disabled_ && !buttons_disabled_)
             buttonsbillboardSet_->setVisible(true);
     }
@@ -283,6 +316,8 @@ namespace RexLogic
             if(!detached_)
             {
                 Attach();
+                // Camera distance updates are ignored while detached, so rescale with the last distance
+                SetCameraDistance(cam_distance_);
             }
             else
             {
@@ -294,8 +329,9 @@ namespace RexLogic
 
     void EC_HoveringWidget::Hide()
     {
-        if (namebillboardSet_)
-            namebillboardSet_->setVisible(false);
+        OgreRenderer::LabelAtlas* atlas = GetLabelAtlas();
+        if (atlas && name_label_)
+            atlas->SetVisible(name_label_, false);
         if(buttonsbillboardSet_)
             buttonsbillboardSet_->setVisible(false);
     }
@@ -331,18 +367,14 @@ namespace RexLogic
 
     void EC_HoveringWidget::UpdateAnimationStep(int step)
     {
-        if (namematerialName_.empty())
+        OgreRenderer::LabelAtlas* atlas = GetLabelAtlas();
+        if (!atlas || !name_label_)
             return;
 
         float alpha = step;
         alpha /= 100;
 
-        Ogre::MaterialManager &mgr = Ogre::MaterialManager::getSingleton();
-        Ogre::MaterialPtr material = mgr.getByName(namematerialName_);
-        assert(material.get());
-
-        material->getTechnique(0)->getPass(0)->getTextureUnitState(0)->setAlphaOperation(
-            Ogre::LBX_BLEND_MANUAL, Ogre::LBS_TEXTURE, Ogre::LBS_MANUAL, 1.0, 0.0, alpha);
+        atlas->SetAlpha(name_label_, alpha);
     }
 
     void EC_HoveringWidget::AnimationFinished()
@@ -353,8 +385,9 @@ namespace RexLogic
 
     bool EC_HoveringWidget::IsVisible() const
     {
-        if (namebillboardSet_)
-            return namebillboardSet_->isVisible();
+        OgreRenderer::LabelAtlas* atlas = GetLabelAtlas();
+        if (atlas && name_label_)
+            return atlas->IsVisible(name_label_);
         else
             return false;
     }
@@ -369,6 +402,11 @@ namespace RexLogic
         hovering_timer_->start(hovering_time_);
     }
 
+    bool EC_HoveringWidget::IsHovered() const
+    {
+        return hovering_timer_->isActive();
+    }
+
     void EC_HoveringWidget::InitializeBillboards()
     {
             if (renderer_.expired())
@@ -379,6 +417,10 @@ namespace RexLogic
         if (!scene)
             return;
 
+        OgreRenderer::LabelAtlas* atlas = renderer_.lock()->GetLabelAtlas();
+        if (!atlas)
+            return;
+
         Scene::Entity *entity = GetParentEntity();
         assert(entity);
         if (!entity)
@@ -393,47 +435,33 @@ namespace RexLogic
         if (!sceneNode)
             return;
 
-        // Create billboard if it doesn't exist.
-        if (!namebillboardSet_ && !namebillboard_ && !buttonsbillboardSet_ && !buttonsbillboard_)
+        // Create billboard if it doesn't exist. The name tag is drawn from the shared label atlas, the buttons keep
+        // their own billboard set because it is used for picking.
+        if (!name_label_ && !buttonsbillboardSet_ && !buttonsbillboard_)
         {
-            namebillboardSet_ = scene->createBillboardSet(renderer_.lock()->GetUniqueObjectName(), 1);
+            name_label_ = atlas->CreateLabel(sceneNode, Ogre::Vector3(0, 0, bb_rel_posy));
+            atlas->SetDimensions(name_label_, name_width_, name_height_);
+
             buttonsbillboardSet_ = scene->createBillboardSet(renderer_.lock()->GetUniqueObjectName(), 1);
-            assert(namebillboardSet_);
             assert(buttonsbillboardSet_);
 
-            namematerialName_ = std::string("material")+ std::string("name") + renderer_.lock()->GetUniqueObjectName();
             buttonsmaterialName_ = std::string("material")+ std::string("buttons") + renderer_.lock()->GetUniqueObjectName();
             
-            OgreRenderer::CloneMaterial("HoveringText", namematerialName_);
             OgreRenderer::CloneMaterial("HoveringText", buttonsmaterialName_);
-            
-
-            namebillboardSet_->setMaterialName(namematerialName_);
-            namebillboardSet_->setCastShadows(false);
 
             buttonsbillboardSet_->setMaterialName(buttonsmaterialName_);
             buttonsbillboardSet_->setCastShadows(false);
 
-
-            namebillboardSet_->setBillboardType(Ogre::BBT_ORIENTED_COMMON);
             buttonsbillboardSet_->setBillboardType(Ogre::BBT_ORIENTED_COMMON);
 
-            namebillboardSet_->setCommonUpVector(Ogre::Vector3::UNIT_Z);
             buttonsbillboardSet_->setCommonUpVector(Ogre::Vector3::UNIT_Z);
 
-            namebillboard_ = namebillboardSet_->createBillboard(Ogre::Vector3(0, 0, bb_rel_posy));
-            assert(namebillboard_);
-            namebillboard_->setDimensions(bb_name_size_view.width(), bb_name_size_view.height());
-            sceneNode->attachObject(namebillboardSet_);
-
-            
             buttonsbillboard_ = buttonsbillboardSet_->createBillboard(Ogre::Vector3(0, 0, bb_rel_posy));
             assert(buttonsbillboard_);
-            assert(namebillboard_);
             buttonsbillboard_->setDimensions(bb_buttons_size_view.width(), bb_buttons_size_view.height());
             sceneNode->attachObject(buttonsbillboardSet_);
         }
-        namebillboardSet_->setVisible(false);
+        atlas->SetVisible(name_label_, false);
         buttonsbillboardSet_->setVisible(false);
         Redraw();
     }
@@ -461,7 +489,8 @@ namespace RexLogic
 
     void EC_HoveringWidget::Redraw()
     {
-        if (renderer_.expired() || !namebillboardSet_ || !namebillboard_)
+        OgreRenderer::LabelAtlas* atlas = GetLabelAtlas();
+        if (!atlas || !name_label_ || !buttonsbillboardSet_)
             return;
 
         // Get pixmap with text rendered to it.
@@ -470,42 +499,32 @@ namespace RexLogic
         if (pixmap1.isNull()||pixmap2.isNull())
             return;
 
+        // Name tag goes to the atlas
+        atlas->SetImage(name_label_, pixmap1.toImage(), name_width_, name_height_);
+
         // Create texture
-        QImage img1 = pixmap1.toImage();
         QImage img2 = pixmap2.toImage();
 
-        Ogre::DataStreamPtr stream1(new Ogre::MemoryDataStream((void*)img1.bits(), img1.byteCount()));
         Ogre::DataStreamPtr stream2(new Ogre::MemoryDataStream((void*)img2.bits(), img2.byteCount()));
 
-        std::string tex_name1("HoveringTextTexture" + renderer_.lock()->GetUniqueObjectName());
         std::string tex_name2("HoveringTextTexture" + renderer_.lock()->GetUniqueObjectName());
 
         Ogre::TextureManager &manager = Ogre::TextureManager::getSingleton();
 
-        Ogre::Texture *tex1 = checked_static_cast<Ogre::Texture *>(manager.create(
-            tex_name1, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME).get());
         Ogre::Texture *tex2 = checked_static_cast<Ogre::Texture *>(manager.create(
             tex_name2, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME).get());
 
-        assert(tex1);
         assert(tex2);
 
-        tex1->loadRawData(stream1, img1.width(), img1.height(), Ogre::PF_A8R8G8B8);
         tex2->loadRawData(stream2, img2.width(), img2.height(), Ogre::PF_A8R8G8B8);
 
         // Set new texture for the material
-        assert(!namematerialName_.empty() || !buttonsmaterialName_.empty());
-        if (!namematerialName_.empty() && !buttonsmaterialName_.empty())
+        assert(!buttonsmaterialName_.empty());
+        if (!buttonsmaterialName_.empty())
         {
             Ogre::MaterialManager &mgr = Ogre::MaterialManager::getSingleton();
 
-            Ogre::MaterialPtr material = mgr.getByName(namematerialName_);
-            material->getTechnique(0)->getPass(0)->getTextureUnitState(0)->setTextureFiltering(Ogre::TFO_ANISOTROPIC);
-            assert(material.get()); 
-            OgreRenderer::SetTextureUnitOnMaterial(material, tex_name1);
-
-
-            material = mgr.getByName(buttonsmaterialName_);
+            Ogre::MaterialPtr material = mgr.getByName(buttonsmaterialName_);
             material->getTechnique(0)->getPass(0)->getTextureUnitState(0)->setTextureFiltering(Ogre::TFO_ANISOTROPIC);
             assert(material.get());
             OgreRenderer::SetTextureUnitOnMaterial(material, tex_name2);
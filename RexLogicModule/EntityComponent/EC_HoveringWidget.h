@@ -31,11 +31,13 @@ namespace Ogre
     class BillboardSet;
     class Billboard;
     class MaterialPtr;
+    class Vector3;
 }
 
 namespace OgreRenderer
 {
     class Renderer;
+    class LabelAtlas;
 }
 
 class QPushButton;
@@ -80,6 +82,9 @@ namespace RexLogic
 
         //!called when widget is hovered
         void HoveredOver();
+
+        //! @return true if the widget was hovered recently, and is shown regardless of its distance
+        bool IsHovered() const;
         //!Initializes billboards, must be called before use
         void InitializeBillboards();
         
@@ -162,22 +167,31 @@ namespace RexLogic
         /// Returns pixmap with widget rendered to it
         QPixmap GetPixmap(QWidget& w, QRect dimensions);
 
+        /// Returns the renderer's label atlas, or null if the renderer is gone.
+        OgreRenderer::LabelAtlas* GetLabelAtlas() const;
+
+        /// Returns world size for a billboard at world_pos to cover size of the screen, and saves its screen position.
+        QSizeF ScreenSizeToWorldSize(const Ogre::Vector3& world_pos, const QSizeF& size);
+
+        /// Scales the name tag to have static screenspace size.
+        void ScaleNameTag();
+
         /// Renderer pointer.
         boost::weak_ptr<OgreRenderer::Renderer> renderer_;
 
-        /// Ogre billboard set.
-        Ogre::BillboardSet *namebillboardSet_;
+        /// Name tag label in the renderer's label atlas, 0 if not created yet.
+        uint name_label_;
+
+        /// World size of the name tag.
+        Real name_width_;
+        Real name_height_;
+
         /// Ogre billboard set.
         Ogre::BillboardSet *buttonsbillboardSet_;
 
-        /// Ogre billboard.
-        Ogre::Billboard *namebillboard_;
-
         /// Ogre billboard.
         Ogre::Billboard *buttonsbillboard_;
 
-        /// Name of the material used for the name billboard set.
-        std::string namematerialName_;
         /// Name of the material used for the buttons billboard set.
         std::string buttonsmaterialName_;
 
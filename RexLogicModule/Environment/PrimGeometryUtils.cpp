@@ -212,16 +212,14 @@ namespace RexLogic
                         if (fullbright)
                             variation |= OgreRenderer::LEGACYMAT_FULLBRIGHT;
                         
-                        std::string suffix = OgreRenderer::GetMaterialSuffix(variation);
-                        
                         // Try to find face's texture in texturemap, use default if not found
-                        texture_id = primitive.PrimDefaultTextureID + suffix;
+                        std::string base_texture_id = primitive.PrimDefaultTextureID;
                         TextureMap::const_iterator t = primitive.PrimTextures.find(facenum);
                         if (t != primitive.PrimTextures.end())
-                            texture_id = t->second + suffix;
-                        // Actually create the material here if texture yet missing, the material will be
+                            base_texture_id = t->second;
+                        // Actually create the material variation here, if texture yet missing the material will be
                         // updated later
-                        OgreRenderer::CreateLegacyMaterials(texture_id);
+                        texture_id = OgreRenderer::GetLegacyMaterial(base_texture_id, variation);
                     }
      
                     // Get texture mapping parameters
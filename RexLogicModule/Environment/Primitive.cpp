@@ -29,6 +29,7 @@
 #include "SceneEvents.h"
 #include "ResourceInterface.h"
 #include "Environment/PrimGeometryUtils.h"
+#include "Environment/SceneSnapshot.h"
 #include "SceneManager.h"
 #include "AssetServiceInterface.h"
 #include "SoundServiceInterface.h"
@@ -38,6 +39,8 @@
 #include "WorldStream.h"
 #include "EC_HoveringText.h"
 #include "EC_OpenSimPrim.h"
+#include "ConfigurationManager.h"
+#include "DataSerializer.h"
 
 #include <OgreSceneNode.h>
 
@@ -48,8 +51,19 @@
 namespace RexLogic
 {
 
+/// Binary EC data is sent as base64 after this prefix, so that it survives the string parameters of GenericMessage
+/// and can't be mistaken for XML.
+static const std::string cBinaryECPrefix = "ECB:";
+
+/// Version of the binary EC data format.
+static const u8 cBinaryECVersion = 1;
+
 Primitive::Primitive(RexLogicModule *rexlogicmodule) : rexlogicmodule_(rexlogicmodule)
 {
+    // Off by default: older clients and tools only parse XML freedata, and the server stores whatever is sent as
+    // the EC state of the prim. Binary data is always understood when received.
+    binary_ec_serialization_ = rexlogicmodule_->GetFramework()->GetDefaultConfig().DeclareSetting(
+        "RexLogic", "binary_ec_serialization", false);
 }
 
 Primitive::~Primitive()
@@ -68,6 +82,9 @@ Scene::EntityPtr Primitive::GetOrCreatePrimEntity(entity_id_t entityid, const Re
     if (!scene)
         return Scene::EntityPtr();
 
+    // Drop a prim restored from the scene snapshot if it conflicts with this object
+    rexlogicmodule_->GetSceneSnapshot()->Reconcile(entityid, fullid);
+
     Scene::EntityPtr entity = rexlogicmodule_->GetPrimEntity(entityid);
     if (!entity)
     {
@@ -514,6 +531,18 @@ void Primitive::SendRexPrimData(entity_id_t entityid)
     RexUUID fullid = prim->FullId;
     
     std::vector<uint8_t> buffer;
+    WriteRexPrimDataBlob(prim, buffer);
+
+    WorldStreamPtr conn = rexlogicmodule_->GetServerConnection();
+    if (!conn)
+        return;
+    StringVector strings;
+    strings.push_back(fullid.ToString());
+    conn->SendGenericMessageBinary("RexPrimData", strings, buffer);
+}
+
+void Primitive::WriteRexPrimDataBlob(const EC_OpenSimPrim *prim, std::vector<uint8_t>& buffer)
+{
     buffer.resize(4096);
     int idx = 0;
     bool send_asset_urls = false;
@@ -587,13 +616,6 @@ void Primitive::SendRexPrimData(entity_id_t entityid)
     }
 
     buffer.resize(idx);
-
-    WorldStreamPtr conn = rexlogicmodule_->GetServerConnection();
-    if (!conn)
-        return;
-    StringVector strings;
-    strings.push_back(fullid.ToString());
-    conn->SendGenericMessageBinary("RexPrimData", strings, buffer);
 }
 
 void Primitive::SendRexFreeData(entity_id_t entityid)
@@ -745,12 +767,27 @@ void Primitive::HandleRexFreeData(entity_id_t entityid, const std::string& freed
     EC_FreeData& free = *(dynamic_cast<EC_FreeData*>(freeptr.get()));
     free.FreeData = freedata;
     
-    // Parse into XML form (may or may not succeed), and create/update EC's as result
+    // Parse binary or XML form (may or may not succeed), and create/update EC's as result
     // (primitive form of EC serialization/replication)
-    QDomDocument temp_doc;
-    if (temp_doc.setContent(QByteArray::fromRawData(freedata.c_str(), freedata.size())))
+    bool success = false;
+    if (freedata.compare(0, cBinaryECPrefix.size(), cBinaryECPrefix) == 0)
+    {
+        QByteArray bytes = QByteArray::fromBase64(QByteArray::fromRawData(freedata.c_str() + cBinaryECPrefix.size(),
+            freedata.size() - cBinaryECPrefix.size()));
+        success = DeserializeECsFromBinary(entity, std::vector<u8>(bytes.begin(), bytes.end()));
+    }
+    else
+    {
+        QDomDocument temp_doc;
+        if (temp_doc.setContent(QByteArray::fromRawData(freedata.c_str(), freedata.size())))
+        {
+            DeserializeECsFromFreeData(entity, temp_doc);
+            success = true;
+        }
+    }
+    
+    if (success)
     {
-        DeserializeECsFromFreeData(entity, temp_doc);
         Scene::Events::SceneEventData event_data(entity->GetId());
         Foundation::EventManagerPtr event_manager = rexlogicmodule_->GetFramework()->GetEventManager();
         event_manager->SendEvent(event_manager->QueryEventCategory("Scene"), Scene::Events::EVENT_ENTITY_ECS_RECEIVED, &event_data);
@@ -1418,8 +1455,8 @@ void Primitive::HandleTextureReady(entity_id_t entityid, Foundation::ResourcePtr
             uint idx = i->first;
             if ((i->second.Type == RexTypes::RexAT_Texture) && (i->second.asset_id.compare(res->GetId()) == 0))
             {
-                // Use a legacy material with the same name as the texture, created automatically by renderer
-                meshptr->SetMaterial(idx, res->GetId());
+                // Use the normal legacy material of the texture, created automatically by renderer
+                meshptr->SetMaterial(idx, OgreRenderer::GetLegacyMaterial(res->GetId(), OgreRenderer::LEGACYMAT_NORMAL));
                 
                 Scene::Events::EntityEventData event_data;
                 event_data.entity = entity;
@@ -1979,23 +2016,44 @@ void Primitive::SerializeECsToNetwork()
             continue;
         EC_FreeData& free = *(dynamic_cast<EC_FreeData*>(freeptr.get()));
         
-        QDomDocument temp_doc;
-        QDomElement entity_elem = temp_doc.createElement("entity");
-        
-        QString id_str;
-        id_str.setNum(entity->GetId());
-        entity_elem.setAttribute("id", id_str);
-        
+        // Use binary form if all the EC's support it, XML otherwise. The server stores the data as the whole EC state of
+        // the prim, so all attributes are always sent.
+        bool binary = binary_ec_serialization_;
         for (uint j = 0; j < components.size(); ++j)
         {
-            if (components[j]->IsSerializable())
-                components[j]->SerializeTo(temp_doc, entity_elem);
-            // Clear the change flag now that component has been processed
-            components[j]->ResetChange();
+            if (components[j]->IsSerializable() && !components[j]->IsBinarySerializable())
+                binary = false;
         }
         
-        temp_doc.appendChild(entity_elem);
-        QByteArray bytes = temp_doc.toByteArray();
+        QByteArray bytes;
+        if (binary)
+        {
+            std::vector<u8> data;
+            SerializeECsToBinary(components, data);
+            bytes = QByteArray(cBinaryECPrefix.c_str()) + QByteArray::fromRawData((const char*)&data[0], data.size()).toBase64();
+        }
+        else
+        {
+            QDomDocument temp_doc;
+            QDomElement entity_elem = temp_doc.createElement("entity");
+            
+            QString id_str;
+            id_str.setNum(entity->GetId());
+            entity_elem.setAttribute("id", id_str);
+            
+            for (uint j = 0; j < components.size(); ++j)
+            {
+                if (components[j]->IsSerializable())
+                    components[j]->SerializeTo(temp_doc, entity_elem);
+            }
+            
+            temp_doc.appendChild(entity_elem);
+            bytes = temp_doc.toByteArray();
+        }
+        
+        // Clear the change flags now that components have been processed
+        for (uint j = 0; j < components.size(); ++j)
+            components[j]->ResetChange();
         
         if (bytes.size() > 1000)
         {
@@ -2032,6 +2090,77 @@ void Primitive::DeserializeECsFromFreeData(Scene::EntityPtr entity, QDomDocument
         }
     }
     
+    RemoveMissingECs(entity, type_names);
+}
+
+void Primitive::SerializeECsToBinary(const Scene::Entity::ComponentVector& components, std::vector<u8>& data)
+{
+    DataSerializer dest(data);
+    dest.AddU8(cBinaryECVersion);
+    
+    uint count = 0;
+    for (uint i = 0; i < components.size(); ++i)
+    {
+        if (components[i]->IsSerializable())
+            ++count;
+    }
+    dest.AddU8(count);
+    
+    for (uint i = 0; i < components.size(); ++i)
+    {
+        if (components[i]->IsSerializable())
+            components[i]->SerializeToBinary(dest);
+    }
+}
+
+bool Primitive::DeserializeECsFromBinary(Scene::EntityPtr entity, const std::vector<u8>& data)
+{
+    if (data.empty())
+        return false;
+    
+    StringVector type_names;
+    try
+    {
+        DataDeserializer source(&data[0], data.size());
+        if (source.ReadU8() != cBinaryECVersion)
+        {
+            RexLogicModule::LogWarning("Unsupported binary entity component data version");
+            return false;
+        }
+        
+        uint count = source.ReadU8();
+        for (uint i = 0; i < count; ++i)
+        {
+            std::string type_name = source.ReadString();
+            type_names.push_back(type_name);
+            Foundation::ComponentPtr new_comp = entity->GetOrCreateComponent(type_name);
+            if (new_comp)
+            {
+                if (new_comp->DeserializeFromBinary(source, Foundation::Network))
+                    new_comp->ComponentChanged(Foundation::Network);
+                else
+                    RexLogicModule::LogWarning("Could not deserialize entity component from binary data: " + type_name);
+            }
+            else
+            {
+                RexLogicModule::LogWarning("Could not create entity component from binary data: " + type_name);
+                if (!Foundation::ComponentInterface::SkipBinary(source))
+                    return false;
+            }
+        }
+    }
+    catch (Exception&)
+    {
+        RexLogicModule::LogWarning("Malformed binary entity component data");
+        return false;
+    }
+    
+    RemoveMissingECs(entity, type_names);
+    return true;
+}
+
+void Primitive::RemoveMissingECs(Scene::EntityPtr entity, const StringVector& type_names)
+{
     // If the entity has extra serializable EC's, we must remove them if they are no longer in the freedata.
     // However, at present time majority of EC's are not serializable, are handled internally, and must not be removed
     Scene::Entity::ComponentVector all_components = entity->GetComponentVector();
@@ -2054,4 +2183,315 @@ void Primitive::DeserializeECsFromFreeData(Scene::EntityPtr entity, QDomDocument
     }
 }
 
+//! Tags of the entity component data in a scene snapshot record
+enum SnapshotECData
+{
+    SnapshotECNone = 0,
+    SnapshotECBinary,
+    SnapshotECFreeData
+};
+
+static void WriteUVParamMap(DataSerializer& dest, const UVParamMap& params)
+{
+    dest.AddU8(params.size());
+    for (UVParamMap::const_iterator i = params.begin(); i != params.end(); ++i)
+    {
+        dest.AddU8(i->first);
+        dest.AddF32(i->second);
+    }
+}
+
+static void ReadUVParamMap(DataDeserializer& source, UVParamMap& params)
+{
+    params.clear();
+    uint count = source.ReadU8();
+    for (uint i = 0; i < count; ++i)
+    {
+        u8 index = source.ReadU8();
+        params[index] = source.ReadF32();
+    }
+}
+
+void Primitive::SerializeToSnapshot(Scene::EntityPtr entity, DataSerializer& dest)
+{
+    EC_OpenSimPrim *prim = entity->GetComponent<EC_OpenSimPrim>().get();
+    EC_NetworkPosition *netpos = entity->GetComponent<EC_NetworkPosition>().get();
+
+    // Ids & properties
+    dest.AddU32(prim->LocalId);
+    dest.AddBytes(prim->FullId.data, RexUUID::cSizeBytes);
+    dest.AddU32(prim->ParentId);
+    dest.AddU8(prim->Material);
+    dest.AddU8(prim->ClickAction);
+    dest.AddU32(prim->UpdateFlags);
+    dest.AddString(prim->ObjectName);
+    dest.AddString(prim->Description);
+
+    // Transform
+    Vector3df position = netpos ? netpos->position_ : Vector3df::ZERO;
+    Quaternion orientation = netpos ? netpos->orientation_ : Quaternion::IDENTITY;
+    dest.AddF32(position.x);
+    dest.AddF32(position.y);
+    dest.AddF32(position.z);
+    dest.AddF32(orientation.w);
+    dest.AddF32(orientation.x);
+    dest.AddF32(orientation.y);
+    dest.AddF32(orientation.z);
+    dest.AddF32(prim->Scale.x);
+    dest.AddF32(prim->Scale.y);
+    dest.AddF32(prim->Scale.z);
+
+    // Prim shape
+    dest.AddBool(prim->HasPrimShapeData);
+    dest.AddU8(prim->PathCurve);
+    dest.AddU8(prim->ProfileCurve);
+    dest.AddF32(prim->PathBegin);
+    dest.AddF32(prim->PathEnd);
+    dest.AddF32(prim->PathScaleX);
+    dest.AddF32(prim->PathScaleY);
+    dest.AddF32(prim->PathShearX);
+    dest.AddF32(prim->PathShearY);
+    dest.AddF32(prim->PathTwist);
+    dest.AddF32(prim->PathTwistBegin);
+    dest.AddF32(prim->PathRadiusOffset);
+    dest.AddF32(prim->PathTaperX);
+    dest.AddF32(prim->PathTaperY);
+    dest.AddF32(prim->PathRevolutions);
+    dest.AddF32(prim->PathSkew);
+    dest.AddF32(prim->ProfileBegin);
+    dest.AddF32(prim->ProfileEnd);
+    dest.AddF32(prim->ProfileHollow);
+
+    // Texture entry
+    dest.AddString(prim->PrimDefaultTextureID);
+    dest.AddU8(prim->PrimTextures.size());
+    for (TextureMap::const_iterator i = prim->PrimTextures.begin(); i != prim->PrimTextures.end(); ++i)
+    {
+        dest.AddU8(i->first);
+        dest.AddString(i->second);
+    }
+    dest.AddF32(prim->PrimDefaultColor.r);
+    dest.AddF32(prim->PrimDefaultColor.g);
+    dest.AddF32(prim->PrimDefaultColor.b);
+    dest.AddF32(prim->PrimDefaultColor.a);
+    dest.AddU8(prim->PrimColors.size());
+    for (ColorMap::const_iterator i = prim->PrimColors.begin(); i != prim->PrimColors.end(); ++i)
+    {
+        dest.AddU8(i->first);
+        dest.AddF32(i->second.r);
+        dest.AddF32(i->second.g);
+        dest.AddF32(i->second.b);
+        dest.AddF32(i->second.a);
+    }
+    dest.AddU8(prim->PrimDefaultMaterialType);
+    dest.AddU8(prim->PrimMaterialTypes.size());
+    for (MaterialTypeMap::const_iterator i = prim->PrimMaterialTypes.begin(); i != prim->PrimMaterialTypes.end(); ++i)
+    {
+        dest.AddU8(i->first);
+        dest.AddU8(i->second);
+    }
+    dest.AddF32(prim->PrimDefaultRepeatU);
+    dest.AddF32(prim->PrimDefaultRepeatV);
+    dest.AddF32(prim->PrimDefaultOffsetU);
+    dest.AddF32(prim->PrimDefaultOffsetV);
+    dest.AddF32(prim->PrimDefaultUVRotation);
+    WriteUVParamMap(dest, prim->PrimRepeatU);
+    WriteUVParamMap(dest, prim->PrimRepeatV);
+    WriteUVParamMap(dest, prim->PrimOffsetU);
+    WriteUVParamMap(dest, prim->PrimOffsetV);
+    WriteUVParamMap(dest, prim->PrimUVRotation);
+
+    // RexPrimData, in the same form as sent to the server
+    std::vector<uint8_t> blob;
+    WriteRexPrimDataBlob(prim, blob);
+    dest.AddU16(blob.size());
+    dest.AddBytes(&blob[0], blob.size());
+
+    // Entity components: by attributes if they all support it, otherwise the freedata as received from server
+    const Scene::Entity::ComponentVector& components = entity->GetComponentVector();
+    bool binary = false;
+    for (uint i = 0; i < components.size(); ++i)
+    {
+        if (components[i]->IsSerializable())
+        {
+            binary = true;
+            if (!components[i]->IsBinarySerializable())
+            {
+                binary = false;
+                break;
+            }
+        }
+    }
+
+    EC_FreeData *free = entity->GetComponent<EC_FreeData>().get();
+    if (binary)
+    {
+        std::vector<u8> data;
+        SerializeECsToBinary(components, data);
+        dest.AddU8(SnapshotECBinary);
+        dest.AddU32(data.size());
+        dest.AddBytes(&data[0], data.size());
+    }
+    else if (free && !free->FreeData.empty())
+    {
+        dest.AddU8(SnapshotECFreeData);
+        dest.AddU32(free->FreeData.size());
+        dest.AddBytes((const u8*)free->FreeData.data(), free->FreeData.size());
+    }
+    else
+        dest.AddU8(SnapshotECNone);
+}
+
+Scene::EntityPtr Primitive::DeserializeFromSnapshot(DataDeserializer& source)
+{
+    Scene::ScenePtr scene = rexlogicmodule_->GetCurrentActiveScene();
+    if (!scene)
+        return Scene::EntityPtr();
+
+    entity_id_t localid = source.ReadU32();
+    RexUUID fullid;
+    source.ReadBytes(fullid.data, RexUUID::cSizeBytes);
+
+    // Don't overwrite anything already in the scene
+    if (scene->GetEntity(localid) || rexlogicmodule_->GetPrimEntity(fullid))
+        return Scene::EntityPtr();
+
+    Scene::EntityPtr entity = CreateNewPrimEntity(localid);
+    if (!entity)
+        return entity;
+    rexlogicmodule_->RegisterFullId(fullid, localid);
+
+    EC_OpenSimPrim *prim = entity->GetComponent<EC_OpenSimPrim>().get();
+    EC_NetworkPosition *netpos = entity->GetComponent<EC_NetworkPosition>().get();
+    prim->LocalId = localid;
+    prim->FullId = fullid;
+
+    std::vector<uint8_t> blob;
+    try
+    {
+        // Ids & properties
+        prim->ParentId = source.ReadU32();
+        prim->Material = source.ReadU8();
+        prim->ClickAction = source.ReadU8();
+        prim->UpdateFlags = source.ReadU32();
+        prim->ObjectName = source.ReadString();
+        prim->Description = source.ReadString();
+
+        // Transform. Placed directly, without interpolation
+        netpos->position_.x = source.ReadF32();
+        netpos->position_.y = source.ReadF32();
+        netpos->position_.z = source.ReadF32();
+        netpos->orientation_.w = source.ReadF32();
+        netpos->orientation_.x = source.ReadF32();
+        netpos->orientation_.y = source.ReadF32();
+        netpos->orientation_.z = source.ReadF32();
+        netpos->NoVelocity();
+        netpos->NoRotationVelocity();
+        netpos->NoPositionDamping();
+        netpos->NoOrientationDamping();
+        netpos->Updated();
+        prim->Scale.x = source.ReadF32();
+        prim->Scale.y = source.ReadF32();
+        prim->Scale.z = source.ReadF32();
+
+        // Prim shape
+        prim->HasPrimShapeData = source.ReadBool();
+        prim->PathCurve = source.ReadU8();
+        prim->ProfileCurve = source.ReadU8();
+        prim->PathBegin = source.ReadF32();
+        prim->PathEnd = source.ReadF32();
+        prim->PathScaleX = source.ReadF32();
+        prim->PathScaleY = source.ReadF32();
+        prim->PathShearX = source.ReadF32();
+        prim->PathShearY = source.ReadF32();
+        prim->PathTwist = source.ReadF32();
+        prim->PathTwistBegin = source.ReadF32();
+        prim->PathRadiusOffset = source.ReadF32();
+        prim->PathTaperX = source.ReadF32();
+        prim->PathTaperY = source.ReadF32();
+        prim->PathRevolutions = source.ReadF32();
+        prim->PathSkew = source.ReadF32();
+        prim->ProfileBegin = source.ReadF32();
+        prim->ProfileEnd = source.ReadF32();
+        prim->ProfileHollow = source.ReadF32();
+
+        // Texture entry
+        prim->PrimDefaultTextureID = source.ReadString();
+        uint count = source.ReadU8();
+        for (uint i = 0; i < count; ++i)
+        {
+            u8 index = source.ReadU8();
+            prim->PrimTextures[index] = source.ReadString();
+        }
+        prim->PrimDefaultColor.r = source.ReadF32();
+        prim->PrimDefaultColor.g = source.ReadF32();
+        prim->PrimDefaultColor.b = source.ReadF32();
+        prim->PrimDefaultColor.a = source.ReadF32();
+        count = source.ReadU8();
+        for (uint i = 0; i < count; ++i)
+        {
+            u8 index = source.ReadU8();
+            Color color;
+            color.r = source.ReadF32();
+            color.g = source.ReadF32();
+            color.b = source.ReadF32();
+            color.a = source.ReadF32();
+            prim->PrimColors[index] = color;
+        }
+        prim->PrimDefaultMaterialType = source.ReadU8();
+        count = source.ReadU8();
+        for (uint i = 0; i < count; ++i)
+        {
+            u8 index = source.ReadU8();
+            prim->PrimMaterialTypes[index] = source.ReadU8();
+        }
+        prim->PrimDefaultRepeatU = source.ReadF32();
+        prim->PrimDefaultRepeatV = source.ReadF32();
+        prim->PrimDefaultOffsetU = source.ReadF32();
+        prim->PrimDefaultOffsetV = source.ReadF32();
+        prim->PrimDefaultUVRotation = source.ReadF32();
+        ReadUVParamMap(source, prim->PrimRepeatU);
+        ReadUVParamMap(source, prim->PrimRepeatV);
+        ReadUVParamMap(source, prim->PrimOffsetU);
+        ReadUVParamMap(source, prim->PrimOffsetV);
+        ReadUVParamMap(source, prim->PrimUVRotation);
+
+        // RexPrimData. Read fully before applying, so that the blob parser stays within the data
+        blob.resize(source.ReadU16());
+        if (!blob.empty())
+            source.ReadBytes(&blob[0], blob.size());
+
+        // Entity components
+        u8 ec_data = source.ReadU8();
+        if (ec_data != SnapshotECNone)
+        {
+            std::vector<u8> data(source.ReadU32());
+            if (!data.empty())
+                source.ReadBytes(&data[0], data.size());
+            if (ec_data == SnapshotECBinary)
+                DeserializeECsFromBinary(entity, data);
+            else
+                HandleRexFreeData(localid, std::string(data.begin(), data.end()));
+        }
+    }
+    catch (Exception&)
+    {
+        RexLogicModule::LogWarning("Malformed scene snapshot data for prim " + fullid.ToString());
+        scene->RemoveEntity(localid);
+        rexlogicmodule_->UnregisterFullId(fullid);
+        return Scene::EntityPtr();
+    }
+
+    // Applying the RexPrimData also sets up the geometry, materials and sound of the prim
+    if (!blob.empty())
+        HandleRexPrimDataBlob(localid, &blob[0], blob.size());
+    else
+    {
+        HandleDrawType(localid);
+        HandlePrimScaleAndVisibility(localid);
+    }
+
+    return entity;
+}
+
 } // namespace RexLogic
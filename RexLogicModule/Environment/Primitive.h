@@ -77,6 +77,16 @@ namespace RexLogic
         
         // Deserialize EC's sent by server
         void DeserializeECsFromFreeData(Scene::EntityPtr entity, QDomDocument& doc);
+
+        // Deserialize EC's sent by server in binary form. Returns false if the data was malformed
+        bool DeserializeECsFromBinary(Scene::EntityPtr entity, const std::vector<u8>& data);
+
+        //! Writes the state of a prim entity as a scene snapshot record
+        void SerializeToSnapshot(Scene::EntityPtr entity, DataSerializer& dest);
+
+        //! Creates a prim entity from a scene snapshot record, as if it had been received from the server.
+        //! @return The new entity, or null if the prim already exists or the record was malformed.
+        Scene::EntityPtr DeserializeFromSnapshot(DataDeserializer& source);
         
     public slots:
         //! Trigger EC sync because of component attributes changing
@@ -178,6 +188,15 @@ namespace RexLogic
         // Go through dirty lists & send changed components to server
         void SerializeECsToNetwork();
 
+        // Serialize the serializable EC's of an entity in binary form
+        void SerializeECsToBinary(const Scene::Entity::ComponentVector& components, std::vector<u8>& data);
+
+        //! Writes the RexPrimData blob of a prim
+        static void WriteRexPrimDataBlob(const EC_OpenSimPrim *prim, std::vector<uint8_t>& buffer);
+
+        // Remove serializable EC's that were not present in the EC data received from server
+        void RemoveMissingECs(Scene::EntityPtr entity, const StringVector& type_names);
+
         //! Return valid uuid if given id is valid uuid or if given id
         //! is valid asset url with format: 'http://domain/path/xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx'
         //! Return zero uuid if either above works
@@ -206,6 +225,10 @@ namespace RexLogic
         EntityIdSet local_dirty_entities_;
         //! entities with EC changes from the network
         EntityIdSet network_dirty_entities_;
+
+        //! send EC data in binary form instead of XML, when all EC's of the entity support it. opt-in, as clients
+        //! that only parse XML would lose the EC's
+        bool binary_ec_serialization_;
     };
 }
 #endif
@@ -0,0 +1,298 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   SceneSnapshot.cpp
+ *  @brief  Saves the prims of a region to disk on logout and restores them on the next connect.
+ */
+
+#include "StableHeaders.h"
+#include "Environment/SceneSnapshot.h"
+#include "Environment/Primitive.h"
+#include "RexLogicModule.h"
+#include "EC_OpenSimPrim.h"
+#include "SceneManager.h"
+#include "DataSerializer.h"
+#include "ConfigurationManager.h"
+#include "Platform.h"
+
+#include <QFile>
+#include <QDir>
+
+namespace RexLogic
+{
+
+/// Identifies a scene snapshot file.
+static const u8 cSnapshotMagic[4] = { 'R', 'X', 'S', 'S' };
+
+/// Version of the snapshot format. Files of other versions are ignored.
+static const u32 cSnapshotVersion = 1;
+
+/// Size of the file header: magic, version, region id, prim count and checksum.
+static const size_t cSnapshotHeaderSize = 4 + 4 + RexUUID::cSizeBytes + 4 + 4;
+
+/// Directory of the snapshot files under the application data directory.
+static const char *cSnapshotDirectory = "/scenecache";
+
+/// 32-bit FNV-1a hash, used to detect truncated or corrupted files.
+static u32 Checksum(const u8 *data, size_t size)
+{
+    u32 hash = 2166136261u;
+    for(size_t i = 0; i < size; ++i)
+    {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+SceneSnapshot::SceneSnapshot(RexLogicModule *rexlogicmodule) :
+    rexlogicmodule_(rexlogicmodule),
+    time_since_confirm_(0.0)
+{
+    Foundation::Framework *framework = rexlogicmodule_->GetFramework();
+    enabled_ = framework->GetDefaultConfig().DeclareSetting("RexLogicModule", "scene_snapshots", true);
+    confirm_timeout_ = framework->GetDefaultConfig().DeclareSetting("RexLogicModule", "scene_snapshot_confirm_timeout", 30.0);
+    cache_path_ = framework->GetPlatform()->GetApplicationDataDirectory() + cSnapshotDirectory;
+}
+
+SceneSnapshot::~SceneSnapshot()
+{
+}
+
+void SceneSnapshot::HandleRegionHandshake(const RexUUID &region_id)
+{
+    // The handshake may be resent
+    if (region_id == region_id_)
+        return;
+
+    region_id_ = region_id;
+    unconfirmed_.clear();
+    time_since_confirm_ = 0.0;
+
+    if (enabled_ && !region_id_.IsNull())
+        Load(region_id_);
+}
+
+void SceneSnapshot::Reconcile(entity_id_t entityid, const RexUUID &fullid)
+{
+    if (unconfirmed_.empty())
+        return;
+
+    // A restored prim with this local id
+    EntityIdMap::iterator i = unconfirmed_.find(entityid);
+    if (i != unconfirmed_.end())
+    {
+        if (i->second == fullid)
+        {
+            unconfirmed_.erase(i);
+            time_since_confirm_ = 0.0;
+            return;
+        }
+
+        // The local id now belongs to another object
+        RemoveEntity(i->first, i->second);
+        unconfirmed_.erase(i);
+    }
+
+    // The object was restored with a different local id
+    Scene::EntityPtr entity = rexlogicmodule_->GetPrimEntity(fullid);
+    if (entity && entity->GetId() != entityid)
+    {
+        i = unconfirmed_.find(entity->GetId());
+        if (i != unconfirmed_.end())
+        {
+            RemoveEntity(i->first, i->second);
+            unconfirmed_.erase(i);
+        }
+    }
+}
+
+void SceneSnapshot::Update(f64 frametime)
+{
+    if (unconfirmed_.empty())
+        return;
+
+    time_since_confirm_ += frametime;
+    if (time_since_confirm_ < confirm_timeout_)
+        return;
+
+    RexLogicModule::LogInfo("Removing " + ToString(unconfirmed_.size()) + " prims of the scene snapshot not sent by the server");
+    for(EntityIdMap::const_iterator i = unconfirmed_.begin(); i != unconfirmed_.end(); ++i)
+        RemoveEntity(i->first, i->second);
+    unconfirmed_.clear();
+}
+
+void SceneSnapshot::HandleLogout()
+{
+    if (enabled_ && !region_id_.IsNull())
+        Save(region_id_);
+
+    region_id_ = RexUUID();
+    unconfirmed_.clear();
+    time_since_confirm_ = 0.0;
+}
+
+void SceneSnapshot::Save(const RexUUID &region_id)
+{
+    PROFILE(SceneSnapshot_Save);
+
+    Scene::ScenePtr scene = rexlogicmodule_->GetCurrentActiveScene();
+    Primitive *primitive = rexlogicmodule_->GetPrimitiveHandler().get();
+    if (!scene || !primitive)
+        return;
+
+    std::vector<u8> data;
+    data.reserve(1024 * 1024);
+    DataSerializer dest(data);
+    dest.AddBytes(cSnapshotMagic, sizeof(cSnapshotMagic));
+    dest.AddU32(cSnapshotVersion);
+    dest.AddBytes(region_id.data, RexUUID::cSizeBytes);
+    size_t count_pos = dest.GetBytesFilled();
+    dest.AddU32(0);
+    dest.AddU32(0);
+
+    u32 count = 0;
+    for(Scene::SceneManager::iterator iter = scene->begin(); iter != scene->end(); ++iter)
+    {
+        Scene::EntityPtr entity = *iter;
+        if (!entity || !entity->GetComponent<EC_OpenSimPrim>())
+            continue;
+        if (unconfirmed_.find(entity->GetId()) != unconfirmed_.end())
+            continue;
+
+        size_t size_pos = dest.GetBytesFilled();
+        dest.AddU32(0);
+        primitive->SerializeToSnapshot(entity, dest);
+        dest.SetU32(size_pos, dest.GetBytesFilled() - size_pos - 4);
+        ++count;
+    }
+
+    dest.SetU32(count_pos, count);
+    dest.SetU32(count_pos + 4, Checksum(&data[cSnapshotHeaderSize], data.size() - cSnapshotHeaderSize));
+
+    // Write to a temporary file first, so that an interrupted write doesn't leave a broken snapshot behind
+    QDir().mkpath(QString::fromStdString(cache_path_));
+    QString path = QString::fromStdString(GetSnapshotPath(region_id));
+    QFile file(path + ".tmp");
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+        file.write((const char*)&data[0], data.size()) != (qint64)data.size())
+    {
+        RexLogicModule::LogWarning("Could not write scene snapshot " + path.toStdString());
+        file.remove();
+        return;
+    }
+    file.close();
+
+    QFile::remove(path);
+    if (!file.rename(path))
+    {
+        RexLogicModule::LogWarning("Could not write scene snapshot " + path.toStdString());
+        file.remove();
+        return;
+    }
+
+    RexLogicModule::LogDebug("Saved " + ToString(count) + " prims to scene snapshot, " + ToString(data.size()) + " bytes");
+}
+
+uint SceneSnapshot::Load(const RexUUID &region_id)
+{
+    PROFILE(SceneSnapshot_Load);
+
+    Scene::ScenePtr scene = rexlogicmodule_->GetCurrentActiveScene();
+    Primitive *primitive = rexlogicmodule_->GetPrimitiveHandler().get();
+    if (!scene || !primitive)
+        return 0;
+
+    QFile file(QString::fromStdString(GetSnapshotPath(region_id)));
+    if (!file.exists() || !file.open(QIODevice::ReadOnly))
+        return 0;
+
+    // Map the file to memory. If mapping is not supported, read it
+    size_t size = (size_t)file.size();
+    const u8 *data = size ? file.map(0, size) : 0;
+    QByteArray contents;
+    if (!data)
+    {
+        contents = file.readAll();
+        data = (const u8*)contents.constData();
+        size = contents.size();
+    }
+
+    if (size < cSnapshotHeaderSize)
+        return 0;
+
+    std::vector<entity_id_t> restored;
+    try
+    {
+        DataDeserializer source(data, size);
+        u8 magic[sizeof(cSnapshotMagic)];
+        source.ReadBytes(magic, sizeof(magic));
+        RexUUID file_region_id;
+        if (memcmp(magic, cSnapshotMagic, sizeof(magic)) != 0 || source.ReadU32() != cSnapshotVersion)
+        {
+            RexLogicModule::LogDebug("Ignoring scene snapshot of unsupported version");
+            return 0;
+        }
+        source.ReadBytes(file_region_id.data, RexUUID::cSizeBytes);
+        if (file_region_id != region_id)
+            return 0;
+
+        u32 count = source.ReadU32();
+        if (source.ReadU32() != Checksum(source.GetCurrentData(), source.GetBytesLeft()))
+        {
+            RexLogicModule::LogWarning("Ignoring corrupted scene snapshot " + file.fileName().toStdString());
+            return 0;
+        }
+
+        restored.reserve(count);
+        for(u32 i = 0; i < count; ++i)
+        {
+            u32 record_size = source.ReadU32();
+            const u8 *record = source.GetCurrentData();
+            source.Skip(record_size);
+
+            DataDeserializer record_source(record, record_size);
+            Scene::EntityPtr entity = primitive->DeserializeFromSnapshot(record_source);
+            if (entity)
+            {
+                restored.push_back(entity->GetId());
+                EC_OpenSimPrim *prim = entity->GetComponent<EC_OpenSimPrim>().get();
+                unconfirmed_[prim->LocalId] = prim->FullId;
+            }
+        }
+    }
+    catch (Exception &)
+    {
+        RexLogicModule::LogWarning("Malformed scene snapshot " + file.fileName().toStdString());
+    }
+
+    // Parent the prims now that they all exist
+    for(uint i = 0; i < restored.size(); ++i)
+        rexlogicmodule_->HandleObjectParent(restored[i]);
+
+    time_since_confirm_ = 0.0;
+    RexLogicModule::LogInfo("Restored " + ToString(restored.size()) + " prims from scene snapshot");
+    return restored.size();
+}
+
+std::string SceneSnapshot::GetSnapshotPath(const RexUUID &region_id) const
+{
+    return cache_path_ + "/" + region_id.ToString() + ".snapshot";
+}
+
+void SceneSnapshot::RemoveEntity(entity_id_t entityid, const RexUUID &fullid)
+{
+    Scene::ScenePtr scene = rexlogicmodule_->GetCurrentActiveScene();
+    if (!scene)
+        return;
+
+    // Make sure the entity is still the restored prim
+    Scene::EntityPtr entity = rexlogicmodule_->GetPrimEntity(entityid);
+    if (!entity || entity->GetComponent<EC_OpenSimPrim>()->FullId != fullid)
+        return;
+
+    scene->RemoveEntity(entityid);
+    rexlogicmodule_->UnregisterFullId(fullid);
+}
+
+}
@@ -0,0 +1,96 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   SceneSnapshot.h
+ *  @brief  Saves the prims of a region to disk on logout and restores them on the next connect.
+*/
+
+#ifndef incl_RexLogicModule_SceneSnapshot_h
+#define incl_RexLogicModule_SceneSnapshot_h
+
+#include "CoreTypes.h"
+#include "RexUUID.h"
+
+namespace RexLogic
+{
+    class RexLogicModule;
+
+    /** Binary snapshot of the prims of a region, for a fast warm start when returning to the region.
+
+        Without a snapshot every prim is built from scratch from ObjectUpdate, RexPrimData and RexFreeData messages
+        each time the region is entered. On logout the prims of the scene are written to a file in the cache
+        directory, named by the region id: ids, transform, prim shape, texture entry, RexPrimData and the entity
+        components. When the same region is entered again, the file is memory mapped and the prims are created
+        before the server has sent anything, so their meshes and textures start loading from the asset cache
+        immediately.
+
+        The restored prims are reconciled with the server by full id. An ObjectUpdate for a restored prim just
+        updates it. A restored prim is dropped if the server uses its local id for another object, or the full id
+        with another local id. Restored prims the server has not sent are removed once no more have been confirmed
+        for a while. Only the confirmed prims are saved again.
+
+        The file starts with a magic, the format version, the region id, the prim count and a checksum of the rest
+        of the data. Each prim record is prefixed with its size. A file with a different version, region or
+        checksum is ignored.
+    */
+    class SceneSnapshot
+    {
+    public:
+        explicit SceneSnapshot(RexLogicModule *rexlogicmodule);
+        ~SceneSnapshot();
+
+        /// Restores the snapshot of a region into the current scene. Called when the region handshake arrives.
+        /// @param region_id Id of the region entered.
+        void HandleRegionHandshake(const RexUUID &region_id);
+
+        /// Called before an object received from the server is created or updated. Drops a restored prim that
+        /// conflicts with it, or marks the restored prim as confirmed.
+        /// @param entityid Local id of the object.
+        /// @param fullid Full id of the object.
+        void Reconcile(entity_id_t entityid, const RexUUID &fullid);
+
+        /// Removes the restored prims the server has not confirmed once the confirm timeout has elapsed.
+        /// @param frametime Seconds since the last call.
+        void Update(f64 frametime);
+
+        /// Saves the snapshot of the current region. Called before the scene is deleted.
+        void HandleLogout();
+
+    private:
+        /// Writes the confirmed prims of the current scene to the snapshot file of a region.
+        void Save(const RexUUID &region_id);
+
+        /// Creates the prims in the snapshot file of a region.
+        /// @return Number of prims restored.
+        uint Load(const RexUUID &region_id);
+
+        /// @return Path of the snapshot file of a region.
+        std::string GetSnapshotPath(const RexUUID &region_id) const;
+
+        /// Removes a restored prim from the scene.
+        void RemoveEntity(entity_id_t entityid, const RexUUID &fullid);
+
+        RexLogicModule *rexlogicmodule_;
+
+        /// Directory of the snapshot files.
+        std::string cache_path_;
+
+        /// Whether snapshots are saved and restored.
+        bool enabled_;
+
+        /// Seconds to wait for more confirmations before removing the unconfirmed prims.
+        f64 confirm_timeout_;
+
+        /// Seconds since a restored prim was last confirmed.
+        f64 time_since_confirm_;
+
+        /// Region currently connected to, null if not known.
+        RexUUID region_id_;
+
+        /// Restored prims the server has not sent yet, full id by local id.
+        typedef std::map<entity_id_t, RexUUID> EntityIdMap;
+        EntityIdMap unconfirmed_;
+    };
+}
+
+#endif
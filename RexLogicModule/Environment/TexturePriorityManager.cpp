@@ -0,0 +1,160 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   TexturePriorityManager.cpp
+ *  @brief  Estimates the on-screen size of prim textures and passes it to the asset service as download priority.
+ */
+
+#include "StableHeaders.h"
+#include "Environment/TexturePriorityManager.h"
+#include "RexLogicModule.h"
+#include "EC_OgrePlaceable.h"
+#include "EC_OpenSimPrim.h"
+#include "Renderer.h"
+#include "SceneManager.h"
+#include "AssetServiceInterface.h"
+#include "ServiceManager.h"
+
+#include <OgreCamera.h>
+#include <OgreSceneNode.h>
+
+namespace RexLogic
+{
+
+/// How often the priorities are recomputed, in seconds.
+static const f64 cUpdateInterval = 0.5;
+
+/// Fraction of its size that a prim outside the view frustum gets.
+static const Real cOffscreenFactor = 0.05f;
+
+/// Priority changes smaller than this fraction are not passed on.
+static const Real cPriorityChange = 0.1f;
+
+/// Adds the on-screen size of a prim to a texture, if the texture id is set.
+static void AddTexturePriority(std::map<std::string, Real> &priorities, const std::string &texture_id, Real pixels)
+{
+    if (RexTypes::IsNull(texture_id))
+        return;
+
+    Real &priority = priorities[texture_id];
+    priority = std::max(priority, pixels);
+}
+
+TexturePriorityManager::TexturePriorityManager(RexLogicModule *rexlogicmodule) :
+    rexlogicmodule_(rexlogicmodule),
+    time_since_update_(0.0)
+{
+}
+
+TexturePriorityManager::~TexturePriorityManager()
+{
+}
+
+void TexturePriorityManager::Update(f64 frametime)
+{
+    time_since_update_ += frametime;
+    if (time_since_update_ < cUpdateInterval)
+        return;
+
+    time_since_update_ = 0.0;
+    UpdatePriorities();
+}
+
+void TexturePriorityManager::HandleLogout()
+{
+    sent_priorities_.clear();
+    time_since_update_ = 0.0;
+}
+
+void TexturePriorityManager::UpdatePriorities()
+{
+    PROFILE(TexturePriorityManager_UpdatePriorities);
+
+    Scene::ScenePtr scene = rexlogicmodule_->GetCurrentActiveScene();
+    OgreRenderer::RendererPtr renderer = rexlogicmodule_->GetOgreRendererPtr();
+    if (!scene || !renderer)
+        return;
+
+    Ogre::Camera *camera = renderer->GetCurrentCamera();
+    const Real width = (Real)renderer->GetWindowWidth();
+    const Real height = (Real)renderer->GetWindowHeight();
+    if (!camera || width <= 0.0f || height <= 0.0f)
+        return;
+
+    boost::shared_ptr<Foundation::AssetServiceInterface> asset_service = rexlogicmodule_->GetFramework()->GetServiceManager()->
+        GetService<Foundation::AssetServiceInterface>(Foundation::Service::ST_Asset).lock();
+    if (!asset_service)
+        return;
+
+    const Real screen_area = width * height;
+    const Real tan_half_fov = Ogre::Math::Tan(camera->getFOVy() * 0.5f);
+    const Ogre::Vector3 camera_pos = camera->getDerivedPosition();
+
+    TexturePriorityMap priorities;
+
+    for(Scene::SceneManager::iterator iter = scene->begin(); iter != scene->end(); ++iter)
+    {
+        Scene::EntityPtr entity = *iter;
+        if (!entity)
+            continue;
+
+        EC_OpenSimPrim *prim = entity->GetComponent<EC_OpenSimPrim>().get();
+        OgreRenderer::EC_OgrePlaceable *placeable = entity->GetComponent<OgreRenderer::EC_OgrePlaceable>().get();
+        if (!prim || !placeable || !placeable->GetSceneNode())
+            continue;
+
+        // Use the bounds of the attached geometry. If it isn't loaded yet, the node's scale is the best guess.
+        Ogre::SceneNode *node = placeable->GetSceneNode();
+        const Ogre::AxisAlignedBox &box = node->_getWorldAABB();
+        Ogre::Sphere bounds;
+        if (box.isFinite())
+            bounds = Ogre::Sphere(box.getCenter(), box.getHalfSize().length());
+        else
+            bounds = Ogre::Sphere(node->_getDerivedPosition(), (node->_getDerivedScale() * 0.5f).length());
+
+        const Real distance = bounds.getCenter().distance(camera_pos);
+        Real pixels = screen_area;
+        if (distance > bounds.getRadius())
+        {
+            Real projected_radius = bounds.getRadius() / (distance * tan_half_fov) * height * 0.5f;
+            pixels = std::min(Ogre::Math::PI * projected_radius * projected_radius, screen_area);
+        }
+
+        if (!camera->isVisible(bounds))
+            pixels *= cOffscreenFactor;
+
+        AddTexturePriority(priorities, prim->PrimDefaultTextureID, pixels);
+
+        for(TextureMap::const_iterator i = prim->PrimTextures.begin(); i != prim->PrimTextures.end(); ++i)
+            AddTexturePriority(priorities, i->second, pixels);
+
+        for(MaterialMap::const_iterator i = prim->Materials.begin(); i != prim->Materials.end(); ++i)
+            if (i->second.Type == RexTypes::RexAT_Texture)
+                AddTexturePriority(priorities, i->second.asset_id, pixels);
+    }
+
+    // Textures that are no longer used by any prim may still be requested by something else, so forget their
+    // priority instead of marking them invisible.
+    for(TexturePriorityMap::iterator i = sent_priorities_.begin(); i != sent_priorities_.end();)
+    {
+        if (priorities.find(i->first) == priorities.end())
+        {
+            asset_service->SetAssetPriority(i->first, -1.0f);
+            sent_priorities_.erase(i++);
+        }
+        else
+            ++i;
+    }
+
+    for(TexturePriorityMap::const_iterator i = priorities.begin(); i != priorities.end(); ++i)
+    {
+        TexturePriorityMap::iterator sent = sent_priorities_.find(i->first);
+        if (sent != sent_priorities_.end() && fabs(i->second - sent->second) <= sent->second * cPriorityChange)
+            continue;
+
+        asset_service->SetAssetPriority(i->first, i->second);
+        sent_priorities_[i->first] = i->second;
+    }
+}
+
+}
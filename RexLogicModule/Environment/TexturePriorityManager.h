@@ -0,0 +1,53 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   TexturePriorityManager.h
+ *  @brief  Estimates the on-screen size of prim textures and passes it to the asset service as download priority.
+*/
+
+#ifndef incl_RexLogicModule_TexturePriorityManager_h
+#define incl_RexLogicModule_TexturePriorityManager_h
+
+#include "CoreTypes.h"
+
+namespace RexLogic
+{
+    class RexLogicModule;
+
+    /** Drives the download priorities of prim textures from what the camera sees.
+
+        Every half a second the bounding sphere of each prim is projected with the current camera to get the number of
+        pixels it covers. Prims outside the view frustum get only a fraction of their size, so that they are loaded
+        after the visible ones. Each texture gets the size of the largest prim using it, and the sizes that have
+        changed noticeably are passed to AssetServiceInterface::SetAssetPriority. The UDP asset provider uses them to
+        order the requests, choose the discard level and park the textures that are not visible.
+    */
+    class TexturePriorityManager
+    {
+    public:
+        explicit TexturePriorityManager(RexLogicModule *rexlogicmodule);
+        ~TexturePriorityManager();
+
+        /// Recomputes the priorities if the update interval has elapsed.
+        /// @param frametime Seconds since the last call.
+        void Update(f64 frametime);
+
+        /// Forgets the priorities sent so far.
+        void HandleLogout();
+
+    private:
+        /// Computes the on-screen sizes of all textures in the scene and sends the changed ones.
+        void UpdatePriorities();
+
+        RexLogicModule *rexlogicmodule_;
+
+        /// Time since the priorities were last computed.
+        f64 time_since_update_;
+
+        /// Priorities last sent to the asset service, by texture id.
+        typedef std::map<std::string, Real> TexturePriorityMap;
+        TexturePriorityMap sent_priorities_;
+    };
+}
+
+#endif
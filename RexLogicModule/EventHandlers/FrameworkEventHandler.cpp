@@ -22,6 +22,16 @@ bool FrameworkEventHandler::HandleFrameworkEvent(event_id_t event_id, Foundation
         QString command, parameter;
         Foundation::ProgramOptionsEvent *po_event = static_cast<Foundation::ProgramOptionsEvent*>(data);
 
+        if (po_event->options.count("capture"))
+            rexLogic_->SetNetworkCaptureFilename(po_event->options["capture"].as<std::string>());
+
+        if (po_event->options.count("replay"))
+        {
+            if (!rexLogic_->StartNetworkReplay(po_event->options["replay"].as<std::string>(),
+                po_event->options["replay_speed"].as<double>(), po_event->options.count("exit_after_replay") > 0))
+                RexLogicModule::LogError("Could not play back network trace " + po_event->options["replay"].as<std::string>());
+        }
+
         for( int count = 0; count < po_event->argc; count++ )
             map[count] = QString(po_event->argv[count]);
 
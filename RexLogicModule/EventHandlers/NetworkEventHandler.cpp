@@ -11,6 +11,7 @@
 #include "BitStream.h"
 #include "Avatar/Avatar.h"
 #include "Environment/Primitive.h"
+#include "Environment/SceneSnapshot.h"
 #include "SceneEvents.h"
 #include "SoundServiceInterface.h"
 #include "AssetServiceInterface.h"
@@ -233,8 +234,16 @@ bool NetworkEventHandler::HandleOSNE_RegionHandshake(ProtocolUtilities::NetworkE
     msg.SkipToNextVariable();
     msg.SkipToNextVariable();*/
 
+    // Skip the rest of RegionInfo to get the region id
+    for(int i = 0; i < 21; ++i)
+        msg.SkipToNextVariable();
+    RexUUID region_id = msg.ReadUUID(); // RegionID
+
     RexLogicModule::LogInfo("Joined to sim " + sim_name);
 
+    // Restore the prims of the region from a previous visit before the server starts sending them
+    rexlogicmodule_->GetSceneSnapshot()->HandleRegionHandshake(region_id);
+
     // Create the "World" scene.
     boost::shared_ptr<ProtocolUtilities::ProtocolModuleInterface> sp = rexlogicmodule_->GetServerConnection()->GetCurrentProtocolModuleWeakPointer().lock();
     if (!sp.get())
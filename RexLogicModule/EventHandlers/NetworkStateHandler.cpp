@@ -8,6 +8,7 @@
 #include "StableHeaders.h"
 #include "EventHandlers/NetworkStateEventHandler.h"
 #include "RexLogicModule.h"
+#include "Environment/SceneSnapshot.h"
 #include "NetworkEvents.h"
 #include "Framework.h"
 #include "EventManager.h"
@@ -49,6 +50,7 @@ bool NetworkStateEventHandler::HandleNetworkStateEvent(event_id_t event_id, Foun
         // Make sure the rexlogic also thinks connection is closed.
         if (owner_->GetServerConnection()->IsConnected())
             owner_->GetServerConnection()->ForceServerDisconnect();
+        owner_->GetSceneSnapshot()->HandleLogout();
         if (owner_->GetFramework()->HasScene("World"))
             owner_->DeleteScene("World");
         break;
@@ -29,6 +29,8 @@
 #include "Avatar/AvatarEditor.h"
 #include "Avatar/AvatarControllable.h"
 #include "Environment/Primitive.h"
+#include "Environment/TexturePriorityManager.h"
+#include "Environment/SceneSnapshot.h"
 #include "CameraControllable.h"
 
 #include "EventManager.h"
@@ -45,6 +47,7 @@
 #include "SceneManager.h"
 #include "WorldStream.h"
 #include "UiModule.h"
+#include "ProtocolModuleOpenSim.h"
 
 // Ogre -specific
 #include "Renderer.h"
@@ -135,6 +138,8 @@ void RexLogicModule::Initialize()
     avatar_ = AvatarPtr(new Avatar(this));
     avatar_editor_ = AvatarEditorPtr(new AvatarEditor(this));
     primitive_ = PrimitivePtr(new Primitive(this));
+    texture_priority_manager_ = TexturePriorityManagerPtr(new TexturePriorityManager(this));
+    scene_snapshot_ = SceneSnapshotPtr(new SceneSnapshot(this));
     world_stream_ = WorldStreamPtr(new ProtocolUtilities::WorldStream(framework_));
     network_handler_ = new NetworkEventHandler(this);
     network_state_handler_ = new NetworkStateEventHandler(this);
@@ -246,6 +251,25 @@ void RexLogicModule::PostInitialize()
         "Adds/removes EC_Highlight for every prim and mesh. Usage: highlight(add|remove)."
         "If add is called and EC already exists for entity, EC's visibility is toggled.",
         Console::Bind(this, &RexLogicModule::ConsoleHighlightTest)));
+
+    RegisterConsoleCommand(Console::CreateCommand("Bandwidth",
+        "Shows the bandwidth budget and the per-category throttles. Usage: bandwidth(max kbps). "
+        "If a maximum is given, it is set as the largest total bandwidth the server is asked to use.",
+        Console::Bind(this, &RexLogicModule::ConsoleBandwidth)));
+
+    RegisterConsoleCommand(Console::CreateCommand("NetworkCapture",
+        "Records the inbound network traffic of the next connections to a trace file. Usage: NetworkCapture(filename). "
+        "Without a filename, stops recording.",
+        Console::Bind(this, &RexLogicModule::ConsoleNetworkCapture)));
+
+    RegisterConsoleCommand(Console::CreateCommand("NetworkReplay",
+        "Plays back a network trace instead of connecting to a server. Usage: NetworkReplay(filename, speed). "
+        "Speed 0 plays the trace back as fast as the messages are handled.",
+        Console::Bind(this, &RexLogicModule::ConsoleNetworkReplay)));
+
+    RegisterConsoleCommand(Console::CreateCommand("NetworkReplayStats",
+        "Shows the time spent handling each type of message of the network trace being played back.",
+        Console::Bind(this, &RexLogicModule::ConsoleNetworkReplayStats)));
 }
 
 void RexLogicModule::SubscribeToNetworkEvents(boost::weak_ptr<ProtocolUtilities::ProtocolModuleInterface> currentProtocolModule)
@@ -329,7 +353,10 @@ void RexLogicModule::DeleteScene(const std::string &name)
     }
 
     if (activeScene_ && activeScene_->Name() == name)
+    {
         activeScene_.reset(); ///\todo Check in SceneManager that scene names surely are unique. -jj.
+        avatar_->GetOverlayManager().Clear();
+    }
 
     framework_->RemoveScene(name);
     assert(!framework_->HasScene(name));
@@ -345,6 +372,8 @@ void RexLogicModule::Uninitialize()
     avatar_.reset();
     avatar_editor_.reset();
     primitive_.reset();
+    texture_priority_manager_.reset();
+    scene_snapshot_.reset();
     avatar_controllable_.reset();
     camera_controllable_.reset();
 
@@ -428,17 +457,16 @@ void RexLogicModule::Update(f64 frametime)
 
         if (world_stream_->IsConnected())
         {
+            world_stream_->UpdateBandwidth(frametime);
+            texture_priority_manager_->Update(frametime);
+            scene_snapshot_->Update(frametime);
             avatar_controllable_->AddTime(frametime);
             camera_controllable_->AddTime(frametime);
-            // Update overlays last, after camera update
-            //UpdateAvatarOverlays();
-            UpdateAvatarNameTags(avatar_->GetUserAvatar());
             input_handler_->Update(frametime);
 
+            // Update overlays last, after camera update
             UpdateAvatarOverlays();
-
-            UpdateAvatarNameTags(avatar_->GetUserAvatar());
-            
+            UpdateAvatarNameTags();
         }
     }
 
@@ -575,7 +603,10 @@ void RexLogicModule::EntityHovered(Scene::Entity* entity)
 {
     EC_HoveringWidget* widget = entity->GetComponent<EC_HoveringWidget>().get();
     if(widget)
+    {
         widget->HoveredOver();
+        avatar_->GetOverlayManager().AvatarHovered(entity->GetId());
+    }
 }
 
 Vector3df RexLogicModule::GetCameraPosition() const
@@ -636,6 +667,10 @@ void RexLogicModule::LogoutAndDeleteWorld()
 {
     AboutToDeleteWorld();
 
+    // Save the scene while it still exists
+    if (scene_snapshot_)
+        scene_snapshot_->HandleLogout();
+
     world_stream_->RequestLogout();
     world_stream_->ForceServerDisconnect(); // Because the current server doesn't send a logoutreplypacket.
 
@@ -643,6 +678,8 @@ void RexLogicModule::LogoutAndDeleteWorld()
         avatar_->HandleLogout();
     if (primitive_)
         primitive_->HandleLogout();
+    if (texture_priority_manager_)
+        texture_priority_manager_->HandleLogout();
 
     if (framework_->HasScene("World"))
         DeleteScene("World");
@@ -807,6 +844,7 @@ void RexLogicModule::UpdateObjects(f64 frametime)
 
         boost::shared_ptr<EC_OgrePlaceable> ogrepos = entity.GetComponent<EC_OgrePlaceable>();
         boost::shared_ptr<EC_NetworkPosition> netpos = entity.GetComponent<EC_NetworkPosition>();
+        bool moved = false;
         if (ogrepos && netpos)
         {
             if (netpos->time_since_update_ <= dead_reckoning_time_)
@@ -843,6 +881,7 @@ void RexLogicModule::UpdateObjects(f64 frametime)
 
                 ogrepos->SetPosition(netpos->damped_position_);
                 ogrepos->SetOrientation(netpos->damped_orientation_);
+                moved = true;
             }
         }
 
@@ -851,6 +890,8 @@ void RexLogicModule::UpdateObjects(f64 frametime)
         {
             found_avatars_.push_back(*iter);
             avatar_->UpdateAvatarAnimations(entity.GetId(), frametime);
+            if (moved)
+                avatar_->GetOverlayManager().AvatarMoved(entity.GetId(), netpos->damped_position_);
         }
 
         // General animation controller update
@@ -1000,47 +1041,10 @@ void RexLogicModule::AboutToDeleteWorld()
     }
 }
 
-void RexLogicModule::UpdateAvatarNameTags(Scene::EntityPtr users_avatar)
+void RexLogicModule::UpdateAvatarNameTags()
 {
-    Scene::ScenePtr current_scene = framework_->GetDefaultWorldScene();
-    if (!current_scene.get() || !users_avatar.get())
-        return;
-
-    // Iterate all avatars to a list
-    QList<Scene::EntityPtr> all_avatars;
-    Scene::SceneManager::iterator iter = current_scene->begin();
-    Scene::SceneManager::iterator end = current_scene->end();
-    while (iter != end)
-    {
-        Scene::EntityPtr entity = (*iter);
-        ++iter;
-        if (!entity.get() /*|| entity.get() == users_avatar.get()*/)
-            continue;
-        if (entity->GetComponent<EC_OpenSimPresence>().get())
-            all_avatars.append(entity);
-    }
-
-    // Get users position
-    boost::shared_ptr<EC_HoveringWidget> widget;
-    boost::shared_ptr<OgreRenderer::EC_OgrePlaceable> placable = users_avatar->GetComponent<OgreRenderer::EC_OgrePlaceable>();
-    if (!placable.get())
-        return;
-
-    Vector3Df camera_position = this->GetCameraPosition();
-    foreach (Scene::EntityPtr avatar, all_avatars)
-    {
-        placable = avatar->GetComponent<OgreRenderer::EC_OgrePlaceable>();
-        widget = avatar->GetComponent<EC_HoveringWidget>();
-
-        if (!placable.get() || !widget.get())
-            continue;
-
-
-        f32 distance = camera_position.getDistanceFrom(placable->GetPosition());
-        widget->SetCameraDistance(distance);
-    }
-
-
+    PROFILE(RexLogicModule_UpdateAvatarNameTags);
+    avatar_->GetOverlayManager().Update();
 }
 
 void RexLogicModule::EntityClicked(Scene::Entity* entity)
@@ -1117,6 +1121,123 @@ Console::CommandResult RexLogicModule::ConsoleToggleFlyMode(const StringVector &
     return Console::ResultSuccess();
 }
 
+Console::CommandResult RexLogicModule::ConsoleBandwidth(const StringVector &params)
+{
+    using namespace ProtocolUtilities;
+
+    if (params.size() > 1)
+        return Console::ResultFailure("Usage: bandwidth(max kbps)");
+
+    if (params.size() == 1)
+    {
+        Real kbps = ParseString<Real>(params[0], 0.0f);
+        if (kbps <= 0.0f)
+            return Console::ResultFailure("Invalid bandwidth: " + params[0]);
+
+        world_stream_->SetMaxBandwidth(kbps * 1000.0f);
+        GetFramework()->GetDefaultConfig().SetSetting("RexLogicModule", "max_bits_per_second", kbps * 1000.0f);
+    }
+
+    const BandwidthManager &bandwidth = world_stream_->GetBandwidthManager();
+    std::stringstream ss;
+    ss << "Budget " << (int)(bandwidth.GetBudget() / 1000.0f) << " / " << (int)(bandwidth.GetMaxBitsPerSecond() / 1000.0f)
+       << " kbps, loss " << (int)(bandwidth.GetLossRate() * 100.0f) << "%, pending textures " << bandwidth.GetPendingTextures()
+       << ", pending assets " << bandwidth.GetPendingAssets() << std::endl;
+    for(int i = 0; i < TC_NumCategories; ++i)
+    {
+        ThrottleCategory category = (ThrottleCategory)i;
+        ss << "  " << ThrottleCategoryName(category) << ": throttle " << (int)(bandwidth.GetThrottle(category) / 1000.0f)
+           << " kbps, measured " << (int)(bandwidth.GetMeasuredRate(category) / 1000.0f) << " kbps" << std::endl;
+    }
+
+    return Console::ResultSuccess(ss.str());
+}
+
+bool RexLogicModule::StartNetworkReplay(const std::string &filename, double speed, bool exit_when_finished)
+{
+    if (world_stream_->IsConnected())
+    {
+        LogError("Log out before playing back a network trace.");
+        return false;
+    }
+
+    world_stream_->UnregisterCurrentProtocolModule();
+    world_stream_->SetCurrentProtocolType(ProtocolUtilities::OpenSim);
+    if (!world_stream_->PrepareCurrentProtocolModule())
+        return false;
+
+    boost::shared_ptr<OpenSimProtocol::ProtocolModuleOpenSim> protocol = framework_->GetModuleManager()->
+        GetModule<OpenSimProtocol::ProtocolModuleOpenSim>(Foundation::Module::MT_OpenSimProtocol).lock();
+    if (!protocol)
+        return false;
+
+    // The connection is then created by Update(), like after a login.
+    return protocol->StartReplay(filename, speed, exit_when_finished);
+}
+
+void RexLogicModule::SetNetworkCaptureFilename(const std::string &filename)
+{
+    boost::shared_ptr<OpenSimProtocol::ProtocolModuleOpenSim> protocol = framework_->GetModuleManager()->
+        GetModule<OpenSimProtocol::ProtocolModuleOpenSim>(Foundation::Module::MT_OpenSimProtocol).lock();
+    if (protocol)
+        protocol->SetCaptureFilename(filename);
+}
+
+Console::CommandResult RexLogicModule::ConsoleNetworkCapture(const StringVector &params)
+{
+    if (params.size() > 1)
+        return Console::ResultFailure("Usage: NetworkCapture(filename)");
+
+    const std::string filename = params.empty() ? std::string() : params[0];
+    SetNetworkCaptureFilename(filename);
+
+    // Recording starts at the next connection, but can also be started or stopped on the current one.
+    if (world_stream_->IsConnected())
+    {
+        ProtocolUtilities::NetMessageManager *manager = world_stream_->GetCurrentProtocolModule()->GetNetworkMessageManager();
+        if (manager)
+        {
+            if (filename.empty())
+                manager->StopCapture();
+            else if (!manager->StartCapture(filename, world_stream_->GetInfo()))
+                return Console::ResultFailure("Could not create " + filename);
+        }
+    }
+
+    if (filename.empty())
+        return Console::ResultSuccess("Network capture stopped.");
+    return Console::ResultSuccess("Recording inbound network traffic to " + filename);
+}
+
+Console::CommandResult RexLogicModule::ConsoleNetworkReplay(const StringVector &params)
+{
+    if (params.empty() || params.size() > 2)
+        return Console::ResultFailure("Usage: NetworkReplay(filename, speed)");
+
+    const double speed = params.size() > 1 ? ParseString<double>(params[1], 1.0) : 1.0;
+    if (!StartNetworkReplay(params[0], speed, false))
+        return Console::ResultFailure("Could not play back " + params[0]);
+
+    return Console::ResultSuccess();
+}
+
+Console::CommandResult RexLogicModule::ConsoleNetworkReplayStats(const StringVector &params)
+{
+    boost::shared_ptr<OpenSimProtocol::ProtocolModuleOpenSim> protocol = framework_->GetModuleManager()->
+        GetModule<OpenSimProtocol::ProtocolModuleOpenSim>(Foundation::Module::MT_OpenSimProtocol).lock();
+    if (!protocol)
+        return Console::ResultFailure("OpenSim protocol module not available.");
+
+    StringVector report = protocol->GetReplayReport();
+    if (report.empty())
+        return Console::ResultFailure("No network trace is being played back.");
+
+    std::stringstream ss;
+    for(size_t i = 0; i < report.size(); ++i)
+        ss << report[i] << std::endl;
+    return Console::ResultSuccess(ss.str());
+}
+
 Console::CommandResult RexLogicModule::ConsoleHighlightTest(const StringVector &params)
 {
     if (!activeScene_)
@@ -53,6 +53,8 @@ namespace RexLogic
     class Avatar;
     class AvatarEditor;
     class Primitive;
+    class TexturePriorityManager;
+    class SceneSnapshot;
     class AvatarControllable;
     class CameraControllable;
     class OpenSimLoginHandler;
@@ -63,6 +65,8 @@ namespace RexLogic
     typedef boost::shared_ptr<Avatar> AvatarPtr;
     typedef boost::shared_ptr<AvatarEditor> AvatarEditorPtr;
     typedef boost::shared_ptr<Primitive> PrimitivePtr;
+    typedef boost::shared_ptr<TexturePriorityManager> TexturePriorityManagerPtr;
+    typedef boost::shared_ptr<SceneSnapshot> SceneSnapshotPtr;
     typedef boost::shared_ptr<AvatarControllable> AvatarControllablePtr;
     typedef boost::shared_ptr<CameraControllable> CameraControllablePtr;
 
@@ -127,6 +131,9 @@ namespace RexLogic
         //! @return The primitive handler object that manages reX primitive logic.
         PrimitivePtr GetPrimitiveHandler() const;
 
+        //! @return The scene snapshot handler that saves and restores the prims of regions.
+        SceneSnapshotPtr GetSceneSnapshot() const { return scene_snapshot_; }
+
         //! Returns the camera controllable
         CameraControllablePtr GetCameraControllable() const { return camera_controllable_; }
 
@@ -174,6 +181,17 @@ namespace RexLogic
         //! login from py - temp while loginui misses dllexport
         void StartLoginOpensim(QString &qfirstAndLast, QString &qpassword, QString &qserverAddressWithPort);
 
+        //! Plays back a network trace instead of logging in to a server, for benchmarking the handling of the inbound traffic
+        /*! \param filename trace recorded with SetNetworkCaptureFilename
+            \param speed playback speed relative to the recording, or 0 to play back as fast as the messages are handled
+            \param exit_when_finished if true, exits after the trace has been played back and the timings logged
+            \return true if the trace could be loaded
+         */
+        bool StartNetworkReplay(const std::string &filename, double speed, bool exit_when_finished);
+
+        //! Sets the file the inbound network traffic of the next OpenSim connections is recorded to. Empty disables recording.
+        void SetNetworkCaptureFilename(const std::string &filename);
+
         //! XXX have linking probs to AvatarController so trying this wrapper
         //! \todo figure workarounds for these functions so that dependency to RexLogicModule
         //! is not needed anymore.
@@ -253,9 +271,9 @@ namespace RexLogic
         //! Add functionality if you need something done before logout.
         void AboutToDeleteWorld();
 
-        //! Gets a map of all avatars in world and the distance from users avatar,
-        //! for updating the name tag fades after certain distance.
-        void UpdateAvatarNameTags(Scene::EntityPtr users_avatar);
+        //! Updates the name tags and buttons of the avatars whose distance from the camera changed enough,
+        //! or that entered the view. See AvatarOverlayManager.
+        void UpdateAvatarNameTags();
 
         //! login through console
         Console::CommandResult ConsoleLogin(const StringVector &params);
@@ -269,6 +287,18 @@ namespace RexLogic
         //! Console command for test EC_Highlight. Adds EC_Highlight for every avatar.
         Console::CommandResult ConsoleHighlightTest(const StringVector &params);
 
+        //! Shows the bandwidth throttles, or sets the maximum bandwidth, through console
+        Console::CommandResult ConsoleBandwidth(const StringVector &params);
+
+        //! Starts or stops recording the inbound network traffic through console
+        Console::CommandResult ConsoleNetworkCapture(const StringVector &params);
+
+        //! Plays back a network trace through console
+        Console::CommandResult ConsoleNetworkReplay(const StringVector &params);
+
+        //! Shows the progress and the message handling times of the network trace being played back through console
+        Console::CommandResult ConsoleNetworkReplayStats(const StringVector &params);
+
         //! Type of the module.
         static const Foundation::Module::Type type_static_ = Foundation::Module::MT_WorldLogic;
 
@@ -312,6 +342,12 @@ namespace RexLogic
         //! Primitive handler pointer.
         PrimitivePtr primitive_;
 
+        //! Texture download priority handler pointer.
+        TexturePriorityManagerPtr texture_priority_manager_;
+
+        //! Scene snapshot handler pointer.
+        SceneSnapshotPtr scene_snapshot_;
+
         //! Active scene pointer.
         Scene::ScenePtr activeScene_;
 
@@ -31,6 +31,15 @@ void XmlRpcConnection::SetServerAddress(const std::string& address, const std::s
 }
 
 XMLRPC_REQUEST XmlRpcConnection::Send(const char* data)
+{
+    std::vector<u8> response_data;
+    SendRaw(data, response_data);
+
+    // Convert the XML string to a XMLRPC reply structure.
+    return XMLRPC_REQUEST_FromXML((const char*)&response_data[0], (int)(response_data.size()), 0);
+}
+
+void XmlRpcConnection::SendRaw(const char* data, std::vector<u8> &reply)
 {
     HttpUtilities::HttpRequest request;
     request.SetUrl(strUrl_);
@@ -38,14 +47,12 @@ XMLRPC_REQUEST XmlRpcConnection::Send(const char* data)
     request.SetMethod(HttpUtilities::HttpRequest::Post);
     request.Perform();
     
-    const std::vector<u8> response_data = request.GetResponseData();
-    
     if (!request.GetSuccess())
         throw XmlRpcException(std::string("XmlRpcEpi exception in XmlRpcConnection::Send() " + request.GetReason()));
 
+    const std::vector<u8> &response_data = request.GetResponseData();
     if (response_data.size() == 0)
-        throw XmlRpcException(std::string("XmlRpcEpi exception in XmlRpcConnection::Send() response data size was zero: "));			
-    
-    // Convert the XML string to a XMLRPC reply structure.
-    return XMLRPC_REQUEST_FromXML((const char*)&response_data[0], (int)(response_data.size()), 0);
+        throw XmlRpcException(std::string("XmlRpcEpi exception in XmlRpcConnection::Send() response data size was zero: "));
+
+    reply = response_data;
 }
@@ -2,7 +2,9 @@
 #ifndef incl_RpcUtilities_XmlRpcConnection_h
 #define incl_RPCUtilities_XmlRpcConnection_h
 
+#include "CoreTypes.h"
 #include <xmlrpc.h>
+#include <vector>
 
 /**
  * Represents a XMLRPC connection. You can do multiple XMLRPC requests/replies using the same connection.
@@ -43,6 +45,14 @@ public:
 	 **/
 	XMLRPC_REQUEST Send(const char* data);  
 
+	/**
+	 * Sends the XMLRPC request data (pure xml) over to the server, but does not build the xmlrpc-epi reply tree.
+	 * @param data is pure xml which is constructed in @p XMLRPCCall -class
+	 * @param reply [out] receives the raw xml reply. Any old contents are discarded.
+	 * @throw XMLRPCException is send failed for some reason.
+	 **/
+	void SendRaw(const char* data, std::vector<u8> &reply);
+
 private:
 	std::string strUrl_;
 };
@@ -113,6 +113,38 @@ void XmlRpcEpi::Send()
     pXmlData = 0;
 }
 
+void XmlRpcEpi::SendRaw(std::vector<u8> &reply)
+{
+    if (call_ == 0)
+       throw XmlRpcException(std::string("XmlRpcEpi exception in XmlRpcEpi::SendRaw() Call object was zero pointer"));
+    else if (connection_ == 0)
+       throw XmlRpcException(std::string("XmlRpcEpi exception in XmlRpcEpi::SendRaw() Connection object was zero pointer"));
+
+    char *pXmlData = XMLRPC_REQUEST_ToXML(call_->GetRequest(), 0);
+    if (pXmlData == 0)
+        throw XmlRpcException(std::string("XmlRpcEpi exception in XmlRpcEpi::SendRaw() xml data was zero pointer"));
+
+    // The old parsed reply would be stale, so clear it out.
+    if (call_->GetReply() != 0)
+    {
+        XMLRPC_RequestFree(call_->GetReply(),1);
+        call_->SetReply(0);
+    }
+
+    try
+    {
+        connection_->SendRaw(pXmlData, reply);
+    }
+    catch(XmlRpcException& ex)
+    {
+        XMLRPC_Free(pXmlData);
+        pXmlData = 0;
+        throw ex;
+    }
+    XMLRPC_Free(pXmlData);
+    pXmlData = 0;
+}
+
 void XmlRpcEpi::AddStringToArray(const std::string& name, const char *sstr)
 {
     if (call_ != 0)
@@ -3,7 +3,9 @@
 #define incl_RpcUtilities_XmlRpcEpi_h
 
 #include "XmlRpcException.h"
+#include "CoreTypes.h"
 #include <string>
+#include <vector>
 
 class XmlRpcConnection;
 class XmlRpcCall;
@@ -80,6 +82,13 @@ class XmlRpcCall;
 			@throw XMLRPCException if message cannot be send or problem occures. */
 		void Send();
 
+		/** Sends the built xmlrpc-call like @p Send(), but leaves the reply unparsed. Use this when the reply is large
+			and is read with a streaming parser instead of the xmlrpc-epi value tree. After this call GetReply() and
+			HasReply() do not see the reply.
+			@param reply [out] receives the raw xml reply.
+			@throw XMLRPCException if message cannot be send or problem occures. */
+		void SendRaw(std::vector<u8> &reply);
+
 		/**
 		 * Sets a new call method name. 
 		 * @param method is new xmlrpc request method name. 
@@ -95,6 +95,7 @@ namespace Scene
             framework_->GetEventManager()->SendEvent(cat_id, Events::EVENT_ENTITY_DELETED, &event_data);
 
             entities_.erase(it);
+            spatial_index_.Remove(id);
             // If entity somehow manages to live, at least it doesn't belong to the scene anymore
             del_entity->SetScene(0);
             del_entity.reset();
@@ -7,6 +7,7 @@
 #include "CoreAnyIterator.h"
 #include "Entity.h"
 #include "ComponentInterface.h"
+#include "SpatialIndex.h"
 
 #include <QObject>
 
@@ -39,7 +40,7 @@ namespace Scene
         SceneManager(const std::string &name, Foundation::Framework *framework) :  name_(name), framework_(framework) {}
 
         //! copy constructor that also takes a name
-        SceneManager(const SceneManager &other, const std::string &name ) : framework_(other.framework_), entities_(other.entities_) { }
+        SceneManager(const SceneManager &other, const std::string &name ) : framework_(other.framework_), entities_(other.entities_), spatial_index_(other.spatial_index_) { }
 
         //! copy constuctor
         SceneManager(const SceneManager &other);
@@ -111,6 +112,12 @@ namespace Scene
         //! Returns entity map for introspection purposes
         const EntityMap &GetEntityMap() const { return entities_; }
 
+        //! Returns the index of entity positions, for proximity queries
+        /*! Entities are added to the index when their placeable is positioned, and removed with RemoveEntity().
+         */
+        SpatialIndex &GetSpatialIndex() { return spatial_index_; }
+        const SpatialIndex &GetSpatialIndex() const { return spatial_index_; }
+
         //! Return list of entities with a spesific component present.
         //! \param type_name Type name of the component
         EntityList GetEntitiesWithComponent(const std::string &type_name);
@@ -160,6 +167,9 @@ namespace Scene
 
         //! Name of the scene
         const std::string name_;
+
+        //! Index of entity positions
+        SpatialIndex spatial_index_;
         
     signals:
         //! Signal when a component is changed and should possibly be replicated (if the change originates from local)
@@ -0,0 +1,337 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+
+#include "SpatialIndex.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "MemoryLeakCheck.h"
+
+namespace Scene
+{
+    //! Computes the bounding box of a convex volume from the corners where its planes meet
+    /*! \return false if the volume is unbounded, f.ex. a frustum without a far plane
+     */
+    static bool GetVolumeBounds(const SpatialPlaneVector& planes, Vector3df& min, Vector3df& max)
+    {
+        const Real epsilon = 0.0001f;
+
+        // The volume is unbounded if some direction along the edge of two planes is not cut off by any plane
+        for (uint i = 0; i < planes.size(); ++i)
+            for (uint j = i + 1; j < planes.size(); ++j)
+            {
+                Vector3df direction = planes[i].normal_.crossProduct(planes[j].normal_);
+                if (direction.getLengthSQ() < epsilon)
+                    continue;
+
+                bool forward_open = true;
+                bool backward_open = true;
+                for (uint k = 0; k < planes.size(); ++k)
+                {
+                    const Real dot = planes[k].normal_.dotProduct(direction);
+                    forward_open = forward_open && dot > -epsilon;
+                    backward_open = backward_open && dot < epsilon;
+                }
+                if (forward_open || backward_open)
+                    return false;
+            }
+
+        bool found = false;
+        for (uint i = 0; i < planes.size(); ++i)
+            for (uint j = i + 1; j < planes.size(); ++j)
+                for (uint k = j + 1; k < planes.size(); ++k)
+                {
+                    const Vector3df& n1 = planes[i].normal_;
+                    const Vector3df& n2 = planes[j].normal_;
+                    const Vector3df& n3 = planes[k].normal_;
+                    const Vector3df n2n3 = n2.crossProduct(n3);
+                    const Real det = n1.dotProduct(n2n3);
+                    if (fabs(det) < epsilon)
+                        continue;
+
+                    const Vector3df corner = (n2n3 * -planes[i].distance_ + n3.crossProduct(n1) * -planes[j].distance_ +
+                        n1.crossProduct(n2) * -planes[k].distance_) / det;
+
+                    bool inside = true;
+                    for (uint l = 0; l < planes.size() && inside; ++l)
+                        inside = planes[l].normal_.dotProduct(corner) + planes[l].distance_ >= -0.01f;
+                    if (!inside)
+                        continue;
+
+                    if (!found)
+                    {
+                        min = max = corner;
+                        found = true;
+                    }
+                    else
+                    {
+                        min = Vector3df(std::min(min.x, corner.x), std::min(min.y, corner.y), std::min(min.z, corner.z));
+                        max = Vector3df(std::max(max.x, corner.x), std::max(max.y, corner.y), std::max(max.z, corner.z));
+                    }
+                }
+
+        return found;
+    }
+
+    SpatialIndex::SpatialIndex(Real cell_size) :
+        cell_size_(cell_size > 0.0f ? cell_size : 16.0f)
+    {
+    }
+
+    SpatialIndex::~SpatialIndex()
+    {
+    }
+
+    void SpatialIndex::SetPosition(entity_id_t id, const Vector3df& position, Real radius)
+    {
+        Item item;
+        item.id_ = id;
+        item.position_ = position;
+        item.radius_ = radius;
+
+        Location location;
+        location.cell_ = GetCell(position);
+        location.large_ = radius > cell_size_ * 0.5f;
+
+        LocationMap::iterator i = locations_.find(id);
+        if (i != locations_.end())
+        {
+            Location& old = i->second;
+
+            // Moving inside the same cell is the common case, update in place
+            if (old.large_ == location.large_ && (old.large_ || old.cell_ == location.cell_))
+            {
+                ItemVector& items = old.large_ ? large_ : cells_[old.cell_];
+                for (ItemVector::iterator j = items.begin(); j != items.end(); ++j)
+                    if (j->id_ == id)
+                    {
+                        *j = item;
+                        return;
+                    }
+            }
+
+            Remove(id);
+        }
+
+        if (location.large_)
+            large_.push_back(item);
+        else
+            cells_[location.cell_].push_back(item);
+        locations_[id] = location;
+    }
+
+    void SpatialIndex::Remove(entity_id_t id)
+    {
+        LocationMap::iterator i = locations_.find(id);
+        if (i == locations_.end())
+            return;
+
+        if (i->second.large_)
+            RemoveItem(large_, id);
+        else
+        {
+            CellMap::iterator cell = cells_.find(i->second.cell_);
+            if (cell != cells_.end())
+            {
+                RemoveItem(cell->second, id);
+                if (cell->second.empty())
+                    cells_.erase(cell);
+            }
+        }
+
+        locations_.erase(i);
+    }
+
+    void SpatialIndex::Clear()
+    {
+        cells_.clear();
+        large_.clear();
+        locations_.clear();
+    }
+
+    void SpatialIndex::QueryRadius(const Vector3df& center, Real radius, EntityIdVector& result) const
+    {
+        const Vector3df extent(radius, radius, radius);
+        std::vector<CellMap::const_iterator> cells;
+        GetCellsInBox(center - extent, center + extent, cells);
+
+        for (uint i = 0; i <= cells.size(); ++i)
+        {
+            const ItemVector& items = i < cells.size() ? cells[i]->second : large_;
+            for (ItemVector::const_iterator j = items.begin(); j != items.end(); ++j)
+            {
+                const Real max_distance = radius + j->radius_;
+                if (center.getDistanceFromSQ(j->position_) <= max_distance * max_distance)
+                    result.push_back(j->id_);
+            }
+        }
+    }
+
+    void SpatialIndex::QueryBox(const Vector3df& min, const Vector3df& max, EntityIdVector& result) const
+    {
+        std::vector<CellMap::const_iterator> cells;
+        GetCellsInBox(min, max, cells);
+
+        for (uint i = 0; i <= cells.size(); ++i)
+        {
+            const ItemVector& items = i < cells.size() ? cells[i]->second : large_;
+            for (ItemVector::const_iterator j = items.begin(); j != items.end(); ++j)
+            {
+                // Distance from the sphere center to the closest point of the box
+                const Vector3df& p = j->position_;
+                Vector3df closest(std::min(std::max(p.x, min.x), max.x), std::min(std::max(p.y, min.y), max.y),
+                    std::min(std::max(p.z, min.z), max.z));
+                if (p.getDistanceFromSQ(closest) <= j->radius_ * j->radius_)
+                    result.push_back(j->id_);
+            }
+        }
+    }
+
+    void SpatialIndex::QueryFrustum(const SpatialPlaneVector& planes, EntityIdVector& result) const
+    {
+        std::vector<CellMap::const_iterator> cells;
+        Vector3df volume_min, volume_max;
+        if (GetVolumeBounds(planes, volume_min, volume_max))
+            GetCellsInBox(volume_min, volume_max, cells);
+        else
+        {
+            for (CellMap::const_iterator i = cells_.begin(); i != cells_.end(); ++i)
+                cells.push_back(i);
+        }
+
+        for (uint i = 0; i <= cells.size(); ++i)
+        {
+            if (i < cells.size())
+            {
+                // Test the loose bounds of the cell first: a box is outside if its corner furthest along the plane
+                // normal is outside
+                Vector3df cell_min, cell_max;
+                GetCellBounds(cells[i]->first, cell_min, cell_max);
+                bool outside = false;
+                for (uint j = 0; j < planes.size() && !outside; ++j)
+                {
+                    const Vector3df& n = planes[j].normal_;
+                    Vector3df corner(n.x >= 0.0f ? cell_max.x : cell_min.x, n.y >= 0.0f ? cell_max.y : cell_min.y,
+                        n.z >= 0.0f ? cell_max.z : cell_min.z);
+                    outside = n.dotProduct(corner) + planes[j].distance_ < 0.0f;
+                }
+                if (outside)
+                    continue;
+            }
+
+            const ItemVector& items = i < cells.size() ? cells[i]->second : large_;
+            for (ItemVector::const_iterator j = items.begin(); j != items.end(); ++j)
+            {
+                bool inside = true;
+                for (uint k = 0; k < planes.size() && inside; ++k)
+                    inside = planes[k].normal_.dotProduct(j->position_) + planes[k].distance_ >= -j->radius_;
+                if (inside)
+                    result.push_back(j->id_);
+            }
+        }
+    }
+
+    void SpatialIndex::QueryNearest(const Vector3df& point, uint count, EntityIdVector& result, Real max_distance) const
+    {
+        if (count == 0 || locations_.empty())
+            return;
+
+        // Search a growing sphere until it contains enough entities. Every entity within the sphere is found,
+        // so the nearest ones are among them.
+        std::vector<std::pair<Real, entity_id_t> > found;
+        Real radius = cell_size_;
+        for(;;)
+        {
+            if (max_distance > 0.0f && radius > max_distance)
+                radius = max_distance;
+
+            found.clear();
+            const Vector3df extent(radius, radius, radius);
+            std::vector<CellMap::const_iterator> cells;
+            GetCellsInBox(point - extent, point + extent, cells);
+
+            for (uint i = 0; i <= cells.size(); ++i)
+            {
+                const ItemVector& items = i < cells.size() ? cells[i]->second : large_;
+                for (ItemVector::const_iterator j = items.begin(); j != items.end(); ++j)
+                {
+                    const Real distance_sq = point.getDistanceFromSQ(j->position_);
+                    if (distance_sq <= radius * radius)
+                        found.push_back(std::make_pair(distance_sq, j->id_));
+                }
+            }
+
+            if (found.size() >= count || found.size() == locations_.size() ||
+                (max_distance > 0.0f && radius >= max_distance))
+                break;
+
+            radius *= 2.0f;
+        }
+
+        const uint num_found = std::min<uint>(count, found.size());
+        std::partial_sort(found.begin(), found.begin() + num_found, found.end());
+        for (uint i = 0; i < num_found; ++i)
+            result.push_back(found[i].second);
+    }
+
+    SpatialIndex::Cell SpatialIndex::GetCell(const Vector3df& position) const
+    {
+        return Cell((int)floor(position.x / cell_size_), (int)floor(position.y / cell_size_),
+            (int)floor(position.z / cell_size_));
+    }
+
+    void SpatialIndex::GetCellsInBox(const Vector3df& min, const Vector3df& max, std::vector<CellMap::const_iterator>& cells) const
+    {
+        // Items may extend half a cell outside their cell
+        const Vector3df loose(cell_size_ * 0.5f, cell_size_ * 0.5f, cell_size_ * 0.5f);
+        const Cell min_cell = GetCell(min - loose);
+        const Cell max_cell = GetCell(max + loose);
+        if (max_cell.x_ < min_cell.x_ || max_cell.y_ < min_cell.y_ || max_cell.z_ < min_cell.z_)
+            return;
+
+        // For a big box it is cheaper to go through the occupied cells than the cells in the box
+        const double num_cells = double(max_cell.x_ - min_cell.x_ + 1) * double(max_cell.y_ - min_cell.y_ + 1) *
+            double(max_cell.z_ - min_cell.z_ + 1);
+        if (num_cells > cells_.size())
+        {
+            for (CellMap::const_iterator i = cells_.begin(); i != cells_.end(); ++i)
+            {
+                const Cell& c = i->first;
+                if (c.x_ >= min_cell.x_ && c.x_ <= max_cell.x_ && c.y_ >= min_cell.y_ && c.y_ <= max_cell.y_ &&
+                    c.z_ >= min_cell.z_ && c.z_ <= max_cell.z_)
+                    cells.push_back(i);
+            }
+            return;
+        }
+
+        for (int x = min_cell.x_; x <= max_cell.x_; ++x)
+            for (int y = min_cell.y_; y <= max_cell.y_; ++y)
+                for (int z = min_cell.z_; z <= max_cell.z_; ++z)
+                {
+                    CellMap::const_iterator i = cells_.find(Cell(x, y, z));
+                    if (i != cells_.end())
+                        cells.push_back(i);
+                }
+    }
+
+    void SpatialIndex::GetCellBounds(const Cell& cell, Vector3df& min, Vector3df& max) const
+    {
+        const Real half_cell = cell_size_ * 0.5f;
+        min = Vector3df(cell.x_ * cell_size_ - half_cell, cell.y_ * cell_size_ - half_cell, cell.z_ * cell_size_ - half_cell);
+        max = min + Vector3df(cell_size_ * 2.0f, cell_size_ * 2.0f, cell_size_ * 2.0f);
+    }
+
+    void SpatialIndex::RemoveItem(ItemVector& items, entity_id_t id)
+    {
+        for (uint i = 0; i < items.size(); ++i)
+            if (items[i].id_ == id)
+            {
+                items[i] = items.back();
+                items.pop_back();
+                return;
+            }
+    }
+}
@@ -0,0 +1,162 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_SceneManager_SpatialIndex_h
+#define incl_SceneManager_SpatialIndex_h
+
+#include "CoreTypes.h"
+#include "Vector3D.h"
+
+#include <boost/unordered_map.hpp>
+
+#include <vector>
+
+namespace Scene
+{
+    //! Plane bounding a query volume. Points for which normal_.dotProduct(point) + distance_ >= 0 are inside.
+    struct SpatialPlane
+    {
+        SpatialPlane() : distance_(0.0f) {}
+        SpatialPlane(const Vector3df& normal, Real distance) : normal_(normal), distance_(distance) {}
+
+        Vector3df normal_;
+        Real distance_;
+    };
+
+    typedef std::vector<SpatialPlane> SpatialPlaneVector;
+    typedef std::vector<entity_id_t> EntityIdVector;
+
+    //! Index of entity positions for proximity queries, so that they don't need to go through all entities.
+    /*! A loose uniform grid: an entity is stored in the cell that contains its center, and its bounding sphere
+        may extend half a cell outside the cell. Entities with a larger radius are kept in a separate list that
+        every query checks. Only occupied cells are stored.
+
+        The index of a scene is fed from EC_OgrePlaceable position changes, including those of parent placeables.
+        Entities are removed from it when they are removed from the scene or lose their placeable.
+        Use SceneManager::GetSpatialIndex().
+
+        \ingroup Scene_group
+     */
+    class SpatialIndex
+    {
+    public:
+        //! Constructor
+        //! \param cell_size Size of a grid cell. Should be about the radius of typical queries.
+        explicit SpatialIndex(Real cell_size = 16.0f);
+
+        //! Destructor
+        ~SpatialIndex();
+
+        //! Adds an entity to the index, or updates its position
+        /*! \param id Entity id
+            \param position Center of the entity
+            \param radius Bounding radius of the entity, or 0 to index the entity as a point
+         */
+        void SetPosition(entity_id_t id, const Vector3df& position, Real radius = 0.0f);
+
+        //! Removes an entity from the index
+        void Remove(entity_id_t id);
+
+        //! Removes all entities from the index
+        void Clear();
+
+        //! Returns true if the entity is in the index
+        bool Contains(entity_id_t id) const { return locations_.find(id) != locations_.end(); }
+
+        //! Returns number of entities in the index
+        uint GetNumEntities() const { return locations_.size(); }
+
+        //! Returns number of occupied grid cells
+        uint GetNumCells() const { return cells_.size(); }
+
+        //! Returns the entities whose bounding sphere intersects a sphere
+        /*! \param center Center of the sphere
+            \param radius Radius of the sphere
+            \param result Entity ids are appended here, in no particular order
+         */
+        void QueryRadius(const Vector3df& center, Real radius, EntityIdVector& result) const;
+
+        //! Returns the entities whose bounding sphere intersects an axis-aligned box
+        /*! \param min Minimum corner of the box
+            \param max Maximum corner of the box
+            \param result Entity ids are appended here, in no particular order
+         */
+        void QueryBox(const Vector3df& min, const Vector3df& max, EntityIdVector& result) const;
+
+        //! Returns the entities whose bounding sphere is at least partially inside a convex volume, f.ex. a view frustum
+        /*! \param planes Planes bounding the volume, with normals pointing inside
+            \param result Entity ids are appended here, in no particular order
+         */
+        void QueryFrustum(const SpatialPlaneVector& planes, EntityIdVector& result) const;
+
+        //! Returns the entities whose centers are nearest to a point
+        /*! \param point Point to measure the distance from
+            \param count Maximum number of entities to return
+            \param result Entity ids are appended here, nearest first
+            \param max_distance Maximum distance of the entities, or 0 for no limit
+         */
+        void QueryNearest(const Vector3df& point, uint count, EntityIdVector& result, Real max_distance = 0.0f) const;
+
+    private:
+        //! Grid cell coordinates
+        struct Cell
+        {
+            Cell() : x_(0), y_(0), z_(0) {}
+            Cell(int x, int y, int z) : x_(x), y_(y), z_(z) {}
+
+            bool operator == (const Cell& other) const { return x_ == other.x_ && y_ == other.y_ && z_ == other.z_; }
+
+            friend std::size_t hash_value(const Cell& cell)
+            {
+                return (std::size_t)cell.x_ * 73856093u ^ (std::size_t)cell.y_ * 19349663u ^ (std::size_t)cell.z_ * 83492791u;
+            }
+
+            int x_, y_, z_;
+        };
+
+        //! Indexed entity
+        struct Item
+        {
+            entity_id_t id_;
+            Vector3df position_;
+            Real radius_;
+        };
+
+        typedef std::vector<Item> ItemVector;
+        typedef boost::unordered_map<Cell, ItemVector> CellMap;
+
+        //! Where an entity is stored
+        struct Location
+        {
+            Cell cell_;
+            bool large_;
+        };
+
+        typedef boost::unordered_map<entity_id_t, Location> LocationMap;
+
+        //! Returns the cell that contains a position
+        Cell GetCell(const Vector3df& position) const;
+
+        //! Returns the cells whose items may intersect a box, that is, whose loose bounds intersect it
+        void GetCellsInBox(const Vector3df& min, const Vector3df& max, std::vector<CellMap::const_iterator>& cells) const;
+
+        //! Returns the loose bounds of a cell
+        void GetCellBounds(const Cell& cell, Vector3df& min, Vector3df& max) const;
+
+        //! Removes an item from a vector
+        static void RemoveItem(ItemVector& items, entity_id_t id);
+
+        //! Size of a cell
+        Real cell_size_;
+
+        //! Occupied cells
+        CellMap cells_;
+
+        //! Entities too large to be stored in a cell
+        ItemVector large_;
+
+        //! Locations of the entities
+        LocationMap locations_;
+    };
+}
+
+#endif